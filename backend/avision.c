@@ -132,7 +132,7 @@
 #include <math.h>
 
 #define BACKEND_NAME avision
-#define BACKEND_BUILD 297 /* avision backend BUILD version */
+#define BACKEND_BUILD 298 /* avision backend BUILD version */
 
 #include "../include/sane/sane.h"
 #include "../include/sane/sanei.h"
@@ -1614,6 +1614,10 @@ static SANE_Bool force_a3 = SANE_FALSE;
 /* trust ADF-presence flag, even if ADF model is nonzero */
 static SANE_Bool skip_adf = SANE_FALSE;
 
+/* number of SCSI image data reads kept in flight, 0 disables read-ahead */
+#define AVISION_READ_AHEAD_MAX 8
+static int read_ahead = 2;
+
 /* hardware resolutions to interpolate from */
 static const int  hw_res_list_c5[] =
   {
@@ -6919,6 +6923,164 @@ read_data (Avision_Scanner* s, SANE_Byte* buf, size_t* count)
   return status;
 }
 
+/* Read-ahead queue for the image data: keeps several READ commands in
+   flight while the reader process is busy with the current stripe, so
+   the scanner does not have to wait for the host. Only available for
+   SCSI connections, as the USB protocol requires each command to be
+   completed with a status read before the next one can be sent. */
+
+typedef struct read_queue_entry
+{
+  command_read cmd;
+  void* id;        /* sanei_scsi request id */
+  uint8_t* data;
+  size_t size;     /* requested size, transferred size once completed */
+  size_t offset;   /* bytes already handed out to the reader */
+  SANE_Bool done;
+  SANE_Status status;
+} read_queue_entry;
+
+typedef struct read_queue
+{
+  unsigned int depth;
+  unsigned int head;     /* oldest request, consumed next */
+  unsigned int pending;  /* number of entered, not yet consumed requests */
+  size_t chunk_size;
+  size_t queued_bytes;
+  size_t total_size;
+  read_queue_entry entry [AVISION_READ_AHEAD_MAX];
+} read_queue;
+
+static SANE_Status
+read_queue_init (read_queue* q, unsigned int depth, size_t chunk_size,
+		 size_t total_size)
+{
+  unsigned int i;
+
+  DBG (3, "read_queue_init: depth: %u, chunk_size: %lu\n",
+       depth, (u_long) chunk_size);
+
+  memset (q, 0, sizeof (*q));
+  q->depth = depth;
+  q->chunk_size = chunk_size;
+  q->total_size = total_size;
+
+  for (i = 0; i < depth; ++i) {
+    q->entry[i].data = malloc (chunk_size);
+    if (!q->entry[i].data) {
+      while (i-- > 0)
+	free (q->entry[i].data);
+      q->depth = 0;
+      return SANE_STATUS_NO_MEM;
+    }
+  }
+  return SANE_STATUS_GOOD;
+}
+
+/* enter new requests until the queue is full or all data is requested */
+static SANE_Status
+read_queue_fill (Avision_Scanner* s, read_queue* q)
+{
+  SANE_Status status = SANE_STATUS_GOOD;
+
+  while (q->pending < q->depth && q->queued_bytes < q->total_size)
+    {
+      read_queue_entry* e = &q->entry[(q->head + q->pending) % q->depth];
+      size_t count = q->chunk_size;
+
+      if (q->queued_bytes + count > q->total_size)
+	count = q->total_size - q->queued_bytes;
+
+      read_constrains(s, count);
+
+      memset (&e->cmd, 0, sizeof (e->cmd));
+      e->cmd.opc = AVISION_SCSI_READ;
+      e->cmd.datatypecode = AVISION_DATATYPECODE_READ_IMAGE_DATA;
+      set_double (e->cmd.datatypequal, s->hw->data_dq);
+      set_triple (e->cmd.transferlen, count);
+
+      e->size = count;
+      e->offset = 0;
+      e->done = SANE_FALSE;
+
+      DBG (9, "read_queue_fill: entering read of %lu\n", (u_long) count);
+      status = sanei_scsi_req_enter2 (s->av_con.scsi_fd, &e->cmd,
+				      sizeof (e->cmd), 0, 0,
+				      e->data, &e->size, &e->id);
+      if (status != SANE_STATUS_GOOD) {
+	DBG (1, "read_queue_fill: req_enter failed: %s\n",
+	     sane_strstatus (status));
+	break;
+      }
+
+      q->queued_bytes += count;
+      ++q->pending;
+    }
+
+  return status;
+}
+
+/* the read-ahead counterpart of read_data () */
+static SANE_Status
+read_queue_read (Avision_Scanner* s, read_queue* q,
+		 SANE_Byte* buf, size_t* count)
+{
+  read_queue_entry* e;
+  size_t avail;
+  SANE_Status status;
+
+  status = read_queue_fill (s, q);
+  if (q->pending == 0) {
+    *count = 0;
+    return status == SANE_STATUS_GOOD ? SANE_STATUS_EOF : status;
+  }
+
+  e = &q->entry[q->head];
+  if (!e->done) {
+    e->status = sanei_scsi_req_wait (e->id);
+    e->done = SANE_TRUE;
+    DBG (9, "read_queue_read: read completed: %lu, status: %d\n",
+	 (u_long) e->size, e->status);
+  }
+
+  avail = e->size - e->offset;
+  if (*count > avail)
+    *count = avail;
+
+  memcpy (buf, e->data + e->offset, *count);
+  e->offset += *count;
+
+  /* consumed, recycle the entry for the next request */
+  if (e->offset == e->size || e->status != SANE_STATUS_GOOD) {
+    q->head = (q->head + 1) % q->depth;
+    --q->pending;
+    if (e->status == SANE_STATUS_GOOD)
+      read_queue_fill (s, q);
+  }
+
+  return e->status;
+}
+
+static void
+read_queue_free (Avision_Scanner* s, read_queue* q)
+{
+  unsigned int i;
+
+  if (q->pending > 0) {
+    DBG (3, "read_queue_free: flushing %u outstanding reads\n", q->pending);
+#ifdef HAVE_SANEI_SCSI_OPEN_EXTENDED
+    sanei_scsi_req_flush_all_extended (s->av_con.scsi_fd);
+#else
+    sanei_scsi_req_flush_all ();
+#endif
+    q->pending = 0;
+  }
+
+  for (i = 0; i < q->depth; ++i)
+    free (q->entry[i].data);
+  q->depth = 0;
+}
+
 static SANE_Status
 init_options (Avision_Scanner* s)
 {
@@ -7424,6 +7586,8 @@ reader_process (void *data)
   /* interpolation output data, one line */
   uint8_t* ip_history = 0;
   uint8_t* ip_data = 0;
+  /* queued SCSI reads, if read-ahead is used */
+  read_queue queue;
 
   DBG (3, "reader_process:\n");
 
@@ -7605,6 +7769,20 @@ reader_process (void *data)
   processed_bytes = 0;
   stripe_fill = 0;
 
+  /* Keep reads in flight while we process the stripes. Not for
+     stripe interlaced duplex, as its first EOF must be hidden. */
+  queue.depth = 0;
+  if (read_ahead > 0 && s->av_con.connection_type == AV_SCSI &&
+      deinterlace != STRIPE && !s->duplex_rear_valid)
+    {
+      status = read_queue_init (&queue, read_ahead,
+				max_bytes_per_read -
+				max_bytes_per_read % s->avdimen.hw_bytes_per_line,
+				total_size);
+      if (status != SANE_STATUS_GOOD)
+	DBG (1, "reader_process: no memory for read-ahead, reading synchronously\n");
+    }
+
   /* First, dump background raster, bypassing all the other processing. */
   if (dev->inquiry_background_raster && s->val[OPT_BACKGROUND].w)
     {
@@ -7654,7 +7832,11 @@ reader_process (void *data)
 	    pthread_setcancelstate (PTHREAD_CANCEL_DISABLE, &old);
 #endif
 
-	  status = read_data (s, stripe_data + stripe_fill, &this_read);
+	  if (queue.depth > 0)
+	    status = read_queue_read (s, &queue, stripe_data + stripe_fill,
+				      &this_read);
+	  else
+	    status = read_data (s, stripe_data + stripe_fill, &this_read);
 
 	  if (sanei_thread_is_forked())
 	    sigprocmask (SIG_UNBLOCK, &sigterm_set, 0);
@@ -8122,6 +8304,9 @@ reader_process (void *data)
     } /* end while not all lines or inf. mode */
 
   DBG (3, "reader_process: i/o loop finished\n");
+  if (queue.depth > 0)
+    read_queue_free (s, &queue);
+
   if (exit_status == SANE_STATUS_GOOD)
     exit_status = SANE_STATUS_EOF;
 
@@ -8354,6 +8539,20 @@ sane_reload_devices (void)
 		     linenumber);
 		skip_adf = SANE_TRUE;
 	      }
+	      else if (strcmp (word, "read-ahead") == 0) {
+		free (word);
+		word = NULL;
+		cp = sanei_config_get_string (cp, &word);
+		if (word) {
+		  read_ahead = atoi (word);
+		  if (read_ahead < 0)
+		    read_ahead = 0;
+		  if (read_ahead > AVISION_READ_AHEAD_MAX)
+		    read_ahead = AVISION_READ_AHEAD_MAX;
+		}
+		DBG (3, "sane_reload_devices: config file line %d: read-ahead %d\n",
+		     linenumber, read_ahead);
+	      }
 	      else if (strcmp (word, "static-red-calib") == 0) {
 		DBG (3, "sane_reload_devices: config file line %d: static red calibration\n",
 		     linenumber);
@@ -132,6 +132,7 @@ struct ScannerState
   unsigned int m_pixelHeight;	/* height in pixels (network byte order) */
   unsigned int m_bytesRead;	/* bytes read by SANE (host byte order) */
   unsigned int m_currentPageBytes;/* number of bytes of current page read (host byte order) */
+  struct JpegDataDecompState *m_pJpeg;	/* decoder of the current JPEG page (or NULL) */
 };
 
 /* state data for a single page
@@ -145,12 +146,21 @@ struct PageInfo
   int m_bytesRemaining;        /* number of bytes not yet passed to SANE client */
 };
 
-/* struct for in-memory jpeg decompression */
+/* struct for incremental in-memory jpeg decompression
+   NOTE: compressed data is taken from ScannerState::m_buf as it arrives,
+   libjpeg is suspended when it runs out of data
+*/
 struct JpegDataDecompState
 {
   struct jpeg_decompress_struct m_cinfo;	/* base struct */
-  unsigned char *m_pData;	/* data pointer */
-  unsigned int m_bytesRemaining;	/* amount of unprocessed data */
+  struct jpeg_source_mgr m_srcMgr;	/* data source */
+  struct jpeg_error_mgr m_errMgr;	/* error handler */
+  int m_bHeader;		/* set non-0 when the header has been read */
+  int m_bStarted;		/* set non-0 when decompression has started */
+  int m_bEndOfPage;		/* set non-0 when no more data will arrive */
+  unsigned long m_skip;		/* bytes to skip from data yet to arrive */
+  JSAMPLE *m_pLine;		/* storage for a single scanline */
+  int m_scanLineSize;		/* scanline size (bytes) */
 };
 
 /* initial ComBuf allocation */
@@ -218,6 +228,12 @@ static int ProcessTcpResponse (struct ScannerState *pState,
 /* Process the data from a single scanned page, \return 0 in success, >0 otherwise */
 static int ProcessPageData (struct ScannerState *pState);
 
+/* Decode as much of the received JPEG page data as possible, \return 0 in success, >0 otherwise */
+static int ProcessJpegData (struct ScannerState *pState, int bEndOfPage);
+
+/* frees the JPEG decoder of the current page */
+static void FreeJpegState (struct ScannerState *pState);
+
 /* Libjpeg decompression interface */
 static void JpegDecompInitSource (j_decompress_ptr cinfo);
 static boolean JpegDecompFillInputBuffer (j_decompress_ptr cinfo);
@@ -1303,6 +1319,9 @@ FreeScannerState (int iHandle)
   /* free m_imageData */
   FreeComBuf (&gOpenScanners[iHandle]->m_imageData);
 
+  /* free JPEG decoder */
+  FreeJpegState (gOpenScanners[iHandle]);
+
   /* free the struct */
   free (gOpenScanners[iHandle]);
 
@@ -1670,6 +1689,7 @@ ProcessTcpResponse (struct ScannerState *pState, struct ComBuf *pTcpBuf)
 
           /* reset the data buffer ready to store a new page */
           pState->m_buf.m_used = 0;
+          FreeJpegState (pState);
 
           /* init current page size */
           pState->m_currentPageBytes = 0;
@@ -1731,6 +1751,10 @@ ProcessTcpResponse (struct ScannerState *pState, struct ComBuf *pTcpBuf)
 
           pItem += dataChunkSize;
 
+          /* decode JPEG data as it arrives, rather than at the end of the page */
+          if (!errorCheck && ntohl (pState->m_compression) == 0x20)
+            errorCheck |= ProcessJpegData (pState, 0);
+
           DBG (10, "Accumulated %lu bytes of scan data so far\n",
                (unsigned long)pState->m_buf.m_used);
         } /* if */
@@ -1791,14 +1815,11 @@ ProcessPageData (struct ScannerState *pState)
 
   FILE *fTmp;
   int fdTmp;
-  struct jpeg_source_mgr jpegSrcMgr;
-  struct JpegDataDecompState jpegCinfo;
-  struct jpeg_error_mgr jpegErr;
-  int numPixels, iPixel, width, height, scanLineSize, imageBytes;
+  j_decompress_ptr cinfo;
+  int numPixels, iPixel, width, height, imageBytes;
   int ret = 0;
   struct PageInfo pageInfo;
 
-  JSAMPLE *pJpegLine = NULL;
   uint32 *pTiffRgba = NULL;
   unsigned char *pOut;
   char tiffErrBuf[1024];
@@ -1806,7 +1827,7 @@ ProcessPageData (struct ScannerState *pState)
   TIFF *pTiff = NULL;
 
   /* If there's no data then there's nothing to write */
-  if (!pState->m_buf.m_used)
+  if (!pState->m_buf.m_used && !pState->m_pJpeg)
     return 0;
 
   DBG (1, "ProcessPageData: Got compression %x\n",
@@ -1819,60 +1840,19 @@ ProcessPageData (struct ScannerState *pState)
       /* decode as JPEG if appropriate */
       {
 
-        jpegSrcMgr.resync_to_restart = jpeg_resync_to_restart;
-        jpegSrcMgr.init_source = JpegDecompInitSource;
-        jpegSrcMgr.fill_input_buffer = JpegDecompFillInputBuffer;
-        jpegSrcMgr.skip_input_data = JpegDecompSkipInputData;
-        jpegSrcMgr.term_source = JpegDecompTermSource;
-
-        jpegCinfo.m_cinfo.err = jpeg_std_error (&jpegErr);
-        jpeg_create_decompress (&jpegCinfo.m_cinfo);
-        jpegCinfo.m_cinfo.src = &jpegSrcMgr;
-        jpegCinfo.m_bytesRemaining = pState->m_buf.m_used;
-        jpegCinfo.m_pData = pState->m_buf.m_pBuf;
-
-        jpeg_read_header (&jpegCinfo.m_cinfo, TRUE);
-        jpeg_start_decompress (&jpegCinfo.m_cinfo);
-
-        /* allocate space for a single scanline */
-        scanLineSize = jpegCinfo.m_cinfo.output_width
-          * jpegCinfo.m_cinfo.output_components;
-        DBG (1, "ProcessPageData: image dimensions: %d x %d, line size: %d\n",
-        jpegCinfo.m_cinfo.output_width,
-        jpegCinfo.m_cinfo.output_height, scanLineSize);
-
-        pJpegLine = calloc (scanLineSize, sizeof (JSAMPLE));
-        if (!pJpegLine)
+        /* decode the data that has not been decoded on arrival */
+        ret |= ProcessJpegData (pState, 1);
+        if (ret || !pState->m_pJpeg->m_bStarted)
           {
-            DBG (1, "ProcessPageData: memory allocation error\n");
+            DBG (1, "ProcessPageData: error decoding JPEG page\n");
             ret = 1;
             goto JPEG_CLEANUP;
           } /* if */
-
-        /* note dimensions - may be different from those previously reported */
-        pState->m_pixelWidth = htonl (jpegCinfo.m_cinfo.output_width);
-        pState->m_pixelHeight = htonl (jpegCinfo.m_cinfo.output_height);
-
-        /* decode scanlines */
-        while (jpegCinfo.m_cinfo.output_scanline
-               < jpegCinfo.m_cinfo.output_height)
-          {
-            DBG (20, "Reading scanline %d of %d\n",
-                 jpegCinfo.m_cinfo.output_scanline,
-                 jpegCinfo.m_cinfo.output_height);
-
-            /* read scanline */
-            jpeg_read_scanlines (&jpegCinfo.m_cinfo, &pJpegLine, 1);
-
-            /* append to output buffer */
-            ret |= AppendToComBuf (&pState->m_imageData,
-                                   pJpegLine, scanLineSize);
-
-          } /* while */
+        cinfo = &pState->m_pJpeg->m_cinfo;
 
         /* update info for this page */
-        pageInfo.m_width = jpegCinfo.m_cinfo.output_width;
-        pageInfo.m_height = jpegCinfo.m_cinfo.output_height;
+        pageInfo.m_width = cinfo->output_width;
+        pageInfo.m_height = cinfo->output_height;
         pageInfo.m_totalSize = pageInfo.m_width * pageInfo.m_height * 3;
         pageInfo.m_bytesRemaining = pageInfo.m_totalSize;
 
@@ -1882,12 +1862,10 @@ ProcessPageData (struct ScannerState *pState)
         ret |= AppendToComBuf( & pState->m_pageInfo, (unsigned char*)& pageInfo, sizeof( pageInfo ) );
         ++( pState->m_numPages );
 
-      JPEG_CLEANUP:
-        jpeg_finish_decompress (&jpegCinfo.m_cinfo);
-        jpeg_destroy_decompress (&jpegCinfo.m_cinfo);
+        jpeg_finish_decompress (cinfo);
 
-        if (pJpegLine)
-          free (pJpegLine);
+      JPEG_CLEANUP:
+        FreeJpegState (pState);
 
         return ret;
       } /* case JPEG */
@@ -2002,11 +1980,137 @@ ProcessPageData (struct ScannerState *pState)
 
 /***********************************************************/
 
+/* Decode as much of the received JPEG page data as possible, \return 0 in success, >0 otherwise */
+int
+ProcessJpegData (struct ScannerState *pState, int bEndOfPage)
+{
+
+  struct JpegDataDecompState *pJpeg = pState->m_pJpeg;
+  j_decompress_ptr cinfo;
+  size_t skip;
+  int ret = 0;
+
+  /* set up a decoder at the start of the page */
+  if (!pJpeg)
+    {
+      if (!(pJpeg = calloc (1, sizeof (struct JpegDataDecompState))))
+        {
+          DBG (1, "ProcessJpegData: memory allocation error\n");
+          return 1;
+        }
+
+      pJpeg->m_srcMgr.resync_to_restart = jpeg_resync_to_restart;
+      pJpeg->m_srcMgr.init_source = JpegDecompInitSource;
+      pJpeg->m_srcMgr.fill_input_buffer = JpegDecompFillInputBuffer;
+      pJpeg->m_srcMgr.skip_input_data = JpegDecompSkipInputData;
+      pJpeg->m_srcMgr.term_source = JpegDecompTermSource;
+
+      pJpeg->m_cinfo.err = jpeg_std_error (&pJpeg->m_errMgr);
+      jpeg_create_decompress (&pJpeg->m_cinfo);
+      pJpeg->m_cinfo.src = &pJpeg->m_srcMgr;
+
+      pState->m_pJpeg = pJpeg;
+    }
+
+  cinfo = &pJpeg->m_cinfo;
+  pJpeg->m_bEndOfPage = bEndOfPage;
+
+  /* drop data that libjpeg has asked to skip */
+  skip = pJpeg->m_skip;
+  if (skip > pState->m_buf.m_used)
+    skip = pState->m_buf.m_used;
+  PopFromComBuf (&pState->m_buf, skip);
+  pJpeg->m_skip -= skip;
+
+  /* point the source at the buffered data (the buffer may have moved) */
+  pJpeg->m_srcMgr.next_input_byte = (const JOCTET *) pState->m_buf.m_pBuf;
+  pJpeg->m_srcMgr.bytes_in_buffer = pState->m_buf.m_used;
+
+  if (!pJpeg->m_bHeader)
+    {
+      if (jpeg_read_header (cinfo, TRUE) == JPEG_SUSPENDED)
+        goto JPEG_SUSPEND;
+      pJpeg->m_bHeader = 1;
+    }
+
+  if (!pJpeg->m_bStarted)
+    {
+      if (!jpeg_start_decompress (cinfo))
+        goto JPEG_SUSPEND;
+      pJpeg->m_bStarted = 1;
+
+      /* allocate space for a single scanline */
+      pJpeg->m_scanLineSize = cinfo->output_width * cinfo->output_components;
+      DBG (1, "ProcessJpegData: image dimensions: %d x %d, line size: %d\n",
+           cinfo->output_width, cinfo->output_height, pJpeg->m_scanLineSize);
+
+      pJpeg->m_pLine = calloc (pJpeg->m_scanLineSize, sizeof (JSAMPLE));
+      if (!pJpeg->m_pLine)
+        {
+          DBG (1, "ProcessJpegData: memory allocation error\n");
+          ret = 1;
+          goto JPEG_SUSPEND;
+        } /* if */
+
+      /* note dimensions - may be different from those previously reported */
+      pState->m_pixelWidth = htonl (cinfo->output_width);
+      pState->m_pixelHeight = htonl (cinfo->output_height);
+    }
+
+  /* decode scanlines until we run out of data */
+  while (cinfo->output_scanline < cinfo->output_height)
+    {
+      DBG (20, "Reading scanline %d of %d\n",
+           cinfo->output_scanline, cinfo->output_height);
+
+      /* read scanline */
+      if (jpeg_read_scanlines (cinfo, &pJpeg->m_pLine, 1) != 1)
+        break;
+
+      /* append to output buffer */
+      ret |= AppendToComBuf (&pState->m_imageData,
+                             pJpeg->m_pLine, pJpeg->m_scanLineSize);
+
+    } /* while */
+
+JPEG_SUSPEND:
+
+  /* remove the data libjpeg has consumed, the rest is kept for the next call */
+  if (bEndOfPage)
+    pState->m_buf.m_used = 0;
+  else
+    PopFromComBuf (&pState->m_buf,
+                   pState->m_buf.m_used - pJpeg->m_srcMgr.bytes_in_buffer);
+
+  return ret;
+
+} /* ProcessJpegData */
+
+/***********************************************************/
+
+/* frees the JPEG decoder of the current page */
+void
+FreeJpegState (struct ScannerState *pState)
+{
+
+  if (!pState->m_pJpeg)
+    return;
+
+  jpeg_destroy_decompress (&pState->m_pJpeg->m_cinfo);
+  if (pState->m_pJpeg->m_pLine)
+    free (pState->m_pJpeg->m_pLine);
+  free (pState->m_pJpeg);
+  pState->m_pJpeg = NULL;
+
+} /* FreeJpegState */
+
+/***********************************************************/
+
 void
-JpegDecompInitSource (j_decompress_ptr cinfo)
+JpegDecompInitSource (j_decompress_ptr __sane_unused__ cinfo)
 /* Libjpeg decompression interface */
 {
-  cinfo->src->bytes_in_buffer = 0;
+  /* nothing to do, ProcessJpegData points the source at the data */
 
 } /* JpegDecompInitSource */
 
@@ -2021,28 +2125,16 @@ JpegDecompFillInputBuffer (j_decompress_ptr cinfo)
     0xFF, JPEG_EOI
   };
 
-  DBG (10, "JpegDecompFillInputBuffer: bytes remaining: %d\n",
-       pState->m_bytesRemaining);
-
-  if (!pState->m_bytesRemaining)
-    {
-
-      /* no input data available so return dummy data */
-      cinfo->src->bytes_in_buffer = 2;
-      cinfo->src->next_input_byte = (const JOCTET *) eoiByte;
-
-    }
-  else
-    {
-
-      /* point to data */
-      cinfo->src->bytes_in_buffer = pState->m_bytesRemaining;
-      cinfo->src->next_input_byte = (const JOCTET *) pState->m_pData;
+  DBG (10, "JpegDecompFillInputBuffer: end of page: %d\n",
+       pState->m_bEndOfPage);
 
-      /* note that data is now gone */
-      pState->m_bytesRemaining = 0;
+  /* suspend until more data arrives */
+  if (!pState->m_bEndOfPage)
+    return FALSE;
 
-    } /* if */
+  /* no input data available so return dummy data */
+  cinfo->src->bytes_in_buffer = 2;
+  cinfo->src->next_input_byte = (const JOCTET *) eoiByte;
 
   return TRUE;
 
@@ -2054,8 +2146,20 @@ void
 JpegDecompSkipInputData (j_decompress_ptr cinfo, long numBytes)
 /* Libjpeg decompression interface */
 {
+  struct JpegDataDecompState *pState = (struct JpegDataDecompState *) cinfo;
+
   DBG (10, "JpegDecompSkipInputData: skipping %ld bytes\n", numBytes);
 
+  if (numBytes <= 0)
+    return;
+
+  /* skip the part that has not arrived yet later */
+  if ((size_t) numBytes > cinfo->src->bytes_in_buffer)
+    {
+      pState->m_skip += numBytes - cinfo->src->bytes_in_buffer;
+      numBytes = cinfo->src->bytes_in_buffer;
+    }
+
   cinfo->src->bytes_in_buffer -= numBytes;
   cinfo->src->next_input_byte += numBytes;
 
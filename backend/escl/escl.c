@@ -604,6 +604,23 @@ _get_resolution(escl_sane_t *handler, int resol)
 }
 
 
+/**
+ * \fn static void _update_jpeg_passthrough(escl_sane_t *s)
+ * \brief Function that enables the JPEG passthrough option only if the
+ *        current source can deliver JPEG data.
+ */
+static void
+_update_jpeg_passthrough(escl_sane_t *s)
+{
+#if(defined HAVE_LIBJPEG)
+    if (s->scanner->caps[s->scanner->source].have_jpeg != -1) {
+        s->opt[OPT_JPEG_PASSTHROUGH].cap &= ~SANE_CAP_INACTIVE;
+        return;
+    }
+#endif
+    s->opt[OPT_JPEG_PASSTHROUGH].cap |= SANE_CAP_INACTIVE;
+}
+
 /**
  * \fn static SANE_Status init_options(SANE_String_Const name, escl_sane_t *s)
  * \brief Function thzt initializes all the needed options of the received scanner
@@ -723,6 +740,8 @@ init_options_small(SANE_String_Const name_source, escl_sane_t *s)
       free (s->val[OPT_SCAN_SOURCE].s);
     s->val[OPT_SCAN_SOURCE].s = strdup (s->scanner->Sources[s->scanner->source]);
 
+    _update_jpeg_passthrough(s);
+
     return (SANE_STATUS_GOOD);
 }
 
@@ -938,6 +957,20 @@ init_options(SANE_String_Const name_source, escl_sane_t *s)
        free (s->val[OPT_SCAN_SOURCE].s);
     s->val[OPT_SCAN_SOURCE].s = strdup (s->scanner->Sources[s->scanner->source]);
 
+	/* OPT_JPEG_PASSTHROUGH */
+    s->opt[OPT_JPEG_PASSTHROUGH].name = "jpeg-passthrough";
+    s->opt[OPT_JPEG_PASSTHROUGH].title = SANE_I18N ("JPEG passthrough");
+    s->opt[OPT_JPEG_PASSTHROUGH].desc =
+        SANE_I18N ("Deliver the JPEG data of the scanner without decoding it. "
+                   "The frontend must support JPEG frames. Not used if the "
+                   "scan area doesn't start at the top left corner, as the "
+                   "data can only be cropped when it is decoded.");
+    s->opt[OPT_JPEG_PASSTHROUGH].type = SANE_TYPE_BOOL;
+    s->opt[OPT_JPEG_PASSTHROUGH].cap =
+        SANE_CAP_SOFT_SELECT | SANE_CAP_SOFT_DETECT | SANE_CAP_ADVANCED;
+    s->val[OPT_JPEG_PASSTHROUGH].w = SANE_FALSE;
+    _update_jpeg_passthrough(s);
+
     /* "Enhancement" group: */
     s->opt[OPT_ENHANCEMENT_GROUP].title = SANE_I18N ("Enhancement");
     s->opt[OPT_ENHANCEMENT_GROUP].desc = "";    /* not valid for a group */
@@ -1293,6 +1326,7 @@ sane_control_option(SANE_Handle h, SANE_Int n, SANE_Action a, void *v, SANE_Int
 	case OPT_NUM_OPTS:
 	case OPT_PREVIEW:
 	case OPT_GRAY_PREVIEW:
+	case OPT_JPEG_PASSTHROUGH:
 	case OPT_RESOLUTION:
         case OPT_BRIGHTNESS:
         case OPT_CONTRAST:
@@ -1318,6 +1352,7 @@ sane_control_option(SANE_Handle h, SANE_Int n, SANE_Action a, void *v, SANE_Int
 	case OPT_NUM_OPTS:
 	case OPT_PREVIEW:
 	case OPT_GRAY_PREVIEW:
+	case OPT_JPEG_PASSTHROUGH:
         case OPT_BRIGHTNESS:
         case OPT_CONTRAST:
         case OPT_SHARPEN:
@@ -1574,6 +1609,17 @@ sane_start(SANE_Handle h)
        else
           DBG(10, "Don't have Brightness\n");
 
+       handler->scanner->use_jpeg_passthrough =
+           IS_ACTIVE(OPT_JPEG_PASSTHROUGH) &&
+           handler->val[OPT_JPEG_PASSTHROUGH].w == SANE_TRUE;
+       /* the image is cropped while decoding, which passthrough skips */
+       if (handler->scanner->use_jpeg_passthrough &&
+           (handler->scanner->caps[handler->scanner->source].pos_x > 0 ||
+            handler->scanner->caps[handler->scanner->source].pos_y > 0)) {
+          DBG(10, "Scan area is cropped, decoding JPEG data\n");
+          handler->scanner->use_jpeg_passthrough = 0;
+       }
+
        handler->result = escl_newjob(handler->scanner, handler->device, &status);
        if (status != SANE_STATUS_GOOD)
           return (status);
@@ -1595,9 +1641,15 @@ sane_start(SANE_Handle h)
     status = escl_scan(handler->scanner, handler->device, handler->result);
     if (status != SANE_STATUS_GOOD)
        return (status);
+    handler->ps.format = SANE_FRAME_RGB;
     if (!strcmp(handler->scanner->caps[handler->scanner->source].default_format, "image/jpeg"))
     {
-       status = get_JPEG_data(handler->scanner, &w, &he, &bps);
+       if (handler->scanner->use_jpeg_passthrough) {
+          status = get_JPEG_raw_data(handler->scanner, &w, &he, &bps);
+          handler->ps.format = SANE_FRAME_JPEG;
+       }
+       else
+          status = get_JPEG_data(handler->scanner, &w, &he, &bps);
     }
     else if (!strcmp(handler->scanner->caps[handler->scanner->source].default_format, "image/png"))
     {
@@ -1625,7 +1677,6 @@ sane_start(SANE_Handle h)
     handler->ps.lines = he;
     handler->ps.bytes_per_line = w * bps;
     handler->ps.last_frame = SANE_TRUE;
-    handler->ps.format = SANE_FRAME_RGB;
     handler->scanner->work = SANE_FALSE;
 //    DBG(10, "NEXT Frame [%s]\n", (handler->ps.last_frame ? "Non" : "Oui"));
     DBG(10, "Real Size Image [%dx%d|%dx%d]\n", 0, 0, w, he);
@@ -1652,7 +1703,7 @@ sane_get_parameters(SANE_Handle h, SANE_Parameters *p)
     if (p != NULL) {
         p->depth = 8;
         p->last_frame = handler->ps.last_frame;
-        p->format = SANE_FRAME_RGB;
+        p->format = handler->ps.format;
         p->pixels_per_line = handler->ps.pixels_per_line;
         p->lines = handler->ps.lines;
         p->bytes_per_line = handler->ps.bytes_per_line;
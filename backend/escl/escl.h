@@ -44,6 +44,7 @@
 #endif
 
 #include "../include/sane/sane.h"
+#include "../include/sane/sanei_frame.h"
 
 #include <stdio.h>
 #include <math.h>
@@ -173,6 +174,7 @@ typedef struct capabilities
     int val_sharpen;
     int use_threshold;
     int val_threshold;
+    int use_jpeg_passthrough;
 } capabilities_t;
 
 typedef struct {
@@ -195,6 +197,7 @@ enum
     OPT_MODE,
     OPT_RESOLUTION,
     OPT_SCAN_SOURCE,
+    OPT_JPEG_PASSTHROUGH,
 
     OPT_GEOMETRY_GROUP,
     OPT_TL_X,
@@ -263,6 +266,11 @@ SANE_Status get_JPEG_data(capabilities_t *scanner,
                           int *height,
                           int *bps);
 
+SANE_Status get_JPEG_raw_data(capabilities_t *scanner,
+                              int *width,
+                              int *height,
+                              int *bps);
+
 // PNG
 SANE_Status get_PNG_data(capabilities_t *scanner,
                          int *width,
@@ -266,6 +266,68 @@ get_JPEG_data(capabilities_t *scanner, int *width, int *height, int *bps)
     scanner->tmp = NULL;
     return (SANE_STATUS_GOOD);
 }
+
+/**
+ * \fn SANE_Status get_JPEG_raw_data(capabilities_t *scanner, int *width, int *height, int *bps)
+ * \brief Function that loads the JPEG file received from the scanner as is,
+ *        without decoding it. Only the header is parsed to get the image size.
+ *
+ * \return SANE_STATUS_GOOD (if everything is OK, otherwise, SANE_STATUS_NO_MEM/SANE_STATUS_INVAL)
+ */
+SANE_Status
+get_JPEG_raw_data(capabilities_t *scanner, int *width, int *height, int *bps)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct my_error_mgr jerr;
+    unsigned char *data = NULL;
+    long size = 0;
+
+    if (scanner->tmp == NULL)
+        return (SANE_STATUS_INVAL);
+    fseek(scanner->tmp, 0, SEEK_SET);
+    cinfo.err = jpeg_std_error(&jerr.errmgr);
+    jerr.errmgr.error_exit = my_error_exit;
+    jerr.errmgr.output_message = output_no_message;
+    if (setjmp(jerr.escape)) {
+        jpeg_destroy_decompress(&cinfo);
+        DBG( 1, "Escl Jpeg : Error reading jpeg header\n");
+        fclose(scanner->tmp);
+        scanner->tmp = NULL;
+        return (SANE_STATUS_INVAL);
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_RW_src(&cinfo, scanner->tmp);
+    jpeg_read_header(&cinfo, TRUE);
+    *width = cinfo.image_width;
+    *height = cinfo.image_height;
+    *bps = cinfo.num_components;
+    jpeg_destroy_decompress(&cinfo);
+
+    if (fseek(scanner->tmp, 0, SEEK_END) == 0)
+        size = ftell(scanner->tmp);
+    if (size > 0)
+        data = malloc(size);
+    if (data == NULL) {
+        DBG( 1, "Escl Jpeg : Memory allocation problem\n");
+        fclose(scanner->tmp);
+        scanner->tmp = NULL;
+        return (SANE_STATUS_NO_MEM);
+    }
+    fseek(scanner->tmp, 0, SEEK_SET);
+    if (fread(data, 1, size, scanner->tmp) != (size_t)size) {
+        DBG( 1, "Escl Jpeg : Error reading jpeg file\n");
+        free(data);
+        fclose(scanner->tmp);
+        scanner->tmp = NULL;
+        return (SANE_STATUS_IO_ERROR);
+    }
+    scanner->img_data = data;
+    scanner->img_size = size;
+    scanner->img_read = 0;
+    fclose(scanner->tmp);
+    scanner->tmp = NULL;
+    return (SANE_STATUS_GOOD);
+}
 #else
 
 SANE_Status
@@ -277,4 +339,13 @@ get_JPEG_data(capabilities_t __sane_unused__ *scanner,
     return (SANE_STATUS_INVAL);
 }
 
+SANE_Status
+get_JPEG_raw_data(capabilities_t __sane_unused__ *scanner,
+                  int __sane_unused__ *width,
+                  int __sane_unused__ *height,
+                  int __sane_unused__ *bps)
+{
+    return (SANE_STATUS_INVAL);
+}
+
 #endif
@@ -170,7 +170,11 @@ escl_newjob (capabilities_t *scanner, const ESCL_Device *device, SANE_Status *st
     int have_tiff = scanner->caps[scanner->source].have_tiff;
     int have_pdf = scanner->caps[scanner->source].have_pdf;
 
-    if ((scanner->source == PLATEN && have_pdf == -1) ||
+    if (scanner->use_jpeg_passthrough && have_jpeg != -1) {
+	    scanner->caps[scanner->source].default_format =
+		    strdup(scanner->caps[scanner->source].DocumentFormats[have_jpeg]);
+    }
+    else if ((scanner->source == PLATEN && have_pdf == -1) ||
         (scanner->source > PLATEN)) {
 	    if (have_tiff != -1) {
 		    scanner->caps[scanner->source].default_format =
@@ -0,0 +1,168 @@
+/* sane - Scanner Access Now Easy.
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#define DEBUG_DECLARE_ONLY
+
+#include "background.h"
+#include "error.h"
+#include <chrono>
+
+namespace genesys {
+
+namespace {
+
+// the worker whose task runs on the current thread, if any
+thread_local BackgroundWorker* s_current_worker = nullptr;
+
+} // namespace
+
+BackgroundWorker::~BackgroundWorker()
+{
+    stop(true);
+}
+
+void BackgroundWorker::start(Task task)
+{
+    stop(true);
+
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        finish_requested_ = false;
+        cancel_requested_ = false;
+        seen_change_generation_ = change_generation_;
+        tracks_changes_ = false;
+    }
+
+    thread_ = std::thread([this, task]()
+    {
+        s_current_worker = this;
+        catch_all_exceptions("BackgroundWorker", [&]() { task(*this); });
+    });
+}
+
+void BackgroundWorker::finish()
+{
+    stop(false);
+}
+
+void BackgroundWorker::cancel()
+{
+    stop(true);
+}
+
+void BackgroundWorker::stop(bool cancel)
+{
+    if (!thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        finish_requested_ = true;
+        if (cancel) {
+            cancel_requested_ = true;
+        }
+    }
+    cond_.notify_all();
+    thread_.join();
+}
+
+void BackgroundWorker::notify_changed()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        change_generation_++;
+    }
+    cond_.notify_all();
+}
+
+bool BackgroundWorker::has_unseen_change() const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    return tracks_changes_ && change_generation_ != seen_change_generation_;
+}
+
+bool BackgroundWorker::is_cancelled() const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    return cancel_requested_;
+}
+
+void BackgroundWorker::mark_changes_seen()
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    seen_change_generation_ = change_generation_;
+    tracks_changes_ = true;
+}
+
+void BackgroundWorker::throw_if_cancelled()
+{
+    if (!s_current_worker) {
+        return;
+    }
+    if (s_current_worker->is_cancelled()) {
+        throw SaneException(SANE_STATUS_CANCELLED, "background task has been cancelled");
+    }
+    if (s_current_worker->has_unseen_change()) {
+        throw SaneException(SANE_STATUS_CANCELLED, "background task has been outdated by a change");
+    }
+}
+
+bool BackgroundWorker::sleep_ms(unsigned ms)
+{
+    std::unique_lock<std::mutex> lock{mutex_};
+    return !cond_.wait_for(lock, std::chrono::milliseconds(ms),
+                           [this]() { return cancel_requested_; });
+}
+
+bool BackgroundWorker::wait_for_finish(unsigned ms)
+{
+    std::unique_lock<std::mutex> lock{mutex_};
+    return cond_.wait_for(lock, std::chrono::milliseconds(ms),
+                          [this]() { return finish_requested_; });
+}
+
+bool BackgroundWorker::wait_for_settled_change(unsigned settle_ms)
+{
+    std::unique_lock<std::mutex> lock{mutex_};
+    while (true) {
+        cond_.wait(lock, [this]()
+        {
+            return finish_requested_ || change_generation_ != seen_change_generation_;
+        });
+        if (finish_requested_) {
+            return false;
+        }
+
+        // the frontend usually sets several options in a row, so wait until it's done
+        unsigned generation = change_generation_;
+        bool changed_again = cond_.wait_for(lock, std::chrono::milliseconds(settle_ms),
+                                            [this, generation]()
+        {
+            return finish_requested_ || change_generation_ != generation;
+        });
+        if (finish_requested_) {
+            return false;
+        }
+        if (!changed_again) {
+            seen_change_generation_ = generation;
+            return true;
+        }
+    }
+}
+
+} // namespace genesys
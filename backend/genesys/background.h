@@ -0,0 +1,134 @@
+/* sane - Scanner Access Now Easy.
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BACKEND_GENESYS_BACKGROUND_H
+#define BACKEND_GENESYS_BACKGROUND_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace genesys {
+
+/*  Runs a single task on a background thread on behalf of a device.
+
+    The task and the frontend-facing entry points share the device, thus both must hold the lock
+    returned by lock_device() while accessing it. The task may hold that lock for a long time, so
+    the option values that both read are guarded by the separate lock returned by lock_settings(),
+    which is held only briefly. When both locks are needed, the device lock is taken first.
+
+    The task can be asked either to finish, in which case it is expected to complete its current
+    step and exit, or to be cancelled, in which case it is expected to exit as soon as possible.
+    Changes that may invalidate the work done by the task are signalled via notify_changed().
+*/
+class BackgroundWorker
+{
+public:
+    using Task = std::function<void(BackgroundWorker&)>;
+
+    BackgroundWorker() = default;
+    BackgroundWorker(const BackgroundWorker&) = delete;
+    BackgroundWorker& operator=(const BackgroundWorker&) = delete;
+    ~BackgroundWorker();
+
+    // Starts the given task. Any previously running task is cancelled first
+    void start(Task task);
+
+    bool is_running() const { return thread_.joinable(); }
+
+    // Asks the task to exit once it completes its current step and waits until it does so
+    void finish();
+
+    // Asks the task to exit as soon as possible and waits until it does so
+    void cancel();
+
+    std::unique_lock<std::mutex> lock_device()
+    {
+        return std::unique_lock<std::mutex>{device_mutex_};
+    }
+
+    // Returns a lock that does not own the mutex if the device lock is already held
+    std::unique_lock<std::mutex> try_lock_device()
+    {
+        return std::unique_lock<std::mutex>{device_mutex_, std::try_to_lock};
+    }
+
+    std::unique_lock<std::mutex> lock_settings()
+    {
+        return std::unique_lock<std::mutex>{settings_mutex_};
+    }
+
+    /*  Signals the task that the work it has done may need to be redone. Once the task tracks
+        changes, the step it is currently doing is abandoned, see throw_if_cancelled().
+    */
+    void notify_changed();
+
+    /*  Returns whether a change has been signalled that the task has not picked up since it last
+        called mark_changes_seen(). Always false before the first such call.
+    */
+    bool has_unseen_change() const;
+
+    // The following functions are to be called only from within the task
+
+    bool is_cancelled() const;
+
+    /*  Marks all changes signalled so far as seen. Until the task calls this for the first time,
+        the work it does is assumed not to depend on what the changes are about.
+    */
+    void mark_changes_seen();
+
+    /*  Throws SaneException with SANE_STATUS_CANCELLED if called from within a task that has been
+        cancelled or has an unseen change (see has_unseen_change()) and does nothing otherwise.
+        Long operations that are shared between the task and the frontend-facing entry points call
+        this at the points where it is safe to stop.
+    */
+    static void throw_if_cancelled();
+
+    // Sleeps for the given time. Returns false if the task has been cancelled in the meantime
+    bool sleep_ms(unsigned ms);
+
+    // Waits for the given time. Returns true if the task has been asked to finish or has been
+    // cancelled in the meantime
+    bool wait_for_finish(unsigned ms);
+
+    /*  Waits until a change is signalled and no further changes are signalled for settle_ms
+        milliseconds. Returns false if the task has been asked to finish or has been cancelled in
+        the meantime.
+    */
+    bool wait_for_settled_change(unsigned settle_ms);
+
+private:
+    void stop(bool cancel);
+
+    std::thread thread_;
+    std::mutex device_mutex_;
+    std::mutex settings_mutex_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    bool finish_requested_ = false;
+    bool cancel_requested_ = false;
+    unsigned change_generation_ = 0;
+    unsigned seen_change_generation_ = 0;
+    bool tracks_changes_ = false;
+};
+
+} // namespace genesys
+
+#endif // BACKEND_GENESYS_BACKGROUND_H
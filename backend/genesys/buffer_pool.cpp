@@ -0,0 +1,251 @@
+/* sane - Scanner Access Now Easy.
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#define DEBUG_DECLARE_ONLY
+
+#include "buffer_pool.h"
+#include "error.h"
+#include <algorithm>
+#include <new>
+
+namespace genesys {
+
+namespace {
+
+thread_local std::shared_ptr<BufferPool> s_current_pool;
+
+} // namespace
+
+constexpr std::size_t BufferPool::MIN_POOLED_SIZE;
+constexpr std::size_t BufferPool::MAX_SIZE_RATIO;
+constexpr std::size_t BufferPool::RECENT_SESSION_COUNT;
+
+std::vector<std::uint8_t> BufferPool::acquire(std::size_t capacity)
+{
+    std::vector<std::uint8_t> buffer;
+    if (capacity < MIN_POOLED_SIZE) {
+        buffer.reserve(capacity);
+        return buffer;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+
+        auto best = free_.end();
+        for (auto it = free_.begin(); it != free_.end(); ++it) {
+            auto it_capacity = it->capacity();
+            if (it_capacity < capacity || it_capacity / MAX_SIZE_RATIO > capacity) {
+                continue;
+            }
+            if (best == free_.end() || it_capacity < best->capacity()) {
+                best = it;
+            }
+        }
+
+        if (best != free_.end()) {
+            buffer = std::move(*best);
+            free_.erase(best);
+            pooled_bytes_ -= buffer.capacity();
+            in_use_bytes_ += buffer.capacity();
+            session_peak_bytes_ = std::max(session_peak_bytes_, in_use_bytes_);
+            reused_count_++;
+            return buffer;
+        }
+    }
+
+    try {
+        buffer.reserve(capacity);
+    } catch (const std::bad_alloc&) {
+        // the memory kept for later sessions is better spent on this one
+        clear();
+        buffer.reserve(capacity);
+    }
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    in_use_bytes_ += buffer.capacity();
+    session_peak_bytes_ = std::max(session_peak_bytes_, in_use_bytes_);
+    allocated_count_++;
+    return buffer;
+}
+
+void BufferPool::release(std::vector<std::uint8_t>&& buffer)
+{
+    std::vector<std::uint8_t> released = std::move(buffer);
+    auto capacity = released.capacity();
+    if (capacity < MIN_POOLED_SIZE) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    in_use_bytes_ -= std::min(in_use_bytes_, capacity);
+
+    if (pooled_bytes_ + capacity > limit()) {
+        return;
+    }
+    released.clear();
+    try {
+        free_.push_back(std::move(released));
+    } catch (const std::bad_alloc&) {
+        return;
+    }
+    pooled_bytes_ += capacity;
+}
+
+void BufferPool::begin_session()
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    recent_peak_bytes_.push_back(session_peak_bytes_);
+    if (recent_peak_bytes_.size() > RECENT_SESSION_COUNT) {
+        recent_peak_bytes_.erase(recent_peak_bytes_.begin());
+    }
+    session_peak_bytes_ = in_use_bytes_;
+
+    trim(limit());
+
+    DBG(DBG_info, "%s: pooled %zu bytes in %zu buffers, %zu bytes in use, reused %zu, "
+        "allocated %zu\n", __func__, pooled_bytes_, free_.size(), in_use_bytes_,
+        reused_count_, allocated_count_);
+}
+
+void BufferPool::clear()
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    trim(0);
+}
+
+std::size_t BufferPool::pooled_bytes() const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    return pooled_bytes_;
+}
+
+std::size_t BufferPool::in_use_bytes() const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    return in_use_bytes_;
+}
+
+std::size_t BufferPool::reused_count() const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    return reused_count_;
+}
+
+std::size_t BufferPool::allocated_count() const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    return allocated_count_;
+}
+
+std::size_t BufferPool::limit() const
+{
+    std::size_t result = session_peak_bytes_;
+    for (auto peak : recent_peak_bytes_) {
+        result = std::max(result, peak);
+    }
+    return result;
+}
+
+void BufferPool::trim(std::size_t max_bytes)
+{
+    // the oldest buffers are the least likely to be needed again
+    auto it = free_.begin();
+    while (pooled_bytes_ > max_bytes && it != free_.end()) {
+        pooled_bytes_ -= it->capacity();
+        ++it;
+    }
+    free_.erase(free_.begin(), it);
+}
+
+BufferPool::Scope::Scope(const std::shared_ptr<BufferPool>& pool) :
+    previous_{s_current_pool}
+{
+    s_current_pool = pool;
+}
+
+BufferPool::Scope::~Scope()
+{
+    s_current_pool = previous_;
+}
+
+const std::shared_ptr<BufferPool>& BufferPool::current()
+{
+    return s_current_pool;
+}
+
+PooledBuffer::PooledBuffer(const PooledBuffer& other) :
+    pool_{other.pool_}
+{
+    if (pool_) {
+        data_ = pool_->acquire(other.size());
+    }
+    data_.assign(other.data_.begin(), other.data_.end());
+}
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept :
+    pool_{std::move(other.pool_)},
+    data_{std::move(other.data_)}
+{}
+
+PooledBuffer& PooledBuffer::operator=(const PooledBuffer& other)
+{
+    if (this != &other) {
+        *this = PooledBuffer{other};
+    }
+    return *this;
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        pool_ = std::move(other.pool_);
+        data_ = std::move(other.data_);
+    }
+    return *this;
+}
+
+PooledBuffer::~PooledBuffer()
+{
+    release();
+}
+
+void PooledBuffer::resize(std::size_t size)
+{
+    if (!pool_ || size <= data_.capacity()) {
+        data_.resize(size);
+        return;
+    }
+
+    auto new_data = pool_->acquire(size);
+    new_data.assign(data_.begin(), data_.end());
+    new_data.resize(size);
+    pool_->release(std::move(data_));
+    data_ = std::move(new_data);
+}
+
+void PooledBuffer::release()
+{
+    if (pool_) {
+        pool_->release(std::move(data_));
+    }
+    data_.clear();
+}
+
+} // namespace genesys
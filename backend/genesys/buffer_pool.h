@@ -0,0 +1,138 @@
+/* sane - Scanner Access Now Easy.
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BACKEND_GENESYS_BUFFER_POOL_H
+#define BACKEND_GENESYS_BUFFER_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace genesys {
+
+/*  Keeps the memory of large image buffers alive between scan sessions, so that the pipeline
+    buffers and calibration images of each scan don't need to be allocated and faulted in again.
+
+    The amount of kept memory is limited to the largest amount of pooled buffers that was in use
+    at once during the recent sessions. Buffers that are not needed by recent sessions are freed
+    when a new session begins. All memory is freed by clear() and when an allocation fails.
+*/
+class BufferPool
+{
+public:
+    // smaller buffers are left to the allocator, which handles them well
+    static constexpr std::size_t MIN_POOLED_SIZE = 32 * 1024;
+    // a pooled buffer is reused only if it's at most this many times larger than requested
+    static constexpr std::size_t MAX_SIZE_RATIO = 2;
+    // the number of sessions whose peak usage limits the size of the pool
+    static constexpr std::size_t RECENT_SESSION_COUNT = 8;
+
+    BufferPool() = default;
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // returns an empty vector with capacity of at least the given size
+    std::vector<std::uint8_t> acquire(std::size_t capacity);
+
+    // gives the memory of a vector obtained from acquire() back to the pool
+    void release(std::vector<std::uint8_t>&& buffer);
+
+    // marks the start of a new scan session
+    void begin_session();
+
+    // frees all memory that is not in use
+    void clear();
+
+    std::size_t pooled_bytes() const;
+    std::size_t in_use_bytes() const;
+    std::size_t reused_count() const;
+    std::size_t allocated_count() const;
+
+    // Makes buffers created on the current thread use the given pool while the scope exists
+    class Scope
+    {
+    public:
+        explicit Scope(const std::shared_ptr<BufferPool>& pool);
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope();
+    private:
+        std::shared_ptr<BufferPool> previous_;
+    };
+
+    // returns the pool of the innermost Scope on the current thread, if any
+    static const std::shared_ptr<BufferPool>& current();
+
+private:
+    std::size_t limit() const;
+    void trim(std::size_t max_bytes);
+
+    mutable std::mutex mutex_;
+    // free buffers, oldest first
+    std::vector<std::vector<std::uint8_t>> free_;
+    std::size_t pooled_bytes_ = 0;
+    std::size_t in_use_bytes_ = 0;
+    std::size_t session_peak_bytes_ = 0;
+    std::vector<std::size_t> recent_peak_bytes_;
+    std::size_t reused_count_ = 0;
+    std::size_t allocated_count_ = 0;
+};
+
+/*  A byte buffer with the interface of a subset of std::vector, whose memory comes from the pool
+    that was current when the buffer was created. Without a pool it is a plain vector.
+*/
+class PooledBuffer
+{
+public:
+    PooledBuffer() : pool_{BufferPool::current()} {}
+    PooledBuffer(const PooledBuffer& other);
+    PooledBuffer(PooledBuffer&& other) noexcept;
+    PooledBuffer& operator=(const PooledBuffer& other);
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+    ~PooledBuffer();
+
+    std::size_t size() const { return data_.size(); }
+    bool empty() const { return data_.empty(); }
+
+    std::uint8_t* data() { return data_.data(); }
+    const std::uint8_t* data() const { return data_.data(); }
+
+    std::uint8_t& operator[](std::size_t i) { return data_[i]; }
+    const std::uint8_t& operator[](std::size_t i) const { return data_[i]; }
+
+    std::vector<std::uint8_t>::iterator begin() { return data_.begin(); }
+    std::vector<std::uint8_t>::iterator end() { return data_.end(); }
+    std::vector<std::uint8_t>::const_iterator begin() const { return data_.begin(); }
+    std::vector<std::uint8_t>::const_iterator end() const { return data_.end(); }
+
+    // new elements are zero-initialized, as with std::vector
+    void resize(std::size_t size);
+    void clear() { data_.clear(); }
+
+private:
+    void release();
+
+    std::shared_ptr<BufferPool> pool_;
+    std::vector<std::uint8_t> data_;
+};
+
+} // namespace genesys
+
+#endif // BACKEND_GENESYS_BUFFER_POOL_H
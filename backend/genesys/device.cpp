@@ -93,8 +93,40 @@ bool Genesys_Model::has_method(ScanMethod method) const
 }
 
 
+void ScanStatistics::add_usb_read(std::size_t bytes, std::chrono::steady_clock::time_point begin,
+                                  std::chrono::steady_clock::time_point end)
+{
+    // reads shorter than this are not considered stalls even if they are slow
+    const std::uint64_t MIN_STALL_US = 50000;
+
+    auto us = static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count());
+
+    if (usb_bytes == 0) {
+        first_byte_latency_ms = static_cast<unsigned>(
+                    std::chrono::duration_cast<std::chrono::milliseconds>(end - start_time).count());
+    } else if (us >= MIN_STALL_US && usb_us > 0) {
+        // the read was slower than a quarter of the average throughput so far
+        if (bytes * usb_us * 4 < usb_bytes * us) {
+            stall_count++;
+        }
+    }
+
+    usb_bytes += bytes;
+    usb_us += us;
+}
+
+float ScanStatistics::usb_mb_per_s() const
+{
+    if (usb_us == 0) {
+        return 0;
+    }
+    return static_cast<float>(usb_bytes) / usb_us; // bytes/us == MB/s
+}
+
 Genesys_Device::~Genesys_Device()
 {
+    background.cancel();
     clear();
 }
 
@@ -106,6 +138,10 @@ void Genesys_Device::clear()
 
     white_average_data.clear();
     dark_average_data.clear();
+
+    pipeline_buffer = ImageBuffer{};
+    pipeline.clear();
+    buffer_pool->clear();
 }
 
 ImagePipelineNodeBufferedCallableSource& Genesys_Device::get_pipeline_source()
@@ -164,7 +200,7 @@ void Genesys_Device::advance_head_pos_by_session(ScanHeadId scan_head)
     advance_head_pos_by_steps(scan_head, direction, motor_steps);
 }
 
-static void advance_pos(unsigned& pos, Direction direction, unsigned offset)
+static void advance_pos(std::atomic<unsigned>& pos, Direction direction, unsigned offset)
 {
     if (direction == Direction::FORWARD) {
         pos += offset;
@@ -251,7 +287,11 @@ std::ostream& operator<<(std::ostream& out, const Genesys_Device& dev)
     out << '\n'
         << "    read_active: " << dev.read_active << '\n'
         << "    parking: " << dev.parking << '\n'
+        << "    park_deferred: " << dev.park_deferred << '\n'
+        << "    cancel_requested: " << dev.cancel_requested.load() << '\n'
+        << "    scan_calls_active: " << dev.scan_calls_active.load() << '\n'
         << "    document: " << dev.document << '\n'
+        << "    document_end_detected: " << dev.document_end_detected << '\n'
         << "    total_bytes_read: " << dev.total_bytes_read << '\n'
         << "    total_bytes_to_read: " << dev.total_bytes_to_read << '\n'
         << "    session: " << format_indent_braced_list(4, dev.session) << '\n'
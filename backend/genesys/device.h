@@ -42,6 +42,7 @@
 #ifndef BACKEND_GENESYS_DEVICE_H
 #define BACKEND_GENESYS_DEVICE_H
 
+#include "background.h"
 #include "calibration.h"
 #include "command_set.h"
 #include "enums.h"
@@ -53,6 +54,9 @@
 #include "usb_device.h"
 #include "scanner_interface.h"
 #include "utilities.h"
+#include "warmup.h"
+#include <atomic>
+#include <chrono>
 #include <vector>
 
 namespace genesys {
@@ -247,6 +251,38 @@ struct Genesys_Model
     bool has_method(ScanMethod method) const;
 };
 
+// Timings and throughput of the last scan. Reported via the read-only performance options.
+struct ScanStatistics
+{
+    // the time when the scan has been started
+    std::chrono::steady_clock::time_point start_time;
+
+    // time spent on lamp warm-up
+    unsigned warmup_ms = 0;
+    // time spent on calibration, zero if the calibration has been restored from the cache
+    unsigned calibration_ms = 0;
+    // time from the start of the scan until the scanner was ready to send image data
+    unsigned start_ms = 0;
+    // time from the start of the scan until the first image data has been received
+    unsigned first_byte_latency_ms = 0;
+
+    // the amount of image data received via USB and the time it took
+    std::uint64_t usb_bytes = 0;
+    std::uint64_t usb_us = 0;
+    // time spent reading the image excluding the USB transfers, i.e. image processing
+    std::uint64_t pipeline_us = 0;
+    // number of USB reads that were much slower than the average, i.e. the scanner stopped
+    // delivering data for a while
+    unsigned stall_count = 0;
+
+    // records a single USB read of image data
+    void add_usb_read(std::size_t bytes, std::chrono::steady_clock::time_point begin,
+                      std::chrono::steady_clock::time_point end);
+
+    // returns the average USB throughput in MB/s
+    float usb_mb_per_s() const;
+};
+
 /**
  * Describes the current device status for the backend
  * session. This should be more accurately called
@@ -282,6 +318,10 @@ struct Genesys_Device
 
     const Genesys_Model* model = nullptr;
 
+    // the sensor table entries of the model. The calibration stores its results, e.g. the LED
+    // exposure, in this copy so that the table shared with other devices stays unchanged
+    std::vector<Genesys_Sensor> sensors;
+
     // pointers to low level functions
     std::unique_ptr<CommandSet> cmd_set;
 
@@ -311,9 +351,41 @@ struct Genesys_Device
     bool read_active = false;
     // signal whether the park command has been issued
     bool parking = false;
+    // whether the head has been left at the end of the last scan. It is parked either by the
+    // background worker after a delay or when the next scan can't start from that position
+    bool park_deferred = false;
+    // set by sane_cancel until the scanner has been stopped. If sane_cancel can't stop it right
+    // away, the running sane_start or sane_read call or the next entry point does that
+    std::atomic<bool> cancel_requested{false};
+    // the number of sane_start and sane_read calls in progress
+    std::atomic<unsigned> scan_calls_active{0};
 
     // for sheetfed scanner's, is TRUE when there is a document in the scanner
     bool document = false;
+    // timings of the last scan
+    ScanStatistics scan_stats;
+
+    // the shading data last written to the scanner memory, if it's known to be still there
+    std::vector<std::uint8_t> uploaded_shading_data;
+
+    // for sheetfed scanners, whether the end of the document has been detected during the current
+    // scan. total_bytes_to_read has been trimmed to the real document length in that case
+    bool document_end_detected = false;
+    // for sheetfed scanners, the value of total_bytes_read at which the paper sensor is polled next
+    std::size_t next_document_end_poll_bytes = 0;
+
+    // whether the lamp has been warmed up in the background and the warm-up at the start of the
+    // next scan can be skipped
+    bool lamp_warmed_up = false;
+    std::chrono::steady_clock::time_point lamp_warmed_up_time;
+
+    // the time spent on the warm-up and calibration done in the background, reported in the
+    // statistics of the next scan
+    unsigned background_warmup_ms = 0;
+    unsigned background_calibration_ms = 0;
+
+    // describes how the lamp brightness stabilizes, stored along with the calibration cache
+    LampWarmupModel lamp_warmup_model;
 
     // total bytes read sent to frontend
     size_t total_bytes_read = 0;
@@ -331,6 +403,9 @@ struct Genesys_Device
     // array describing the order of the sub-segments of the sensor
     std::vector<unsigned> segment_order;
 
+    // keeps the memory of image buffers between scans
+    std::shared_ptr<BufferPool> buffer_pool = std::make_shared<BufferPool>();
+
     // stores information about how the input image should be processed
     ImagePipelineStack pipeline;
 
@@ -341,6 +416,9 @@ struct Genesys_Device
 
     std::unique_ptr<ScannerInterface> interface;
 
+    // prepares the scanner for scanning while the frontend is idle after opening the device
+    BackgroundWorker background;
+
     bool is_head_pos_known(ScanHeadId scan_head) const;
     unsigned head_pos(ScanHeadId scan_head) const;
     void set_head_pos_unknown(ScanHeadId scan_head);
@@ -349,13 +427,14 @@ struct Genesys_Device
     void advance_head_pos_by_steps(ScanHeadId scan_head, Direction direction, unsigned steps);
 
 private:
-    // the position of the primary scan head in motor->base_dpi units
-    unsigned head_pos_primary_ = 0;
+    // the position of the primary scan head in motor->base_dpi units. It is read when computing
+    // the scan parameters, which happens while the background preparation may be moving the head
+    std::atomic<unsigned> head_pos_primary_{0};
     bool is_head_pos_primary_known_ = true;
 
     // the position of the secondary scan head in motor->base_dpi units. Only certain scanners
     // have a secondary scan head.
-    unsigned head_pos_secondary_ = 0;
+    std::atomic<unsigned> head_pos_secondary_{0};
     bool is_head_pos_secondary_known_ = true;
 
     friend class ScannerInterfaceUsb;
@@ -44,6 +44,10 @@
 
 namespace genesys {
 
+// buffer_pool.h
+class BufferPool;
+class PooledBuffer;
+
 // calibration.h
 struct Genesys_Calibration_Cache;
 
@@ -54,6 +58,7 @@ class CommandSet;
 struct Genesys_Gpo;
 struct MethodResolutions;
 struct Genesys_Model;
+struct ScanStatistics;
 struct Genesys_Device;
 
 // error.h
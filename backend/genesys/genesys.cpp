@@ -73,7 +73,9 @@
 #include "../include/sane/sanei_config.h"
 
 #include <array>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
 #include <iterator>
@@ -103,6 +105,20 @@ namespace {
 
     // Maximum time for lamp warm-up
     constexpr unsigned WARMUP_TIME = 65;
+
+    // The lamp is considered warmed up once its brightness changes by less than this fraction
+    // per second
+    constexpr float WARMUP_MAX_BRIGHTNESS_CHANGE = 0.005f;
+
+    // Time to keep the head at the end of the scan area in case the next scan starts further down
+    constexpr unsigned PARK_DELAY_MS = 3000;
+
+    // Bounds of the interval between test scans during lamp warm-up
+    constexpr unsigned WARMUP_MIN_SAMPLE_INTERVAL_MS = 100;
+    constexpr unsigned WARMUP_MAX_SAMPLE_INTERVAL_MS = 1000;
+
+    // The paper sensor of sheetfed scanners is polled at most once per this much paper movement
+    constexpr float DOCUMENT_END_POLL_DISTANCE_MM = 1.0f;
 } // namespace
 
 static SANE_String_Const mode_list[] = {
@@ -179,22 +195,21 @@ static const SANE_Range expiration_range = {
 const Genesys_Sensor& sanei_genesys_find_sensor_any(const Genesys_Device* dev)
 {
     DBG_HELPER(dbg);
-    for (const auto& sensor : *s_sensors) {
-        if (dev->model->sensor_id == sensor.sensor_id) {
-            return sensor;
-        }
+    if (!dev->sensors.empty()) {
+        return dev->sensors.front();
     }
     throw std::runtime_error("Given device does not have sensor defined");
 }
 
-Genesys_Sensor* find_sensor_impl(const Genesys_Device* dev, unsigned dpi, unsigned channels,
-                                 ScanMethod scan_method)
+template<class Sensors>
+auto find_sensor_impl(Sensors& sensors, unsigned dpi, unsigned channels, ScanMethod scan_method)
+    -> decltype(&*sensors.begin())
 {
     DBG_HELPER_ARGS(dbg, "dpi: %d, channels: %d, scan_method: %d", dpi, channels,
                     static_cast<unsigned>(scan_method));
-    for (auto& sensor : *s_sensors) {
-        if (dev->model->sensor_id == sensor.sensor_id && sensor.resolutions.matches(dpi) &&
-            sensor.matches_channel_count(channels) && sensor.method == scan_method)
+    for (auto& sensor : sensors) {
+        if (sensor.resolutions.matches(dpi) && sensor.matches_channel_count(channels) &&
+            sensor.method == scan_method)
         {
             return &sensor;
         }
@@ -207,7 +222,7 @@ bool sanei_genesys_has_sensor(const Genesys_Device* dev, unsigned dpi, unsigned
 {
     DBG_HELPER_ARGS(dbg, "dpi: %d, channels: %d, scan_method: %d", dpi, channels,
                     static_cast<unsigned>(scan_method));
-    return find_sensor_impl(dev, dpi, channels, scan_method) != nullptr;
+    return find_sensor_impl(dev->sensors, dpi, channels, scan_method) != nullptr;
 }
 
 const Genesys_Sensor& sanei_genesys_find_sensor(const Genesys_Device* dev, unsigned dpi,
@@ -215,7 +230,7 @@ const Genesys_Sensor& sanei_genesys_find_sensor(const Genesys_Device* dev, unsig
 {
     DBG_HELPER_ARGS(dbg, "dpi: %d, channels: %d, scan_method: %d", dpi, channels,
                     static_cast<unsigned>(scan_method));
-    const auto* sensor = find_sensor_impl(dev, dpi, channels, scan_method);
+    const auto* sensor = find_sensor_impl(dev->sensors, dpi, channels, scan_method);
     if (sensor)
         return *sensor;
     throw std::runtime_error("Given device does not have sensor defined");
@@ -227,7 +242,19 @@ Genesys_Sensor& sanei_genesys_find_sensor_for_write(Genesys_Device* dev, unsigne
 {
     DBG_HELPER_ARGS(dbg, "dpi: %d, channels: %d, scan_method: %d", dpi, channels,
                     static_cast<unsigned>(scan_method));
-    auto* sensor = find_sensor_impl(dev, dpi, channels, scan_method);
+    auto* sensor = find_sensor_impl(dev->sensors, dpi, channels, scan_method);
+    if (sensor)
+        return *sensor;
+    throw std::runtime_error("Given device does not have sensor defined");
+}
+
+const Genesys_Sensor& sanei_genesys_find_default_sensor(const Genesys_Device* dev, unsigned dpi,
+                                                        unsigned channels, ScanMethod scan_method)
+{
+    DBG_HELPER_ARGS(dbg, "dpi: %d, channels: %d, scan_method: %d", dpi, channels,
+                    static_cast<unsigned>(scan_method));
+    auto sensors = get_sensor_table_range(dev->model->sensor_id);
+    const auto* sensor = find_sensor_impl(sensors, dpi, channels, scan_method);
     if (sensor)
         return *sensor;
     throw std::runtime_error("Given device does not have sensor defined");
@@ -239,8 +266,8 @@ std::vector<std::reference_wrapper<const Genesys_Sensor>>
 {
     DBG_HELPER_ARGS(dbg, "scan_method: %d", static_cast<unsigned>(scan_method));
     std::vector<std::reference_wrapper<const Genesys_Sensor>> ret;
-    for (auto& sensor : *s_sensors) {
-        if (dev->model->sensor_id == sensor.sensor_id && sensor.method == scan_method) {
+    for (const auto& sensor : dev->sensors) {
+        if (sensor.method == scan_method) {
             ret.push_back(sensor);
         }
     }
@@ -252,8 +279,8 @@ std::vector<std::reference_wrapper<Genesys_Sensor>>
 {
     DBG_HELPER_ARGS(dbg, "scan_method: %d", static_cast<unsigned>(scan_method));
     std::vector<std::reference_wrapper<Genesys_Sensor>> ret;
-    for (auto& sensor : *s_sensors) {
-        if (dev->model->sensor_id == sensor.sensor_id && sensor.method == scan_method) {
+    for (auto& sensor : dev->sensors) {
+        if (sensor.method == scan_method) {
             ret.push_back(sensor);
         }
     }
@@ -3084,29 +3111,25 @@ static void compute_coefficients(Genesys_Device * dev,
      end = pixels_per_line - offset;
    }
 
-  for (c = 0; c < channels; c++)
-    {
-      for (x = start; x < end; x++)
-	{
-	  /* TODO if channels=1 , use filter to know the base addr */
-	  ptr = shading_data + 4 * ((x + offset) * channels + cmat[c]);
-
-        // dark data
-        dk = dev->dark_average_data[x * channels + c];
+    // the input and output are both pixel-interleaved, so iterate in memory order
+    const auto* dark_data = dev->dark_average_data.data();
+    const auto* white_data = dev->white_average_data.data();
 
-        // white data
-        br = dev->white_average_data[x * channels + c];
+    for (x = start; x < end; x++) {
+        for (c = 0; c < channels; c++) {
+            // TODO if channels=1 , use filter to know the base addr
+            ptr = shading_data + 4 * ((x + offset) * channels + cmat[c]);
 
-	  /* compute coeff */
-	  val=compute_coefficient(coeff,target,br-dk);
+            dk = dark_data[x * channels + c];
+            br = white_data[x * channels + c];
 
-	  /* assign it */
-	  ptr[0] = dk & 255;
-	  ptr[1] = dk / 256;
-	  ptr[2] = val & 0xff;
-	  ptr[3] = val / 256;
+            val = compute_coefficient(coeff, target, br - dk);
 
-	}
+            ptr[0] = dk & 255;
+            ptr[1] = dk / 256;
+            ptr[2] = val & 0xff;
+            ptr[3] = val / 256;
+        }
     }
 }
 
@@ -3584,6 +3607,19 @@ static void genesys_send_shading_coefficient(Genesys_Device* dev, const Genesys_
 }
 
 
+// returns whether the calibration cache contains an entry usable with the current settings
+static bool has_compatible_calibration(Genesys_Device* dev, const Genesys_Sensor& sensor)
+{
+    auto session = dev->cmd_set->calculate_scan_session(dev, sensor, dev->settings);
+
+    for (auto& cache : dev->calibration_cache) {
+        if (sanei_genesys_is_compatible_calibration(dev, session, &cache, false)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 /**
  * search calibration cache list for an entry matching required scan.
  * If one is found, set device calibration with it
@@ -3675,6 +3711,14 @@ static void genesys_save_calibration(Genesys_Device* dev, const Genesys_Sensor&
 #endif
 }
 
+// Marks the start of a step of the calibration. When the calibration runs in the background, it
+// stops between steps once it has been cancelled.
+static void begin_calibration_step(Genesys_Device* dev, const char* name)
+{
+    BackgroundWorker::throw_if_cancelled();
+    dev->interface->record_progress_message(name);
+}
+
 static void genesys_flatbed_calibration(Genesys_Device* dev, Genesys_Sensor& sensor)
 {
     DBG_HELPER(dbg);
@@ -3699,10 +3743,10 @@ static void genesys_flatbed_calibration(Genesys_Device* dev, Genesys_Sensor& sen
 
     if (!has_flag(dev->model->flags, ModelFlag::DISABLE_ADC_CALIBRATION)) {
         // do ADC calibration first.
-        dev->interface->record_progress_message("offset_calibration");
+        begin_calibration_step(dev, "offset_calibration");
         dev->cmd_set->offset_calibration(dev, sensor, local_reg);
 
-        dev->interface->record_progress_message("coarse_gain_calibration");
+        begin_calibration_step(dev, "coarse_gain_calibration");
         dev->cmd_set->coarse_gain_calibration(dev, sensor, local_reg, coarse_res);
     }
 
@@ -3710,7 +3754,7 @@ static void genesys_flatbed_calibration(Genesys_Device* dev, Genesys_Sensor& sen
         !has_flag(dev->model->flags, ModelFlag::DISABLE_EXPOSURE_CALIBRATION))
     {
         // ADC now sends correct data, we can configure the exposure for the LEDs
-        dev->interface->record_progress_message("led_calibration");
+        begin_calibration_step(dev, "led_calibration");
         switch (dev->model->asic_type) {
             case AsicType::GL124:
             case AsicType::GL841:
@@ -3732,10 +3776,10 @@ static void genesys_flatbed_calibration(Genesys_Device* dev, Genesys_Sensor& sen
 
         if (!has_flag(dev->model->flags, ModelFlag::DISABLE_ADC_CALIBRATION)) {
             // recalibrate ADC again for the new LED exposure
-            dev->interface->record_progress_message("offset_calibration");
+            begin_calibration_step(dev, "offset_calibration");
             dev->cmd_set->offset_calibration(dev, sensor, local_reg);
 
-            dev->interface->record_progress_message("coarse_gain_calibration");
+            begin_calibration_step(dev, "coarse_gain_calibration");
             dev->cmd_set->coarse_gain_calibration(dev, sensor, local_reg, coarse_res);
         }
     }
@@ -3750,7 +3794,7 @@ static void genesys_flatbed_calibration(Genesys_Device* dev, Genesys_Sensor& sen
     }
 
     // send default shading data
-    dev->interface->record_progress_message("sanei_genesys_init_shading_data");
+    begin_calibration_step(dev, "sanei_genesys_init_shading_data");
     sanei_genesys_init_shading_data(dev, sensor, pixels_per_line);
 
     if (dev->settings.scan_method == ScanMethod::TRANSPARENCY ||
@@ -3762,19 +3806,19 @@ static void genesys_flatbed_calibration(Genesys_Device* dev, Genesys_Sensor& sen
     // shading calibration
     if (!has_flag(dev->model->flags, ModelFlag::DISABLE_SHADING_CALIBRATION)) {
         if (has_flag(dev->model->flags, ModelFlag::DARK_WHITE_CALIBRATION)) {
-            dev->interface->record_progress_message("genesys_dark_white_shading_calibration");
+            begin_calibration_step(dev, "genesys_dark_white_shading_calibration");
             genesys_dark_white_shading_calibration(dev, sensor, local_reg);
         } else {
             DBG(DBG_proc, "%s : genesys_dark_shading_calibration local_reg ", __func__);
             debug_dump(DBG_proc, local_reg);
 
             if (has_flag(dev->model->flags, ModelFlag::DARK_CALIBRATION)) {
-                dev->interface->record_progress_message("genesys_dark_shading_calibration");
+                begin_calibration_step(dev, "genesys_dark_shading_calibration");
                 genesys_dark_shading_calibration(dev, sensor, local_reg);
                 genesys_repark_sensor_before_shading(dev);
             }
 
-            dev->interface->record_progress_message("genesys_white_shading_calibration");
+            begin_calibration_step(dev, "genesys_white_shading_calibration");
             genesys_white_shading_calibration(dev, sensor, local_reg);
 
             genesys_repark_sensor_after_white_shading(dev);
@@ -3790,7 +3834,7 @@ static void genesys_flatbed_calibration(Genesys_Device* dev, Genesys_Sensor& sen
     }
 
     if (!dev->cmd_set->has_send_shading_data()) {
-        dev->interface->record_progress_message("genesys_send_shading_coefficient");
+        begin_calibration_step(dev, "genesys_send_shading_coefficient");
         genesys_send_shading_coefficient(dev, sensor);
     }
 }
@@ -3932,92 +3976,102 @@ static void genesys_scanner_calibration(Genesys_Device* dev, Genesys_Sensor& sen
 /*                  High level (exported) functions                         */
 /* ------------------------------------------------------------------------ */
 
-/*
- * wait lamp to be warm enough by scanning the same line until
- * differences between two scans are below a threshold
- */
-static void genesys_warmup_lamp(Genesys_Device* dev)
+/*  Waits until the lamp reaches stable brightness. Test scans are taken at the moments the
+    brightness is predicted to stabilize according to the lamp warm-up model of the device, which
+    is refined afterwards. When run from the background worker, the device lock is released while
+    waiting between the test scans and false is returned if the worker has been cancelled in the
+    meantime.
+*/
+static bool genesys_warmup_lamp(Genesys_Device* dev, BackgroundWorker* worker = nullptr,
+                                std::unique_lock<std::mutex>* device_lock = nullptr)
 {
     DBG_HELPER(dbg);
-    unsigned seconds = 0;
 
   const auto& sensor = sanei_genesys_find_sensor_any(dev);
 
     dev->cmd_set->init_regs_for_warmup(dev, sensor, &dev->reg);
     dev->interface->write_registers(dev->reg);
 
-    auto total_pixels =  dev->session.output_pixels;
     auto total_size = dev->session.output_line_bytes;
     auto channels = dev->session.params.channels;
     auto lines = dev->session.output_line_count;
 
-  std::vector<uint8_t> first_line(total_size);
-  std::vector<uint8_t> second_line(total_size);
+    std::vector<uint8_t> prev_line(total_size);
+    std::vector<uint8_t> line(total_size);
+
+    LampWarmupTracker tracker{dev->lamp_warmup_model, WARMUP_MAX_BRIGHTNESS_CHANGE};
+    auto start_time = std::chrono::steady_clock::now();
+    unsigned elapsed_ms = 0;
+    bool is_stable = false;
 
     do {
-        first_line = second_line;
+        if (worker && tracker.sample_count() > 0) {
+            // the registers may have been changed while the device was unlocked
+            dev->cmd_set->init_regs_for_warmup(dev, sensor, &dev->reg);
+            dev->interface->write_registers(dev->reg);
+        }
 
         dev->cmd_set->begin_scan(dev, sensor, &dev->reg, false);
 
         if (is_testing_mode()) {
             dev->interface->test_checkpoint("warmup_lamp");
             dev->cmd_set->end_scan(dev, &dev->reg, true);
-            return;
+            return true;
         }
 
         wait_until_buffer_non_empty(dev);
 
-        sanei_genesys_read_data_from_scanner(dev, second_line.data(), total_size);
+        prev_line.swap(line);
+        sanei_genesys_read_data_from_scanner(dev, line.data(), total_size);
         dev->cmd_set->end_scan(dev, &dev->reg, true);
 
-        // compute difference between the two scans
-        double first_average = 0;
-        double second_average = 0;
-        for (unsigned pixel = 0; pixel < total_size; pixel++) {
-            // 16 bit data
-            if (dev->session.params.depth == 16) {
-                first_average += (first_line[pixel] + first_line[pixel + 1] * 256);
-                second_average += (second_line[pixel] + second_line[pixel + 1] * 256);
-                pixel++;
-            } else {
-                first_average += first_line[pixel];
-                second_average += second_line[pixel];
-            }
-        }
+        elapsed_ms = static_cast<unsigned>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start_time).count());
 
-        first_average /= total_pixels;
-        second_average /= total_pixels;
+        auto averages = compute_channel_averages(line.data(), total_size,
+                                                 dev->session.params.depth, channels, lines,
+                                                 dev->model->is_cis);
+        tracker.add_sample(elapsed_ms, averages);
 
         if (dbg_log_image_data()) {
-            write_tiff_file("gl_warmup1.tiff", first_line.data(), dev->session.params.depth,
+            write_tiff_file("gl_warmup1.tiff", prev_line.data(), dev->session.params.depth,
                             channels, total_size / (lines * channels), lines);
-            write_tiff_file("gl_warmup2.tiff", second_line.data(), dev->session.params.depth,
+            write_tiff_file("gl_warmup2.tiff", line.data(), dev->session.params.depth,
                             channels, total_size / (lines * channels), lines);
         }
 
-        DBG(DBG_info, "%s: average 1 = %.2f, average 2 = %.2f\n", __func__, first_average,
-            second_average);
+        dbg.vlog(DBG_info, "%d ms: average = %.2f", elapsed_ms,
+                 std::accumulate(averages.begin(), averages.end(), 0.0f) / averages.size());
 
-        float average_difference = std::fabs(first_average - second_average) / second_average;
-        if (second_average > 0 && average_difference < 0.005)
-        {
-            dbg.vlog(DBG_info, "difference: %f, exiting", average_difference);
+        is_stable = tracker.is_stable();
+        if (is_stable) {
             break;
         }
 
-        dev->interface->sleep_ms(1000);
-        seconds++;
-    } while (seconds < WARMUP_TIME);
+        unsigned delay_ms = tracker.next_sample_delay_ms(WARMUP_MIN_SAMPLE_INTERVAL_MS,
+                                                         WARMUP_MAX_SAMPLE_INTERVAL_MS);
+        if (worker) {
+            device_lock->unlock();
+            bool cancelled = !worker->sleep_ms(delay_ms);
+            device_lock->lock();
+            if (cancelled) {
+                dbg.log(DBG_info, "cancelled");
+                return false;
+            }
+        } else {
+            dev->interface->sleep_ms(delay_ms);
+        }
+    } while (elapsed_ms < WARMUP_TIME * 1000);
 
-  if (seconds >= WARMUP_TIME)
-    {
+    if (!is_stable) {
         throw SaneException(SANE_STATUS_IO_ERROR,
-                            "warmup timed out after %d seconds. Lamp defective?", seconds);
-    }
-  else
-    {
-      DBG(DBG_info, "%s: warmup succeeded after %d seconds\n", __func__, seconds);
+                            "warmup timed out after %d seconds. Lamp defective?", WARMUP_TIME);
     }
+
+    dev->lamp_warmup_model = tracker.updated_model();
+    dbg.vlog(DBG_info, "warmup succeeded after %d ms and %zu samples", elapsed_ms,
+             tracker.sample_count());
+    return true;
 }
 
 static void init_regs_for_scan(Genesys_Device& dev, const Genesys_Sensor& sensor,
@@ -4052,12 +4106,295 @@ static void init_regs_for_scan(Genesys_Device& dev, const Genesys_Sensor& sensor
     dev.cmd_set->init_regs_for_scan_session(&dev, sensor, &regs, session);
 }
 
+static bool is_background_work_enabled()
+{
+    // the transfers of a background thread are not replayed and interleave with the transfers
+    // of the frontend-facing thread in an arbitrary order
+    if (is_testing_mode() || sanei_usb_is_replay_mode_enabled() ||
+        sanei_usb_is_record_mode_enabled())
+    {
+        return false;
+    }
+    const char* setting = std::getenv("SANE_GENESYS_BACKGROUND_PREPARATION");
+    return !setting || std::strcmp(setting, "0") != 0;
+}
+
+// returns the position of the start of the scan area in motor->base_ydpi steps
+static unsigned get_scan_area_start_steps(const Genesys_Device& dev)
+{
+    float move = dev.model->y_offset + dev.settings.tl_y;
+    return static_cast<unsigned>((move * dev.motor.base_ydpi) / MM_PER_INCH);
+}
+
+/*  Returns whether the next scan can start from the position the head has been left at by the
+    previous one instead of returning home first. This is the case when the chip computes the
+    scan start relative to the current head position, the scan area is not behind the head and
+    no calibration, which needs the calibration strip at the home position, is needed.
+*/
+static bool can_start_scan_from_head_pos(Genesys_Device* dev, const Genesys_Sensor& sensor)
+{
+    if (dev->model->is_sheetfed ||
+        dev->settings.scan_method != ScanMethod::FLATBED ||
+        dev->cmd_set->needs_home_before_init_regs_for_scan(dev) ||
+        dev->parking ||
+        !dev->is_head_pos_known(ScanHeadId::PRIMARY))
+    {
+        return false;
+    }
+    if (get_scan_area_start_steps(*dev) < dev->head_pos(ScanHeadId::PRIMARY)) {
+        return false;
+    }
+    return has_compatible_calibration(dev, sensor);
+}
+
+static void park_head_in_background(Genesys_Device* dev, BackgroundWorker& worker)
+{
+    DBG_HELPER(dbg);
+
+    if (worker.wait_for_finish(PARK_DELAY_MS)) {
+        // the next scan decides whether the head needs to be parked
+        return;
+    }
+
+    auto device_lock = worker.lock_device();
+    if (dev->park_deferred) {
+        dev->park_deferred = false;
+        dev->cmd_set->move_back_home(dev, false);
+        dev->parking = true;
+    }
+}
+
+/*  Starts parking the head once all data of a flatbed scan has been read. Scanners that can start
+    the next scan from the current head position keep the head in place for a short while, so
+    that a scan of an area further down the glass doesn't need to wait for a full home return.
+*/
+static void scanner_park_after_scan(Genesys_Device* dev)
+{
+    DBG_HELPER(dbg);
+
+    if (dev->model->is_sheetfed || has_flag(dev->model->flags, ModelFlag::MUST_WAIT)) {
+        return;
+    }
+
+    {
+        auto device_lock = dev->background.lock_device();
+        if (dev->parking || dev->park_deferred) {
+            return;
+        }
+
+        bool can_defer = is_background_work_enabled() &&
+                         dev->settings.scan_method == ScanMethod::FLATBED &&
+                         !dev->cmd_set->needs_home_before_init_regs_for_scan(dev) &&
+                         dev->is_head_pos_known(ScanHeadId::PRIMARY);
+        if (!can_defer) {
+            dev->cmd_set->move_back_home(dev, false);
+            dev->parking = true;
+            return;
+        }
+
+        dev->cmd_set->end_scan(dev, &dev->reg, true);
+        dev->park_deferred = true;
+    }
+
+    // must be called without the device lock, as any previous task is joined
+    dev->background.start([dev](BackgroundWorker& worker)
+    {
+        park_head_in_background(dev, worker);
+    });
+}
+
+/*  Returns whether the shading and gamma memory of the chip is separate from the memory holding
+    the motor slope tables. Only on such chips the tables can be written while the motor is moving.
+    GL646, GL841 and GL842 keep the slope tables in the same buffer as the shading data.
+*/
+static bool has_separate_shading_memory(const Genesys_Device& dev)
+{
+    switch (dev.model->asic_type) {
+        case AsicType::GL843:
+        case AsicType::GL845:
+        case AsicType::GL846:
+        case AsicType::GL847:
+        case AsicType::GL124:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Stops the scanner after a scan has been cancelled. The device lock must be held.
+static void scanner_stop_cancelled_scan(Genesys_Device* dev)
+{
+    DBG_HELPER(dbg);
+    dev->cancel_requested = false;
+
+    // the scan has completed and the head is left for the next scan or the background worker
+    if (dev->park_deferred) {
+        return;
+    }
+
+    // no need to end scan if we are parking the head
+    if (!dev->parking) {
+        dev->cmd_set->end_scan(dev, &dev->reg, true);
+    }
+
+    // park head if flatbed scanner
+    if (!dev->model->is_sheetfed) {
+        if (!dev->parking) {
+            dev->cmd_set->move_back_home(dev, has_flag(dev->model->flags, ModelFlag::MUST_WAIT));
+            dev->parking = !has_flag(dev->model->flags, ModelFlag::MUST_WAIT);
+        }
+    } else {
+        // in case of sheetfed scanners, we have to eject the document if still present
+        dev->cmd_set->eject_document(dev);
+    }
+
+    // enable power saving mode unless we are parking ....
+    if (!dev->parking) {
+        dev->cmd_set->save_power(dev, true);
+    }
+}
+
+// Stops the scanner and throws if sane_cancel has been called while sane_start or sane_read was
+// running. Must be called without the device lock.
+static void scanner_stop_scan_if_cancel_requested(Genesys_Device* dev)
+{
+    if (!dev->cancel_requested) {
+        return;
+    }
+    {
+        auto device_lock = dev->background.lock_device();
+        dev->read_active = false;
+        scanner_stop_cancelled_scan(dev);
+    }
+    throw SaneException(SANE_STATUS_CANCELLED, "scan has been cancelled");
+}
+
+// Stops the scanner if sane_cancel has been called during a scan. The device lock must be held.
+static void scanner_stop_scan_if_cancel_pending_locked(Genesys_Scanner* s)
+{
+    auto* dev = s->dev;
+    if (!dev->cancel_requested) {
+        return;
+    }
+    if (!s->scanning) {
+        dev->cancel_requested = false;
+        return;
+    }
+    s->scanning = false;
+    dev->read_active = false;
+    scanner_stop_cancelled_scan(dev);
+}
+
+/*  Stops the scanner if sane_cancel has been called but could not stop it itself. Every entry
+    point that may follow it calls this first. A request made while no scan has been started is
+    dropped. Must be called without the device lock.
+*/
+static void scanner_stop_scan_if_cancel_pending(Genesys_Scanner* s)
+{
+    auto* dev = s->dev;
+    if (!dev->cancel_requested) {
+        return;
+    }
+    if (!s->scanning) {
+        dev->cancel_requested = false;
+        return;
+    }
+
+    auto device_lock = dev->background.lock_device();
+    scanner_stop_scan_if_cancel_pending_locked(s);
+}
+
+/*  Marks a sane_start or sane_read call as being in progress. sane_cancel leaves stopping the
+    scanner to such a call, thus a cancellation that arrives after the call has last checked for
+    it is acted upon when the call returns.
+*/
+class ScanCallGuard
+{
+public:
+    explicit ScanCallGuard(Genesys_Scanner* s) : s_{s}
+    {
+        s_->dev->scan_calls_active++;
+    }
+
+    ScanCallGuard(const ScanCallGuard&) = delete;
+    ScanCallGuard& operator=(const ScanCallGuard&) = delete;
+
+    ~ScanCallGuard()
+    {
+        s_->dev->scan_calls_active--;
+        catch_all_exceptions(__func__, [this]() { scanner_stop_scan_if_cancel_pending(s_); });
+    }
+
+private:
+    Genesys_Scanner* s_ = nullptr;
+};
+
+static unsigned get_elapsed_ms(std::chrono::steady_clock::time_point since)
+{
+    return static_cast<unsigned>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - since).count());
+}
+
 // High-level start of scanning
 static void genesys_start_scan(Genesys_Device* dev, bool lamp_off)
 {
     DBG_HELPER(dbg);
   unsigned int steps, expected;
 
+    dev->scan_stats = ScanStatistics{};
+    dev->scan_stats.start_time = std::chrono::steady_clock::now();
+    // the warm-up and calibration done in the background are part of this scan. They are
+    // overwritten below if they are done again
+    dev->scan_stats.warmup_ms = dev->background_warmup_ms;
+    dev->scan_stats.calibration_ms = dev->background_calibration_ms;
+    dev->background_warmup_ms = 0;
+    dev->background_calibration_ms = 0;
+
+    dev->document_end_detected = false;
+    dev->next_document_end_poll_bytes = 0;
+
+    auto& sensor = sanei_genesys_find_sensor_for_write(dev, dev->settings.xres,
+                                                       dev->settings.get_channels(),
+                                                       dev->settings.scan_method);
+
+  /* wait for lamp warmup : until a warmup for TRANSPARENCY is designed, skip
+   * it when scanning from XPA. */
+    bool needs_warmup = has_flag(dev->model->flags, ModelFlag::WARMUP) &&
+                        dev->settings.scan_method != ScanMethod::TRANSPARENCY_INFRARED;
+    if (needs_warmup && dev->lamp_warmed_up && dev->settings.scan_method == ScanMethod::FLATBED) {
+        dbg.log(DBG_info, "lamp has already been warmed up in background");
+        needs_warmup = false;
+    }
+    dev->lamp_warmed_up = false;
+
+    bool start_from_head_pos = false;
+    if (dev->park_deferred) {
+        dev->park_deferred = false;
+        start_from_head_pos = can_start_scan_from_head_pos(dev, sensor);
+        if (start_from_head_pos) {
+            dbg.vlog(DBG_info, "starting scan from head position %d",
+                     dev->head_pos(ScanHeadId::PRIMARY));
+        } else {
+            dev->cmd_set->move_back_home(dev, false);
+            dev->parking = true;
+        }
+    }
+
+    // Gamma and shading are disabled for the head movement, thus when the cached calibration can
+    // be used, the tables can be uploaded while the head is still on its way home, as long as the
+    // upload doesn't touch the memory the motor reads its slope tables from. Scanners that
+    // compute the scan start relative to the head position need to know it first.
+    bool is_calibration_restored = false;
+    if (dev->parking && !needs_warmup &&
+        dev->settings.scan_method == ScanMethod::FLATBED &&
+        dev->cmd_set->needs_home_before_init_regs_for_scan(dev) &&
+        has_separate_shading_memory(*dev) &&
+        has_compatible_calibration(dev, sensor))
+    {
+        dbg.log(DBG_info, "restoring calibration while parking");
+        dev->cmd_set->send_gamma_table(dev, sensor);
+        is_calibration_restored = genesys_restore_calibration(dev, sensor);
+    }
 
   /* since not all scanners are set to wait for head to park
    * we check we are not still parking before starting a new scan */
@@ -4068,22 +4405,20 @@ static void genesys_start_scan(Genesys_Device* dev, bool lamp_off)
     // disable power saving
     dev->cmd_set->save_power(dev, false);
 
-  /* wait for lamp warmup : until a warmup for TRANSPARENCY is designed, skip
-   * it when scanning from XPA. */
-    if (has_flag(dev->model->flags, ModelFlag::WARMUP) &&
-        (dev->settings.scan_method != ScanMethod::TRANSPARENCY_INFRARED))
-    {
+    if (needs_warmup) {
         if (dev->settings.scan_method == ScanMethod::TRANSPARENCY ||
             dev->settings.scan_method == ScanMethod::TRANSPARENCY_INFRARED)
         {
             scanner_move_to_ta(*dev);
         }
 
+        auto warmup_start = std::chrono::steady_clock::now();
         genesys_warmup_lamp(dev);
+        dev->scan_stats.warmup_ms = get_elapsed_ms(warmup_start);
     }
 
   /* set top left x and y values by scanning the internals if flatbed scanners */
-    if (!dev->model->is_sheetfed) {
+    if (!dev->model->is_sheetfed && !start_from_head_pos) {
         // TODO: check we can drop this since we cannot have the scanner's head wandering here
         dev->parking = false;
         dev->cmd_set->move_back_home(dev, true);
@@ -4101,28 +4436,28 @@ static void genesys_start_scan(Genesys_Device* dev, bool lamp_off)
         dev->cmd_set->load_document(dev);
     }
 
-    auto& sensor = sanei_genesys_find_sensor_for_write(dev, dev->settings.xres,
-                                                       dev->settings.get_channels(),
-                                                       dev->settings.scan_method);
-
-    // send gamma tables. They have been set to device or user value
-    // when setting option value */
-    dev->cmd_set->send_gamma_table(dev, sensor);
+    if (!is_calibration_restored) {
+        // send gamma tables. They have been set to device or user value
+        // when setting option value */
+        dev->cmd_set->send_gamma_table(dev, sensor);
 
-  /* try to use cached calibration first */
-  if (!genesys_restore_calibration (dev, sensor))
-    {
-        // calibration : sheetfed scanners can't calibrate before each scan.
-        // also don't run calibration for those scanners where all passes are disabled
-        bool shading_disabled =
-                has_flag(dev->model->flags, ModelFlag::DISABLE_ADC_CALIBRATION) &&
-                has_flag(dev->model->flags, ModelFlag::DISABLE_EXPOSURE_CALIBRATION) &&
-                has_flag(dev->model->flags, ModelFlag::DISABLE_SHADING_CALIBRATION);
-        if (!shading_disabled && !dev->model->is_sheetfed) {
-            genesys_scanner_calibration(dev, sensor);
-            genesys_save_calibration(dev, sensor);
-        } else {
-          DBG(DBG_warn, "%s: no calibration done\n", __func__);
+        /* try to use cached calibration first */
+        if (!genesys_restore_calibration (dev, sensor))
+        {
+            // calibration : sheetfed scanners can't calibrate before each scan.
+            // also don't run calibration for those scanners where all passes are disabled
+            bool shading_disabled =
+                    has_flag(dev->model->flags, ModelFlag::DISABLE_ADC_CALIBRATION) &&
+                    has_flag(dev->model->flags, ModelFlag::DISABLE_EXPOSURE_CALIBRATION) &&
+                    has_flag(dev->model->flags, ModelFlag::DISABLE_SHADING_CALIBRATION);
+            if (!shading_disabled && !dev->model->is_sheetfed) {
+                auto calibration_start = std::chrono::steady_clock::now();
+                genesys_scanner_calibration(dev, sensor);
+                genesys_save_calibration(dev, sensor);
+                dev->scan_stats.calibration_ms = get_elapsed_ms(calibration_start);
+            } else {
+                DBG(DBG_warn, "%s: no calibration done\n", __func__);
+            }
         }
     }
 
@@ -4188,6 +4523,8 @@ static void genesys_start_scan(Genesys_Device* dev, bool lamp_off)
         }
       while (steps < 1);
     }
+
+    dev->scan_stats.start_ms = get_elapsed_ms(dev->scan_stats.start_time);
 }
 
 /* this function does the effective data read in a manner that suits
@@ -4214,12 +4551,7 @@ static void genesys_read_ordered_data(Genesys_Device* dev, SANE_Byte* destinatio
     {
       /* issue park command immediately in case scanner can handle it
        * so we save time */
-        if (!dev->model->is_sheetfed && !has_flag(dev->model->flags, ModelFlag::MUST_WAIT) &&
-            !dev->parking)
-        {
-            dev->cmd_set->move_back_home(dev, false);
-            dev->parking = true;
-        }
+        scanner_park_after_scan(dev);
         throw SaneException(SANE_STATUS_EOF, "nothing more to scan: EOF");
     }
 
@@ -4229,8 +4561,21 @@ static void genesys_read_ordered_data(Genesys_Device* dev, SANE_Byte* destinatio
         }
         dev->total_bytes_read += *len;
     } else {
-        if (dev->model->is_sheetfed) {
+        if (dev->model->is_sheetfed && dev->document &&
+            dev->total_bytes_read >= dev->next_document_end_poll_bytes)
+        {
             dev->cmd_set->detect_document_end(dev);
+
+            if (!dev->document) {
+                dev->document_end_detected = true;
+                dbg.vlog(DBG_info, "document end detected, %zu bytes left to read",
+                         dev->total_bytes_to_read - dev->total_bytes_read);
+            }
+
+            auto poll_lines = std::max(1u, static_cast<unsigned>(
+                    DOCUMENT_END_POLL_DISTANCE_MM * dev->session.params.yres / MM_PER_INCH));
+            dev->next_document_end_poll_bytes = dev->total_bytes_read +
+                    poll_lines * dev->session.output_line_bytes_requested;
         }
 
         if (dev->total_bytes_read + *len > dev->total_bytes_to_read) {
@@ -4238,6 +4583,7 @@ static void genesys_read_ordered_data(Genesys_Device* dev, SANE_Byte* destinatio
         }
 
         dev->pipeline_buffer.get_data(*len, destination);
+        scanner_stop_scan_if_cancel_requested(dev);
         dev->total_bytes_read += *len;
     }
 
@@ -4346,8 +4692,9 @@ static Genesys_Settings calculate_scan_settings(Genesys_Scanner* s)
     unsigned pixels_per_line = static_cast<unsigned>(((br_x - settings.tl_x) * settings.xres) /
                                                      MM_PER_INCH);
 
-    const auto& sensor = sanei_genesys_find_sensor(dev, settings.xres, settings.get_channels(),
-                                                   settings.scan_method);
+    const auto& sensor = sanei_genesys_find_default_sensor(dev, settings.xres,
+                                                           settings.get_channels(),
+                                                           settings.scan_method);
 
     pixels_per_line = session_adjust_output_pixels(pixels_per_line, *dev, sensor,
                                                    settings.xres, settings.yres, true);
@@ -4382,19 +4729,27 @@ static Genesys_Settings calculate_scan_settings(Genesys_Scanner* s)
     }
 
     settings.expiration_time = s->expiration_time;
+    settings.smooth_scaling = s->smooth_scaling;
 
     return settings;
 }
 
+/*  Computes the parameters of a scan with the given settings. This runs with only the settings lock
+    held, while the background preparation may be calibrating the device, so everything the
+    calibration changes is passed explicitly instead of being read from the device.
+*/
 static SANE_Parameters calculate_scan_parameters(const Genesys_Device& dev,
+                                                 const Genesys_Sensor& sensor,
                                                  const Genesys_Settings& settings)
 {
     DBG_HELPER(dbg);
 
-    auto sensor = sanei_genesys_find_sensor(&dev, settings.xres, settings.get_channels(),
-                                            settings.scan_method);
     auto session = dev.cmd_set->calculate_scan_session(&dev, sensor, settings);
-    auto pipeline = build_image_pipeline(dev, session, 0, false);
+    // shading does not change the size of the image. Leaving it out keeps this away from the
+    // calibration data which a calibration running in the background may be updating
+    session.params.flags |= ScanFlag::DISABLE_SHADING;
+    auto pipeline = build_image_pipeline(dev, session, sensor.segment_order,
+                                         settings.smooth_scaling, 0, false);
 
     SANE_Parameters params;
     if (settings.scan_mode == ScanColorMode::GRAY) {
@@ -4412,12 +4767,18 @@ static SANE_Parameters calculate_scan_parameters(const Genesys_Device& dev,
     return params;
 }
 
+/*  Computes the scan settings and parameters from the current option values. The device settings
+    are not touched, the caller copies s->settings to them when it has the device lock.
+*/
 static void calc_parameters(Genesys_Scanner* s)
 {
     DBG_HELPER(dbg);
 
-    s->dev->settings = calculate_scan_settings(s);
-    s->params = calculate_scan_parameters(*s->dev, s->dev->settings);
+    s->settings = calculate_scan_settings(s);
+    const auto& sensor = sanei_genesys_find_default_sensor(s->dev, s->settings.xres,
+                                                           s->settings.get_channels(),
+                                                           s->settings.scan_method);
+    s->params = calculate_scan_parameters(*s->dev, sensor, s->settings);
 }
 
 static void create_bpp_list (Genesys_Scanner * s, const std::vector<unsigned>& bpp)
@@ -4903,6 +5264,19 @@ static void init_options(Genesys_Scanner* s)
   s->opt[OPT_LAMP_OFF].constraint_type = SANE_CONSTRAINT_NONE;
   s->lamp_off = false;
 
+  /* filter the image when scaling it to the requested resolution */
+  s->opt[OPT_SMOOTH_SCALING].name = "smooth-scaling";
+  s->opt[OPT_SMOOTH_SCALING].title = SANE_I18N ("Smooth scaling");
+  s->opt[OPT_SMOOTH_SCALING].desc =
+    SANE_I18N
+    ("When the scanner cannot scan at the requested resolution, filter the "
+     "image while scaling it instead of dropping or repeating pixels.");
+  s->opt[OPT_SMOOTH_SCALING].type = SANE_TYPE_BOOL;
+  s->opt[OPT_SMOOTH_SCALING].unit = SANE_UNIT_NONE;
+  s->opt[OPT_SMOOTH_SCALING].cap |= SANE_CAP_ADVANCED;
+  s->opt[OPT_SMOOTH_SCALING].constraint_type = SANE_CONSTRAINT_NONE;
+  s->smooth_scaling = false;
+
   s->opt[OPT_SENSOR_GROUP].name = SANE_NAME_SENSORS;
   s->opt[OPT_SENSOR_GROUP].title = SANE_TITLE_SENSORS;
   s->opt[OPT_SENSOR_GROUP].desc = SANE_DESC_SENSORS;
@@ -5072,7 +5446,67 @@ static void init_options(Genesys_Scanner* s)
     s->opt[OPT_IGNORE_OFFSETS].cap = SANE_CAP_SOFT_DETECT | SANE_CAP_SOFT_SELECT |
                                      SANE_CAP_ADVANCED;
 
+    // performance group
+    s->opt[OPT_PERFORMANCE_GROUP].name = "performance";
+    s->opt[OPT_PERFORMANCE_GROUP].title = SANE_I18N("Performance");
+    s->opt[OPT_PERFORMANCE_GROUP].desc = SANE_I18N("Statistics of the last scan");
+    s->opt[OPT_PERFORMANCE_GROUP].type = SANE_TYPE_GROUP;
+    s->opt[OPT_PERFORMANCE_GROUP].cap = SANE_CAP_ADVANCED;
+    s->opt[OPT_PERFORMANCE_GROUP].size = 0;
+    s->opt[OPT_PERFORMANCE_GROUP].constraint_type = SANE_CONSTRAINT_NONE;
+
+    auto init_perf_option = [s](int option, const char* name, const char* title,
+                                const char* desc, SANE_Value_Type type)
+    {
+        s->opt[option].name = name;
+        s->opt[option].title = title;
+        s->opt[option].desc = desc;
+        s->opt[option].type = type;
+        s->opt[option].unit = SANE_UNIT_NONE;
+        s->opt[option].size = sizeof(SANE_Word);
+        s->opt[option].constraint_type = SANE_CONSTRAINT_NONE;
+        s->opt[option].cap = SANE_CAP_SOFT_DETECT | SANE_CAP_ADVANCED;
+    };
+
+    init_perf_option(OPT_PERF_WARMUP_TIME, "perf-warmup-ms",
+                     SANE_I18N("Lamp warm-up time"),
+                     SANE_I18N("Time in milliseconds spent warming up the lamp for the last "
+                               "scan, including a warm-up done in the background before it"),
+                     SANE_TYPE_INT);
+    init_perf_option(OPT_PERF_CALIBRATION_TIME, "perf-calibration-ms",
+                     SANE_I18N("Calibration time"),
+                     SANE_I18N("Time in milliseconds spent calibrating for the last scan, "
+                               "including a calibration done in the background before it. Zero "
+                               "if a cached calibration was used"),
+                     SANE_TYPE_INT);
+    init_perf_option(OPT_PERF_START_TIME, "perf-start-ms",
+                     SANE_I18N("Scan start time"),
+                     SANE_I18N("Time in milliseconds from the start of the last scan until the "
+                               "scanner was ready to send image data, including head movements"),
+                     SANE_TYPE_INT);
+    init_perf_option(OPT_PERF_FIRST_BYTE_LATENCY, "perf-first-byte-latency-ms",
+                     SANE_I18N("First byte latency"),
+                     SANE_I18N("Time in milliseconds from the start of the last scan until the "
+                               "first image data has been received"),
+                     SANE_TYPE_INT);
+    init_perf_option(OPT_PERF_USB_SPEED, "perf-usb-mb-per-s",
+                     SANE_I18N("USB throughput"),
+                     SANE_I18N("Average speed in megabytes per second of the image data "
+                               "transfers of the last scan"),
+                     SANE_TYPE_FIXED);
+    init_perf_option(OPT_PERF_PIPELINE_TIME, "perf-pipeline-cpu-ms",
+                     SANE_I18N("Image processing time"),
+                     SANE_I18N("Time in milliseconds spent processing the image data of the "
+                               "last scan"),
+                     SANE_TYPE_INT);
+    init_perf_option(OPT_PERF_STALL_COUNT, "perf-stall-count",
+                     SANE_I18N("Transfer stalls"),
+                     SANE_I18N("Number of image data transfers of the last scan during which "
+                               "the scanner stopped sending data for a while"),
+                     SANE_TYPE_INT);
+
     calc_parameters(s);
+    s->dev->settings = s->settings;
 }
 
 static bool present;
@@ -5231,10 +5665,10 @@ static void probe_genesys_devices()
    of Genesys_Calibration_Cache as is.
 */
 static const char* CALIBRATION_IDENT = "sane_genesys";
-static const int CALIBRATION_VERSION = 31;
+static const int CALIBRATION_VERSION = 32;
 
 bool read_calibration(std::istream& str, Genesys_Device::Calibration& calibration,
-                      const std::string& path)
+                      LampWarmupModel& warmup_model, const std::string& path)
 {
     DBG_HELPER(dbg);
 
@@ -5256,6 +5690,7 @@ bool read_calibration(std::istream& str, Genesys_Device::Calibration& calibratio
 
     calibration.clear();
     serialize(str, calibration);
+    serialize(str, warmup_model);
     return true;
 }
 
@@ -5264,6 +5699,7 @@ bool read_calibration(std::istream& str, Genesys_Device::Calibration& calibratio
  * from file defined in dev->calib_file
  */
 static bool sanei_genesys_read_calibration(Genesys_Device::Calibration& calibration,
+                                           LampWarmupModel& warmup_model,
                                            const std::string& path)
 {
     DBG_HELPER(dbg);
@@ -5275,10 +5711,11 @@ static bool sanei_genesys_read_calibration(Genesys_Device::Calibration& calibrat
         return false;
     }
 
-    return read_calibration(str, calibration, path);
+    return read_calibration(str, calibration, warmup_model, path);
 }
 
-void write_calibration(std::ostream& str, Genesys_Device::Calibration& calibration)
+void write_calibration(std::ostream& str, Genesys_Device::Calibration& calibration,
+                       LampWarmupModel& warmup_model)
 {
     std::string ident = CALIBRATION_IDENT;
     serialize(str, ident);
@@ -5286,9 +5723,12 @@ void write_calibration(std::ostream& str, Genesys_Device::Calibration& calibrati
     serialize(str, version);
     serialize_newline(str);
     serialize(str, calibration);
+    serialize_newline(str);
+    serialize(str, warmup_model);
 }
 
-static void write_calibration(Genesys_Device::Calibration& calibration, const std::string& path)
+static void write_calibration(Genesys_Device::Calibration& calibration,
+                              LampWarmupModel& warmup_model, const std::string& path)
 {
     DBG_HELPER(dbg);
 
@@ -5297,11 +5737,36 @@ static void write_calibration(Genesys_Device::Calibration& calibration, const st
     if (!str.is_open()) {
         throw SaneException("Cannot open calibration for writing");
     }
-    write_calibration(str, calibration);
+    write_calibration(str, calibration, warmup_model);
 }
 
 /* -------------------------- SANE API functions ------------------------- */
 
+/*  Only the tables needed to enumerate devices are initialized in sane_init(). The sensor, motor
+    and other tables are built when the first device is opened, so that frontends which only list
+    devices don't pay for them.
+*/
+static void init_device_tables()
+{
+    DBG_HELPER(dbg);
+    // the tables are checked one by one, because the testsuite builds some of them by itself
+    if (!s_sensors.is_init()) {
+        genesys_init_sensor_tables();
+    }
+    if (!s_frontends.is_init()) {
+        genesys_init_frontend_tables();
+    }
+    if (!s_gpo.is_init()) {
+        genesys_init_gpo_tables();
+    }
+    if (!s_memory_layout.is_init()) {
+        genesys_init_memory_layout_tables();
+    }
+    if (!s_motors.is_init()) {
+        genesys_init_motor_tables();
+    }
+}
+
 void sane_init_impl(SANE_Int * version_code, SANE_Auth_Callback authorize)
 {
   DBG_INIT ();
@@ -5330,11 +5795,6 @@ void sane_init_impl(SANE_Int * version_code, SANE_Auth_Callback authorize)
   s_sane_devices.init();
     s_sane_devices_data.init();
   s_sane_devices_ptrs.init();
-  genesys_init_sensor_tables();
-  genesys_init_frontend_tables();
-    genesys_init_gpo_tables();
-    genesys_init_memory_layout_tables();
-    genesys_init_motor_tables();
     genesys_init_usb_device_tables();
 
 
@@ -5436,11 +5896,156 @@ SANE_Status sane_get_devices(const SANE_Device *** device_list, SANE_Bool local_
     });
 }
 
+static void read_calibration_file(Genesys_Scanner* s)
+{
+    DBG_HELPER(dbg);
+    auto* dev = s->dev;
+
+    auto path = calibration_filename(dev);
+    s->calibration_file = path;
+    dev->calib_file = path;
+    DBG(DBG_info, "%s: Calibration filename set to:\n", __func__);
+    DBG(DBG_info, "%s: >%s<\n", __func__, dev->calib_file.c_str());
+
+    LampWarmupModel warmup_model;
+    catch_all_exceptions(__func__, [&]()
+    {
+        sanei_genesys_read_calibration(dev->calibration_cache, warmup_model, dev->calib_file);
+    });
+
+    // the model learned during this session is more recent than the one in the file
+    if (dev->lamp_warmup_model.empty()) {
+        dev->lamp_warmup_model = std::move(warmup_model);
+    }
+}
+
+static bool is_background_preparation_enabled(Genesys_Device* dev)
+{
+    if (!is_background_work_enabled()) {
+        return false;
+    }
+    return has_flag(dev->model->flags, ModelFlag::WARMUP) || !dev->model->is_sheetfed;
+}
+
+/*  Warms up the lamp and calibrates the scanner for the current settings while the frontend is
+    busy with other things, usually waiting for user input. Once done, the worker waits for the
+    options to change and calibrates again if the cached calibration no longer matches. A
+    calibration that is in progress when the options change is abandoned and started again once
+    they settle. All device access happens with the device lock held, sane_start() asks the worker
+    to finish before touching the device.
+*/
+static void prepare_scanner_in_background(Genesys_Scanner* s, BackgroundWorker& worker)
+{
+    DBG_HELPER(dbg);
+    auto* dev = s->dev;
+    auto device_lock = worker.lock_device();
+
+    {
+        auto settings_lock = worker.lock_settings();
+        calc_parameters(s);
+        dev->settings = s->settings;
+    }
+    if (dev->settings.scan_method != ScanMethod::FLATBED) {
+        return;
+    }
+
+    dev->cmd_set->save_power(dev, false);
+
+    if (has_flag(dev->model->flags, ModelFlag::WARMUP)) {
+        if (dev->parking) {
+            sanei_genesys_wait_for_home(dev);
+        }
+        auto warmup_start = std::chrono::steady_clock::now();
+        if (!genesys_warmup_lamp(dev, &worker, &device_lock)) {
+            return;
+        }
+        dev->background_warmup_ms = get_elapsed_ms(warmup_start);
+        dev->lamp_warmed_up = true;
+        dev->lamp_warmed_up_time = std::chrono::steady_clock::now();
+    }
+
+    bool shading_disabled =
+            has_flag(dev->model->flags, ModelFlag::DISABLE_ADC_CALIBRATION) &&
+            has_flag(dev->model->flags, ModelFlag::DISABLE_EXPOSURE_CALIBRATION) &&
+            has_flag(dev->model->flags, ModelFlag::DISABLE_SHADING_CALIBRATION);
+    if (shading_disabled || dev->model->is_sheetfed || dev->force_calibration != 0) {
+        return;
+    }
+
+    {
+        auto settings_lock = worker.lock_settings();
+        read_calibration_file(s);
+    }
+
+    while (!worker.is_cancelled()) {
+        {
+            // options are changed only with the settings lock held, so no change can be missed
+            auto settings_lock = worker.lock_settings();
+            worker.mark_changes_seen();
+            calc_parameters(s);
+            dev->settings = s->settings;
+        }
+
+        if (dev->force_calibration == 0 && dev->settings.scan_method == ScanMethod::FLATBED) {
+            auto& sensor = sanei_genesys_find_sensor_for_write(dev, dev->settings.xres,
+                                                               dev->settings.get_channels(),
+                                                               dev->settings.scan_method);
+
+            if (!has_compatible_calibration(dev, sensor)) {
+                dbg.vlog(DBG_info, "calibrating for %d dpi", dev->settings.xres);
+                if (dev->parking) {
+                    sanei_genesys_wait_for_home(dev);
+                }
+                dev->parking = false;
+                dev->cmd_set->move_back_home(dev, true);
+
+                auto calibration_start = std::chrono::steady_clock::now();
+                bool calibrated = false;
+                try {
+                    genesys_scanner_calibration(dev, sensor);
+                    calibrated = true;
+                } catch (const SaneException& e) {
+                    if (e.status() != SANE_STATUS_CANCELLED) {
+                        throw;
+                    }
+                    // either the device is being closed or the options have changed and the
+                    // calibration would be for the wrong settings. Don't wait for the head to
+                    // return home in either case
+                    dbg.log(DBG_info, "calibration abandoned");
+                    bool must_wait = has_flag(dev->model->flags, ModelFlag::MUST_WAIT);
+                    dev->cmd_set->move_back_home(dev, must_wait);
+                    dev->parking = !must_wait;
+                    if (worker.is_cancelled()) {
+                        return;
+                    }
+                }
+                if (calibrated) {
+                    genesys_save_calibration(dev, sensor);
+                    dev->background_calibration_ms = get_elapsed_ms(calibration_start);
+
+                    // sane_start() reloads the calibration cache from the file
+                    write_calibration(dev->calibration_cache, dev->lamp_warmup_model,
+                                      dev->calib_file);
+                }
+            }
+        }
+
+        device_lock.unlock();
+        bool changed = worker.wait_for_settled_change(1000);
+        device_lock.lock();
+        if (!changed) {
+            break;
+        }
+    }
+}
+
 static void sane_open_impl(SANE_String_Const devicename, SANE_Handle * handle)
 {
     DBG_HELPER_ARGS(dbg, "devicename = %s", devicename);
     Genesys_Device* dev = nullptr;
 
+    init_device_tables();
+
   /* devicename="" or devicename="genesys" are default values that use
    * first available device
    */
@@ -5505,6 +6110,9 @@ static void sane_open_impl(SANE_String_Const devicename, SANE_Handle * handle)
 
     dbg.vlog(DBG_info, "Opened device %s", dev->model->name);
 
+    auto sensors = get_sensor_table_range(dev->model->sensor_id);
+    dev->sensors.assign(sensors.begin(), sensors.end());
+
     if (has_flag(dev->model->flags, ModelFlag::UNTESTED)) {
         DBG(DBG_error0, "WARNING: Your scanner is not fully supported or at least \n");
         DBG(DBG_error0, "         had only limited testing. Please be careful and \n");
@@ -5542,6 +6150,8 @@ static void sane_open_impl(SANE_String_Const devicename, SANE_Handle * handle)
 
     // some hardware capabilities are detected through sensors
     dev->cmd_set->update_hardware_sensors (s);
+
+    dev->lamp_warmed_up = false;
 }
 
 SANE_GENESYS_API_LINKAGE
@@ -5575,10 +6185,19 @@ sane_close_impl(SANE_Handle handle)
 
     auto* dev = it->dev;
 
+    dev->background.cancel();
+    dev->lamp_warmed_up = false;
+
+    catch_all_exceptions(__func__, [&](){ scanner_stop_scan_if_cancel_pending(&*it); });
+
     // eject document for sheetfed scanners
     if (dev->model->is_sheetfed) {
         catch_all_exceptions(__func__, [&](){ dev->cmd_set->eject_document(dev); });
     } else {
+        if (dev->park_deferred) {
+            dev->park_deferred = false;
+            dev->cmd_set->move_back_home(dev, true);
+        }
         // in case scanner is parking, wait for the head to reach home position
         if (dev->parking) {
             sanei_genesys_wait_for_home(dev);
@@ -5591,6 +6210,7 @@ sane_close_impl(SANE_Handle handle)
     // here is the place to store calibration cache
     if (dev->force_calibration == 0 && !is_testing_mode()) {
         catch_all_exceptions(__func__, [&](){ write_calibration(dev->calibration_cache,
+                                                                dev->lamp_warmup_model,
                                                                 dev->calib_file); });
     }
 
@@ -5679,13 +6299,15 @@ static void get_option_value(Genesys_Scanner* s, int option, void* val)
   std::vector<uint16_t> gamma_table;
   unsigned option_size = 0;
 
+    // most options are read with only the settings lock held, so use the table entry that the
+    // calibration doesn't touch
     const Genesys_Sensor* sensor = nullptr;
-    if (sanei_genesys_has_sensor(dev, dev->settings.xres, dev->settings.get_channels(),
-                                 dev->settings.scan_method))
+    if (sanei_genesys_has_sensor(dev, s->settings.xres, s->settings.get_channels(),
+                                 s->settings.scan_method))
     {
-        sensor = &sanei_genesys_find_sensor(dev, dev->settings.xres,
-                                            dev->settings.get_channels(),
-                                            dev->settings.scan_method);
+        sensor = &sanei_genesys_find_default_sensor(dev, s->settings.xres,
+                                                    s->settings.get_channels(),
+                                                    s->settings.scan_method);
     }
 
   switch (option)
@@ -5719,6 +6341,9 @@ static void get_option_value(Genesys_Scanner* s, int option, void* val)
     case OPT_LAMP_OFF:
         *reinterpret_cast<SANE_Word*>(val) = s->lamp_off;
         break;
+    case OPT_SMOOTH_SCALING:
+        *reinterpret_cast<SANE_Word*>(val) = s->smooth_scaling;
+        break;
     case OPT_LAMP_OFF_TIME:
         *reinterpret_cast<SANE_Word*>(val) = s->lamp_off_time;
         break;
@@ -5832,19 +6457,33 @@ static void get_option_value(Genesys_Scanner* s, int option, void* val)
 
             // scanner needs calibration for current mode unless a matching calibration cache is
             // found
-
-            bool result = true;
-
-            auto session = dev->cmd_set->calculate_scan_session(dev, *sensor, dev->settings);
-
-            for (auto& cache : dev->calibration_cache) {
-                if (sanei_genesys_is_compatible_calibration(dev, session, &cache, false)) {
-                    *reinterpret_cast<SANE_Bool*>(val) = SANE_FALSE;
-                }
-            }
-            *reinterpret_cast<SANE_Bool*>(val) = result;
+            dev->settings = s->settings;
+            *reinterpret_cast<SANE_Bool*>(val) = has_compatible_calibration(dev, *sensor)
+                    ? SANE_FALSE : SANE_TRUE;
             break;
         }
+        case OPT_PERF_WARMUP_TIME:
+            *reinterpret_cast<SANE_Word*>(val) = dev->scan_stats.warmup_ms;
+            break;
+        case OPT_PERF_CALIBRATION_TIME:
+            *reinterpret_cast<SANE_Word*>(val) = dev->scan_stats.calibration_ms;
+            break;
+        case OPT_PERF_START_TIME:
+            *reinterpret_cast<SANE_Word*>(val) = dev->scan_stats.start_ms;
+            break;
+        case OPT_PERF_FIRST_BYTE_LATENCY:
+            *reinterpret_cast<SANE_Word*>(val) = dev->scan_stats.first_byte_latency_ms;
+            break;
+        case OPT_PERF_USB_SPEED:
+            *reinterpret_cast<SANE_Word*>(val) = float_to_fixed(dev->scan_stats.usb_mb_per_s());
+            break;
+        case OPT_PERF_PIPELINE_TIME:
+            *reinterpret_cast<SANE_Word*>(val) =
+                    static_cast<SANE_Word>(dev->scan_stats.pipeline_us / 1000);
+            break;
+        case OPT_PERF_STALL_COUNT:
+            *reinterpret_cast<SANE_Word*>(val) = dev->scan_stats.stall_count;
+            break;
     default:
       DBG(DBG_warn, "%s: can't get unknown option %d\n", __func__, option);
     }
@@ -5861,11 +6500,13 @@ static void set_calibration_value(Genesys_Scanner* s, const char* val)
 
     std::string new_calib_path = val;
     Genesys_Device::Calibration new_calibration;
+    LampWarmupModel new_warmup_model;
 
     bool is_calib_success = false;
     catch_all_exceptions(__func__, [&]()
     {
-        is_calib_success = sanei_genesys_read_calibration(new_calibration, new_calib_path);
+        is_calib_success = sanei_genesys_read_calibration(new_calibration, new_warmup_model,
+                                                          new_calib_path);
     });
 
     if (!is_calib_success) {
@@ -5873,6 +6514,7 @@ static void set_calibration_value(Genesys_Scanner* s, const char* val)
     }
 
     dev->calibration_cache = std::move(new_calibration);
+    dev->lamp_warmup_model = std::move(new_warmup_model);
     dev->calib_file = new_calib_path;
     s->calibration_file = new_calib_path;
     DBG(DBG_info, "%s: Calibration filename set to '%s':\n", __func__, new_calib_path.c_str());
@@ -5921,6 +6563,10 @@ static void set_option_value(Genesys_Scanner* s, int option, void *val, SANE_Int
         calc_parameters(s);
         *myinfo |= SANE_INFO_RELOAD_PARAMS;
         break;
+    case OPT_SMOOTH_SCALING:
+        s->smooth_scaling = *reinterpret_cast<SANE_Word*>(val);
+        calc_parameters(s);
+        break;
     case OPT_PREVIEW:
         s->preview = *reinterpret_cast<SANE_Word*>(val);
         calc_parameters(s);
@@ -6099,6 +6745,7 @@ static void set_option_value(Genesys_Scanner* s, int option, void *val, SANE_Int
             break;
         }
         case OPT_CALIBRATE: {
+            dev->settings = s->settings;
             auto& sensor = sanei_genesys_find_sensor_for_write(dev, dev->settings.xres,
                                                                dev->settings.get_channels(),
                                                                dev->settings.scan_method);
@@ -6144,6 +6791,34 @@ static void set_option_value(Genesys_Scanner* s, int option, void *val, SANE_Int
 }
 
 
+/*  Returns whether accessing the given option involves the device and not just the option values.
+    Setting such an option may also invalidate the work done in the background.
+*/
+static bool option_needs_device(int option, SANE_Action action)
+{
+    switch (option) {
+        case OPT_SCAN_SW:
+        case OPT_FILE_SW:
+        case OPT_EMAIL_SW:
+        case OPT_COPY_SW:
+        case OPT_PAGE_LOADED_SW:
+        case OPT_OCR_SW:
+        case OPT_POWER_SW:
+        case OPT_EXTRA_SW:
+        case OPT_NEED_CALIBRATION_SW:
+            return true;
+        case OPT_CALIBRATION_FILE:
+        case OPT_LAMP_OFF_TIME:
+        case OPT_CALIBRATE:
+        case OPT_CLEAR_CALIBRATION:
+        case OPT_FORCE_CALIBRATION:
+        case OPT_IGNORE_OFFSETS:
+            return action == SANE_ACTION_SET_VALUE;
+        default:
+            return false;
+    }
+}
+
 /* sets and gets scanner option values */
 void sane_control_option_impl(SANE_Handle handle, SANE_Int option,
                               SANE_Action action, void *val, SANE_Int * info)
@@ -6154,9 +6829,24 @@ void sane_control_option_impl(SANE_Handle handle, SANE_Int option,
                       (action == SANE_ACTION_SET_AUTO) ? "set_auto" : "unknown";
     DBG_HELPER_ARGS(dbg, "action = %s, option = %s (%d)", action_str,
                     s->opt[option].name, option);
+    scanner_stop_scan_if_cancel_pending(s);
+
+    // plain option values are guarded by the settings lock only, so that they can be accessed
+    // while the background preparation holds the device lock
+    std::unique_lock<std::mutex> device_lock;
+    if (option >= 0 && option < NUM_OPTIONS && option_needs_device(option, action)) {
+        if (action == SANE_ACTION_SET_VALUE) {
+            // don't wait for a warm-up or calibration whose result may be thrown away anyway.
+            // The background preparation is started again below
+            s->dev->background.cancel();
+        }
+        device_lock = s->dev->background.lock_device();
+    }
+    auto settings_lock = s->dev->background.lock_settings();
 
   SANE_Word cap;
   SANE_Int myinfo = 0;
+    bool start_background = false;
 
     if (info) {
         *info = 0;
@@ -6190,6 +6880,9 @@ void sane_control_option_impl(SANE_Handle handle, SANE_Int option,
             TIE(sanei_constrain_value(s->opt + option, val, &myinfo));
 
             set_option_value(s, option, val, &myinfo);
+            s->dev->background.notify_changed();
+            start_background = !s->dev->background.is_running() &&
+                               is_background_preparation_enabled(s->dev);
             break;
 
         case SANE_ACTION_SET_AUTO:
@@ -6199,8 +6892,22 @@ void sane_control_option_impl(SANE_Handle handle, SANE_Int option,
             throw SaneException("unknown action %d for option %d", action, option);
     }
 
-  if (info)
-    *info = myinfo;
+    if (info) {
+        *info = myinfo;
+    }
+
+    // Merely opening the device, e.g. to list its options, does not start the background work.
+    // Setting an option means that a scan is likely to follow.
+    if (start_background) {
+        settings_lock.unlock();
+        if (device_lock.owns_lock()) {
+            device_lock.unlock();
+        }
+        s->dev->background.start([s](BackgroundWorker& worker)
+        {
+            prepare_scanner_in_background(s, worker);
+        });
+    }
 }
 
 SANE_GENESYS_API_LINKAGE
@@ -6218,6 +6925,8 @@ void sane_get_parameters_impl(SANE_Handle handle, SANE_Parameters* params)
     DBG_HELPER(dbg);
     Genesys_Scanner* s = reinterpret_cast<Genesys_Scanner*>(handle);
     auto* dev = s->dev;
+    scanner_stop_scan_if_cancel_pending(s);
+    auto settings_lock = dev->background.lock_settings();
 
   /* don't recompute parameters once data reading is active, ie during scan */
     if (!dev->read_active) {
@@ -6236,6 +6945,11 @@ void sane_get_parameters_impl(SANE_Handle handle, SANE_Parameters* params)
         {
             params->lines = -1;
         }
+
+        // once the end of the document has been seen, the real height is known
+        if (dev->read_active && dev->document_end_detected && params->bytes_per_line > 0) {
+            params->lines = dev->total_bytes_to_read / params->bytes_per_line;
+        }
     }
     debug_dump(DBG_proc, *params);
 }
@@ -6254,6 +6968,7 @@ void sane_start_impl(SANE_Handle handle)
     DBG_HELPER(dbg);
     Genesys_Scanner* s = reinterpret_cast<Genesys_Scanner*>(handle);
     auto* dev = s->dev;
+    ScanCallGuard call_guard{s};
 
     if (s->pos_top_left_x >= s->pos_bottom_right_x) {
         throw SaneException("top left x >= bottom right x");
@@ -6262,25 +6977,39 @@ void sane_start_impl(SANE_Handle handle)
         throw SaneException("top left y >= bottom right y");
     }
 
+    // let any warm-up or calibration in progress complete, the scan would need to do it anyway.
+    // A calibration for options that have changed since it was started is abandoned instead
+    if (dev->background.has_unseen_change()) {
+        dev->background.cancel();
+    } else {
+        dev->background.finish();
+    }
+
+    // a cancellation that has not been acted upon belongs to the previous scan
+    scanner_stop_scan_if_cancel_pending(s);
+
+    dev->buffer_pool->begin_session();
+
+    if (dev->lamp_warmed_up && s->lamp_off_time > 0 &&
+        std::chrono::steady_clock::now() - dev->lamp_warmed_up_time >=
+            std::chrono::minutes(s->lamp_off_time))
+    {
+        // the lamp may have been switched off by the scanner in the meantime
+        dev->lamp_warmed_up = false;
+    }
+
     // fetch stored calibration
     if (dev->force_calibration == 0) {
-        auto path = calibration_filename(dev);
-        s->calibration_file = path;
-        dev->calib_file = path;
-        DBG(DBG_info, "%s: Calibration filename set to:\n", __func__);
-        DBG(DBG_info, "%s: >%s<\n", __func__, dev->calib_file.c_str());
-
-        catch_all_exceptions(__func__, [&]()
-        {
-            sanei_genesys_read_calibration(dev->calibration_cache, dev->calib_file);
-        });
+        read_calibration_file(s);
     }
 
     // First make sure we have a current parameter set.  Some of the
     // parameters will be overwritten below, but that's OK.
 
     calc_parameters(s);
+    dev->settings = s->settings;
     genesys_start_scan(dev, s->lamp_off);
+    scanner_stop_scan_if_cancel_requested(dev);
 
     s->scanning = true;
 }
@@ -6318,9 +7047,15 @@ SANE_Status sane_read_impl(SANE_Handle handle, SANE_Byte * buf, SANE_Int max_len
         throw SaneException("len is nullptr");
     }
 
+    ScanCallGuard call_guard{s};
   *len = 0;
 
-    if (!s->scanning) {
+    if (s->scanning && dev->cancel_requested) {
+        scanner_stop_scan_if_cancel_pending(s);
+        throw SaneException(SANE_STATUS_CANCELLED, "scan has been cancelled");
+    }
+
+    if (!s->scanning || !dev->read_active) {
         throw SaneException(SANE_STATUS_CANCELLED,
                             "scan was cancelled, is over or has not been initiated yet");
     }
@@ -6335,18 +7070,32 @@ SANE_Status sane_read_impl(SANE_Handle handle, SANE_Byte * buf, SANE_Int max_len
 
       /* issue park command immediately in case scanner can handle it
        * so we save time */
-        if (!dev->model->is_sheetfed && !has_flag(dev->model->flags, ModelFlag::MUST_WAIT) &&
-            !dev->parking)
-        {
-            dev->cmd_set->move_back_home(dev, false);
-            dev->parking = true;
-        }
+        scanner_park_after_scan(dev);
         return SANE_STATUS_EOF;
     }
 
   local_len = max_len;
 
-    genesys_read_ordered_data(dev, buf, &local_len);
+    auto read_start = std::chrono::steady_clock::now();
+    auto usb_us_before = dev->scan_stats.usb_us;
+
+    try {
+        genesys_read_ordered_data(dev, buf, &local_len);
+    } catch (const SaneException& e) {
+        // the scanner has already been stopped if the scan has been cancelled meanwhile
+        if (e.status() == SANE_STATUS_CANCELLED) {
+            s->scanning = false;
+        }
+        throw;
+    }
+
+    // whatever is not spent waiting for USB transfers is spent processing the image
+    auto read_us = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - read_start).count());
+    auto usb_us = dev->scan_stats.usb_us - usb_us_before;
+    if (read_us > usb_us) {
+        dev->scan_stats.pipeline_us += read_us - usb_us;
+    }
 
   *len = local_len;
     if (local_len > static_cast<std::size_t>(max_len)) {
@@ -6367,33 +7116,29 @@ SANE_Status sane_read(SANE_Handle handle, SANE_Byte * buf, SANE_Int max_len, SAN
 
 void sane_cancel_impl(SANE_Handle handle)
 {
-    DBG_HELPER(dbg);
     Genesys_Scanner* s = reinterpret_cast<Genesys_Scanner*>(handle);
     auto* dev = s->dev;
 
-    s->scanning = false;
-    dev->read_active = false;
-
-    // no need to end scan if we are parking the head
-    if (!dev->parking) {
-        dev->cmd_set->end_scan(dev, &dev->reg, true);
+    // The flag keeps a sane_read that races with this function from reading further. A running
+    // sane_start or sane_read call stops the scanner itself, at the latest when it returns.
+    dev->cancel_requested = true;
+    if (dev->scan_calls_active != 0) {
+        return;
     }
-
-    // park head if flatbed scanner
-    if (!dev->model->is_sheetfed) {
-        if (!dev->parking) {
-            dev->cmd_set->move_back_home(dev, has_flag(dev->model->flags, ModelFlag::MUST_WAIT));
-            dev->parking = !has_flag(dev->model->flags, ModelFlag::MUST_WAIT);
-        }
-    } else {
-        // in case of sheetfed scanners, we have to eject the document if still present
-        dev->cmd_set->eject_document(dev);
+    if (!s->scanning) {
+        dev->cancel_requested = false;
+        return;
     }
 
-    // enable power saving mode unless we are parking ....
-    if (!dev->parking) {
-        dev->cmd_set->save_power(dev, true);
+    // Otherwise the scanner is stopped right away, so that the motor and the lamp are not left
+    // running until the frontend calls the next entry point. Frontends may call this function
+    // from a signal handler, possibly interrupting an entry point that holds the device lock, thus
+    // the lock is not waited for. Its holder or the next entry point stops the scanner instead.
+    auto device_lock = dev->background.try_lock_device();
+    if (!device_lock.owns_lock()) {
+        return;
     }
+    scanner_stop_scan_if_cancel_pending_locked(s);
 }
 
 SANE_GENESYS_API_LINKAGE
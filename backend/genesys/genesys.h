@@ -111,6 +111,7 @@ enum Genesys_Option
   OPT_EXTRAS_GROUP,
   OPT_LAMP_OFF_TIME,
   OPT_LAMP_OFF,
+  OPT_SMOOTH_SCALING,
   OPT_COLOR_FILTER,
   OPT_CALIBRATION_FILE,
   OPT_EXPIRATION_TIME,
@@ -131,6 +132,16 @@ enum Genesys_Option
   OPT_FORCE_CALIBRATION,
   OPT_IGNORE_OFFSETS,
 
+    // read-only statistics of the last scan
+    OPT_PERFORMANCE_GROUP,
+    OPT_PERF_WARMUP_TIME,
+    OPT_PERF_CALIBRATION_TIME,
+    OPT_PERF_START_TIME,
+    OPT_PERF_FIRST_BYTE_LATENCY,
+    OPT_PERF_USB_SPEED,
+    OPT_PERF_PIPELINE_TIME,
+    OPT_PERF_STALL_COUNT,
+
   /* must come last: */
   NUM_OPTIONS
 };
@@ -204,6 +215,7 @@ struct Genesys_Scanner
     SANE_Word resolution = 0;
     bool preview = false; // TODO: currently not used
     bool lamp_off = false;
+    bool smooth_scaling = false;
     SANE_Word lamp_off_time = 0;
     SANE_Word contrast = 0;
     SANE_Word brightness = 0;
@@ -224,14 +236,19 @@ struct Genesys_Scanner
     // Button states
     GenesysButton buttons[NUM_BUTTONS];
 
+    // the scan settings computed from the option values. They are copied to the device settings
+    // before the device is accessed
+    Genesys_Settings settings;
+
     // SANE Parameters
     SANE_Parameters params = {};
     SANE_Int bpp_list[5] = {};
 };
 
-void write_calibration(std::ostream& str, Genesys_Device::Calibration& cache);
+void write_calibration(std::ostream& str, Genesys_Device::Calibration& cache,
+                       LampWarmupModel& warmup_model);
 bool read_calibration(std::istream& str, Genesys_Device::Calibration& cache,
-                      const std::string& path);
+                      LampWarmupModel& warmup_model, const std::string& path);
 
 } // namespace genesys
 
@@ -794,7 +794,7 @@ ScanSession CommandSetGl124::calculate_scan_session(const Genesys_Device* dev,
 
     unsigned move_dpi = dev->motor.base_ydpi / 4;
     float move = dev->model->y_offset;
-    move += dev->settings.tl_y;
+    move += settings.tl_y;
     move = static_cast<float>((move * move_dpi) / MM_PER_INCH);
 
     float start = dev->model->x_offset;
@@ -816,6 +816,9 @@ ScanSession CommandSetGl124::calculate_scan_session(const Genesys_Device* dev,
     session.params.scan_mode = settings.scan_mode;
     session.params.color_filter = settings.color_filter;
     session.params.flags = ScanFlag::NONE;
+    if (settings.true_gray) {
+        session.params.flags |= ScanFlag::ENABLE_LEDADD;
+    }
 
     compute_session(dev, session, sensor);
 
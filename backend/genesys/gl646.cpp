@@ -438,10 +438,9 @@ static void gl646_stop_motor(Genesys_Device* dev)
  */
 static int get_cksel(SensorId sensor_id, int required, unsigned channels)
 {
-    for (const auto& sensor : *s_sensors) {
+    for (const auto& sensor : get_sensor_table_range(sensor_id)) {
         // exit on perfect match
-        if (sensor.sensor_id == sensor_id && sensor.resolutions.matches(required) &&
-            sensor.matches_channel_count(channels))
+        if (sensor.resolutions.matches(required) && sensor.matches_channel_count(channels))
         {
             unsigned cksel = sensor.ccd_pixels_per_system_pixel();
             return cksel;
@@ -2963,7 +2962,7 @@ ScanSession CommandSetGl646::calculate_scan_session(const Genesys_Device* dev,
     session.params.lines = settings.lines;
     session.params.depth = settings.depth;
     session.params.channels = settings.get_channels();
-    session.params.scan_method = dev->settings.scan_method;
+    session.params.scan_method = settings.scan_method;
     session.params.scan_mode = settings.scan_mode;
     session.params.color_filter = settings.color_filter;
     session.params.flags = ScanFlag::AUTO_GO_HOME;
@@ -1097,22 +1097,22 @@ ScanSession CommandSetGl841::calculate_scan_session(const Genesys_Device* dev,
        mm_to_steps()=motor dpi / 2.54 / 10=motor dpi / MM_PER_INCH
     */
     float move = dev->model->y_offset;
-    move += dev->settings.tl_y;
+    move += settings.tl_y;
 
     int move_dpi = dev->motor.base_ydpi;
     move = static_cast<float>((move * move_dpi) / MM_PER_INCH);
 
     float start = dev->model->x_offset;
-    start += dev->settings.tl_x;
-    start = static_cast<float>((start * dev->settings.xres) / MM_PER_INCH);
+    start += settings.tl_x;
+    start = static_cast<float>((start * settings.xres) / MM_PER_INCH);
 
     // we enable true gray for cis scanners only, and just when doing
     // scan since color calibration is OK for this mode
     ScanFlag flags = ScanFlag::NONE;
 
     // true gray (led add for cis scanners)
-    if (dev->model->is_cis && dev->settings.true_gray &&
-        dev->settings.scan_mode != ScanColorMode::COLOR_SINGLE_PASS &&
+    if (dev->model->is_cis && settings.true_gray &&
+        settings.scan_mode != ScanColorMode::COLOR_SINGLE_PASS &&
         dev->model->sensor_id != SensorId::CIS_CANON_LIDE_80)
     {
         // on Lide 80 the LEDADD bit results in only red LED array being lit
@@ -1120,18 +1120,18 @@ ScanSession CommandSetGl841::calculate_scan_session(const Genesys_Device* dev,
     }
 
     ScanSession session;
-    session.params.xres = dev->settings.xres;
-    session.params.yres = dev->settings.yres;
+    session.params.xres = settings.xres;
+    session.params.yres = settings.yres;
     session.params.startx = static_cast<unsigned>(start);
     session.params.starty = static_cast<unsigned>(move);
-    session.params.pixels = dev->settings.pixels;
-    session.params.requested_pixels = dev->settings.requested_pixels;
-    session.params.lines = dev->settings.lines;
-    session.params.depth = dev->settings.depth;
-    session.params.channels = dev->settings.get_channels();
-    session.params.scan_method = dev->settings.scan_method;
-    session.params.scan_mode = dev->settings.scan_mode;
-    session.params.color_filter = dev->settings.color_filter;
+    session.params.pixels = settings.pixels;
+    session.params.requested_pixels = settings.requested_pixels;
+    session.params.lines = settings.lines;
+    session.params.depth = settings.depth;
+    session.params.channels = settings.get_channels();
+    session.params.scan_method = settings.scan_method;
+    session.params.scan_mode = settings.scan_mode;
+    session.params.color_filter = settings.color_filter;
     session.params.flags = flags;
     compute_session(dev, session, sensor);
 
@@ -46,6 +46,7 @@
 #include "gl843.h"
 #include "test_settings.h"
 
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -1756,18 +1757,36 @@ void CommandSetGl843::send_shading_data(Genesys_Device* dev, const Genesys_Senso
         length = size - offset;
     }
 
-  /* loop over calibration data */
-  for (i = 0; i < length; i++)
+    // copy calibration data in blocks of 252 words, each followed by a gap of 4 words
+    i = 0;
+    while (i < length) {
+        unsigned bytes_to_gap = (252 * 2 + 256 * 2 - 1 - count % (256 * 2)) % (256 * 2) + 1;
+        unsigned block_size = std::min<unsigned>(bytes_to_gap, length - i);
+        std::memcpy(buffer + count, data + offset + i, block_size);
+        count += block_size;
+        i += block_size;
+        if ((count % (256 * 2)) == (252 * 2)) {
+            count += 4 * 2;
+        }
+    }
+
+    /*  The shading memory is not touched by anything else, so an upload of the same data as
+        last time can be skipped. This saves a large transfer at each scan start on the high
+        resolution film scanners. Recorded or replayed sessions need all writes to be done.
+    */
+    bool can_skip = !is_testing_mode() && !sanei_usb_is_replay_mode_enabled() &&
+                    !sanei_usb_is_record_mode_enabled();
+    if (can_skip && dev->uploaded_shading_data.size() == static_cast<std::size_t>(count) &&
+        std::equal(final_data.begin(), final_data.begin() + count,
+                   dev->uploaded_shading_data.begin()))
     {
-      buffer[count] = data[offset+i];
-      count++;
-      if ((count % (256*2)) == (252*2))
-	{
-	  count += 4*2;
-	}
+        DBG(DBG_io, "%s: shading data already uploaded, skipping\n", __func__);
+        return;
     }
 
+    dev->uploaded_shading_data.clear();
     dev->interface->write_buffer(0x3c, 0, final_data.data(), count);
+    dev->uploaded_shading_data.assign(final_data.begin(), final_data.begin() + count);
 }
 
 bool CommandSetGl843::needs_home_before_init_regs_for_scan(Genesys_Device* dev) const
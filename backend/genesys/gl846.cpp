@@ -743,7 +743,7 @@ ScanSession CommandSetGl846::calculate_scan_session(const Genesys_Device* dev,
         start = dev->model->x_offset;
     }
 
-    start = start + dev->settings.tl_x;
+    start = start + settings.tl_x;
     start = static_cast<float>((start * settings.xres) / MM_PER_INCH);
 
     ScanSession session;
@@ -761,6 +761,9 @@ ScanSession CommandSetGl846::calculate_scan_session(const Genesys_Device* dev,
     session.params.color_filter = settings.color_filter;
     // backtracking isn't handled well, so don't enable it
     session.params.flags = flags;
+    if (settings.true_gray) {
+        session.params.flags |= ScanFlag::ENABLE_LEDADD;
+    }
 
     compute_session(dev, session, sensor);
 
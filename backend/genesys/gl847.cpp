@@ -719,7 +719,7 @@ ScanSession CommandSetGl847::calculate_scan_session(const Genesys_Device* dev,
         start = dev->model->x_offset;
     }
 
-    start = start + dev->settings.tl_x;
+    start = start + settings.tl_x;
     start = static_cast<float>((start * settings.xres) / MM_PER_INCH);
 
     ScanSession session;
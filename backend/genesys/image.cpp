@@ -106,6 +106,69 @@ void Image::resize(std::size_t width, std::size_t height, PixelFormat format)
     data_.resize(get_row_bytes() * height);
 }
 
+// Converts pixels with 8 or 16-bit channels between color formats that differ only in depth or
+// channel order, or from a gray format by replicating the single channel. The results are the
+// same as with get_pixel_from_row() and set_pixel_to_row(): 8-bit values are widened by
+// replicating them to both bytes and 16-bit values are narrowed to their high byte. Conversions
+// to gray formats are not handled, they weight the channels in floating point.
+template<unsigned InChannels, unsigned InBytes, unsigned OutChannels, unsigned OutBytes,
+         bool SwapOrder>
+void convert_pixel_row_direct(const std::uint8_t* in_data, std::uint8_t* out_data,
+                              std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        const std::uint8_t* in = in_data + i * InChannels * InBytes;
+        std::uint8_t* out = out_data + i * OutChannels * OutBytes;
+
+        for (unsigned ch = 0; ch < OutChannels; ++ch) {
+            unsigned in_ch = InChannels == 1 ? 0 : (SwapOrder ? OutChannels - 1 - ch : ch);
+            const std::uint8_t* in_value = in + in_ch * InBytes;
+            std::uint8_t* out_value = out + ch * OutBytes;
+
+            if (InBytes == OutBytes) {
+                for (unsigned b = 0; b < OutBytes; ++b) {
+                    out_value[b] = in_value[b];
+                }
+            } else if (InBytes == 1) {
+                out_value[0] = in_value[0];
+                out_value[1] = in_value[0];
+            } else {
+                out_value[0] = in_value[1];
+            }
+        }
+    }
+}
+
+struct DirectPixelConversion
+{
+    PixelFormat in_format;
+    PixelFormat out_format;
+    void (*convert)(const std::uint8_t* in_data, std::uint8_t* out_data, std::size_t count);
+};
+
+const DirectPixelConversion s_direct_pixel_conversions[] = {
+    { PixelFormat::RGB888, PixelFormat::BGR888, convert_pixel_row_direct<3, 1, 3, 1, true> },
+    { PixelFormat::BGR888, PixelFormat::RGB888, convert_pixel_row_direct<3, 1, 3, 1, true> },
+    { PixelFormat::RGB161616, PixelFormat::BGR161616, convert_pixel_row_direct<3, 2, 3, 2, true> },
+    { PixelFormat::BGR161616, PixelFormat::RGB161616, convert_pixel_row_direct<3, 2, 3, 2, true> },
+    { PixelFormat::RGB888, PixelFormat::RGB161616, convert_pixel_row_direct<3, 1, 3, 2, false> },
+    { PixelFormat::RGB888, PixelFormat::BGR161616, convert_pixel_row_direct<3, 1, 3, 2, true> },
+    { PixelFormat::BGR888, PixelFormat::RGB161616, convert_pixel_row_direct<3, 1, 3, 2, true> },
+    { PixelFormat::BGR888, PixelFormat::BGR161616, convert_pixel_row_direct<3, 1, 3, 2, false> },
+    { PixelFormat::RGB161616, PixelFormat::RGB888, convert_pixel_row_direct<3, 2, 3, 1, false> },
+    { PixelFormat::RGB161616, PixelFormat::BGR888, convert_pixel_row_direct<3, 2, 3, 1, true> },
+    { PixelFormat::BGR161616, PixelFormat::RGB888, convert_pixel_row_direct<3, 2, 3, 1, true> },
+    { PixelFormat::BGR161616, PixelFormat::BGR888, convert_pixel_row_direct<3, 2, 3, 1, false> },
+    { PixelFormat::I8, PixelFormat::RGB888, convert_pixel_row_direct<1, 1, 3, 1, false> },
+    { PixelFormat::I8, PixelFormat::BGR888, convert_pixel_row_direct<1, 1, 3, 1, false> },
+    { PixelFormat::I8, PixelFormat::RGB161616, convert_pixel_row_direct<1, 1, 3, 2, false> },
+    { PixelFormat::I8, PixelFormat::BGR161616, convert_pixel_row_direct<1, 1, 3, 2, false> },
+    { PixelFormat::I16, PixelFormat::RGB888, convert_pixel_row_direct<1, 2, 3, 1, false> },
+    { PixelFormat::I16, PixelFormat::BGR888, convert_pixel_row_direct<1, 2, 3, 1, false> },
+    { PixelFormat::I16, PixelFormat::RGB161616, convert_pixel_row_direct<1, 2, 3, 2, false> },
+    { PixelFormat::I16, PixelFormat::BGR161616, convert_pixel_row_direct<1, 2, 3, 2, false> },
+};
+
 template<PixelFormat SrcFormat, PixelFormat DstFormat>
 void convert_pixel_row_impl2(const std::uint8_t* in_data, std::uint8_t* out_data,
                              std::size_t count)
@@ -165,6 +228,14 @@ void convert_pixel_row_format(const std::uint8_t* in_data, PixelFormat in_format
         return;
     }
 
+    // the common conversions don't need to go through the generic Pixel representation
+    for (const auto& conversion : s_direct_pixel_conversions) {
+        if (conversion.in_format == in_format && conversion.out_format == out_format) {
+            conversion.convert(in_data, out_data, count);
+            return;
+        }
+    }
+
     switch (in_format) {
         case PixelFormat::I1: {
             convert_pixel_row_impl<PixelFormat::I1>(in_data, out_data, out_format, count);
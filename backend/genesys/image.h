@@ -42,6 +42,7 @@
 #ifndef BACKEND_GENESYS_IMAGE_H
 #define BACKEND_GENESYS_IMAGE_H
 
+#include "buffer_pool.h"
 #include "image_pixel.h"
 #include <vector>
 
@@ -74,7 +75,7 @@ private:
     std::size_t height_ = 0;
     PixelFormat format_ = PixelFormat::UNKNOWN;
     std::size_t row_bytes_ = 0;
-    std::vector<std::uint8_t> data_;
+    PooledBuffer data_;
 };
 
 void convert_pixel_row_format(const std::uint8_t* in_data, PixelFormat in_format,
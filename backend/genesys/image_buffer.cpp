@@ -49,11 +49,20 @@ namespace genesys {
 
 ImageBuffer::ImageBuffer(std::size_t size, ProducerCallback producer) :
     producer_{producer},
-    size_{size}
+    size_{size},
+    max_batch_size_{size}
 {
     buffer_.resize(size_);
 }
 
+void ImageBuffer::set_max_batch_size(std::size_t bytes)
+{
+    if (size_ == 0) {
+        return;
+    }
+    max_batch_size_ = std::max(size_, bytes - bytes % size_);
+}
+
 bool ImageBuffer::get_data(std::size_t size, std::uint8_t* out_data)
 {
     const std::uint8_t* out_data_end = out_data + size;
@@ -79,8 +88,13 @@ bool ImageBuffer::get_data(std::size_t size, std::uint8_t* out_data)
     bool got_data = true;
     do {
         buffer_offset_ = 0;
+        curr_size_ = 0;
 
+        std::size_t wanted_size = out_data_end - out_data;
         std::size_t size_to_read = size_;
+        if (wanted_size > size_) {
+            size_to_read = std::min(wanted_size - wanted_size % size_, max_batch_size_);
+        }
         if (remaining_size_ != BUFFER_SIZE_UNSET) {
             size_to_read = std::min<std::uint64_t>(size_to_read, remaining_size_);
             remaining_size_ -= size_to_read;
@@ -91,10 +105,19 @@ bool ImageBuffer::get_data(std::size_t size, std::uint8_t* out_data)
             aligned_size_to_read = align_multiple_ceil(size_to_read, last_read_multiple_);
         }
 
-        got_data &= producer_(aligned_size_to_read, buffer_.data());
-        curr_size_ = size_to_read;
-
-        copy_buffer();
+        if (aligned_size_to_read == size_to_read && size_to_read <= wanted_size) {
+            // the whole read goes to the output, there's no need to copy it through the buffer
+            got_data &= producer_(aligned_size_to_read, out_data);
+            out_data += aligned_size_to_read;
+        } else {
+            if (buffer_.size() < aligned_size_to_read) {
+                buffer_.resize(aligned_size_to_read);
+            }
+            got_data &= producer_(aligned_size_to_read, buffer_.data());
+            curr_size_ = size_to_read;
+
+            copy_buffer();
+        }
 
         if (remaining_size_ == 0 && out_data < out_data_end) {
             got_data = false;
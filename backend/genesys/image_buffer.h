@@ -42,6 +42,7 @@
 #ifndef BACKEND_GENESYS_IMAGE_BUFFER_H
 #define BACKEND_GENESYS_IMAGE_BUFFER_H
 
+#include "buffer_pool.h"
 #include "enums.h"
 #include "row_buffer.h"
 #include <algorithm>
@@ -69,18 +70,24 @@ public:
     // May be used to force the last read to be rounded up of a certain number of bytes
     void set_last_read_multiple(std::uint64_t bytes) { last_read_multiple_ = bytes; }
 
+    // Allows requesting up to the given number of bytes from the producer at once when a large
+    // read is requested. The data is read in multiples of the chunk size and never more than
+    // requested, so the producer sees no read-ahead. By default each producer call is one chunk.
+    void set_max_batch_size(std::size_t bytes);
+
     bool get_data(std::size_t size, std::uint8_t* out_data);
 
 private:
     ProducerCallback producer_;
     std::size_t size_ = 0;
+    std::size_t max_batch_size_ = 0;
     std::size_t curr_size_ = 0;
 
     std::uint64_t remaining_size_ = BUFFER_SIZE_UNSET;
     std::uint64_t last_read_multiple_ = BUFFER_SIZE_UNSET;
 
     std::size_t buffer_offset_ = 0;
-    std::vector<std::uint8_t> buffer_;
+    PooledBuffer buffer_;
 };
 
 } // namespace genesys
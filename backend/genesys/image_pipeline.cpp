@@ -51,6 +51,16 @@ namespace genesys {
 
 ImagePipelineNode::~ImagePipelineNode() {}
 
+bool ImagePipelineNode::get_next_rows(std::size_t count, std::uint8_t* out_data)
+{
+    bool got_data = true;
+    auto row_bytes = get_row_bytes();
+    for (std::size_t i = 0; i < count; ++i) {
+        got_data &= get_next_row_data(out_data + row_bytes * i);
+    }
+    return got_data;
+}
+
 bool ImagePipelineNodeCallableSource::get_next_row_data(std::uint8_t* out_data)
 {
     bool got_data = producer_(get_row_bytes(), out_data);
@@ -70,21 +80,26 @@ ImagePipelineNodeBufferedCallableSource::ImagePipelineNodeBufferedCallableSource
     buffer_.set_remaining_size(height_ * get_row_bytes());
 }
 
-bool ImagePipelineNodeBufferedCallableSource::get_next_row_data(std::uint8_t* out_data)
+bool ImagePipelineNodeBufferedCallableSource::get_next_rows(std::size_t count,
+                                                            std::uint8_t* out_data)
 {
-    if (curr_row_ >= get_height()) {
-        DBG(DBG_warn, "%s: reading out of bounds. Row %zu, height: %zu\n", __func__,
-            curr_row_, get_height());
+    if (curr_row_ + count > get_height()) {
+        DBG(DBG_warn, "%s: reading out of bounds. Row %zu, count %zu, height: %zu\n", __func__,
+            curr_row_, count, get_height());
         eof_ = true;
-        return false;
+        if (curr_row_ >= get_height()) {
+            return false;
+        }
     }
 
     bool got_data = true;
 
-    got_data &= buffer_.get_data(get_row_bytes(), out_data);
-    curr_row_++;
-    if (!got_data) {
+    auto rows = std::min(count, get_height() - curr_row_);
+    got_data &= buffer_.get_data(get_row_bytes() * rows, out_data);
+    curr_row_ += rows;
+    if (!got_data || rows < count) {
         eof_ = true;
+        got_data = false;
     }
     return got_data;
 }
@@ -105,17 +120,22 @@ ImagePipelineNodeArraySource::ImagePipelineNodeArraySource(std::size_t width, st
     }
 }
 
-bool ImagePipelineNodeArraySource::get_next_row_data(std::uint8_t* out_data)
+bool ImagePipelineNodeArraySource::get_next_rows(std::size_t count, std::uint8_t* out_data)
 {
     if (next_row_ >= height_) {
         eof_ = true;
         return false;
     }
 
+    auto rows = std::min(count, height_ - next_row_);
     auto row_bytes = get_row_bytes();
-    std::memcpy(out_data, data_.data() + row_bytes * next_row_, row_bytes);
-    next_row_++;
+    std::memcpy(out_data, data_.data() + row_bytes * next_row_, row_bytes * rows);
+    next_row_ += rows;
 
+    if (rows < count) {
+        eof_ = true;
+        return false;
+    }
     return true;
 }
 
@@ -124,28 +144,35 @@ ImagePipelineNodeImageSource::ImagePipelineNodeImageSource(const Image& source)
     source_{source}
 {}
 
-bool ImagePipelineNodeImageSource::get_next_row_data(std::uint8_t* out_data)
+bool ImagePipelineNodeImageSource::get_next_rows(std::size_t count, std::uint8_t* out_data)
 {
     if (next_row_ >= get_height()) {
         return false;
     }
-    std::memcpy(out_data, source_.get_row_ptr(next_row_), get_row_bytes());
-    next_row_++;
-    return true;
+    auto rows = std::min(count, get_height() - next_row_);
+    std::memcpy(out_data, source_.get_row_ptr(next_row_), get_row_bytes() * rows);
+    next_row_ += rows;
+    return rows == count;
 }
 
-bool ImagePipelineNodeFormatConvert::get_next_row_data(std::uint8_t* out_data)
+bool ImagePipelineNodeFormatConvert::get_next_rows(std::size_t count, std::uint8_t* out_data)
 {
     auto src_format = source_.get_format();
     if (src_format == dst_format_) {
-        return source_.get_next_row_data(out_data);
+        return source_.get_next_rows(count, out_data);
     }
 
-    buffer_.clear();
-    buffer_.resize(source_.get_row_bytes());
-    bool got_data = source_.get_next_row_data(buffer_.data());
+    auto src_row_bytes = source_.get_row_bytes();
+    auto dst_row_bytes = get_row_bytes();
+    auto width = get_width();
+
+    buffer_.resize(src_row_bytes * count);
+    bool got_data = source_.get_next_rows(count, buffer_.data());
 
-    convert_pixel_row_format(buffer_.data(), src_format, out_data, dst_format_, get_width());
+    for (std::size_t i = 0; i < count; ++i) {
+        convert_pixel_row_format(buffer_.data() + src_row_bytes * i, src_format,
+                                 out_data + dst_row_bytes * i, dst_format_, width);
+    }
     return got_data;
 }
 
@@ -160,8 +187,7 @@ ImagePipelineNodeDesegment::ImagePipelineNodeDesegment(ImagePipelineNode& source
     segment_order_{segment_order},
     segment_pixels_{segment_pixels},
     interleaved_lines_{interleaved_lines},
-    pixels_per_chunk_{pixels_per_chunk},
-    buffer_{source_.get_row_bytes()}
+    pixels_per_chunk_{pixels_per_chunk}
 {
     DBG_HELPER_ARGS(dbg, "segment_count=%zu, segment_size=%zu, interleaved_lines=%zu, "
                          "pixels_per_shunk=%zu", segment_order.size(), segment_pixels,
@@ -183,8 +209,7 @@ ImagePipelineNodeDesegment::ImagePipelineNodeDesegment(ImagePipelineNode& source
     output_width_{output_width},
     segment_pixels_{segment_pixels},
     interleaved_lines_{interleaved_lines},
-    pixels_per_chunk_{pixels_per_chunk},
-    buffer_{source_.get_row_bytes()}
+    pixels_per_chunk_{pixels_per_chunk}
 {
     DBG_HELPER_ARGS(dbg, "segment_count=%zu, segment_size=%zu, interleaved_lines=%zu, "
                     "pixels_per_shunk=%zu", segment_count, segment_pixels, interleaved_lines,
@@ -194,35 +219,34 @@ ImagePipelineNodeDesegment::ImagePipelineNodeDesegment(ImagePipelineNode& source
     std::iota(segment_order_.begin(), segment_order_.end(), 0);
 }
 
-bool ImagePipelineNodeDesegment::get_next_row_data(uint8_t* out_data)
+bool ImagePipelineNodeDesegment::get_next_rows(std::size_t count, std::uint8_t* out_data)
 {
-    bool got_data = true;
+    // each output row is produced out of interleaved_lines_ consecutive input rows
+    auto in_rows_bytes = source_.get_row_bytes() * interleaved_lines_;
+    auto out_row_bytes = get_row_bytes();
 
-    buffer_.clear();
-    for (std::size_t i = 0; i < interleaved_lines_; ++i) {
-        buffer_.push_back();
-        got_data &= source_.get_next_row_data(buffer_.get_row_ptr(i));
-    }
-    if (!buffer_.is_linear()) {
-        throw SaneException("Buffer is not linear");
-    }
+    buffer_.resize(in_rows_bytes * count);
+    bool got_data = source_.get_next_rows(interleaved_lines_ * count, buffer_.data());
 
     auto format = get_format();
     auto segment_count = segment_order_.size();
 
-    const std::uint8_t* in_data = buffer_.get_row_ptr(0);
-
     std::size_t groups_count = output_width_ / (segment_order_.size() * pixels_per_chunk_);
 
-    for (std::size_t igroup = 0; igroup < groups_count; ++igroup) {
-        for (std::size_t isegment = 0; isegment < segment_count; ++isegment) {
-            auto input_offset = igroup * pixels_per_chunk_;
-            input_offset += segment_pixels_ * segment_order_[isegment];
-            auto output_offset = (igroup * segment_count + isegment) * pixels_per_chunk_;
+    for (std::size_t irow = 0; irow < count; ++irow) {
+        const std::uint8_t* in_data = buffer_.data() + in_rows_bytes * irow;
+        std::uint8_t* out_row = out_data + out_row_bytes * irow;
+
+        for (std::size_t igroup = 0; igroup < groups_count; ++igroup) {
+            for (std::size_t isegment = 0; isegment < segment_count; ++isegment) {
+                auto input_offset = igroup * pixels_per_chunk_;
+                input_offset += segment_pixels_ * segment_order_[isegment];
+                auto output_offset = (igroup * segment_count + isegment) * pixels_per_chunk_;
 
-            for (std::size_t ipixel = 0; ipixel < pixels_per_chunk_; ++ipixel) {
-                auto pixel = get_raw_pixel_from_row(in_data, input_offset + ipixel, format);
-                set_raw_pixel_to_row(out_data, output_offset + ipixel, pixel, format);
+                for (std::size_t ipixel = 0; ipixel < pixels_per_chunk_; ++ipixel) {
+                    auto pixel = get_raw_pixel_from_row(in_data, input_offset + ipixel, format);
+                    set_raw_pixel_to_row(out_row, output_offset + ipixel, pixel, format);
+                }
             }
         }
     }
@@ -247,15 +271,11 @@ ImagePipelineNodeSwap16BitEndian::ImagePipelineNodeSwap16BitEndian(ImagePipeline
     }
 }
 
-bool ImagePipelineNodeSwap16BitEndian::get_next_row_data(std::uint8_t* out_data)
+bool ImagePipelineNodeSwap16BitEndian::get_next_rows(std::size_t count, std::uint8_t* out_data)
 {
-    bool got_data = source_.get_next_row_data(out_data);
+    bool got_data = source_.get_next_rows(count, out_data);
     if (needs_swapping_) {
-        std::size_t pixels = get_row_bytes() / 2;
-        for (std::size_t i = 0; i < pixels; ++i) {
-            std::swap(*out_data, *(out_data + 1));
-            out_data += 2;
-        }
+        swap_16bit_endian(out_data, get_row_bytes() * count / 2);
     }
     return got_data;
 }
@@ -265,78 +285,53 @@ ImagePipelineNodeInvert::ImagePipelineNodeInvert(ImagePipelineNode& source) :
 {
 }
 
-bool ImagePipelineNodeInvert::get_next_row_data(std::uint8_t* out_data)
+bool ImagePipelineNodeInvert::get_next_rows(std::size_t count, std::uint8_t* out_data)
 {
-    bool got_data = source_.get_next_row_data(out_data);
-    auto num_values = get_width() * get_pixel_channels(source_.get_format());
-    auto depth = get_pixel_format_depth(source_.get_format());
+    bool got_data = source_.get_next_rows(count, out_data);
 
-    switch (depth) {
-        case 16: {
-            auto* data = reinterpret_cast<std::uint16_t*>(out_data);
-            for (std::size_t i = 0; i < num_values; ++i) {
-                *data = 0xffff - *data;
-                data++;
-            }
-            break;
-        }
-        case 8: {
-            auto* data = out_data;
-            for (std::size_t i = 0; i < num_values; ++i) {
-                *data = 0xff - *data;
-                data++;
-            }
-            break;
-        }
-        case 1: {
-            auto* data = out_data;
-            auto num_bytes = (num_values + 7) / 8;
-            for (std::size_t i = 0; i < num_bytes; ++i) {
-                *data = ~*data;
-                data++;
-            }
-            break;
-        }
-        default:
-            throw SaneException("Unsupported pixel depth");
+    auto depth = get_pixel_format_depth(source_.get_format());
+    if (depth != 1 && depth != 8 && depth != 16) {
+        throw SaneException("Unsupported pixel depth");
     }
 
+    // rows of 1-bit data are padded to whole bytes, the padding bits are inverted too
+    invert_pixel_data(out_data, get_row_bytes() * count);
     return got_data;
 }
 
 ImagePipelineNodeMergeMonoLines::ImagePipelineNodeMergeMonoLines(ImagePipelineNode& source,
                                                                  ColorOrder color_order) :
-    source_(source),
-    buffer_(source_.get_row_bytes())
+    source_(source)
 {
     DBG_HELPER_ARGS(dbg, "color_order %d", static_cast<unsigned>(color_order));
 
     output_format_ = get_output_format(source_.get_format(), color_order);
 }
 
-bool ImagePipelineNodeMergeMonoLines::get_next_row_data(std::uint8_t* out_data)
+bool ImagePipelineNodeMergeMonoLines::get_next_rows(std::size_t count, std::uint8_t* out_data)
 {
-    bool got_data = true;
+    auto in_row_bytes = source_.get_row_bytes();
+    auto out_row_bytes = get_row_bytes();
 
-    buffer_.clear();
-    for (unsigned i = 0; i < 3; ++i) {
-        buffer_.push_back();
-        got_data &= source_.get_next_row_data(buffer_.get_row_ptr(i));
-    }
-
-    const auto* row0 = buffer_.get_row_ptr(0);
-    const auto* row1 = buffer_.get_row_ptr(1);
-    const auto* row2 = buffer_.get_row_ptr(2);
+    buffer_.resize(in_row_bytes * 3 * count);
+    bool got_data = source_.get_next_rows(3 * count, buffer_.data());
 
     auto format = source_.get_format();
 
-    for (std::size_t x = 0, width = get_width(); x < width; ++x) {
-        std::uint16_t ch0 = get_raw_channel_from_row(row0, x, 0, format);
-        std::uint16_t ch1 = get_raw_channel_from_row(row1, x, 0, format);
-        std::uint16_t ch2 = get_raw_channel_from_row(row2, x, 0, format);
-        set_raw_channel_to_row(out_data, x, 0, ch0, output_format_);
-        set_raw_channel_to_row(out_data, x, 1, ch1, output_format_);
-        set_raw_channel_to_row(out_data, x, 2, ch2, output_format_);
+    for (std::size_t irow = 0; irow < count; ++irow) {
+        const auto* row0 = buffer_.data() + in_row_bytes * 3 * irow;
+        const auto* row1 = row0 + in_row_bytes;
+        const auto* row2 = row1 + in_row_bytes;
+        auto* out_row = out_data + out_row_bytes * irow;
+
+        for (std::size_t x = 0, width = get_width(); x < width; ++x) {
+            std::uint16_t ch0 = get_raw_channel_from_row(row0, x, 0, format);
+            std::uint16_t ch1 = get_raw_channel_from_row(row1, x, 0, format);
+            std::uint16_t ch2 = get_raw_channel_from_row(row2, x, 0, format);
+            set_raw_channel_to_row(out_row, x, 0, ch0, output_format_);
+            set_raw_channel_to_row(out_row, x, 1, ch1, output_format_);
+            set_raw_channel_to_row(out_row, x, 2, ch2, output_format_);
+        }
     }
     return got_data;
 }
@@ -419,8 +414,7 @@ PixelFormat ImagePipelineNodeSplitMonoLines::get_output_format(PixelFormat input
 
 ImagePipelineNodeComponentShiftLines::ImagePipelineNodeComponentShiftLines(
         ImagePipelineNode& source, unsigned shift_r, unsigned shift_g, unsigned shift_b) :
-    source_(source),
-    buffer_{source.get_row_bytes()}
+    source_(source)
 {
     DBG_HELPER_ARGS(dbg, "shifts={%d, %d, %d}", shift_r, shift_g, shift_b);
 
@@ -449,39 +443,74 @@ ImagePipelineNodeComponentShiftLines::ImagePipelineNodeComponentShiftLines(
     }
 }
 
-bool ImagePipelineNodeComponentShiftLines::get_next_row_data(std::uint8_t* out_data)
-{
-    bool got_data = true;
+namespace {
 
-    if (!buffer_.empty()) {
-        buffer_.pop_front();
+// Reads the next count rows of source into a buffer that holds extra_height rows of history
+// starting at row history_start, followed by the new rows. The first read fills the history as
+// well. The history is moved to the front of the buffer only when there's no room after it. The
+// buffer then gets room for extra_height more rows, so that a move happens only after at least as
+// many rows as are moved have been consumed.
+bool read_rows_with_history(ImagePipelineNode& source, PooledBuffer& buffer,
+                            bool& history_valid, std::size_t& history_start,
+                            std::size_t extra_height, std::size_t count)
+{
+    auto row_bytes = source.get_row_bytes();
+    if (!history_valid) {
+        history_valid = true;
+        history_start = 0;
+        buffer.resize(row_bytes * (2 * extra_height + count));
+        return source.get_next_rows(extra_height + count, buffer.data());
     }
-    while (buffer_.height() < extra_height_ + 1) {
-        buffer_.push_back();
-        got_data &= source_.get_next_row_data(buffer_.get_back_row_ptr());
+
+    if (row_bytes * (history_start + extra_height + count) > buffer.size()) {
+        if (history_start > 0 && extra_height > 0) {
+            std::memmove(buffer.data(), buffer.data() + row_bytes * history_start,
+                         row_bytes * extra_height);
+        }
+        history_start = 0;
+        buffer.resize(std::max(buffer.size(), row_bytes * (2 * extra_height + count)));
     }
+    return source.get_next_rows(count,
+                                buffer.data() + row_bytes * (history_start + extra_height));
+}
+
+} // namespace
+
+bool ImagePipelineNodeComponentShiftLines::get_next_rows(std::size_t count,
+                                                         std::uint8_t* out_data)
+{
+    bool got_data = read_rows_with_history(source_, buffer_, history_valid_, history_start_,
+                                           extra_height_, count);
 
     auto format = get_format();
-    const auto* row0 = buffer_.get_row_ptr(channel_shifts_[0]);
-    const auto* row1 = buffer_.get_row_ptr(channel_shifts_[1]);
-    const auto* row2 = buffer_.get_row_ptr(channel_shifts_[2]);
+    auto row_bytes = get_row_bytes();
 
-    for (std::size_t x = 0, width = get_width(); x < width; ++x) {
-        std::uint16_t ch0 = get_raw_channel_from_row(row0, x, 0, format);
-        std::uint16_t ch1 = get_raw_channel_from_row(row1, x, 1, format);
-        std::uint16_t ch2 = get_raw_channel_from_row(row2, x, 2, format);
-        set_raw_channel_to_row(out_data, x, 0, ch0, format);
-        set_raw_channel_to_row(out_data, x, 1, ch1, format);
-        set_raw_channel_to_row(out_data, x, 2, ch2, format);
+    for (std::size_t irow = 0; irow < count; ++irow) {
+        const auto* rows = buffer_.data() + row_bytes * (history_start_ + irow);
+        const auto* row0 = rows + row_bytes * channel_shifts_[0];
+        const auto* row1 = rows + row_bytes * channel_shifts_[1];
+        const auto* row2 = rows + row_bytes * channel_shifts_[2];
+        auto* out_row = out_data + row_bytes * irow;
+
+        for (std::size_t x = 0, width = get_width(); x < width; ++x) {
+            std::uint16_t ch0 = get_raw_channel_from_row(row0, x, 0, format);
+            std::uint16_t ch1 = get_raw_channel_from_row(row1, x, 1, format);
+            std::uint16_t ch2 = get_raw_channel_from_row(row2, x, 2, format);
+            set_raw_channel_to_row(out_row, x, 0, ch0, format);
+            set_raw_channel_to_row(out_row, x, 1, ch1, format);
+            set_raw_channel_to_row(out_row, x, 2, ch2, format);
+        }
     }
+
+    // the last extra_height_ rows are the history of the next read
+    history_start_ += count;
     return got_data;
 }
 
 ImagePipelineNodePixelShiftLines::ImagePipelineNodePixelShiftLines(
         ImagePipelineNode& source, const std::vector<std::size_t>& shifts) :
     source_(source),
-    pixel_shifts_{shifts},
-    buffer_{get_row_bytes()}
+    pixel_shifts_{shifts}
 {
     extra_height_ = *std::max_element(pixel_shifts_.begin(), pixel_shifts_.end());
     height_ = source_.get_height();
@@ -492,34 +521,34 @@ ImagePipelineNodePixelShiftLines::ImagePipelineNodePixelShiftLines(
     }
 }
 
-bool ImagePipelineNodePixelShiftLines::get_next_row_data(std::uint8_t* out_data)
+bool ImagePipelineNodePixelShiftLines::get_next_rows(std::size_t count, std::uint8_t* out_data)
 {
-    bool got_data = true;
-
-    if (!buffer_.empty()) {
-        buffer_.pop_front();
-    }
-    while (buffer_.height() < extra_height_ + 1) {
-        buffer_.push_back();
-        got_data &= source_.get_next_row_data(buffer_.get_back_row_ptr());
-    }
+    bool got_data = read_rows_with_history(source_, buffer_, history_valid_, history_start_,
+                                           extra_height_, count);
 
     auto format = get_format();
+    auto row_bytes = get_row_bytes();
     auto shift_count = pixel_shifts_.size();
 
-    std::vector<std::uint8_t*> rows;
-    rows.resize(shift_count, nullptr);
+    rows_.resize(shift_count, nullptr);
 
-    for (std::size_t irow = 0; irow < shift_count; ++irow) {
-        rows[irow] = buffer_.get_row_ptr(pixel_shifts_[irow]);
-    }
+    for (std::size_t irow = 0; irow < count; ++irow) {
+        for (std::size_t ishift = 0; ishift < shift_count; ++ishift) {
+            rows_[ishift] = buffer_.data() +
+                    row_bytes * (history_start_ + irow + pixel_shifts_[ishift]);
+        }
+        auto* out_row = out_data + row_bytes * irow;
 
-    for (std::size_t x = 0, width = get_width(); x < width;) {
-        for (std::size_t irow = 0; irow < shift_count && x < width; irow++, x++) {
-            RawPixel pixel = get_raw_pixel_from_row(rows[irow], x, format);
-            set_raw_pixel_to_row(out_data, x, pixel, format);
+        for (std::size_t x = 0, width = get_width(); x < width;) {
+            for (std::size_t ishift = 0; ishift < shift_count && x < width; ishift++, x++) {
+                RawPixel pixel = get_raw_pixel_from_row(rows_[ishift], x, format);
+                set_raw_pixel_to_row(out_row, x, pixel, format);
+            }
         }
     }
+
+    // the last extra_height_ rows are the history of the next read
+    history_start_ += count;
     return got_data;
 }
 
@@ -538,21 +567,30 @@ ImagePipelineNodePixelShiftColumns::ImagePipelineNodePixelShiftColumns(
     temp_buffer_.resize(source_.get_row_bytes());
 }
 
-bool ImagePipelineNodePixelShiftColumns::get_next_row_data(std::uint8_t* out_data)
+bool ImagePipelineNodePixelShiftColumns::get_next_rows(std::size_t count,
+                                                       std::uint8_t* out_data)
 {
     if (width_ == 0) {
         throw SaneException("Attempt to read zero-width line");
     }
-    bool got_data = source_.get_next_row_data(temp_buffer_.data());
+    auto in_row_bytes = source_.get_row_bytes();
+    auto out_row_bytes = get_row_bytes();
+
+    temp_buffer_.resize(in_row_bytes * count);
+    bool got_data = source_.get_next_rows(count, temp_buffer_.data());
 
     auto format = get_format();
     auto shift_count = pixel_shifts_.size();
 
-    for (std::size_t x = 0, width = get_width(); x < width; x += shift_count) {
-        for (std::size_t ishift = 0; ishift < shift_count && x + ishift < width; ishift++) {
-            RawPixel pixel = get_raw_pixel_from_row(temp_buffer_.data(), x + pixel_shifts_[ishift],
-                                                    format);
-            set_raw_pixel_to_row(out_data, x + ishift, pixel, format);
+    for (std::size_t irow = 0; irow < count; ++irow) {
+        const auto* in_row = temp_buffer_.data() + in_row_bytes * irow;
+        auto* out_row = out_data + out_row_bytes * irow;
+
+        for (std::size_t x = 0, width = get_width(); x < width; x += shift_count) {
+            for (std::size_t ishift = 0; ishift < shift_count && x + ishift < width; ishift++) {
+                RawPixel pixel = get_raw_pixel_from_row(in_row, x + pixel_shifts_[ishift], format);
+                set_raw_pixel_to_row(out_row, x + ishift, pixel, format);
+            }
         }
     }
     return got_data;
@@ -708,6 +746,236 @@ bool ImagePipelineNodeExtract::get_next_row_data(std::uint8_t* out_data)
     return got_data;
 }
 
+namespace {
+
+float resample_filter_radius(ResampleFilter filter)
+{
+    switch (filter) {
+        case ResampleFilter::BOX: return 0.5f;
+        case ResampleFilter::BILINEAR: return 1.0f;
+    }
+    throw SaneException("Unknown resample filter %d", static_cast<unsigned>(filter));
+}
+
+float resample_filter_weight(ResampleFilter filter, float x)
+{
+    switch (filter) {
+        case ResampleFilter::BOX:
+            return (x >= -0.5f && x < 0.5f) ? 1.0f : 0.0f;
+        case ResampleFilter::BILINEAR:
+            return std::max(0.0f, 1.0f - std::abs(x));
+    }
+    throw SaneException("Unknown resample filter %d", static_cast<unsigned>(filter));
+}
+
+void unpack_row(const std::uint8_t* data, float* out, std::size_t width, PixelFormat format)
+{
+    auto count = width * get_pixel_channels(format);
+    switch (format) {
+        case PixelFormat::I8:
+        case PixelFormat::RGB888:
+        case PixelFormat::BGR888:
+            for (std::size_t i = 0; i < count; i++) {
+                out[i] = data[i];
+            }
+            return;
+        case PixelFormat::I16:
+        case PixelFormat::RGB161616:
+        case PixelFormat::BGR161616:
+            for (std::size_t i = 0; i < count; i++) {
+                out[i] = data[i * 2] | (data[i * 2 + 1] << 8);
+            }
+            return;
+        default:
+            throw SaneException("Unsupported format %d", static_cast<unsigned>(format));
+    }
+}
+
+template<class T>
+T clamp_resampled_value(float value, float max_value)
+{
+    value = std::min(std::max(value + 0.5f, 0.0f), max_value);
+    return static_cast<T>(value);
+}
+
+void pack_row(const float* data, std::uint8_t* out, std::size_t width, PixelFormat format)
+{
+    auto count = width * get_pixel_channels(format);
+    switch (format) {
+        case PixelFormat::I8:
+        case PixelFormat::RGB888:
+        case PixelFormat::BGR888:
+            for (std::size_t i = 0; i < count; i++) {
+                out[i] = clamp_resampled_value<std::uint8_t>(data[i], 255.0f);
+            }
+            return;
+        case PixelFormat::I16:
+        case PixelFormat::RGB161616:
+        case PixelFormat::BGR161616:
+            for (std::size_t i = 0; i < count; i++) {
+                auto value = clamp_resampled_value<std::uint16_t>(data[i], 65535.0f);
+                out[i * 2] = value & 0xff;
+                out[i * 2 + 1] = value >> 8;
+            }
+            return;
+        default:
+            throw SaneException("Unsupported format %d", static_cast<unsigned>(format));
+    }
+}
+
+// The channel count is a template parameter so that the inner loops have constant trip counts
+template<unsigned Channels>
+void resample_row_horizontal(const float* src, float* dst, const ResampleCoefficients& coeffs)
+{
+    auto taps = coeffs.taps;
+    for (std::size_t x = 0; x < coeffs.first.size(); x++) {
+        const float* weights = coeffs.weights.data() + x * taps;
+        const float* src_pixel = src + coeffs.first[x] * Channels;
+
+        float sums[Channels] = {};
+        for (std::size_t t = 0; t < taps; t++) {
+            for (unsigned c = 0; c < Channels; c++) {
+                sums[c] += weights[t] * src_pixel[t * Channels + c];
+            }
+        }
+        for (unsigned c = 0; c < Channels; c++) {
+            dst[x * Channels + c] = sums[c];
+        }
+    }
+}
+
+} // namespace
+
+ResampleCoefficients compute_resample_coefficients(std::size_t src_size, std::size_t dst_size,
+                                                   ResampleFilter filter)
+{
+    if (src_size == 0 || dst_size == 0) {
+        throw SaneException("Can't resample from size %zu to size %zu", src_size, dst_size);
+    }
+
+    float scale = static_cast<float>(dst_size) / src_size;
+    // when downscaling the filter is stretched so that it covers all source samples
+    float filter_scale = std::max(1.0f, 1.0f / scale);
+    float support = resample_filter_radius(filter) * filter_scale;
+
+    ResampleCoefficients coeffs;
+    if (src_size == dst_size) {
+        // a single tap is enough to copy the samples
+        coeffs.taps = 1;
+        coeffs.first.resize(dst_size);
+        std::iota(coeffs.first.begin(), coeffs.first.end(), 0);
+        coeffs.weights.resize(dst_size, 1.0f);
+        return coeffs;
+    }
+
+    coeffs.taps = std::min<std::size_t>(static_cast<std::size_t>(std::ceil(support * 2)) + 1,
+                                        src_size);
+    coeffs.first.resize(dst_size);
+    coeffs.weights.resize(dst_size * coeffs.taps);
+
+    for (std::size_t i = 0; i < dst_size; i++) {
+        float center = (i + 0.5f) / scale - 0.5f;
+
+        // the window is moved inwards at the image edges, weights outside the filter support
+        // are zero
+        long first = static_cast<long>(std::floor(center - support)) + 1;
+        first = std::max(0l, std::min(first, static_cast<long>(src_size - coeffs.taps)));
+        coeffs.first[i] = first;
+
+        float* weights = coeffs.weights.data() + i * coeffs.taps;
+        float sum = 0;
+        for (std::size_t t = 0; t < coeffs.taps; t++) {
+            weights[t] = resample_filter_weight(filter, (first + t - center) / filter_scale);
+            sum += weights[t];
+        }
+
+        if (sum == 0) {
+            // can only happen when the window was clamped at the edge of a tiny image
+            auto nearest = static_cast<long>(std::floor(center + 0.5f)) - first;
+            nearest = std::max(0l, std::min(nearest, static_cast<long>(coeffs.taps - 1)));
+            weights[nearest] = 1.0f;
+            continue;
+        }
+        for (std::size_t t = 0; t < coeffs.taps; t++) {
+            weights[t] /= sum;
+        }
+    }
+    return coeffs;
+}
+
+ImagePipelineNodeResample::ImagePipelineNodeResample(ImagePipelineNode& source,
+                                                     std::size_t width, std::size_t height,
+                                                     ResampleFilter filter) :
+    source_(source),
+    width_{width},
+    height_{height}
+{
+    x_coeffs_ = compute_resample_coefficients(source_.get_width(), width_, filter);
+    y_coeffs_ = compute_resample_coefficients(source_.get_height(), height_, filter);
+
+    auto depth = get_pixel_format_depth(get_format());
+    if (depth != 8 && depth != 16) {
+        throw SaneException("Unsupported depth %u", depth);
+    }
+    auto channels = get_pixel_channels(get_format());
+    if (channels != 1 && channels != 3) {
+        throw SaneException("Unsupported number of channels %u", channels);
+    }
+
+    cached_line_.resize(source_.get_row_bytes());
+    unpacked_line_.resize(source_.get_width() * channels);
+    rows_.resize(y_coeffs_.taps * width_ * channels);
+    out_line_.resize(width_ * channels);
+}
+
+void ImagePipelineNodeResample::read_source_row()
+{
+    got_data_ &= source_.get_next_row_data(cached_line_.data());
+
+    auto format = get_format();
+    unpack_row(cached_line_.data(), unpacked_line_.data(), source_.get_width(), format);
+
+    auto row_size = out_line_.size();
+    float* row = rows_.data() + (rows_read_ % y_coeffs_.taps) * row_size;
+    if (get_pixel_channels(format) == 1) {
+        resample_row_horizontal<1>(unpacked_line_.data(), row, x_coeffs_);
+    } else {
+        resample_row_horizontal<3>(unpacked_line_.data(), row, x_coeffs_);
+    }
+    rows_read_++;
+}
+
+bool ImagePipelineNodeResample::get_next_row_data(std::uint8_t* out_data)
+{
+    auto y = std::min(current_row_, height_ - 1);
+    auto taps = y_coeffs_.taps;
+    auto first = y_coeffs_.first[y];
+
+    while (rows_read_ < first + taps) {
+        read_source_row();
+    }
+
+    const float* weights = y_coeffs_.weights.data() + y * taps;
+    auto row_size = out_line_.size();
+
+    std::fill(out_line_.begin(), out_line_.end(), 0.0f);
+    for (std::size_t t = 0; t < taps; t++) {
+        if (weights[t] == 0) {
+            continue;
+        }
+        float weight = weights[t];
+        const float* row = rows_.data() + ((first + t) % taps) * row_size;
+        float* out = out_line_.data();
+        for (std::size_t i = 0; i < row_size; i++) {
+            out[i] += weight * row[i];
+        }
+    }
+
+    pack_row(out_line_.data(), out_data, width_, get_format());
+    current_row_++;
+    return got_data_;
+}
+
 ImagePipelineNodeCalibrate::ImagePipelineNodeCalibrate(ImagePipelineNode& source,
                                                        const std::vector<std::uint16_t>& bottom,
                                                        const std::vector<std::uint16_t>& top,
@@ -728,9 +996,9 @@ ImagePipelineNodeCalibrate::ImagePipelineNodeCalibrate(ImagePipelineNode& source
     }
 }
 
-bool ImagePipelineNodeCalibrate::get_next_row_data(std::uint8_t* out_data)
+bool ImagePipelineNodeCalibrate::get_next_rows(std::size_t count, std::uint8_t* out_data)
 {
-    bool ret = source_.get_next_row_data(out_data);
+    bool ret = source_.get_next_rows(count, out_data);
 
     auto format = get_format();
     auto depth = get_pixel_format_depth(format);
@@ -742,21 +1010,26 @@ bool ImagePipelineNodeCalibrate::get_next_row_data(std::uint8_t* out_data)
             throw SaneException("Unsupported depth for calibration %d", depth);
     }
     unsigned channels = get_pixel_channels(format);
+    auto row_bytes = get_row_bytes();
 
     std::size_t max_calib_i = offset_.size();
-    std::size_t curr_calib_i = 0;
 
-    for (std::size_t x = 0, width = get_width(); x < width && curr_calib_i < max_calib_i; ++x) {
-        for (unsigned ch = 0; ch < channels && curr_calib_i < max_calib_i; ++ch) {
-            std::int32_t value = get_raw_channel_from_row(out_data, x, ch, format);
+    for (std::size_t irow = 0; irow < count; ++irow) {
+        auto* row = out_data + row_bytes * irow;
+        std::size_t curr_calib_i = 0;
+
+        for (std::size_t x = 0, width = get_width(); x < width && curr_calib_i < max_calib_i; ++x) {
+            for (unsigned ch = 0; ch < channels && curr_calib_i < max_calib_i; ++ch) {
+                std::int32_t value = get_raw_channel_from_row(row, x, ch, format);
 
-            float value_f = static_cast<float>(value) / max_value;
-            value_f = (value_f - offset_[curr_calib_i]) * multiplier_[curr_calib_i];
-            value_f = std::round(value_f * max_value);
-            value = clamp<std::int32_t>(static_cast<std::int32_t>(value_f), 0, max_value);
-            set_raw_channel_to_row(out_data, x, ch, value, format);
+                float value_f = static_cast<float>(value) / max_value;
+                value_f = (value_f - offset_[curr_calib_i]) * multiplier_[curr_calib_i];
+                value_f = std::round(value_f * max_value);
+                value = clamp<std::int32_t>(static_cast<std::int32_t>(value_f), 0, max_value);
+                set_raw_channel_to_row(row, x, ch, value, format);
 
-            curr_calib_i++;
+                curr_calib_i++;
+            }
         }
     }
     return ret;
@@ -856,16 +1129,27 @@ void ImagePipelineStack::clear()
     nodes_.clear();
 }
 
+constexpr std::size_t ImagePipelineStack::MAX_BATCH_BYTES;
+
+std::size_t ImagePipelineStack::get_batch_rows(std::size_t row_bytes)
+{
+    if (row_bytes == 0) {
+        return 1;
+    }
+    return std::max<std::size_t>(1, MAX_BATCH_BYTES / row_bytes);
+}
+
 std::vector<std::uint8_t> ImagePipelineStack::get_all_data()
 {
     auto row_bytes = get_output_row_bytes();
     auto height = get_output_height();
+    auto batch_rows = get_batch_rows(row_bytes);
 
     std::vector<std::uint8_t> ret;
     ret.resize(row_bytes * height);
 
-    for (std::size_t i = 0; i < height; ++i) {
-        get_next_row_data(ret.data() + row_bytes * i);
+    for (std::size_t i = 0; i < height; i += batch_rows) {
+        get_next_rows(std::min(batch_rows, height - i), ret.data() + row_bytes * i);
     }
     return ret;
 }
@@ -877,8 +1161,11 @@ Image ImagePipelineStack::get_image()
     Image ret;
     ret.resize(get_output_width(), height, get_output_format());
 
-    for (std::size_t i = 0; i < height; ++i) {
-        get_next_row_data(ret.get_row_ptr(i));
+    auto row_bytes = ret.get_row_bytes();
+    auto batch_rows = get_batch_rows(row_bytes);
+
+    for (std::size_t i = 0; i < height; i += batch_rows) {
+        get_next_rows(std::min(batch_rows, height - i), ret.get_row_ptr(i));
     }
     return ret;
 }
@@ -71,6 +71,11 @@ public:
     // returns true if the row was filled successfully, false otherwise (e.g. if not enough data
     // was available.
     virtual bool get_next_row_data(std::uint8_t* out_data) = 0;
+
+    // fills count consecutive rows of get_row_bytes() bytes each. Returns true if all rows were
+    // filled successfully. The default implementation reads the rows one by one; nodes that
+    // process many rows override it so that a whole batch passes through the pipeline at once.
+    virtual bool get_next_rows(std::size_t count, std::uint8_t* out_data);
 };
 
 // A pipeline node that produces data from a callable
@@ -119,7 +124,8 @@ public:
 
     bool eof() const override { return eof_; }
 
-    bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_row_data(std::uint8_t* out_data) override { return get_next_rows(1, out_data); }
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
     std::size_t remaining_bytes() const { return buffer_.remaining_size(); }
     void set_remaining_bytes(std::size_t bytes) { buffer_.set_remaining_size(bytes); }
@@ -150,7 +156,8 @@ public:
 
     bool eof() const override { return eof_; }
 
-    bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_row_data(std::uint8_t* out_data) override { return get_next_rows(1, out_data); }
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
 private:
     std::size_t width_ = 0;
@@ -176,7 +183,8 @@ public:
 
     bool eof() const override { return next_row_ >= get_height(); }
 
-    bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_row_data(std::uint8_t* out_data) override { return get_next_rows(1, out_data); }
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
 private:
     const Image& source_;
@@ -200,12 +208,13 @@ public:
 
     bool eof() const override { return source_.eof(); }
 
-    bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_row_data(std::uint8_t* out_data) override { return get_next_rows(1, out_data); }
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
 private:
     ImagePipelineNode& source_;
     PixelFormat dst_format_;
-    std::vector<std::uint8_t> buffer_;
+    PooledBuffer buffer_;
 };
 
 // A pipeline node that handles data that comes out of segmented sensors. Note that the width of
@@ -236,7 +245,8 @@ public:
 
     bool eof() const override { return source_.eof(); }
 
-    bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_row_data(std::uint8_t* out_data) override { return get_next_rows(1, out_data); }
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
 private:
     ImagePipelineNode& source_;
@@ -246,7 +256,7 @@ private:
     std::size_t interleaved_lines_ = 0;
     std::size_t pixels_per_chunk_ = 0;
 
-    RowBuffer buffer_;
+    PooledBuffer buffer_;
 };
 
 // A pipeline node that deinterleaves data on multiple lines
@@ -270,7 +280,8 @@ public:
 
     bool eof() const override { return source_.eof(); }
 
-    bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_row_data(std::uint8_t* out_data) override { return get_next_rows(1, out_data); }
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
 private:
     ImagePipelineNode& source_;
@@ -288,7 +299,8 @@ public:
 
     bool eof() const override { return source_.eof(); }
 
-    bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_row_data(std::uint8_t* out_data) override { return get_next_rows(1, out_data); }
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
 private:
     ImagePipelineNode& source_;
@@ -307,7 +319,8 @@ public:
 
     bool eof() const override { return source_.eof(); }
 
-    bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_row_data(std::uint8_t* out_data) override { return get_next_rows(1, out_data); }
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
 private:
     static PixelFormat get_output_format(PixelFormat input_format, ColorOrder order);
@@ -315,7 +328,7 @@ private:
     ImagePipelineNode& source_;
     PixelFormat output_format_ = PixelFormat::UNKNOWN;
 
-    RowBuffer buffer_;
+    PooledBuffer buffer_;
 };
 
 // A pipeline node that splits a color channel into 3 mono lines
@@ -338,7 +351,7 @@ private:
     ImagePipelineNode& source_;
     PixelFormat output_format_ = PixelFormat::UNKNOWN;
 
-    std::vector<std::uint8_t> buffer_;
+    PooledBuffer buffer_;
     unsigned next_channel_ = 0;
 };
 
@@ -355,7 +368,8 @@ public:
 
     bool eof() const override { return source_.eof(); }
 
-    bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_row_data(std::uint8_t* out_data) override { return get_next_rows(1, out_data); }
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
 private:
     ImagePipelineNode& source_;
@@ -364,7 +378,11 @@ private:
 
     std::array<unsigned, 3> channel_shifts_;
 
-    RowBuffer buffer_;
+    // extra_height_ rows of history starting at row history_start_ followed by the rows of the
+    // current batch
+    PooledBuffer buffer_;
+    bool history_valid_ = false;
+    std::size_t history_start_ = 0;
 };
 
 // A pipeline node that shifts pixels across lines by the given offsets (performs vertical
@@ -381,7 +399,8 @@ public:
 
     bool eof() const override { return source_.eof(); }
 
-    bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_row_data(std::uint8_t* out_data) override { return get_next_rows(1, out_data); }
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
 private:
     ImagePipelineNode& source_;
@@ -390,7 +409,12 @@ private:
 
     std::vector<std::size_t> pixel_shifts_;
 
-    RowBuffer buffer_;
+    // extra_height_ rows of history starting at row history_start_ followed by the rows of the
+    // current batch
+    PooledBuffer buffer_;
+    bool history_valid_ = false;
+    std::size_t history_start_ = 0;
+    std::vector<std::uint8_t*> rows_;
 };
 
 // A pipeline node that shifts pixels across columns by the given offsets. Each row is divided
@@ -408,7 +432,8 @@ public:
 
     bool eof() const override { return source_.eof(); }
 
-    bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_row_data(std::uint8_t* out_data) override { return get_next_rows(1, out_data); }
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
 private:
     ImagePipelineNode& source_;
@@ -417,7 +442,7 @@ private:
 
     std::vector<std::size_t> pixel_shifts_;
 
-    std::vector<std::uint8_t> temp_buffer_;
+    PooledBuffer temp_buffer_;
 };
 
 // exposed for tests
@@ -451,7 +476,7 @@ private:
     std::size_t height_ = 0;
 
     std::size_t current_line_ = 0;
-    std::vector<std::uint8_t> cached_line_;
+    PooledBuffer cached_line_;
 };
 
 // A pipeline node that scales rows to the specified width by using a point filter
@@ -472,7 +497,67 @@ private:
     ImagePipelineNode& source_;
     std::size_t width_ = 0;
 
-    std::vector<std::uint8_t> cached_line_;
+    PooledBuffer cached_line_;
+};
+
+enum class ResampleFilter
+{
+    BOX,
+    BILINEAR,
+};
+
+// Precomputed filter weights for resampling along a single axis. Output sample i is the sum of
+// weights[i * taps + t] * source[first[i] + t] for t in [0, taps).
+struct ResampleCoefficients
+{
+    std::size_t taps = 0;
+    std::vector<std::size_t> first;
+    std::vector<float> weights;
+};
+
+// exposed for tests
+ResampleCoefficients compute_resample_coefficients(std::size_t src_size, std::size_t dst_size,
+                                                   ResampleFilter filter);
+
+// A pipeline node that resamples the image to the specified size in both directions using a
+// separable filter. Rows are first resampled horizontally as they are read from the source and
+// then only as many of them are kept as the vertical filter needs. Only formats with 8 or 16 bits
+// per channel are supported.
+class ImagePipelineNodeResample : public ImagePipelineNode
+{
+public:
+    ImagePipelineNodeResample(ImagePipelineNode& source, std::size_t width, std::size_t height,
+                              ResampleFilter filter);
+
+    std::size_t get_width() const override { return width_; }
+    std::size_t get_height() const override { return height_; }
+    PixelFormat get_format() const override { return source_.get_format(); }
+
+    // when upscaling, output rows are still pending after the last source row has been read
+    bool eof() const override { return current_row_ >= height_; }
+
+    bool get_next_row_data(std::uint8_t* out_data) override;
+
+private:
+    void read_source_row();
+
+    ImagePipelineNode& source_;
+    std::size_t width_ = 0;
+    std::size_t height_ = 0;
+
+    ResampleCoefficients x_coeffs_;
+    ResampleCoefficients y_coeffs_;
+
+    PooledBuffer cached_line_;
+    std::vector<float> unpacked_line_;
+
+    // horizontally resampled source rows. Source row y is stored at slot y % y_coeffs_.taps
+    std::vector<float> rows_;
+    std::size_t rows_read_ = 0;
+    std::size_t current_row_ = 0;
+    bool got_data_ = true;
+
+    std::vector<float> out_line_;
 };
 
 // A pipeline node that mimics the calibration behavior on Genesys chips
@@ -489,7 +574,8 @@ public:
 
     bool eof() const override { return source_.eof(); }
 
-    bool get_next_row_data(std::uint8_t* out_data) override;
+    bool get_next_row_data(std::uint8_t* out_data) override { return get_next_rows(1, out_data); }
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data) override;
 
 private:
     ImagePipelineNode& source_;
@@ -521,6 +607,10 @@ private:
 class ImagePipelineStack
 {
 public:
+    // the approximate size of the batches of rows read by get_all_data() and get_image() and the
+    // largest batch that is useful to request from the pipeline at once
+    static constexpr std::size_t MAX_BATCH_BYTES = 256 * 1024;
+
     ImagePipelineStack() {}
     ImagePipelineStack(ImagePipelineStack&& other)
     {
@@ -577,10 +667,18 @@ public:
         return nodes_.back()->get_next_row_data(out_data);
     }
 
+    bool get_next_rows(std::size_t count, std::uint8_t* out_data)
+    {
+        return nodes_.back()->get_next_rows(count, out_data);
+    }
+
     std::vector<std::uint8_t> get_all_data();
 
     Image get_image();
 
+    // returns the number of rows of the given size in a batch of about MAX_BATCH_BYTES
+    static std::size_t get_batch_rows(std::size_t row_bytes);
+
 private:
     void ensure_node_exists() const;
 
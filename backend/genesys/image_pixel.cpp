@@ -44,6 +44,7 @@
 #include "image.h"
 
 #include <array>
+#include <cstring>
 
 namespace genesys {
 
@@ -398,6 +399,23 @@ void set_raw_channel_to_row(std::uint8_t* data, std::size_t x, unsigned channel,
     }
 }
 
+void swap_16bit_endian(std::uint8_t* data, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        std::uint16_t value;
+        std::memcpy(&value, data + i * 2, 2);
+        value = static_cast<std::uint16_t>((value >> 8) | (value << 8));
+        std::memcpy(data + i * 2, &value, 2);
+    }
+}
+
+void invert_pixel_data(std::uint8_t* data, std::size_t size)
+{
+    for (std::size_t i = 0; i < size; ++i) {
+        data[i] = ~data[i];
+    }
+}
+
 template<PixelFormat Format>
 Pixel get_pixel_from_row(const std::uint8_t* data, std::size_t x)
 {
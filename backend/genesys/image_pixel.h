@@ -122,6 +122,13 @@ std::uint16_t get_raw_channel_from_row(const std::uint8_t* data, std::size_t x,
 void set_raw_channel_to_row(std::uint8_t* data, std::size_t x, unsigned channel, std::uint16_t pixel,
                             PixelFormat format);
 
+// swaps the bytes of count consecutive 16-bit values in place
+void swap_16bit_endian(std::uint8_t* data, std::size_t count);
+
+// inverts size bytes of pixel data in place. Inverting all bits of the data inverts the values of
+// all channels regardless of the depth of the pixel format.
+void invert_pixel_data(std::uint8_t* data, std::size_t size);
+
 template<PixelFormat Format>
 Pixel get_pixel_from_row(const std::uint8_t* data, std::size_t x);
 template<PixelFormat Format>
@@ -393,6 +393,7 @@ Image read_unshuffled_image_from_scanner(Genesys_Device* dev, const ScanSession&
                                          std::size_t total_bytes)
 {
     DBG_HELPER(dbg);
+    BufferPool::Scope pool_scope{dev->buffer_pool};
 
     auto format = create_pixel_format(session.params.depth,
                                       dev->model->is_cis ? 1 : session.params.channels,
@@ -899,7 +900,7 @@ unsigned session_adjust_output_pixels(unsigned output_pixels,
         if (output_xresolution >= 1200 && (
                     dev.model->asic_type == AsicType::GL124 ||
                     dev.model->asic_type == AsicType::GL847 ||
-                    dev.session.params.xres < dev.session.params.yres))
+                    output_xresolution < output_yresolution))
         {
             if (output_xresolution < output_yresolution) {
                 // FIXME: this is an artifact of the fact that the resolution was twice as large than
@@ -1114,7 +1115,8 @@ void compute_session(const Genesys_Device* dev, ScanSession& s, const Genesys_Se
         dev->model->asic_type == AsicType::GL845 ||
         dev->model->asic_type == AsicType::GL846)
     {
-        s.enable_ledadd = (s.params.channels == 1 && dev->model->is_cis && dev->settings.true_gray);
+        s.enable_ledadd = s.params.channels == 1 && dev->model->is_cis &&
+                          has_flag(s.params.flags, ScanFlag::ENABLE_LEDADD);
     }
 
     s.use_host_side_calib = sensor.use_host_side_calib;
@@ -1136,7 +1138,9 @@ void compute_session(const Genesys_Device* dev, ScanSession& s, const Genesys_Se
 }
 
 ImagePipelineStack build_image_pipeline(const Genesys_Device& dev, const ScanSession& session,
-                                        unsigned pipeline_index, bool log_image_data)
+                                        const std::vector<unsigned>& segment_order,
+                                        bool smooth_scaling, unsigned pipeline_index,
+                                        bool log_image_data, ScanStatistics* stats)
 {
     auto format = create_pixel_format(session.params.depth,
                                       dev.model->is_cis ? 1 : session.params.channels,
@@ -1144,15 +1148,18 @@ ImagePipelineStack build_image_pipeline(const Genesys_Device& dev, const ScanSes
     auto depth = get_pixel_format_depth(format);
     auto width = get_pixels_from_row_bytes(format, session.output_line_bytes_raw);
 
-    auto read_data_from_usb = [&dev](std::size_t size, std::uint8_t* data)
+    auto read_data_from_usb = [&dev, stats](std::size_t size, std::uint8_t* data)
     {
         DBG(DBG_info, "read_data_from_usb: reading %zu bytes\n", size);
-        auto begin = std::chrono::high_resolution_clock::now();
+        auto begin = std::chrono::steady_clock::now();
         dev.interface->bulk_read_data(0x45, data, size);
-        auto end = std::chrono::high_resolution_clock::now();
+        auto end = std::chrono::steady_clock::now();
         float us = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
         float speed = size / us; // bytes/us == MB/s
         DBG(DBG_info, "read_data_from_usb: reading %zu bytes finished %f MB/s\n", size, speed);
+        if (stats) {
+            stats->add_usb_read(size, begin, end);
+        }
         return true;
     };
 
@@ -1177,7 +1184,7 @@ ImagePipelineStack build_image_pipeline(const Genesys_Device& dev, const ScanSes
 
     if (session.segment_count > 1) {
         auto output_width = session.output_segment_pixel_group_count * session.segment_count;
-        pipeline.push_node<ImagePipelineNodeDesegment>(output_width, dev.segment_order,
+        pipeline.push_node<ImagePipelineNodeDesegment>(output_width, segment_order,
                                                             session.conseq_pixel_dist,
                                                             1, 1);
 
@@ -1274,8 +1281,20 @@ ImagePipelineStack build_image_pipeline(const Genesys_Device& dev, const ScanSes
         }
     }
 
-    if (pipeline.get_output_width() != session.params.get_requested_pixels()) {
-        pipeline.push_node<ImagePipelineNodeScaleRows>(session.params.get_requested_pixels());
+    // the data has been scanned at a different horizontal resolution than the requested one
+    auto requested_pixels = session.params.get_requested_pixels();
+    if (pipeline.get_output_width() != requested_pixels) {
+        auto output_depth = get_pixel_format_depth(pipeline.get_output_format());
+        if (smooth_scaling && (output_depth == 8 || output_depth == 16) &&
+            pipeline.get_output_height() > 0)
+        {
+            auto filter = requested_pixels < pipeline.get_output_width() ? ResampleFilter::BOX
+                                                                         : ResampleFilter::BILINEAR;
+            pipeline.push_node<ImagePipelineNodeResample>(requested_pixels,
+                                                          pipeline.get_output_height(), filter);
+        } else {
+            pipeline.push_node<ImagePipelineNodeScaleRows>(requested_pixels);
+        }
     }
 
     return pipeline;
@@ -1287,15 +1306,24 @@ void setup_image_pipeline(Genesys_Device& dev, const ScanSession& session)
 
     s_pipeline_index++;
 
-    dev.pipeline = build_image_pipeline(dev, session, s_pipeline_index, dbg_log_image_data());
+    // give the buffers of the previous scan back to the pool before building the new pipeline
+    dev.pipeline_buffer = ImageBuffer{};
+    dev.pipeline.clear();
+
+    BufferPool::Scope pool_scope{dev.buffer_pool};
+
+    dev.pipeline = build_image_pipeline(dev, session, dev.segment_order,
+                                        dev.settings.smooth_scaling, s_pipeline_index,
+                                        dbg_log_image_data(), &dev.scan_stats);
 
     auto read_from_pipeline = [&dev](std::size_t size, std::uint8_t* out_data)
     {
-        (void) size; // will be always equal to dev.pipeline.get_output_row_bytes()
-        return dev.pipeline.get_next_row_data(out_data);
+        // size is always a multiple of dev.pipeline.get_output_row_bytes()
+        return dev.pipeline.get_next_rows(size / dev.pipeline.get_output_row_bytes(), out_data);
     };
     dev.pipeline_buffer = ImageBuffer{dev.pipeline.get_output_row_bytes(),
                                        read_from_pipeline};
+    dev.pipeline_buffer.set_max_batch_size(ImagePipelineStack::MAX_BATCH_BYTES);
 }
 
 std::uint8_t compute_frontend_gain_wolfson(float value, float target_value)
@@ -1442,6 +1470,9 @@ void sanei_genesys_asic_init(Genesys_Device* dev)
         return;
     }
 
+    // the scanner memory contents are lost
+    dev->uploaded_shading_data.clear();
+
     // set up hardware and registers
     dev->cmd_set->asic_boot(dev, cold);
 
@@ -1664,6 +1695,7 @@ void sanei_genesys_wait_for_home(Genesys_Device* dev)
     if (status.is_at_home) {
 	  DBG (DBG_info,
 	       "%s: already at home\n", __func__);
+        dev->set_head_pos_zero(ScanHeadId::PRIMARY);
         return;
     }
 
@@ -1683,6 +1715,7 @@ void sanei_genesys_wait_for_home(Genesys_Device* dev)
              timeout_ms / 1000);
         throw SaneException(SANE_STATUS_IO_ERROR, "failed to reach park position");
     }
+    dev->set_head_pos_zero(ScanHeadId::PRIMARY);
 }
 
 const MotorProfile* get_motor_profile_ptr(const std::vector<MotorProfile>& profiles,
@@ -235,6 +235,10 @@ bool sanei_genesys_has_sensor(const Genesys_Device* dev, unsigned dpi, unsigned
                               ScanMethod scan_method);
 Genesys_Sensor& sanei_genesys_find_sensor_for_write(Genesys_Device* dev, unsigned dpi,
                                                     unsigned channels, ScanMethod scan_method);
+// finds the sensor in the shared sensor table, which holds no calibration results. Unlike the
+// lookups above, this may be used while the device is in use by the background preparation
+const Genesys_Sensor& sanei_genesys_find_default_sensor(const Genesys_Device* dev, unsigned dpi,
+                                                        unsigned channels, ScanMethod scan_method);
 
 std::vector<std::reference_wrapper<const Genesys_Sensor>>
     sanei_genesys_find_sensors_all(const Genesys_Device* dev, ScanMethod scan_method);
@@ -426,8 +430,13 @@ unsigned session_adjust_output_pixels(unsigned output_pixels,
 
 void compute_session(const Genesys_Device* dev, ScanSession& s, const Genesys_Sensor& sensor);
 
+// if `stats` is not nullptr, the USB reads of the pipeline are recorded there. The segment order
+// and smooth scaling are passed separately from the device so that the pipeline can be built
+// while the device is in use by the background preparation
 ImagePipelineStack build_image_pipeline(const Genesys_Device& dev, const ScanSession& session,
-                                        unsigned pipeline_index, bool log_image_data);
+                                        const std::vector<unsigned>& segment_order,
+                                        bool smooth_scaling, unsigned pipeline_index,
+                                        bool log_image_data, ScanStatistics* stats = nullptr);
 
 // sets up a image pipeline for device `dev`
 void setup_image_pipeline(Genesys_Device& dev, const ScanSession& session);
@@ -439,6 +448,20 @@ std::uint8_t compute_frontend_gain(float value, float target_value,
 /*                ASIC specific functions declarations                       */
 /*---------------------------------------------------------------------------*/
 
+// A contiguous range of s_sensors containing all entries of a single sensor
+struct SensorTableRange
+{
+    SensorTableRange() = default;
+    SensorTableRange(Genesys_Sensor* first, Genesys_Sensor* last) : first_{first}, last_{last} {}
+
+    Genesys_Sensor* begin() const { return first_; }
+    Genesys_Sensor* end() const { return last_; }
+
+private:
+    Genesys_Sensor* first_ = nullptr;
+    Genesys_Sensor* last_ = nullptr;
+};
+
 extern StaticInit<std::vector<Genesys_Sensor>> s_sensors;
 extern StaticInit<std::vector<Genesys_Frontend>> s_frontends;
 extern StaticInit<std::vector<Genesys_Gpo>> s_gpo;
@@ -447,6 +470,8 @@ extern StaticInit<std::vector<Genesys_Motor>> s_motors;
 extern StaticInit<std::vector<UsbDeviceEntry>> s_usb_devices;
 
 void genesys_init_sensor_tables();
+// returns the entries of s_sensors for the given sensor, none if the table has not been built yet
+SensorTableRange get_sensor_table_range(SensorId sensor_id);
 void genesys_init_frontend_tables();
 void genesys_init_gpo_tables();
 void genesys_init_memory_layout_tables();
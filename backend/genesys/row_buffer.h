@@ -42,6 +42,7 @@
 #ifndef BACKEND_GENESYS_LINE_BUFFER_H
 #define BACKEND_GENESYS_LINE_BUFFER_H
 
+#include "buffer_pool.h"
 #include "error.h"
 
 #include <algorithm>
@@ -204,7 +205,7 @@ private:
     std::size_t last_ = 0;
     std::size_t buffer_end_ = 0;
     bool is_linear_ = true;
-    std::vector<std::uint8_t> data_;
+    PooledBuffer data_;
 };
 
 } // namespace genesys
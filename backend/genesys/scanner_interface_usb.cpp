@@ -282,7 +282,9 @@ void ScannerInterfaceUsb::bulk_read_data(std::uint8_t addr, std::uint8_t* data,
 
     // loop until computed data size is read
     while (target_size > 0) {
-        std::size_t block_size = std::min(target_size, max_in_size);
+        // sanei_usb tunes the transfer size for the bus, the smaller sizes are multiples of 4 KiB
+        std::size_t block_size = std::min(target_size,
+                                          usb_dev_.get_bulk_size(USB_DIR_IN, 4096, max_in_size));
 
         if (has_header_before_each_chunk) {
             bulk_read_data_send_header(usb_dev_, dev_->model->asic_type, block_size);
@@ -88,6 +88,9 @@ struct Genesys_Settings
     // cache entries expiration time
     int expiration_time = 0;
 
+    // whether to filter the image when scaling it to the requested width
+    bool smooth_scaling = false;
+
     unsigned get_channels() const
     {
         if (scan_mode == ScanColorMode::COLOR_SINGLE_PASS)
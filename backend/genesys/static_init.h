@@ -72,6 +72,8 @@ public:
         ptr_.reset();
     }
 
+    bool is_init() const { return ptr_ != nullptr; }
+
     const T* operator->() const { return ptr_.get(); }
     T* operator->() { return ptr_.get(); }
     const T& operator*() const { return *ptr_.get(); }
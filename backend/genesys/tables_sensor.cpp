@@ -42,11 +42,15 @@
 #define DEBUG_DECLARE_ONLY
 
 #include "low.h"
+#include <algorithm>
 #include <map>
 
 namespace genesys {
 
 StaticInit<std::vector<Genesys_Sensor>> s_sensors;
+StaticInit<std::vector<SensorTableRange>> s_sensor_ranges;
+
+static void build_sensor_ranges();
 
 void genesys_init_sensor_tables()
 {
@@ -3818,6 +3822,47 @@ void genesys_init_sensor_tables()
             s_sensors->push_back(sensor);
         }
     }
+
+    build_sensor_ranges();
+}
+
+/*  Groups the sensor entries by sensor ID and records where the group of each ID starts and ends,
+    so that lookups don't need to go through the entries of all other sensors. The relative order
+    of the entries for a single sensor is preserved, as lookups return the first match.
+*/
+static void build_sensor_ranges()
+{
+    std::stable_sort(s_sensors->begin(), s_sensors->end(),
+                     [](const Genesys_Sensor& a, const Genesys_Sensor& b)
+    {
+        return static_cast<unsigned>(a.sensor_id) < static_cast<unsigned>(b.sensor_id);
+    });
+
+    unsigned max_id = 0;
+    for (const auto& sensor : *s_sensors) {
+        max_id = std::max(max_id, static_cast<unsigned>(sensor.sensor_id));
+    }
+
+    s_sensor_ranges.init(max_id + 1);
+    auto* data = s_sensors->data();
+    std::size_t i = 0;
+    while (i < s_sensors->size()) {
+        auto id = static_cast<unsigned>((*s_sensors)[i].sensor_id);
+        std::size_t begin = i;
+        while (i < s_sensors->size() && static_cast<unsigned>((*s_sensors)[i].sensor_id) == id) {
+            i++;
+        }
+        (*s_sensor_ranges)[id] = SensorTableRange{data + begin, data + i};
+    }
+}
+
+SensorTableRange get_sensor_table_range(SensorId sensor_id)
+{
+    auto id = static_cast<unsigned>(sensor_id);
+    if (!s_sensor_ranges.is_init() || id >= s_sensor_ranges->size()) {
+        return SensorTableRange{};
+    }
+    return (*s_sensor_ranges)[id];
 }
 
 void verify_sensor_tables()
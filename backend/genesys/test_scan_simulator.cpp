@@ -0,0 +1,239 @@
+/* sane - Scanner Access Now Easy.
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#define DEBUG_DECLARE_ONLY
+
+#include "test_scan_simulator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace genesys {
+
+TestScanSimulator::TestScanSimulator(const TestScanSimulatorSettings& settings) :
+    settings_{settings},
+    real_start_{std::chrono::steady_clock::now()}
+{}
+
+std::uint64_t TestScanSimulator::now_us()
+{
+    // the simulated clock never runs slower than real time scaled by time_scale, so that the time
+    // the host spends processing counts as well
+    if (settings_.time_scale > 0) {
+        auto real_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - real_start_).count();
+        auto scaled_us = static_cast<std::uint64_t>(real_us / settings_.time_scale);
+        now_us_ = std::max(now_us_, scaled_us);
+    }
+    return now_us_;
+}
+
+void TestScanSimulator::sleep_us(std::uint64_t microseconds)
+{
+    now_us_ = now_us() + microseconds;
+    if (settings_.time_scale > 0) {
+        auto real_us = static_cast<std::int64_t>(now_us_ * settings_.time_scale);
+        std::this_thread::sleep_until(real_start_ + std::chrono::microseconds(real_us));
+    }
+}
+
+void TestScanSimulator::set_lamp(bool on)
+{
+    if (on && !lamp_on_) {
+        lamp_on_us_ = now_us();
+    }
+    lamp_on_ = on;
+}
+
+double TestScanSimulator::lamp_brightness()
+{
+    if (!lamp_on_) {
+        return 0;
+    }
+    double t = static_cast<double>(now_us() - lamp_on_us_);
+    double tau = std::max(1u, settings_.lamp_time_constant_us);
+    return 1 - (1 - settings_.lamp_initial_brightness) * std::exp(-t / tau);
+}
+
+void TestScanSimulator::start_scan(const TestScanSimulatorFormat& format, bool move_head)
+{
+    format_ = format;
+    scanning_ = format.line_bytes > 0 && format.depth > 0 && format.channels > 0;
+    move_head_ = move_head;
+    head_stopped_ = false;
+    bytes_produced_ = 0;
+    bytes_read_ = 0;
+    pixels_ = 0;
+    if (scanning_) {
+        pixels_ = std::max(1u, format.line_bytes * 8 / (format.depth * format.channels));
+    }
+    motion_start_us_ = now_us();
+    last_update_us_ = motion_start_us_;
+}
+
+double TestScanSimulator::line_rate() const
+{
+    double rate = settings_.max_line_rate;
+    if (move_head_) {
+        rate = std::min(rate, settings_.motor_speed_ips * format_.yres);
+    }
+    return std::max(rate, 1.0);
+}
+
+void TestScanSimulator::update()
+{
+    auto now = now_us();
+    if (!scanning_ || head_stopped_) {
+        last_update_us_ = now;
+        return;
+    }
+
+    // number of lines produced since the head started moving. The head accelerates linearly
+    // during the acceleration time; a head that does not move does not need to accelerate.
+    double lines_per_us = line_rate() / 1e6;
+    double accel_us = move_head_ ? settings_.motor_acceleration_us : 0;
+    auto lines_since_start = [&](std::uint64_t t)
+    {
+        double s = static_cast<double>(t - motion_start_us_);
+        if (s < accel_us) {
+            return lines_per_us * s * s / (2 * accel_us);
+        }
+        return lines_per_us * (s - accel_us / 2);
+    };
+
+    bytes_produced_ += (lines_since_start(now) - lines_since_start(last_update_us_)) *
+            format_.line_bytes;
+    last_update_us_ = now;
+
+    double fifo_limit = static_cast<double>(bytes_read_ + settings_.fifo_size);
+    if (bytes_produced_ >= fifo_limit) {
+        bytes_produced_ = fifo_limit;
+        head_stopped_ = true;
+        head_stops_++;
+    }
+}
+
+void TestScanSimulator::read_data(std::uint8_t* data, std::size_t size)
+{
+    if (!scanning_) {
+        std::memset(data, 0, size);
+        return;
+    }
+
+    while (size > 0) {
+        update();
+        auto available = bytes_produced() - bytes_read_;
+        if (available > 0) {
+            auto count = static_cast<std::size_t>(std::min<std::uint64_t>(available, size));
+            fill(data, count);
+            data += count;
+            size -= count;
+            bytes_read_ += count;
+
+            if (head_stopped_) {
+                // there's room in the FIFO again, the head starts moving again
+                head_stopped_ = false;
+                motion_start_us_ = now_us();
+                last_update_us_ = motion_start_us_;
+            }
+            continue;
+        }
+
+        // wait until the data can have been produced at full speed
+        double bytes_per_us = line_rate() * format_.line_bytes / 1e6;
+        double wait_us = std::min<double>(size, format_.line_bytes) / bytes_per_us;
+        sleep_us(std::max<std::uint64_t>(100, static_cast<std::uint64_t>(wait_us)));
+    }
+}
+
+double TestScanSimulator::pixel_gain(unsigned pixel, unsigned channel) const
+{
+    // falloff of the light towards the ends of the sensor
+    double u = 2.0 * (pixel + 0.5) / pixels_ - 1.0;
+    double gain = 1.0 - settings_.vignetting * u * u;
+
+    // fixed gain deviation of each pixel, deterministic so that calibration can correct it
+    std::uint32_t h = pixel * 2654435761u ^ (channel + 1) * 40503u;
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    double deviation = (h & 0xffff) / 32767.5 - 1.0;
+    return gain * (1.0 + settings_.pixel_nonuniformity * deviation);
+}
+
+double TestScanSimulator::compute_sample(std::uint64_t line, unsigned pixel, unsigned channel,
+                                         double lamp) const
+{
+    double reflectance = 1.0;
+    if (move_head_ && line >= settings_.calibration_strip_lines) {
+        double x = static_cast<double>(pixel) / pixels_;
+        double phase = x + 0.25 * channel + static_cast<double>(line) / 1024;
+        reflectance = 0.1 + 0.8 * (phase - std::floor(phase));
+    }
+
+    double value = settings_.dark_level + (settings_.white_level - settings_.dark_level) *
+            lamp * pixel_gain(pixel, channel) * reflectance;
+    return std::min(std::max(value, 0.0), 1.0);
+}
+
+double TestScanSimulator::sample_value(std::uint64_t line, unsigned pixel, unsigned channel)
+{
+    return compute_sample(line, pixel, channel, lamp_brightness());
+}
+
+void TestScanSimulator::fill(std::uint8_t* data, std::size_t size)
+{
+    double lamp = lamp_brightness();
+    std::uint64_t offset = bytes_read_;
+    unsigned channels = format_.channels;
+
+    for (std::size_t i = 0; i < size; ++i, ++offset) {
+        auto line = offset / format_.line_bytes;
+        auto pos = static_cast<unsigned>(offset % format_.line_bytes);
+
+        switch (format_.depth) {
+            case 1: {
+                std::uint8_t byte = 0;
+                for (unsigned bit = 0; bit < 8; ++bit) {
+                    unsigned pixel = std::min(pos * 8 + bit, pixels_ - 1);
+                    if (compute_sample(line, pixel, 0, lamp) < 0.5) {
+                        byte |= 0x80 >> bit;
+                    }
+                }
+                data[i] = byte;
+                break;
+            }
+            case 16: {
+                unsigned sample = std::min(pos / 2, pixels_ * channels - 1);
+                auto value = static_cast<std::uint16_t>(
+                        compute_sample(line, sample / channels, sample % channels, lamp) * 65535);
+                data[i] = (pos % 2) ? value >> 8 : value & 0xff;
+                break;
+            }
+            default: {
+                unsigned sample = std::min(pos, pixels_ * channels - 1);
+                data[i] = static_cast<std::uint8_t>(
+                        compute_sample(line, sample / channels, sample % channels, lamp) * 255);
+                break;
+            }
+        }
+    }
+}
+
+} // namespace genesys
@@ -0,0 +1,150 @@
+/* sane - Scanner Access Now Easy.
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BACKEND_GENESYS_TEST_SCAN_SIMULATOR_H
+#define BACKEND_GENESYS_TEST_SCAN_SIMULATOR_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace genesys {
+
+struct TestScanSimulatorSettings
+{
+    // Ratio of real time to simulated time. 1 runs at the speed of the modeled scanner, 0 does
+    // not sleep at all and only advances the simulated clock, which makes runs deterministic.
+    double time_scale = 1.0;
+
+    // speed of the scan head in inches per second and the time it takes to reach it
+    double motor_speed_ips = 1.0;
+    unsigned motor_acceleration_us = 50000;
+
+    // the highest line rate of the sensor, limits the speed at high resolutions and when the
+    // head does not move
+    unsigned max_line_rate = 2000;
+
+    // size of the image FIFO of the scanner. The head stops while it's full.
+    std::size_t fifo_size = 1024 * 1024;
+
+    // the lamp brightness relative to a warm lamp right after it has been switched on and the
+    // time constant with which it approaches the final brightness
+    double lamp_initial_brightness = 0.7;
+    unsigned lamp_time_constant_us = 10000000;
+
+    // sensor response relative to full scale: the level of black, the level of white under a warm
+    // lamp in the middle of the sensor, the relative loss of brightness at the ends of the sensor
+    // and the maximum deviation of the gain of single pixels
+    double dark_level = 0.04;
+    double white_level = 0.85;
+    double vignetting = 0.15;
+    double pixel_nonuniformity = 0.03;
+
+    // the number of lines at the beginning of each scan that see the white calibration strip
+    unsigned calibration_strip_lines = 0;
+};
+
+// The layout of the data produced by the scanner
+struct TestScanSimulatorFormat
+{
+    unsigned channels = 1;
+    unsigned depth = 8;
+    unsigned line_bytes = 0;
+    unsigned yres = 0;
+};
+
+/*  A behavioral model of a scanner that produces image data at the rate a real scanner would.
+
+    The head accelerates to its speed after the scan is started and produces lines at a rate given
+    by the head speed and the resolution, or by the maximum line rate of the sensor. Produced data
+    goes into a FIFO of limited size; the head stops while the FIFO is full and accelerates again
+    once the host has read from it. Reads block until the requested data has been produced.
+
+    The data is synthesized as a sensor would see it: dark level plus the reflectance of the target
+    times the lamp brightness, the shading profile of the sensor and the per-pixel gain. The lamp
+    warms up as B(t) = 1 - (1 - B_initial) * exp(-t / T) after it is switched on. The target is
+    white for the first lines of each scan and while the head doesn't move, and a pattern of
+    gradients otherwise. Samples are assumed to be pixel-interleaved; 16-bit samples are little
+    endian.
+*/
+class TestScanSimulator
+{
+public:
+    explicit TestScanSimulator(const TestScanSimulatorSettings& settings);
+
+    const TestScanSimulatorSettings& settings() const { return settings_; }
+
+    void set_lamp(bool on);
+    void start_scan(const TestScanSimulatorFormat& format, bool move_head);
+
+    // blocks until size bytes have been produced and copies them to data
+    void read_data(std::uint8_t* data, std::size_t size);
+
+    // advances the simulated time by the given number of microseconds
+    void sleep_us(std::uint64_t microseconds);
+
+    // the simulated time in microseconds since the simulator was created
+    std::uint64_t now_us();
+
+    // the relative brightness of the lamp at the current time
+    double lamp_brightness();
+
+    // the number of bytes produced and read since the scan was started
+    std::uint64_t bytes_produced() const
+    {
+        return static_cast<std::uint64_t>(bytes_produced_);
+    }
+    std::uint64_t bytes_read() const { return bytes_read_; }
+
+    // how many times the head had to stop because the FIFO was full
+    unsigned head_stops() const { return head_stops_; }
+
+    // the sample value in range [0, 1] at the given position of the scan
+    double sample_value(std::uint64_t line, unsigned pixel, unsigned channel);
+
+private:
+    // produces the data for the time elapsed since the last call
+    void update();
+    double line_rate() const;
+    double pixel_gain(unsigned pixel, unsigned channel) const;
+    double compute_sample(std::uint64_t line, unsigned pixel, unsigned channel, double lamp) const;
+    void fill(std::uint8_t* data, std::size_t size);
+
+    TestScanSimulatorSettings settings_;
+    TestScanSimulatorFormat format_;
+
+    std::chrono::steady_clock::time_point real_start_;
+    std::uint64_t now_us_ = 0;
+    std::uint64_t last_update_us_ = 0;
+
+    bool lamp_on_ = true;
+    std::uint64_t lamp_on_us_ = 0;
+
+    bool scanning_ = false;
+    bool move_head_ = false;
+    bool head_stopped_ = false;
+    std::uint64_t motion_start_us_ = 0;
+    double bytes_produced_ = 0;
+    std::uint64_t bytes_read_ = 0;
+    unsigned head_stops_ = 0;
+    unsigned pixels_ = 0;
+};
+
+} // namespace genesys
+
+#endif // BACKEND_GENESYS_TEST_SCAN_SIMULATOR_H
@@ -52,6 +52,10 @@ TestScannerInterface::TestScannerInterface(Genesys_Device* dev, uint16_t vendor_
     dev_{dev},
     usb_dev_{vendor_id, product_id, bcd_device}
 {
+    if (const auto* settings = get_testing_simulation_settings()) {
+        simulator_.reset(new TestScanSimulator(*settings));
+    }
+
     // initialize status registers
     if (dev_->model->asic_type == AsicType::GL124) {
         write_register(0x101, 0x00);
@@ -111,11 +115,48 @@ std::uint8_t TestScannerInterface::read_register(std::uint16_t address)
 void TestScannerInterface::write_register(std::uint16_t address, std::uint8_t value)
 {
     cached_regs_.update(address, value);
+    // GL646 starts scans only through write_registers() in begin_scan(), a single write of 0x0f
+    // comes from gl646_stop_motor()
+    if (address == 0x0f && dev_->model->asic_type == AsicType::GL646) {
+        return;
+    }
+    simulate_register_write(address, value);
 }
 
 void TestScannerInterface::write_registers(const Genesys_Register_Set& regs)
 {
     cached_regs_.update(regs);
+    if (simulator_) {
+        // the lamp must be switched on before the scan that uses it is started
+        for (std::uint16_t address : { 0x03, 0x0f }) {
+            if (regs.has_reg(address)) {
+                simulate_register_write(address, regs.get8(address));
+            }
+        }
+    }
+}
+
+void TestScannerInterface::simulate_register_write(std::uint16_t address, std::uint8_t value)
+{
+    if (!simulator_) {
+        return;
+    }
+
+    // REG_0x03_LAMPPWR is at the same location on all ASICs. So is the scan start register
+    // written by scanner_start_action() and by the GL646 begin_scan(), though GL646 also writes
+    // it to stop the motor.
+    if (address == 0x03) {
+        simulator_->set_lamp((value & 0x10) != 0);
+    }
+    if (address == 0x0f) {
+        const auto& session = dev_->session;
+        TestScanSimulatorFormat format;
+        format.channels = session.params.channels;
+        format.depth = session.params.depth;
+        format.line_bytes = session.output_line_bytes_raw;
+        format.yres = session.params.yres;
+        simulator_->start_scan(format, value != 0);
+    }
 }
 
 
@@ -128,6 +169,10 @@ void TestScannerInterface::write_0x8c(std::uint8_t index, std::uint8_t value)
 void TestScannerInterface::bulk_read_data(std::uint8_t addr, std::uint8_t* data, std::size_t size)
 {
     (void) addr;
+    if (simulator_) {
+        simulator_->read_data(data, size);
+        return;
+    }
     std::memset(data, 0, size);
 }
 
@@ -180,7 +225,9 @@ IUsbDevice& TestScannerInterface::get_usb_device()
 
 void TestScannerInterface::sleep_us(unsigned microseconds)
 {
-    (void) microseconds;
+    if (simulator_) {
+        simulator_->sleep_us(microseconds);
+    }
 }
 
 void TestScannerInterface::record_slope_table(unsigned table_nr,
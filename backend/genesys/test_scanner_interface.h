@@ -46,8 +46,10 @@
 #include "register_cache.h"
 #include "test_usb_device.h"
 #include "test_settings.h"
+#include "test_scan_simulator.h"
 
 #include <map>
+#include <memory>
 
 namespace genesys {
 
@@ -101,7 +103,12 @@ public:
 
     void set_checkpoint_callback(TestCheckpointCallback callback);
 
+    // the simulator producing the image data, nullptr if simulation is not enabled
+    TestScanSimulator* simulator() { return simulator_.get(); }
+
 private:
+    void simulate_register_write(std::uint16_t address, std::uint8_t value);
+
     Genesys_Device* dev_;
 
     RegisterCache<std::uint8_t> cached_regs_;
@@ -114,6 +121,8 @@ private:
 
     std::string last_progress_message_;
     std::map<std::string, std::string> key_values_;
+
+    std::unique_ptr<TestScanSimulator> simulator_;
 };
 
 } // namespace genesys
@@ -52,6 +52,8 @@ std::uint16_t s_vendor_id = 0;
 std::uint16_t s_product_id = 0;
 std::uint16_t s_bcd_device = 0;
 TestCheckpointCallback s_checkpoint_callback;
+bool s_simulation_enabled = false;
+TestScanSimulatorSettings s_simulation_settings;
 
 } // namespace
 
@@ -109,4 +111,23 @@ TestCheckpointCallback get_testing_checkpoint_callback()
     return s_checkpoint_callback;
 }
 
+void enable_testing_simulation(const TestScanSimulatorSettings& settings)
+{
+    s_simulation_enabled = true;
+    s_simulation_settings = settings;
+}
+
+void disable_testing_simulation()
+{
+    s_simulation_enabled = false;
+}
+
+const TestScanSimulatorSettings* get_testing_simulation_settings()
+{
+    if (!s_simulation_enabled) {
+        return nullptr;
+    }
+    return &s_simulation_settings;
+}
+
 } // namespace genesys
@@ -45,6 +45,7 @@
 #include "scanner_interface.h"
 #include "register_cache.h"
 #include "test_usb_device.h"
+#include "test_scan_simulator.h"
 #include <functional>
 
 namespace genesys {
@@ -64,6 +65,11 @@ std::uint16_t get_testing_bcd_device();
 std::string get_testing_device_name();
 TestCheckpointCallback get_testing_checkpoint_callback();
 
+// when enabled, the test scanner interface produces image data through a TestScanSimulator
+void enable_testing_simulation(const TestScanSimulatorSettings& settings);
+void disable_testing_simulation();
+const TestScanSimulatorSettings* get_testing_simulation_settings();
+
 
 } // namespace genesys
 
@@ -144,6 +144,14 @@ void TestUsbDevice::bulk_write(const std::uint8_t* buffer, std::size_t* size)
     assert_is_open();
 }
 
+std::size_t TestUsbDevice::get_bulk_size(int ep_dir, std::size_t min_size, std::size_t max_size)
+{
+    (void) ep_dir;
+    (void) min_size;
+    assert_is_open();
+    return max_size;
+}
+
 void TestUsbDevice::assert_is_open() const
 {
     if (!is_open()) {
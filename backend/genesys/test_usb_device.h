@@ -69,6 +69,8 @@ public:
                      std::uint8_t* data) override;
     void bulk_read(std::uint8_t* buffer, std::size_t* size) override;
     void bulk_write(const std::uint8_t* buffer, std::size_t* size) override;
+
+    std::size_t get_bulk_size(int ep_dir, std::size_t min_size, std::size_t max_size) override;
 private:
     void assert_is_open() const;
 
@@ -150,6 +150,12 @@ void UsbDevice::bulk_write(const std::uint8_t* buffer, std::size_t* size)
     TIE(sanei_usb_write_bulk(device_num_, buffer, size));
 }
 
+std::size_t UsbDevice::get_bulk_size(int ep_dir, std::size_t min_size, std::size_t max_size)
+{
+    assert_is_open();
+    return sanei_usb_get_bulk_size(device_num_, ep_dir, min_size, max_size);
+}
+
 void UsbDevice::assert_is_open() const
 {
     if (!is_open()) {
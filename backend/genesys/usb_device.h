@@ -78,6 +78,9 @@ public:
     virtual void bulk_read(std::uint8_t* buffer, std::size_t* size) = 0;
     virtual void bulk_write(const std::uint8_t* buffer, std::size_t* size) = 0;
 
+    // returns the size of the next bulk transfer as tuned by sanei_usb_get_bulk_size()
+    virtual std::size_t get_bulk_size(int ep_dir, std::size_t min_size,
+                                      std::size_t max_size) = 0;
 };
 
 class UsbDevice : public IUsbDevice {
@@ -105,6 +108,8 @@ public:
     void bulk_read(std::uint8_t* buffer, std::size_t* size) override;
     void bulk_write(const std::uint8_t* buffer, std::size_t* size) override;
 
+    std::size_t get_bulk_size(int ep_dir, std::size_t min_size, std::size_t max_size) override;
+
 private:
 
     void assert_is_open() const;
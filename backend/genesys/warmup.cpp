@@ -0,0 +1,278 @@
+/* sane - Scanner Access Now Easy.
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#define DEBUG_DECLARE_ONLY
+
+#include "warmup.h"
+#include "error.h"
+#include "utilities.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace genesys {
+
+namespace {
+    // the maximum number of brightness derivatives used to fit the time constant
+    constexpr std::size_t MAX_FIT_POINTS = 6;
+
+    // the range of plausible time constants. Fits outside it are caused by noise
+    constexpr float MIN_TIME_CONSTANT_MS = 100;
+    constexpr float MAX_TIME_CONSTANT_MS = 120000;
+
+    // the lamp is not considered warmed up before this many samples spanning at least this
+    // time have been taken. The threshold is a change per second, so it is measured over a second
+    constexpr std::size_t MIN_STABLE_SAMPLES = 4;
+    constexpr unsigned MIN_STABLE_TIME_MS = 1000;
+} // namespace
+
+LampWarmupTracker::LampWarmupTracker(const LampWarmupModel& model, float threshold) :
+    model_{model},
+    threshold_{threshold}
+{}
+
+void LampWarmupTracker::add_sample(unsigned time_ms, const std::vector<float>& channel_averages)
+{
+    if (!samples_.empty()) {
+        if (channel_averages.size() != samples_.front().averages.size()) {
+            throw SaneException("Inconsistent number of channels in lamp warm-up samples");
+        }
+        if (time_ms <= samples_.back().time_ms) {
+            throw SaneException("Lamp warm-up samples must be in increasing time order");
+        }
+    }
+    Sample sample;
+    sample.time_ms = time_ms;
+    sample.averages = channel_averages;
+    samples_.push_back(std::move(sample));
+}
+
+LampWarmupTracker::ChannelEstimate LampWarmupTracker::estimate_channel(unsigned channel) const
+{
+    ChannelEstimate estimate;
+    estimate.rate = std::numeric_limits<float>::infinity();
+
+    if (samples_.size() < 2) {
+        return estimate;
+    }
+
+    float last = samples_.back().averages[channel];
+    if (last <= 0) {
+        return estimate;
+    }
+    float last_time = static_cast<float>(samples_.back().time_ms);
+
+    // brightness derivatives at the midpoints between consecutive samples
+    std::size_t count = std::min(samples_.size() - 1, MAX_FIT_POINTS);
+    std::size_t first_sample = samples_.size() - 1 - count;
+    std::vector<float> times;
+    std::vector<float> derivatives;
+    for (std::size_t i = first_sample; i < samples_.size() - 1; ++i) {
+        const auto& curr = samples_[i];
+        const auto& next = samples_[i + 1];
+        float dt = static_cast<float>(next.time_ms - curr.time_ms);
+        times.push_back(curr.time_ms + dt / 2);
+        derivatives.push_back((next.averages[channel] - curr.averages[channel]) / dt);
+    }
+
+    // the exponential model applies only to the trailing monotonic part of the curve
+    float last_derivative = derivatives.back();
+    std::size_t run = 0;
+    while (last_derivative != 0 && run < derivatives.size()) {
+        float d = derivatives[derivatives.size() - 1 - run];
+        if (d == 0 || (d > 0) != (last_derivative > 0)) {
+            break;
+        }
+        run++;
+    }
+
+    if (run >= 2) {
+        // least squares fit of ln|dB/dt| = c - t / T
+        std::size_t first = derivatives.size() - run;
+        float mean_t = 0;
+        float mean_log = 0;
+        for (std::size_t i = first; i < derivatives.size(); ++i) {
+            mean_t += times[i];
+            mean_log += std::log(std::fabs(derivatives[i]));
+        }
+        mean_t /= run;
+        mean_log /= run;
+
+        float cov = 0;
+        float var = 0;
+        for (std::size_t i = first; i < derivatives.size(); ++i) {
+            float dt = times[i] - mean_t;
+            cov += dt * (std::log(std::fabs(derivatives[i])) - mean_log);
+            var += dt * dt;
+        }
+
+        if (var > 0 && cov < 0) {
+            float fitted = -var / cov;
+            if (fitted >= MIN_TIME_CONSTANT_MS && fitted <= MAX_TIME_CONSTANT_MS) {
+                // the fitted derivative at the time of the last sample
+                estimate.is_fitted = true;
+                estimate.time_constant_ms = fitted;
+                estimate.rate = std::exp(mean_log - (last_time - mean_t) / fitted) * 1000 / last;
+                return estimate;
+            }
+        }
+    }
+
+    // otherwise the slope of a straight line fitted to the brightness of the same samples, which
+    // unlike the difference of the last two samples is not thrown off by noise
+    float mean_t = 0;
+    float mean_b = 0;
+    for (std::size_t i = first_sample; i < samples_.size(); ++i) {
+        mean_t += samples_[i].time_ms;
+        mean_b += samples_[i].averages[channel];
+    }
+    mean_t /= count + 1;
+    mean_b /= count + 1;
+
+    float cov = 0;
+    float var = 0;
+    for (std::size_t i = first_sample; i < samples_.size(); ++i) {
+        float dt = samples_[i].time_ms - mean_t;
+        cov += dt * (samples_[i].averages[channel] - mean_b);
+        var += dt * dt;
+    }
+    estimate.rate = std::fabs(cov / var) * 1000 / last;
+
+    if (channel < model_.time_constants_ms.size() && model_.time_constants_ms[channel] > 0) {
+        // the slope is that at the mean time of the samples, extrapolate to the last sample
+        estimate.time_constant_ms = static_cast<float>(model_.time_constants_ms[channel]);
+        estimate.rate *= std::exp(-(last_time - mean_t) / estimate.time_constant_ms);
+    }
+    return estimate;
+}
+
+bool LampWarmupTracker::is_stable() const
+{
+    // a rate below the threshold from a few closely spaced samples may be just noise
+    if (samples_.size() < MIN_STABLE_SAMPLES ||
+        samples_.back().time_ms - samples_.front().time_ms < MIN_STABLE_TIME_MS)
+    {
+        return false;
+    }
+    for (unsigned ch = 0; ch < samples_.front().averages.size(); ++ch) {
+        if (!(estimate_channel(ch).rate < threshold_)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+unsigned LampWarmupTracker::next_sample_delay_ms(unsigned min_ms, unsigned max_ms) const
+{
+    if (samples_.size() < 2) {
+        return min_ms;
+    }
+
+    float delay = 0;
+    for (unsigned ch = 0; ch < samples_.front().averages.size(); ++ch) {
+        auto estimate = estimate_channel(ch);
+        if (estimate.rate < threshold_) {
+            continue;
+        }
+        if (estimate.time_constant_ms <= 0 || std::isinf(estimate.rate)) {
+            delay = static_cast<float>(max_ms);
+            continue;
+        }
+        // the rate of change decays with the same time constant as the brightness difference
+        delay = std::max(delay, estimate.time_constant_ms *
+                                    std::log(estimate.rate / threshold_));
+    }
+    return static_cast<unsigned>(clamp<float>(delay, static_cast<float>(min_ms),
+                                              static_cast<float>(max_ms)));
+}
+
+LampWarmupModel LampWarmupTracker::updated_model() const
+{
+    LampWarmupModel model = model_;
+    if (samples_.empty()) {
+        return model;
+    }
+
+    unsigned channels = samples_.front().averages.size();
+    for (unsigned ch = 0; ch < channels; ++ch) {
+        auto estimate = estimate_channel(ch);
+        if (!estimate.is_fitted) {
+            continue;
+        }
+        if (model.time_constants_ms.size() < channels) {
+            model.time_constants_ms.resize(channels, 0);
+        }
+        float fitted = estimate.time_constant_ms;
+        float previous = static_cast<float>(model.time_constants_ms[ch]);
+        if (previous > 0) {
+            // smooth the estimates across warm-ups as each individual fit is noisy
+            fitted = (fitted + previous) / 2;
+        }
+        model.time_constants_ms[ch] = static_cast<unsigned>(std::round(fitted));
+    }
+    return model;
+}
+
+std::vector<float> compute_channel_averages(const std::uint8_t* data, std::size_t size,
+                                            unsigned depth, unsigned channels, unsigned lines,
+                                            bool is_line_interleaved)
+{
+    if (depth != 8 && depth != 16) {
+        throw SaneException("Unsupported depth %u", depth);
+    }
+    if (channels == 0 || lines == 0) {
+        throw SaneException("Invalid channel count %u or line count %u", channels, lines);
+    }
+
+    std::size_t bytes_per_sample = depth / 8;
+    std::size_t samples_per_channel = size / (bytes_per_sample * channels * lines) * lines;
+
+    auto get_sample = [data, depth](std::size_t index) -> unsigned
+    {
+        if (depth == 16) {
+            return data[index * 2] | (data[index * 2 + 1] << 8);
+        }
+        return data[index];
+    };
+
+    std::vector<std::uint64_t> sums(channels, 0);
+    if (is_line_interleaved) {
+        // each line holds a single channel, the channels follow each other
+        std::size_t line_samples = samples_per_channel / lines;
+        for (std::size_t row = 0; row < lines * channels; ++row) {
+            auto& sum = sums[row % channels];
+            for (std::size_t i = row * line_samples; i < (row + 1) * line_samples; ++i) {
+                sum += get_sample(i);
+            }
+        }
+    } else {
+        for (std::size_t i = 0; i < samples_per_channel * channels; ++i) {
+            sums[i % channels] += get_sample(i);
+        }
+    }
+
+    std::vector<float> averages(channels, 0);
+    if (samples_per_channel > 0) {
+        for (unsigned ch = 0; ch < channels; ++ch) {
+            averages[ch] = static_cast<float>(sums[ch]) / samples_per_channel;
+        }
+    }
+    return averages;
+}
+
+} // namespace genesys
@@ -0,0 +1,117 @@
+/* sane - Scanner Access Now Easy.
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef BACKEND_GENESYS_WARMUP_H
+#define BACKEND_GENESYS_WARMUP_H
+
+#include "serialize.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace genesys {
+
+/*  Describes how the brightness of the lamp of a particular device approaches its final value
+    after the lamp is switched on. The brightness of each channel is modeled as
+
+        B(t) = B_final - A * exp(-t / T)
+
+    where T is the time constant of the channel. The model is learned during lamp warm-ups and is
+    stored in the calibration file.
+*/
+struct LampWarmupModel
+{
+    // time constants of each channel in milliseconds. Empty if nothing has been learned yet
+    std::vector<unsigned> time_constants_ms;
+
+    bool empty() const { return time_constants_ms.empty(); }
+
+    bool operator==(const LampWarmupModel& other) const
+    {
+        return time_constants_ms == other.time_constants_ms;
+    }
+};
+
+template<class Stream>
+void serialize(Stream& str, LampWarmupModel& x)
+{
+    serialize(str, x.time_constants_ms);
+}
+
+/*  Decides when the lamp can be considered warmed up, given the average brightness of each channel
+    sampled over time. The lamp is warmed up once the relative brightness change per second of
+    each channel, as given by a fit over the recent samples, falls below the threshold and enough
+    samples have been taken over a long enough time for that fit to be trusted. The time constant of each channel is fitted to the
+    derivative of the brightness curve, which allows predicting when that happens and sampling
+    exactly then instead of at fixed intervals. While there are too few samples for a fit, the
+    time constants from the supplied model are used instead.
+*/
+class LampWarmupTracker
+{
+public:
+    // threshold is the maximum relative brightness change per second of a warmed up lamp
+    LampWarmupTracker(const LampWarmupModel& model, float threshold);
+
+    void add_sample(unsigned time_ms, const std::vector<float>& channel_averages);
+
+    std::size_t sample_count() const { return samples_.size(); }
+
+    bool is_stable() const;
+
+    // returns the time to wait until the next sample, clamped to the given range
+    unsigned next_sample_delay_ms(unsigned min_ms, unsigned max_ms) const;
+
+    // returns the model updated with the time constants observed during this warm-up
+    LampWarmupModel updated_model() const;
+
+private:
+    struct Sample
+    {
+        unsigned time_ms = 0;
+        std::vector<float> averages;
+    };
+
+    struct ChannelEstimate
+    {
+        // whether the time constant has been fitted from the samples
+        bool is_fitted = false;
+        // zero if unknown
+        float time_constant_ms = 0;
+        // the estimated relative brightness change per second at the time of the last sample
+        float rate = 0;
+    };
+
+    ChannelEstimate estimate_channel(unsigned channel) const;
+
+    LampWarmupModel model_;
+    float threshold_ = 0;
+    std::vector<Sample> samples_;
+};
+
+/*  Computes the average value of each channel of the given lines of raw scanner data. The
+    channels of each pixel are adjacent, unless is_line_interleaved is set, in which case each
+    line holds a single channel and the lines of the channels follow each other, as sent by CIS
+    sensors.
+*/
+std::vector<float> compute_channel_averages(const std::uint8_t* data, std::size_t size,
+                                            unsigned depth, unsigned channels, unsigned lines,
+                                            bool is_line_interleaved);
+
+} // namespace genesys
+
+#endif // BACKEND_GENESYS_WARMUP_H
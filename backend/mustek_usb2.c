@@ -154,9 +154,9 @@ static SANE_Bool PowerControl (SANE_Bool isLampOn, SANE_Bool isTaLampOn);
 static SANE_Bool CarriageHome (void);
 static SANE_Bool SetParameters (LPSETPARAMETERS pSetParameters);
 static SANE_Bool GetParameters (LPGETPARAMETERS pGetParameters);
-static SANE_Bool StartScan (void);
-static SANE_Bool ReadScannedData (LPIMAGEROWS pImageRows);
-static SANE_Bool StopScan (void);
+static SANE_Bool StartScan (ImageRing * ring);
+static SANE_Bool ReadScannedData (ImageRing * ring, LPIMAGEROWS pImageRows);
+static SANE_Bool StopScan (ImageRing * ring);
 static SANE_Bool IsTAConnected (void);
 static void AutoLevel (SANE_Byte *lpSource, SCANMODE scanMode, unsigned short ScanLines,
 		unsigned int BytesPerLine);
@@ -906,7 +906,7 @@ Author: Jack            Date: 2005/05/13
 Routine Description:
 	start scan image
 Parameters:
-	none
+	ring: the image ring
 Return value:
 	if operation is success
 	return TRUE
@@ -914,14 +914,14 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-StartScan ()
+StartScan (ImageRing * ring)
 {
   DBG (DBG_FUNC, "StartScan: start\n");
   if (ST_Reflective == g_ScanType)
     {
       DBG (DBG_INFO, "StartScan: g_ScanType==ST_Reflective\n");
 
-      return Reflective_SetupScan (g_ssSuggest.cmScanMode,
+      return Reflective_SetupScan (ring, g_ssSuggest.cmScanMode,
 				   g_ssSuggest.wXDpi,
 				   g_ssSuggest.wYDpi,
 				   PF_BlackIs0,
@@ -935,7 +935,7 @@ StartScan ()
 
       DBG (DBG_INFO, "StartScan: g_ScanType==ST_Transparent\n");
 
-      return Transparent_SetupScan (g_ssSuggest.cmScanMode,
+      return Transparent_SetupScan (ring, g_ssSuggest.cmScanMode,
 				    g_ssSuggest.wXDpi,
 				    g_ssSuggest.wYDpi,
 				    PF_BlackIs0,
@@ -950,7 +950,7 @@ Author: Jack             Date: 2005/05/14
 Routine Description:
 	Read the scanner data
 Parameters:
-
+	ring: the image ring
 	pImageRows: the information of the data
 Return value:
 	if the operation is seccuss
@@ -959,7 +959,7 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-ReadScannedData (LPIMAGEROWS pImageRows)
+ReadScannedData (ImageRing * ring, LPIMAGEROWS pImageRows)
 {
   SANE_Bool isRGBInvert;
   unsigned short Rows = 0;
@@ -980,12 +980,12 @@ ReadScannedData (LPIMAGEROWS pImageRows)
 
   if (ST_Reflective == g_ScanType)
     {
-      if (FALSE == Reflective_GetRows (lpBlock, &Rows, isRGBInvert))
+      if (FALSE == Reflective_GetRows (ring, lpBlock, &Rows, isRGBInvert))
 	return FALSE;
     }
   else if (SS_Positive == g_ssScanSource)
     {
-      if (FALSE == Transparent_GetRows (lpBlock, &Rows, isRGBInvert))
+      if (FALSE == Transparent_GetRows (ring, lpBlock, &Rows, isRGBInvert))
 	return FALSE;
     }
 
@@ -1015,7 +1015,7 @@ ReadScannedData (LPIMAGEROWS pImageRows)
 		   "ReadScannedData: malloc the negative data is success!\n");
 	      g_bIsMallocNegData = TRUE;
 	      if (!Transparent_GetRows
-		  (g_lpNegImageData, &g_SWHeight, isRGBInvert))
+		  (ring, g_lpNegImageData, &g_SWHeight, isRGBInvert))
 		{
 		  return FALSE;
 		}
@@ -1059,7 +1059,7 @@ ReadScannedData (LPIMAGEROWS pImageRows)
 	  int TotalSize = Rows * g_ssSuggest.dwBytesPerRow;
 	  DBG (DBG_INFO,
 	       "ReadScannedData: malloc the negative data is fail!\n");
-	  if (!Transparent_GetRows (lpReturnData, &Rows, isRGBInvert))
+	  if (!Transparent_GetRows (ring, lpReturnData, &Rows, isRGBInvert))
 	    {
 	      return FALSE;
 	    }
@@ -1091,7 +1091,7 @@ Author: Jack             Date: 2005/05/14
 Routine Description:
 	Stop scan
 Parameters:
-	none
+	ring: the image ring
 Return value:
 	if operation is success
 	return TRUE
@@ -1099,7 +1099,7 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-StopScan ()
+StopScan (ImageRing * ring)
 {
   SANE_Bool rt;
   int i;
@@ -1109,11 +1109,11 @@ StopScan ()
   /*stop read data and kill thread */
   if (ST_Reflective == g_ScanType)
     {
-      rt = Reflective_StopScan ();
+      rt = Reflective_StopScan (ring);
     }
   else
     {
-      rt = Transparent_StopScan ();
+      rt = Transparent_StopScan (ring);
     }
 
   /*free gamma table */
@@ -1135,11 +1135,11 @@ StopScan ()
     }
 
   /*free image buffer */
-  if (g_lpReadImageHead != NULL)
+  if (ring->lpImage != NULL)
 
     {
-      free (g_lpReadImageHead);
-      g_lpReadImageHead = NULL;
+      free (ring->lpImage);
+      ring->lpImage = NULL;
     }
 
   DBG (DBG_FUNC, "StopScan: exit\n");
@@ -2098,6 +2098,7 @@ sane_open (SANE_String_Const devicename, SANE_Handle * handle)
   if (s == NULL)
     return SANE_STATUS_NO_MEM;
   memset (s, 0, sizeof (*s));
+  MustScanner_InitImageRing (&s->ring);
 
   s->gamma_table = NULL;
   memcpy (&s->model, &mustek_A2nu2_model, sizeof (Scanner_Model));
@@ -2122,6 +2123,8 @@ sane_close (SANE_Handle handle)
   Mustek_Scanner *s = handle;
   DBG (DBG_FUNC, "sane_close: start\n");
 
+  MustScanner_FreeImageRing (&s->ring);
+
   PowerControl (SANE_FALSE, SANE_FALSE);
 
   CarriageHome ();
@@ -2464,7 +2467,7 @@ sane_start (SANE_Handle handle)
   if (s->Scan_data_buf == NULL)
     return SANE_STATUS_NO_MEM;
 
-  StartScan ();
+  StartScan (&s->ring);
 
   DBG (DBG_FUNC, "sane_start: exit\n");
 
@@ -2535,11 +2538,12 @@ sane_read (SANE_Handle handle, SANE_Byte * buf, SANE_Int max_len,
 	  image_row.pBuffer = (SANE_Byte *) tempbuf;
 	  s->bIsReading = SANE_TRUE;
 
-	  if (!ReadScannedData (&image_row))
+	  if (!ReadScannedData (&s->ring, &image_row))
 	    {
 	      DBG (DBG_ERR, "sane_read: ReadScannedData error\n");
 	      s->bIsReading = SANE_FALSE;
-	      return SANE_STATUS_INVAL;
+	      free (tempbuf);
+	      return SANE_STATUS_IO_ERROR;
 	    }
 
 	  DBG (DBG_DBG, "sane_read: Finish ReadScanedData\n");
@@ -2612,7 +2616,7 @@ sane_cancel (SANE_Handle handle)
 	  DBG (DBG_INFO, "sane_cancel: Scan finished\n");
 	}
 
-      StopScan ();
+      StopScan (&s->ring);
 
       CarriageHome ();
       for (i = 0; i < 20; i++)
@@ -150,6 +150,7 @@ typedef struct Mustek_Scanner
   SANE_Byte *Scan_data_buf;	/*store Scanned data for transfer */
   SANE_Byte *Scan_data_buf_start;	/*point to data need to transfer */
   size_t scan_buffer_len;	/* length of data buf */
+  ImageRing ring;		/* image ring filled by the reader thread */
 }
 Mustek_Scanner;
 
@@ -65,7 +65,6 @@ static SANE_Bool g_isScanning;
 static SANE_Bool g_isSelfGamma;
 
 static SANE_Byte g_bScanBits;
-static SANE_Byte *g_lpReadImageHead;
 
 static unsigned short s_wOpticalYDpi[] = { 1200, 600, 300, 150, 75, 0 };
 static unsigned short s_wOpticalXDpi[] = { 1200, 600, 300, 150, 75, 0 };
@@ -79,17 +78,12 @@ static unsigned short g_SWWidth;
 static unsigned short g_SWHeight;
 static unsigned short g_wPixelDistance;		/*even & odd sensor problem */
 static unsigned short g_wLineDistance;
-static unsigned short g_wScanLinesPerBlock;
 static unsigned short g_wReadedLines;
 static unsigned short g_wReadImageLines;
 static unsigned short g_wReadyShadingLine;
 static unsigned short g_wStartShadingLinePos;
 static unsigned short g_wLineartThreshold;
 
-static unsigned int g_wtheReadyLines;
-static unsigned int g_wMaxScanLines;
-static unsigned int g_dwScannedTotalLines;
-static unsigned int g_dwImageBufferSize;
 static unsigned int g_BytesPerRow;
 static unsigned int g_SWBytesPerRow;
 static unsigned int g_dwCalibrationSize;
@@ -100,8 +94,6 @@ static unsigned int g_dwTotalTotalXferLines;
 static unsigned short *g_pGammaTable;
 static unsigned char *g_pDeviceFile;
 
-static pthread_t g_threadid_readimage;
-
 /*user define type*/
 static COLORMODE g_ScanMode;
 static TARGETIMAGE g_tiTarget;
@@ -119,9 +111,6 @@ static unsigned short g_wDarkCalWidth;
 static int g_nPowerNum;
 static unsigned short g_wStartPosition;
 
-static pthread_mutex_t g_scannedLinesMutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t g_readyLinesMutex = PTHREAD_MUTEX_INITIALIZER;
-
 /*for modify the last point*/
 static SANE_Byte * g_lpBefLineImageData = NULL;
 static SANE_Bool g_bIsFirstReadBefData = TRUE;
@@ -148,36 +137,42 @@ static SANE_Bool MustScanner_SecondAdjustOffset (int nTimes, SANE_Bool * bDirect
 #endif
 static unsigned short MustScanner_FiltLower (unsigned short * pSort, unsigned short TotalCount, unsigned short LowCount,
 				   unsigned short HighCount);
-static SANE_Bool MustScanner_GetRgb48BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+static SANE_Bool MustScanner_GetRgb48BitLine (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 					 unsigned short * wLinesCount);
-static SANE_Bool MustScanner_GetRgb48BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+static SANE_Bool MustScanner_GetRgb48BitLine1200DPI (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 						unsigned short * wLinesCount);
-static SANE_Bool MustScanner_GetRgb24BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+static SANE_Bool MustScanner_GetRgb24BitLine (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 					 unsigned short * wLinesCount);
-static SANE_Bool MustScanner_GetRgb24BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+static SANE_Bool MustScanner_GetRgb24BitLine1200DPI (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 						unsigned short * wLinesCount);
-static SANE_Bool MustScanner_GetMono16BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+static SANE_Bool MustScanner_GetMono16BitLine (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 					  unsigned short * wLinesCount);
-static SANE_Bool MustScanner_GetMono16BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+static SANE_Bool MustScanner_GetMono16BitLine1200DPI (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 						 unsigned short * wLinesCount);
-static SANE_Bool MustScanner_GetMono8BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+static SANE_Bool MustScanner_GetMono8BitLine (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 					 unsigned short * wLinesCount);
-static SANE_Bool MustScanner_GetMono8BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+static SANE_Bool MustScanner_GetMono8BitLine1200DPI (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 						unsigned short * wLinesCount);
-static SANE_Bool MustScanner_GetMono1BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+static SANE_Bool MustScanner_GetMono1BitLine (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 					 unsigned short * wLinesCount);
-static SANE_Bool MustScanner_GetMono1BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+static SANE_Bool MustScanner_GetMono1BitLine1200DPI (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 						unsigned short * wLinesCount);
-static void *MustScanner_ReadDataFromScanner (void * dummy);
+static void *MustScanner_ReadDataFromScanner (void * arg);
 static void MustScanner_PrepareCalculateMaxMin (unsigned short wResolution);
 static void MustScanner_CalculateMaxMin (SANE_Byte * pBuffer, unsigned short * lpMaxValue,
 					 unsigned short * lpMinValue, unsigned short wResolution);
 
 static SANE_Byte QBET4 (SANE_Byte A, SANE_Byte B);
-static unsigned int GetScannedLines (void);
-static unsigned int GetReadyLines (void);
-static void AddScannedLines (unsigned short wAddLines);
-static void AddReadyLines (void);
+static void MustScanner_InitImageRing (ImageRing * ring);
+static void MustScanner_FreeImageRing (ImageRing * ring);
+static SANE_Bool StartReadImageThread (ImageRing * ring);
+static void StopReadImageThread (ImageRing * ring);
+static SANE_Bool WaitScannedLines (ImageRing * ring);
+static SANE_Bool ReadImageFailed (ImageRing * ring);
+static SANE_Bool WaitReadyLines (ImageRing * ring, unsigned int dwHighLines,
+				 unsigned int dwLowLines);
+static void AddScannedLines (ImageRing * ring, unsigned short wAddLines);
+static void AddReadyLines (ImageRing * ring);
 static void ModifyLinePoint (SANE_Byte * lpImageData,
 			     SANE_Byte * lpImageDataBefore,
 			     unsigned int dwBytesPerLine,
@@ -216,10 +211,8 @@ MustScanner_Init ()
       return FALSE;
     }
 
-  g_dwImageBufferSize = 24L * 1024L * 1024L;
   g_dwBufferSize = 64L * 1024L;
   g_dwCalibrationSize = 64L * 1024L;
-  g_lpReadImageHead = NULL;
 
   g_isCanceled = FALSE;
   g_bFirstReadImage = TRUE;
@@ -787,6 +780,7 @@ Author: Jack             Date: 2005/05/15
 Routine Description:
 	Repair line when single CCD and color is 48bit
 Parameters:
+	ring: the image ring
 	lpLine: point to image be repaired
 	isOrderInvert: RGB or BGR
 	wLinesCount: how many line be repaired
@@ -797,7 +791,7 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-MustScanner_GetRgb48BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+MustScanner_GetRgb48BitLine (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 			     unsigned short * wLinesCount)
 {
   unsigned short wWantedTotalLines;
@@ -819,8 +813,7 @@ MustScanner_GetRgb48BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 
   if (g_bFirstReadImage)
     {
-      pthread_create (&g_threadid_readimage, NULL,
-		      MustScanner_ReadDataFromScanner, NULL);
+      StartReadImageThread (ring);
       DBG (DBG_FUNC, "MustScanner_GetRgb48BitLine: thread create\n");
       g_bFirstReadImage = FALSE;
     }
@@ -831,8 +824,7 @@ MustScanner_GetRgb48BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	{
 	  if (g_dwTotalTotalXferLines >= g_SWHeight)
 	    {
-	      pthread_cancel (g_threadid_readimage);
-	      pthread_join (g_threadid_readimage, NULL);
+	      StopReadImageThread (ring);
 	      DBG (DBG_FUNC, "MustScanner_GetRgb48BitLine: thread exit\n");
 
 	      *wLinesCount = TotalXferLines;
@@ -840,33 +832,33 @@ MustScanner_GetRgb48BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	      return TRUE;
 	    }
 
-	  if (GetScannedLines () > g_wtheReadyLines)
+	  if (WaitScannedLines (ring))
 	    {
-	      wRLinePos = g_wtheReadyLines % g_wMaxScanLines;
+	      wRLinePos = ring->dwReadyLines % ring->wMaxLines;
 	      wGLinePos =
-		(g_wtheReadyLines - g_wLineDistance) % g_wMaxScanLines;
+		(ring->dwReadyLines - g_wLineDistance) % ring->wMaxLines;
 	      wBLinePos =
-		(g_wtheReadyLines - g_wLineDistance * 2) % g_wMaxScanLines;
+		(ring->dwReadyLines - g_wLineDistance * 2) % ring->wMaxLines;
 
 	      for (i = 0; i < g_SWWidth; i++)
 		{
 		  wRTempData =
-		    *(g_lpReadImageHead + wRLinePos * g_BytesPerRow + i * 6 +
+		    *(ring->lpImage + wRLinePos * g_BytesPerRow + i * 6 +
 		      0);
 		  wRTempData +=
-		    *(g_lpReadImageHead + wRLinePos * g_BytesPerRow + i * 6 +
+		    *(ring->lpImage + wRLinePos * g_BytesPerRow + i * 6 +
 		      1) << 8;
 		  wGTempData =
-		    *(g_lpReadImageHead + wGLinePos * g_BytesPerRow + i * 6 +
+		    *(ring->lpImage + wGLinePos * g_BytesPerRow + i * 6 +
 		      2);
 		  wGTempData +=
-		    *(g_lpReadImageHead + wGLinePos * g_BytesPerRow + i * 6 +
+		    *(ring->lpImage + wGLinePos * g_BytesPerRow + i * 6 +
 		      3) << 8;
 		  wBTempData =
-		    *(g_lpReadImageHead + wBLinePos * g_BytesPerRow + i * 6 +
+		    *(ring->lpImage + wBLinePos * g_BytesPerRow + i * 6 +
 		      4);
 		  wBTempData +=
-		    *(g_lpReadImageHead + wBLinePos * g_BytesPerRow + i * 6 +
+		    *(ring->lpImage + wBLinePos * g_BytesPerRow + i * 6 +
 		      5) << 8;
 		  *(lpLine + i * 6 + 0) = LOBYTE (g_pGammaTable[wRTempData]);
 		  *(lpLine + i * 6 + 1) = HIBYTE (g_pGammaTable[wRTempData]);
@@ -882,13 +874,12 @@ MustScanner_GetRgb48BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	      TotalXferLines++;
 	      g_dwTotalTotalXferLines++;
 	      lpLine += g_SWBytesPerRow;
-	      AddReadyLines ();
+	      AddReadyLines (ring);
 	    }
 
 	  if (g_isCanceled)
 	    {
-	      pthread_cancel (g_threadid_readimage);
-	      pthread_join (g_threadid_readimage, NULL);
+	      StopReadImageThread (ring);
 
 	      DBG (DBG_FUNC, "MustScanner_GetRgb48BitLine: thread exit\n");
 
@@ -902,8 +893,7 @@ MustScanner_GetRgb48BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	{
 	  if (g_dwTotalTotalXferLines >= g_SWHeight)
 	    {
-	      pthread_cancel (g_threadid_readimage);
-	      pthread_join (g_threadid_readimage, NULL);
+	      StopReadImageThread (ring);
 
 	      DBG (DBG_FUNC, "MustScanner_GetRgb48BitLine: thread exit\n");
 
@@ -913,33 +903,33 @@ MustScanner_GetRgb48BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	      return TRUE;
 	    }
 
-	  if (GetScannedLines () > g_wtheReadyLines)
+	  if (WaitScannedLines (ring))
 	    {
-	      wRLinePos = g_wtheReadyLines % g_wMaxScanLines;
+	      wRLinePos = ring->dwReadyLines % ring->wMaxLines;
 	      wGLinePos =
-		(g_wtheReadyLines - g_wLineDistance) % g_wMaxScanLines;
+		(ring->dwReadyLines - g_wLineDistance) % ring->wMaxLines;
 	      wBLinePos =
-		(g_wtheReadyLines - g_wLineDistance * 2) % g_wMaxScanLines;
+		(ring->dwReadyLines - g_wLineDistance * 2) % ring->wMaxLines;
 
 	      for (i = 0; i < g_SWWidth; i++)
 		{
 		  wRTempData =
-		    *(g_lpReadImageHead + wRLinePos * g_BytesPerRow + i * 6 +
+		    *(ring->lpImage + wRLinePos * g_BytesPerRow + i * 6 +
 		      0);
 		  wRTempData +=
-		    *(g_lpReadImageHead + wRLinePos * g_BytesPerRow + i * 6 +
+		    *(ring->lpImage + wRLinePos * g_BytesPerRow + i * 6 +
 		      1) << 8;
 		  wGTempData =
-		    *(g_lpReadImageHead + wGLinePos * g_BytesPerRow + i * 6 +
+		    *(ring->lpImage + wGLinePos * g_BytesPerRow + i * 6 +
 		      2);
 		  wGTempData +=
-		    *(g_lpReadImageHead + wGLinePos * g_BytesPerRow + i * 6 +
+		    *(ring->lpImage + wGLinePos * g_BytesPerRow + i * 6 +
 		      3) << 8;
 		  wBTempData =
-		    *(g_lpReadImageHead + wBLinePos * g_BytesPerRow + i * 6 +
+		    *(ring->lpImage + wBLinePos * g_BytesPerRow + i * 6 +
 		      4);
 		  wBTempData +=
-		    *(g_lpReadImageHead + wBLinePos * g_BytesPerRow + i * 6 +
+		    *(ring->lpImage + wBLinePos * g_BytesPerRow + i * 6 +
 		      5) << 8;
 		  *(lpLine + i * 6 + 4) = LOBYTE (g_pGammaTable[wRTempData]);
 		  *(lpLine + i * 6 + 5) = HIBYTE (g_pGammaTable[wRTempData]);
@@ -956,13 +946,12 @@ MustScanner_GetRgb48BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	      TotalXferLines++;
 	      g_dwTotalTotalXferLines++;
 	      lpLine += g_SWBytesPerRow;
-	      AddReadyLines ();
+	      AddReadyLines (ring);
 
 	    }
 	  if (g_isCanceled)
 	    {
-	      pthread_cancel (g_threadid_readimage);
-	      pthread_join (g_threadid_readimage, NULL);
+	      StopReadImageThread (ring);
 
 	      DBG (DBG_FUNC, "MustScanner_GetRgb48BitLine: thread exit\n");
 	      break;
@@ -973,6 +962,12 @@ MustScanner_GetRgb48BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
   *wLinesCount = TotalXferLines;
   g_isScanning = FALSE;
 
+  if (ReadImageFailed (ring))
+    {
+      DBG (DBG_ERR, "MustScanner_GetRgb48BitLine: reading the image failed\n");
+      return FALSE;
+    }
+
   DBG (DBG_FUNC,
        "MustScanner_GetRgb48BitLine: leave MustScanner_GetRgb48BitLine\n");
   return TRUE;
@@ -983,6 +978,7 @@ Author: Jack             Date: 2005/05/15
 Routine Description:
 	Repair line when double CCD and color is 48bit
 Parameters:
+	ring: the image ring
 	lpLine: point to image be repaired
 	isOrderInvert: RGB or BGR
 	wLinesCount: how many line be repaired
@@ -993,7 +989,7 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-MustScanner_GetRgb48BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+MustScanner_GetRgb48BitLine1200DPI (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 				    unsigned short * wLinesCount)
 {
   unsigned short wWantedTotalLines;
@@ -1021,8 +1017,7 @@ MustScanner_GetRgb48BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 
   if (g_bFirstReadImage)
     {
-      pthread_create (&g_threadid_readimage, NULL,
-		      MustScanner_ReadDataFromScanner, NULL);
+      StartReadImageThread (ring);
       DBG (DBG_FUNC, "MustScanner_GetRgb48BitLine1200DPI: thread create\n");
       g_bFirstReadImage = FALSE;
     }
@@ -1033,8 +1028,7 @@ MustScanner_GetRgb48BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	{
 	  if (g_dwTotalTotalXferLines >= g_SWHeight)
 	    {
-	      pthread_cancel (g_threadid_readimage);
-	      pthread_join (g_threadid_readimage, NULL);
+	      StopReadImageThread (ring);
 	      DBG (DBG_FUNC,
 		   "MustScanner_GetRgb48BitLine1200DPI: thread exit\n");
 
@@ -1043,41 +1037,41 @@ MustScanner_GetRgb48BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	      return TRUE;
 	    }
 
-	  if (GetScannedLines () > g_wtheReadyLines)
+	  if (WaitScannedLines (ring))
 	    {
 	      if (ST_Reflective == g_ScanType)
 		{
 		  wRLinePosOdd =
-		    (g_wtheReadyLines - g_wPixelDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wPixelDistance) % ring->wMaxLines;
 		  wGLinePosOdd =
-		    (g_wtheReadyLines - g_wLineDistance -
-		     g_wPixelDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance -
+		     g_wPixelDistance) % ring->wMaxLines;
 		  wBLinePosOdd =
-		    (g_wtheReadyLines - g_wLineDistance * 2 -
-		     g_wPixelDistance) % g_wMaxScanLines;
-		  wRLinePosEven = (g_wtheReadyLines) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance * 2 -
+		     g_wPixelDistance) % ring->wMaxLines;
+		  wRLinePosEven = (ring->dwReadyLines) % ring->wMaxLines;
 		  wGLinePosEven =
-		    (g_wtheReadyLines - g_wLineDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance) % ring->wMaxLines;
 		  wBLinePosEven =
-		    (g_wtheReadyLines -
-		     g_wLineDistance * 2) % g_wMaxScanLines;
+		    (ring->dwReadyLines -
+		     g_wLineDistance * 2) % ring->wMaxLines;
 		}
 	      else
 		{
 		  wRLinePosEven =
-		    (g_wtheReadyLines - g_wPixelDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wPixelDistance) % ring->wMaxLines;
 		  wGLinePosEven =
-		    (g_wtheReadyLines - g_wLineDistance -
-		     g_wPixelDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance -
+		     g_wPixelDistance) % ring->wMaxLines;
 		  wBLinePosEven =
-		    (g_wtheReadyLines - g_wLineDistance * 2 -
-		     g_wPixelDistance) % g_wMaxScanLines;
-		  wRLinePosOdd = (g_wtheReadyLines) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance * 2 -
+		     g_wPixelDistance) % ring->wMaxLines;
+		  wRLinePosOdd = (ring->dwReadyLines) % ring->wMaxLines;
 		  wGLinePosOdd =
-		    (g_wtheReadyLines - g_wLineDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance) % ring->wMaxLines;
 		  wBLinePosOdd =
-		    (g_wtheReadyLines -
-		     g_wLineDistance * 2) % g_wMaxScanLines;
+		    (ring->dwReadyLines -
+		     g_wLineDistance * 2) % ring->wMaxLines;
 		}
 
 	      for (i = 0; i < g_SWWidth;)
@@ -1085,44 +1079,44 @@ MustScanner_GetRgb48BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 		  if (i + 1 != g_SWWidth)
 		    {
 		      wRTempData =
-			*(g_lpReadImageHead + wRLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosOdd * g_BytesPerRow +
 			  i * 6 + 0);
 		      wRTempData +=
-			*(g_lpReadImageHead + wRLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosOdd * g_BytesPerRow +
 			  i * 6 + 1) << 8;
 		      wNextTempData =
-			*(g_lpReadImageHead + wRLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosEven * g_BytesPerRow +
 			  (i + 1) * 6 + 0);
 		      wNextTempData +=
-			*(g_lpReadImageHead + wRLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosEven * g_BytesPerRow +
 			  (i + 1) * 6 + 1) << 8;
 		      wRTempData = (wRTempData + wNextTempData) >> 1;
 
 		      wGTempData =
-			*(g_lpReadImageHead + wGLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosOdd * g_BytesPerRow +
 			  i * 6 + 2);
 		      wGTempData +=
-			*(g_lpReadImageHead + wGLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosOdd * g_BytesPerRow +
 			  i * 6 + 3) << 8;
 		      wNextTempData =
-			*(g_lpReadImageHead + wGLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosEven * g_BytesPerRow +
 			  (i + 1) * 6 + 2);
 		      wNextTempData +=
-			*(g_lpReadImageHead + wGLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosEven * g_BytesPerRow +
 			  (i + 1) * 6 + 3) << 8;
 		      wGTempData = (wGTempData + wNextTempData) >> 1;
 
 		      wBTempData =
-			*(g_lpReadImageHead + wBLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosOdd * g_BytesPerRow +
 			  i * 6 + 4);
 		      wBTempData +=
-			*(g_lpReadImageHead + wBLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosOdd * g_BytesPerRow +
 			  i * 6 + 5) << 8;
 		      wNextTempData =
-			*(g_lpReadImageHead + wBLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosEven * g_BytesPerRow +
 			  (i + 1) * 6 + 4);
 		      wNextTempData +=
-			*(g_lpReadImageHead + wBLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosEven * g_BytesPerRow +
 			  (i + 1) * 6 + 5) << 8;
 		      wBTempData = (wBTempData + wNextTempData) >> 1;
 
@@ -1145,44 +1139,44 @@ MustScanner_GetRgb48BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 			}
 
 		      wRTempData =
-			*(g_lpReadImageHead + wRLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosEven * g_BytesPerRow +
 			  i * 6 + 0);
 		      wRTempData +=
-			*(g_lpReadImageHead + wRLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosEven * g_BytesPerRow +
 			  i * 6 + 1) << 8;
 		      wNextTempData =
-			*(g_lpReadImageHead + wRLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosOdd * g_BytesPerRow +
 			  (i + 1) * 6 + 0);
 		      wNextTempData +=
-			*(g_lpReadImageHead + wRLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosOdd * g_BytesPerRow +
 			  (i + 1) * 6 + 1) << 8;
 		      wRTempData = (wRTempData + wNextTempData) >> 1;
 
 		      wGTempData =
-			*(g_lpReadImageHead + wGLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosEven * g_BytesPerRow +
 			  i * 6 + 2);
 		      wGTempData +=
-			*(g_lpReadImageHead + wGLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosEven * g_BytesPerRow +
 			  i * 6 + 3) << 8;
 		      wNextTempData =
-			*(g_lpReadImageHead + wGLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosOdd * g_BytesPerRow +
 			  (i + 1) * 6 + 2);
 		      wNextTempData +=
-			*(g_lpReadImageHead + wGLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosOdd * g_BytesPerRow +
 			  (i + 1) * 6 + 3) << 8;
 		      wGTempData = (wGTempData + wNextTempData) >> 1;
 
 		      wBTempData =
-			*(g_lpReadImageHead + wBLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosEven * g_BytesPerRow +
 			  i * 6 + 4);
 		      wBTempData +=
-			*(g_lpReadImageHead + wBLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosEven * g_BytesPerRow +
 			  i * 6 + 5) << 8;
 		      wNextTempData =
-			*(g_lpReadImageHead + wBLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosOdd * g_BytesPerRow +
 			  (i + 1) * 6 + 4);
 		      wNextTempData +=
-			*(g_lpReadImageHead + wBLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosOdd * g_BytesPerRow +
 			  (i + 1) * 6 + 5) << 8;
 		      wBTempData = (wBTempData + wNextTempData) >> 1;
 
@@ -1206,12 +1200,11 @@ MustScanner_GetRgb48BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	      TotalXferLines++;
 	      g_dwTotalTotalXferLines++;
 	      lpLine += g_SWBytesPerRow;
-	      AddReadyLines ();
+	      AddReadyLines (ring);
 	    }
 	  if (g_isCanceled)
 	    {
-	      pthread_cancel (g_threadid_readimage);
-	      pthread_join (g_threadid_readimage, NULL);
+	      StopReadImageThread (ring);
 	      DBG (DBG_FUNC,
 		   "MustScanner_GetRgb48BitLine1200DPI: thread exit\n");
 	      break;
@@ -1227,8 +1220,7 @@ MustScanner_GetRgb48BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	{
 	  if (g_dwTotalTotalXferLines >= g_SWHeight)
 	    {
-	      pthread_cancel (g_threadid_readimage);
-	      pthread_join (g_threadid_readimage, NULL);
+	      StopReadImageThread (ring);
 	      DBG (DBG_FUNC,
 		   "MustScanner_GetRgb48BitLine1200DPI: thread exit\n");
 
@@ -1237,41 +1229,41 @@ MustScanner_GetRgb48BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	      return TRUE;
 	    }
 
-	  if (GetScannedLines () > g_wtheReadyLines)
+	  if (WaitScannedLines (ring))
 	    {
 	      if (ST_Reflective == g_ScanType)
 		{
 		  wRLinePosOdd =
-		    (g_wtheReadyLines - g_wPixelDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wPixelDistance) % ring->wMaxLines;
 		  wGLinePosOdd =
-		    (g_wtheReadyLines - g_wLineDistance -
-		     g_wPixelDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance -
+		     g_wPixelDistance) % ring->wMaxLines;
 		  wBLinePosOdd =
-		    (g_wtheReadyLines - g_wLineDistance * 2 -
-		     g_wPixelDistance) % g_wMaxScanLines;
-		  wRLinePosEven = (g_wtheReadyLines) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance * 2 -
+		     g_wPixelDistance) % ring->wMaxLines;
+		  wRLinePosEven = (ring->dwReadyLines) % ring->wMaxLines;
 		  wGLinePosEven =
-		    (g_wtheReadyLines - g_wLineDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance) % ring->wMaxLines;
 		  wBLinePosEven =
-		    (g_wtheReadyLines -
-		     g_wLineDistance * 2) % g_wMaxScanLines;
+		    (ring->dwReadyLines -
+		     g_wLineDistance * 2) % ring->wMaxLines;
 		}
 	      else
 		{
 		  wRLinePosEven =
-		    (g_wtheReadyLines - g_wPixelDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wPixelDistance) % ring->wMaxLines;
 		  wGLinePosEven =
-		    (g_wtheReadyLines - g_wLineDistance -
-		     g_wPixelDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance -
+		     g_wPixelDistance) % ring->wMaxLines;
 		  wBLinePosEven =
-		    (g_wtheReadyLines - g_wLineDistance * 2 -
-		     g_wPixelDistance) % g_wMaxScanLines;
-		  wRLinePosOdd = (g_wtheReadyLines) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance * 2 -
+		     g_wPixelDistance) % ring->wMaxLines;
+		  wRLinePosOdd = (ring->dwReadyLines) % ring->wMaxLines;
 		  wGLinePosOdd =
-		    (g_wtheReadyLines - g_wLineDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance) % ring->wMaxLines;
 		  wBLinePosOdd =
-		    (g_wtheReadyLines -
-		     g_wLineDistance * 2) % g_wMaxScanLines;
+		    (ring->dwReadyLines -
+		     g_wLineDistance * 2) % ring->wMaxLines;
 		}
 
 	      for (i = 0; i < g_SWWidth;)
@@ -1279,44 +1271,44 @@ MustScanner_GetRgb48BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 		  if ((i + 1) != g_SWWidth)
 		    {
 		      wRTempData =
-			*(g_lpReadImageHead + wRLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosOdd * g_BytesPerRow +
 			  i * 6 + 0);
 		      wRTempData +=
-			*(g_lpReadImageHead + wRLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosOdd * g_BytesPerRow +
 			  i * 6 + 1) << 8;
 		      wNextTempData =
-			*(g_lpReadImageHead + wRLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosEven * g_BytesPerRow +
 			  (i + 1) * 6 + 0);
 		      wNextTempData +=
-			*(g_lpReadImageHead + wRLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosEven * g_BytesPerRow +
 			  (i + 1) * 6 + 1) << 8;
 		      wRTempData = (wRTempData + wNextTempData) >> 1;
 
 		      wGTempData =
-			*(g_lpReadImageHead + wGLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosOdd * g_BytesPerRow +
 			  i * 6 + 2);
 		      wGTempData +=
-			*(g_lpReadImageHead + wGLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosOdd * g_BytesPerRow +
 			  i * 6 + 3) << 8;
 		      wNextTempData =
-			*(g_lpReadImageHead + wGLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosEven * g_BytesPerRow +
 			  (i + 1) * 6 + 2);
 		      wNextTempData +=
-			*(g_lpReadImageHead + wGLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosEven * g_BytesPerRow +
 			  (i + 1) * 6 + 3) << 8;
 		      wGTempData = (wGTempData + wNextTempData) >> 1;
 
 		      wBTempData =
-			*(g_lpReadImageHead + wBLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosOdd * g_BytesPerRow +
 			  i * 6 + 4);
 		      wBTempData +=
-			*(g_lpReadImageHead + wBLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosOdd * g_BytesPerRow +
 			  i * 6 + 5) << 8;
 		      wNextTempData =
-			*(g_lpReadImageHead + wBLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosEven * g_BytesPerRow +
 			  (i + 1) * 6 + 4);
 		      wNextTempData +=
-			*(g_lpReadImageHead + wBLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosEven * g_BytesPerRow +
 			  (i + 1) * 6 + 5) << 8;
 		      wBTempData = (wBTempData + wNextTempData) >> 1;
 
@@ -1339,45 +1331,45 @@ MustScanner_GetRgb48BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 			}
 
 		      wRTempData =
-			*(g_lpReadImageHead + wRLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosEven * g_BytesPerRow +
 			  i * 6 + 0);
 		      wRTempData +=
-			*(g_lpReadImageHead + wRLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosEven * g_BytesPerRow +
 			  i * 6 + 1) << 8;
 		      wNextTempData =
-			*(g_lpReadImageHead + wRLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosOdd * g_BytesPerRow +
 			  (i + 1) * 6 + 0);
 		      wNextTempData +=
-			*(g_lpReadImageHead + wRLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosOdd * g_BytesPerRow +
 			  (i + 1) * 6 + 1) << 8;
 		      wRTempData = (wRTempData + wNextTempData) >> 1;
 
 		      wGTempData =
-			*(g_lpReadImageHead + wGLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosEven * g_BytesPerRow +
 			  i * 6 + 2);
 		      wGTempData +=
-			*(g_lpReadImageHead + wGLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosEven * g_BytesPerRow +
 			  i * 6 + 3) << 8;
 		      wNextTempData =
-			*(g_lpReadImageHead + wGLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosOdd * g_BytesPerRow +
 			  (i + 1) * 6 + 2);
 		      wNextTempData +=
-			*(g_lpReadImageHead + wGLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosOdd * g_BytesPerRow +
 			  (i + 1) * 6 + 3) << 8;
 		      wGTempData = (wGTempData + wNextTempData) >> 1;
 
 
 		      wBTempData =
-			*(g_lpReadImageHead + wBLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosEven * g_BytesPerRow +
 			  i * 6 + 4);
 		      wBTempData +=
-			*(g_lpReadImageHead + wBLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosEven * g_BytesPerRow +
 			  i * 6 + 5) << 8;
 		      wNextTempData =
-			*(g_lpReadImageHead + wBLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosOdd * g_BytesPerRow +
 			  (i + 1) * 6 + 4);
 		      wNextTempData +=
-			*(g_lpReadImageHead + wBLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosOdd * g_BytesPerRow +
 			  (i + 1) * 6 + 5) << 8;
 		      wBTempData = (wBTempData + wNextTempData) >> 1;
 
@@ -1400,12 +1392,11 @@ MustScanner_GetRgb48BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	      TotalXferLines++;
 	      g_dwTotalTotalXferLines++;
 	      lpLine += g_SWBytesPerRow;
-	      AddReadyLines ();
+	      AddReadyLines (ring);
 	    }
 	  if (g_isCanceled)
 	    {
-	      pthread_cancel (g_threadid_readimage);
-	      pthread_join (g_threadid_readimage, NULL);
+	      StopReadImageThread (ring);
 
 	      DBG (DBG_FUNC,
 		   "MustScanner_GetRgb48BitLine1200DPI: thread exit\n");
@@ -1418,6 +1409,12 @@ MustScanner_GetRgb48BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
   *wLinesCount = TotalXferLines;
   g_isScanning = FALSE;
 
+  if (ReadImageFailed (ring))
+    {
+      DBG (DBG_ERR, "MustScanner_GetRgb48BitLine1200DPI: reading the image failed\n");
+      return FALSE;
+    }
+
   DBG (DBG_FUNC,
        "MustScanner_GetRgb48BitLine1200DPI: leave MustScanner_GetRgb48BitLine1200DPI\n");
   return TRUE;
@@ -1428,6 +1425,7 @@ Author: Jack             Date: 2005/05/15
 Routine Description:
 	Repair line when single CCD and color is 24bit
 Parameters:
+	ring: the image ring
 	lpLine: point to image be repaired
 	isOrderInvert: RGB or BGR
 	wLinesCount: how many line be repaired
@@ -1438,7 +1436,7 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-MustScanner_GetRgb24BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+MustScanner_GetRgb24BitLine (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 			     unsigned short * wLinesCount)
 {
   unsigned short wWantedTotalLines;
@@ -1468,8 +1466,7 @@ MustScanner_GetRgb24BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 
   if (g_bFirstReadImage)
     {
-      pthread_create (&g_threadid_readimage, NULL,
-		      MustScanner_ReadDataFromScanner, NULL);
+      StartReadImageThread (ring);
       DBG (DBG_FUNC, "MustScanner_GetRgb24BitLine: thread create\n");
 
       g_bFirstReadImage = FALSE;
@@ -1483,8 +1480,7 @@ MustScanner_GetRgb24BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	{
 	  if (g_dwTotalTotalXferLines >= g_SWHeight)
 	    {
-	      pthread_cancel (g_threadid_readimage);
-	      pthread_join (g_threadid_readimage, NULL);
+	      StopReadImageThread (ring);
 	      DBG (DBG_FUNC, "MustScanner_GetRgb24BitLine: thread exit\n");
 
 	      *wLinesCount = TotalXferLines;
@@ -1492,37 +1488,37 @@ MustScanner_GetRgb24BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	      return TRUE;
 	    }
 
-	  if (GetScannedLines () > g_wtheReadyLines)
+	  if (WaitScannedLines (ring))
 	    {
-	      wRLinePos = g_wtheReadyLines % g_wMaxScanLines;
+	      wRLinePos = ring->dwReadyLines % ring->wMaxLines;
 	      wGLinePos =
-		(g_wtheReadyLines - g_wLineDistance) % g_wMaxScanLines;
+		(ring->dwReadyLines - g_wLineDistance) % ring->wMaxLines;
 	      wBLinePos =
-		(g_wtheReadyLines - g_wLineDistance * 2) % g_wMaxScanLines;
+		(ring->dwReadyLines - g_wLineDistance * 2) % ring->wMaxLines;
 
 	      for (i = 0; i < g_SWWidth; i++)
 		{
 		  byRed =
-		    *(g_lpReadImageHead + wRLinePos * g_BytesPerRow + i * 3 +
+		    *(ring->lpImage + wRLinePos * g_BytesPerRow + i * 3 +
 		      0);
 		  bNextPixel =
-		    *(g_lpReadImageHead + wRLinePos * g_BytesPerRow +
+		    *(ring->lpImage + wRLinePos * g_BytesPerRow +
 		      (i + 1) * 3 + 0);
 		  byRed = (byRed + bNextPixel) >> 1;
 
 		  byGreen =
-		    *(g_lpReadImageHead + wGLinePos * g_BytesPerRow + i * 3 +
+		    *(ring->lpImage + wGLinePos * g_BytesPerRow + i * 3 +
 		      1);
 		  bNextPixel =
-		    *(g_lpReadImageHead + wGLinePos * g_BytesPerRow +
+		    *(ring->lpImage + wGLinePos * g_BytesPerRow +
 		      (i + 1) * 3 + 1);
 		  byGreen = (byGreen + bNextPixel) >> 1;
 
 		  byBlue =
-		    *(g_lpReadImageHead + wBLinePos * g_BytesPerRow + i * 3 +
+		    *(ring->lpImage + wBLinePos * g_BytesPerRow + i * 3 +
 		      2);
 		  bNextPixel =
-		    *(g_lpReadImageHead + wBLinePos * g_BytesPerRow +
+		    *(ring->lpImage + wBLinePos * g_BytesPerRow +
 		      (i + 1) * 3 + 2);
 		  byBlue = (byBlue + bNextPixel) >> 1;
 
@@ -1547,7 +1543,7 @@ MustScanner_GetRgb24BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	      TotalXferLines++;
 	      g_dwTotalTotalXferLines++;
 	      lpLine += g_SWBytesPerRow;
-	      AddReadyLines ();
+	      AddReadyLines (ring);
 
 	      DBG (DBG_FUNC,
 		   "MustScanner_GetRgb24BitLine: g_dwTotalTotalXferLines=%d,g_SWHeight=%d\n",
@@ -1558,8 +1554,7 @@ MustScanner_GetRgb24BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	    }
 	  if (g_isCanceled)
 	    {
-	      pthread_cancel (g_threadid_readimage);
-	      pthread_join (g_threadid_readimage, NULL);
+	      StopReadImageThread (ring);
 	      DBG (DBG_FUNC, "MustScanner_GetRgb24BitLine: thread exit\n");
 
 	      break;
@@ -1573,8 +1568,7 @@ MustScanner_GetRgb24BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	{
 	  if (g_dwTotalTotalXferLines >= g_SWHeight)
 	    {
-	      pthread_cancel (g_threadid_readimage);
-	      pthread_join (g_threadid_readimage, NULL);
+	      StopReadImageThread (ring);
 	      DBG (DBG_FUNC, "MustScanner_GetRgb24BitLine: thread exit\n");
 
 	      *wLinesCount = TotalXferLines;
@@ -1582,40 +1576,40 @@ MustScanner_GetRgb24BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	      return TRUE;
 	    }
 
-	  if (GetScannedLines () > g_wtheReadyLines)
+	  if (WaitScannedLines (ring))
 	    {
-	      wRLinePos = g_wtheReadyLines % g_wMaxScanLines;
+	      wRLinePos = ring->dwReadyLines % ring->wMaxLines;
 	      wGLinePos =
-		(g_wtheReadyLines - g_wLineDistance) % g_wMaxScanLines;
+		(ring->dwReadyLines - g_wLineDistance) % ring->wMaxLines;
 	      wBLinePos =
-		(g_wtheReadyLines - g_wLineDistance * 2) % g_wMaxScanLines;
+		(ring->dwReadyLines - g_wLineDistance * 2) % ring->wMaxLines;
 
 	      for (i = 0; i < g_SWWidth; i++)
 		{
 		  DBG (DBG_FUNC,
 		       "MustScanner_GetRgb24BitLine: before byRed\n");
 		  byRed =
-		    *(g_lpReadImageHead + wRLinePos * g_BytesPerRow + i * 3 +
+		    *(ring->lpImage + wRLinePos * g_BytesPerRow + i * 3 +
 		      0);
-		  bNextPixel = *(g_lpReadImageHead + wRLinePos * g_BytesPerRow + (i + 1) * 3 + 0);	/*R-channel */
+		  bNextPixel = *(ring->lpImage + wRLinePos * g_BytesPerRow + (i + 1) * 3 + 0);	/*R-channel */
 		  byRed = (byRed + bNextPixel) >> 1;
 
 		  DBG (DBG_FUNC,
 		       "MustScanner_GetRgb24BitLine: before byGreen\n");
 
 		  byGreen =
-		    *(g_lpReadImageHead + wGLinePos * g_BytesPerRow + i * 3 +
+		    *(ring->lpImage + wGLinePos * g_BytesPerRow + i * 3 +
 		      1);
-		  bNextPixel = *(g_lpReadImageHead + wGLinePos * g_BytesPerRow + (i + 1) * 3 + 1);	/*G-channel */
+		  bNextPixel = *(ring->lpImage + wGLinePos * g_BytesPerRow + (i + 1) * 3 + 1);	/*G-channel */
 		  byGreen = (byGreen + bNextPixel) >> 1;
 
 		  DBG (DBG_FUNC,
 		       "MustScanner_GetRgb24BitLine: before byBlue\n");
 
 		  byBlue =
-		    *(g_lpReadImageHead + wBLinePos * g_BytesPerRow + i * 3 +
+		    *(ring->lpImage + wBLinePos * g_BytesPerRow + i * 3 +
 		      2);
-		  bNextPixel = *(g_lpReadImageHead + wBLinePos * g_BytesPerRow + (i + 1) * 3 + 2);	/*B-channel */
+		  bNextPixel = *(ring->lpImage + wBLinePos * g_BytesPerRow + (i + 1) * 3 + 2);	/*B-channel */
 		  byBlue = (byBlue + bNextPixel) >> 1;
 
 
@@ -1648,7 +1642,7 @@ MustScanner_GetRgb24BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	      TotalXferLines++;
 	      g_dwTotalTotalXferLines++;
 	      lpLine += g_SWBytesPerRow;
-	      AddReadyLines ();
+	      AddReadyLines (ring);
 
 	      DBG (DBG_FUNC,
 		   "MustScanner_GetRgb24BitLine: g_dwTotalTotalXferLines=%d,g_SWHeight=%d\n",
@@ -1659,8 +1653,7 @@ MustScanner_GetRgb24BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	    }
 	  if (g_isCanceled)
 	    {
-	      pthread_cancel (g_threadid_readimage);
-	      pthread_join (g_threadid_readimage, NULL);
+	      StopReadImageThread (ring);
 	      DBG (DBG_FUNC, "MustScanner_GetRgb24BitLine: thread exit\n");
 
 	      break;
@@ -1671,6 +1664,12 @@ MustScanner_GetRgb24BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
   *wLinesCount = TotalXferLines;
   g_isScanning = FALSE;
 
+  if (ReadImageFailed (ring))
+    {
+      DBG (DBG_ERR, "MustScanner_GetRgb24BitLine: reading the image failed\n");
+      return FALSE;
+    }
+
   DBG (DBG_FUNC,
        "MustScanner_GetRgb24BitLine: leave MustScanner_GetRgb24BitLine\n");
   return TRUE;
@@ -1681,6 +1680,7 @@ Author: Jack             Date: 2005/05/15
 Routine Description:
 	Repair line when double CCD and color is 24bit
 Parameters:
+	ring: the image ring
 	lpLine: point to image be repaired
 	isOrderInvert: RGB or BGR
 	wLinesCount: how many line be repaired
@@ -1691,7 +1691,7 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-MustScanner_GetRgb24BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+MustScanner_GetRgb24BitLine1200DPI (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 				    unsigned short * wLinesCount)
 {
   unsigned short wWantedTotalLines;
@@ -1717,8 +1717,7 @@ MustScanner_GetRgb24BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 
   if (g_bFirstReadImage)
     {
-      pthread_create (&g_threadid_readimage, NULL,
-		      MustScanner_ReadDataFromScanner, NULL);
+      StartReadImageThread (ring);
       DBG (DBG_FUNC, "MustScanner_GetRgb24BitLine1200DPI: thread create\n");
 
       g_bFirstReadImage = FALSE;
@@ -1737,8 +1736,7 @@ MustScanner_GetRgb24BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 		   "MustScanner_GetRgb24BitLine1200DPI: g_Height=%d\n",
 		   g_Height);
 
-	      pthread_cancel (g_threadid_readimage);
-	      pthread_join (g_threadid_readimage, NULL);
+	      StopReadImageThread (ring);
 	      DBG (DBG_FUNC,
 		   "MustScanner_GetRgb24BitLine1200DPI: thread exit\n");
 
@@ -1747,41 +1745,41 @@ MustScanner_GetRgb24BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	      return TRUE;
 	    }
 
-	  if (GetScannedLines () > g_wtheReadyLines)
+	  if (WaitScannedLines (ring))
 	    {
 	      if (ST_Reflective == g_ScanType)
 		{
 		  wRLinePosOdd =
-		    (g_wtheReadyLines - g_wPixelDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wPixelDistance) % ring->wMaxLines;
 		  wGLinePosOdd =
-		    (g_wtheReadyLines - g_wLineDistance -
-		     g_wPixelDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance -
+		     g_wPixelDistance) % ring->wMaxLines;
 		  wBLinePosOdd =
-		    (g_wtheReadyLines - g_wLineDistance * 2 -
-		     g_wPixelDistance) % g_wMaxScanLines;
-		  wRLinePosEven = (g_wtheReadyLines) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance * 2 -
+		     g_wPixelDistance) % ring->wMaxLines;
+		  wRLinePosEven = (ring->dwReadyLines) % ring->wMaxLines;
 		  wGLinePosEven =
-		    (g_wtheReadyLines - g_wLineDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance) % ring->wMaxLines;
 		  wBLinePosEven =
-		    (g_wtheReadyLines -
-		     g_wLineDistance * 2) % g_wMaxScanLines;
+		    (ring->dwReadyLines -
+		     g_wLineDistance * 2) % ring->wMaxLines;
 		}
 	      else
 		{
 		  wRLinePosEven =
-		    (g_wtheReadyLines - g_wPixelDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wPixelDistance) % ring->wMaxLines;
 		  wGLinePosEven =
-		    (g_wtheReadyLines - g_wLineDistance -
-		     g_wPixelDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance -
+		     g_wPixelDistance) % ring->wMaxLines;
 		  wBLinePosEven =
-		    (g_wtheReadyLines - g_wLineDistance * 2 -
-		     g_wPixelDistance) % g_wMaxScanLines;
-		  wRLinePosOdd = (g_wtheReadyLines) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance * 2 -
+		     g_wPixelDistance) % ring->wMaxLines;
+		  wRLinePosOdd = (ring->dwReadyLines) % ring->wMaxLines;
 		  wGLinePosOdd =
-		    (g_wtheReadyLines - g_wLineDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance) % ring->wMaxLines;
 		  wBLinePosOdd =
-		    (g_wtheReadyLines -
-		     g_wLineDistance * 2) % g_wMaxScanLines;
+		    (ring->dwReadyLines -
+		     g_wLineDistance * 2) % ring->wMaxLines;
 		}
 
 
@@ -1791,21 +1789,21 @@ MustScanner_GetRgb24BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 		  if ((i + 1) != g_SWWidth)
 		    {
 		      byRed =
-			*(g_lpReadImageHead + wRLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosOdd * g_BytesPerRow +
 			  i * 3 + 0);
-		      bNextPixel = *(g_lpReadImageHead + wRLinePosEven * g_BytesPerRow + (i + 1) * 3 + 0);	/*R-channel */
+		      bNextPixel = *(ring->lpImage + wRLinePosEven * g_BytesPerRow + (i + 1) * 3 + 0);	/*R-channel */
 		      byRed = (byRed + bNextPixel) >> 1;
 
 		      byGreen =
-			*(g_lpReadImageHead + wGLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosOdd * g_BytesPerRow +
 			  i * 3 + 1);
-		      bNextPixel = *(g_lpReadImageHead + wGLinePosEven * g_BytesPerRow + (i + 1) * 3 + 1);	/*G-channel */
+		      bNextPixel = *(ring->lpImage + wGLinePosEven * g_BytesPerRow + (i + 1) * 3 + 1);	/*G-channel */
 		      byGreen = (byGreen + bNextPixel) >> 1;
 
 		      byBlue =
-			*(g_lpReadImageHead + wBLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosOdd * g_BytesPerRow +
 			  i * 3 + 2);
-		      bNextPixel = *(g_lpReadImageHead + wBLinePosEven * g_BytesPerRow + (i + 1) * 3 + 2);	/*B-channel */
+		      bNextPixel = *(ring->lpImage + wBLinePosEven * g_BytesPerRow + (i + 1) * 3 + 2);	/*B-channel */
 		      byBlue = (byBlue + bNextPixel) >> 1;
 #ifdef ENABLE_GAMMA
 		      *(lpLine + i * 3 + 0) =
@@ -1836,26 +1834,26 @@ MustScanner_GetRgb24BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 			}
 
 		      byRed =
-			*(g_lpReadImageHead + wRLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosEven * g_BytesPerRow +
 			  i * 3 + 0);
 		      bNextPixel =
-			*(g_lpReadImageHead + wRLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosOdd * g_BytesPerRow +
 			  (i + 1) * 3 + 0);
 		      byRed = (byRed + bNextPixel) >> 1;
 
 		      byGreen =
-			*(g_lpReadImageHead + wGLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosEven * g_BytesPerRow +
 			  i * 3 + 1);
 		      bNextPixel =
-			*(g_lpReadImageHead + wGLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosOdd * g_BytesPerRow +
 			  (i + 1) * 3 + 1);
 		      byGreen = (byGreen + bNextPixel) >> 1;
 
 		      byBlue =
-			*(g_lpReadImageHead + wBLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosEven * g_BytesPerRow +
 			  i * 3 + 2);
 		      bNextPixel =
-			*(g_lpReadImageHead + wBLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosOdd * g_BytesPerRow +
 			  (i + 1) * 3 + 2);
 		      byBlue = (byBlue + bNextPixel) >> 1;
 #ifdef ENABLE_GAMMA
@@ -1887,7 +1885,7 @@ MustScanner_GetRgb24BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	      TotalXferLines++;
 	      g_dwTotalTotalXferLines++;
 	      lpLine += g_SWBytesPerRow;
-	      AddReadyLines ();
+	      AddReadyLines (ring);
 
 	      DBG (DBG_FUNC,
 		   "MustScanner_GetRgb24BitLine1200DPI: g_dwTotalTotalXferLines=%d\n",
@@ -1899,8 +1897,7 @@ MustScanner_GetRgb24BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	    }
 	  if (g_isCanceled)
 	    {
-	      pthread_cancel (g_threadid_readimage);
-	      pthread_join (g_threadid_readimage, NULL);
+	      StopReadImageThread (ring);
 	      DBG (DBG_FUNC,
 		   "MustScanner_GetRgb24BitLine1200DPI: thread exit\n");
 
@@ -1923,8 +1920,7 @@ MustScanner_GetRgb24BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 		   "MustScanner_GetRgb24BitLine1200DPI: g_Height=%d\n",
 		   g_Height);
 
-	      pthread_cancel (g_threadid_readimage);
-	      pthread_join (g_threadid_readimage, NULL);
+	      StopReadImageThread (ring);
 	      DBG (DBG_FUNC,
 		   "MustScanner_GetRgb24BitLine1200DPI: thread exit\n");
 
@@ -1933,41 +1929,41 @@ MustScanner_GetRgb24BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	      return TRUE;
 	    }
 
-	  if (GetScannedLines () > g_wtheReadyLines)
+	  if (WaitScannedLines (ring))
 	    {
 	      if (ST_Reflective == g_ScanType)
 		{
 		  wRLinePosOdd =
-		    (g_wtheReadyLines - g_wPixelDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wPixelDistance) % ring->wMaxLines;
 		  wGLinePosOdd =
-		    (g_wtheReadyLines - g_wLineDistance -
-		     g_wPixelDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance -
+		     g_wPixelDistance) % ring->wMaxLines;
 		  wBLinePosOdd =
-		    (g_wtheReadyLines - g_wLineDistance * 2 -
-		     g_wPixelDistance) % g_wMaxScanLines;
-		  wRLinePosEven = (g_wtheReadyLines) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance * 2 -
+		     g_wPixelDistance) % ring->wMaxLines;
+		  wRLinePosEven = (ring->dwReadyLines) % ring->wMaxLines;
 		  wGLinePosEven =
-		    (g_wtheReadyLines - g_wLineDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance) % ring->wMaxLines;
 		  wBLinePosEven =
-		    (g_wtheReadyLines -
-		     g_wLineDistance * 2) % g_wMaxScanLines;
+		    (ring->dwReadyLines -
+		     g_wLineDistance * 2) % ring->wMaxLines;
 		}
 	      else
 		{
 		  wRLinePosEven =
-		    (g_wtheReadyLines - g_wPixelDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wPixelDistance) % ring->wMaxLines;
 		  wGLinePosEven =
-		    (g_wtheReadyLines - g_wLineDistance -
-		     g_wPixelDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance -
+		     g_wPixelDistance) % ring->wMaxLines;
 		  wBLinePosEven =
-		    (g_wtheReadyLines - g_wLineDistance * 2 -
-		     g_wPixelDistance) % g_wMaxScanLines;
-		  wRLinePosOdd = (g_wtheReadyLines) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance * 2 -
+		     g_wPixelDistance) % ring->wMaxLines;
+		  wRLinePosOdd = (ring->dwReadyLines) % ring->wMaxLines;
 		  wGLinePosOdd =
-		    (g_wtheReadyLines - g_wLineDistance) % g_wMaxScanLines;
+		    (ring->dwReadyLines - g_wLineDistance) % ring->wMaxLines;
 		  wBLinePosOdd =
-		    (g_wtheReadyLines -
-		     g_wLineDistance * 2) % g_wMaxScanLines;
+		    (ring->dwReadyLines -
+		     g_wLineDistance * 2) % ring->wMaxLines;
 		}
 
 	      for (i = 0; i < g_SWWidth;)
@@ -1975,26 +1971,26 @@ MustScanner_GetRgb24BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 		  if ((i + 1) != g_SWWidth)
 		    {
 		      byRed =
-			*(g_lpReadImageHead + wRLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosOdd * g_BytesPerRow +
 			  i * 3 + 0);
 		      bNextPixel =
-			*(g_lpReadImageHead + wRLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosEven * g_BytesPerRow +
 			  (i + 1) * 3 + 0);
 		      byRed = (byRed + bNextPixel) >> 1;
 
 		      byGreen =
-			*(g_lpReadImageHead + wGLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosOdd * g_BytesPerRow +
 			  i * 3 + 1);
 		      bNextPixel =
-			*(g_lpReadImageHead + wGLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosEven * g_BytesPerRow +
 			  (i + 1) * 3 + 1);
 		      byGreen = (byGreen + bNextPixel) >> 1;
 
 		      byBlue =
-			*(g_lpReadImageHead + wBLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosOdd * g_BytesPerRow +
 			  i * 3 + 2);
 		      bNextPixel =
-			*(g_lpReadImageHead + wBLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosEven * g_BytesPerRow +
 			  (i + 1) * 3 + 2);
 		      byBlue = (byBlue + bNextPixel) >> 1;
 
@@ -2026,26 +2022,26 @@ MustScanner_GetRgb24BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 			}
 
 		      byRed =
-			*(g_lpReadImageHead + wRLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosEven * g_BytesPerRow +
 			  i * 3 + 0);
 		      bNextPixel =
-			*(g_lpReadImageHead + wRLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wRLinePosOdd * g_BytesPerRow +
 			  (i + 1) * 3 + 0);
 		      byRed = (byRed + bNextPixel) >> 1;
 
 		      byGreen =
-			*(g_lpReadImageHead + wGLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosEven * g_BytesPerRow +
 			  i * 3 + 1);
 		      bNextPixel =
-			*(g_lpReadImageHead + wGLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wGLinePosOdd * g_BytesPerRow +
 			  (i + 1) * 3 + 1);
 		      byGreen = (byGreen + bNextPixel) >> 1;
 
 		      byBlue =
-			*(g_lpReadImageHead + wBLinePosEven * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosEven * g_BytesPerRow +
 			  i * 3 + 2);
 		      bNextPixel =
-			*(g_lpReadImageHead + wBLinePosOdd * g_BytesPerRow +
+			*(ring->lpImage + wBLinePosOdd * g_BytesPerRow +
 			  (i + 1) * 3 + 2);
 		      byBlue = (byBlue + bNextPixel) >> 1;
 #ifdef ENABLE_GAMMA
@@ -2076,7 +2072,7 @@ MustScanner_GetRgb24BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	      TotalXferLines++;
 	      g_dwTotalTotalXferLines++;
 	      lpLine += g_SWBytesPerRow;
-	      AddReadyLines ();
+	      AddReadyLines (ring);
 
 	      DBG (DBG_FUNC,
 		   "MustScanner_GetRgb24BitLine1200DPI: g_dwTotalTotalXferLines=%d\n",
@@ -2088,8 +2084,7 @@ MustScanner_GetRgb24BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	    }
 	  if (g_isCanceled)
 	    {
-	      pthread_cancel (g_threadid_readimage);
-	      pthread_join (g_threadid_readimage, NULL);
+	      StopReadImageThread (ring);
 	      DBG (DBG_FUNC,
 		   "MustScanner_GetRgb24BitLine1200DPI: thread exit\n");
 
@@ -2102,6 +2097,12 @@ MustScanner_GetRgb24BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
   *wLinesCount = TotalXferLines;
   g_isScanning = FALSE;
 
+  if (ReadImageFailed (ring))
+    {
+      DBG (DBG_ERR, "MustScanner_GetRgb24BitLine1200DPI: reading the image failed\n");
+      return FALSE;
+    }
+
   DBG (DBG_FUNC,
        "MustScanner_GetRgb24BitLine1200DPI: leave MustScanner_GetRgb24BitLine1200DPI\n");
   return TRUE;
@@ -2112,6 +2113,7 @@ Author: Jack             Date: 2005/05/15
 Routine Description:
 	Repair line when single CCD and color is 16bit
 Parameters:
+	ring: the image ring
 	lpLine: point to image be repaired
 	isOrderInvert: RGB or BGR
 	wLinesCount: how many line be repaired
@@ -2122,7 +2124,7 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-MustScanner_GetMono16BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+MustScanner_GetMono16BitLine (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 			      unsigned short * wLinesCount)
 {
   unsigned short wWantedTotalLines;
@@ -2143,8 +2145,7 @@ MustScanner_GetMono16BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 
   if (g_bFirstReadImage)
     {
-      pthread_create (&g_threadid_readimage, NULL,
-		      MustScanner_ReadDataFromScanner, NULL);
+      StartReadImageThread (ring);
       DBG (DBG_FUNC, "MustScanner_GetMono16BitLine: thread create\n");
       g_bFirstReadImage = FALSE;
     }
@@ -2154,8 +2155,7 @@ MustScanner_GetMono16BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 
       if (g_dwTotalTotalXferLines >= g_SWHeight)
 	{
-	  pthread_cancel (g_threadid_readimage);
-	  pthread_join (g_threadid_readimage, NULL);
+	  StopReadImageThread (ring);
 	  DBG (DBG_FUNC, "MustScanner_GetMono16BitLine: thread exit\n");
 
 	  *wLinesCount = TotalXferLines;
@@ -2163,16 +2163,16 @@ MustScanner_GetMono16BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	  return TRUE;
 	}
 
-      if (GetScannedLines () > g_wtheReadyLines)
+      if (WaitScannedLines (ring))
 	{
-	  wLinePos = g_wtheReadyLines % g_wMaxScanLines;
+	  wLinePos = ring->dwReadyLines % ring->wMaxLines;
 
 	  for (i = 0; i < g_SWWidth; i++)
 	    {
 	      wTempData =
-		*(g_lpReadImageHead + wLinePos * g_BytesPerRow + i * 2 + 0);
+		*(ring->lpImage + wLinePos * g_BytesPerRow + i * 2 + 0);
 	      wTempData +=
-		*(g_lpReadImageHead + wLinePos * g_BytesPerRow + i * 2 +
+		*(ring->lpImage + wLinePos * g_BytesPerRow + i * 2 +
 		  1) << 8;
 	      *(lpLine + i * 2 + 0) = LOBYTE (g_pGammaTable[wTempData]);
 	      *(lpLine + i * 2 + 1) = HIBYTE (g_pGammaTable[wTempData]);
@@ -2182,12 +2182,11 @@ MustScanner_GetMono16BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	  g_dwTotalTotalXferLines++;
 
 	  lpLine += g_SWBytesPerRow;
-	  AddReadyLines ();
+	  AddReadyLines (ring);
 	}
       if (g_isCanceled)
 	{
-	  pthread_cancel (g_threadid_readimage);
-	  pthread_join (g_threadid_readimage, NULL);
+	  StopReadImageThread (ring);
 	  DBG (DBG_FUNC, "MustScanner_GetMono16BitLine: thread exit\n");
 
 	  break;
@@ -2197,6 +2196,12 @@ MustScanner_GetMono16BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
   *wLinesCount = TotalXferLines;
   g_isScanning = FALSE;
 
+  if (ReadImageFailed (ring))
+    {
+      DBG (DBG_ERR, "MustScanner_GetMono16BitLine: reading the image failed\n");
+      return FALSE;
+    }
+
   DBG (DBG_FUNC,
        "MustScanner_GetMono16BitLine: leave MustScanner_GetMono16BitLine\n");
   return TRUE;
@@ -2207,6 +2212,7 @@ Author: Jack             Date: 2005/05/15
 Routine Description:
 	Repair line when double CCD and color is 16bit
 Parameters:
+	ring: the image ring
 	lpLine: point to image be repaired
 	isOrderInvert: RGB or BGR
 	wLinesCount: how many line be repaired
@@ -2217,7 +2223,7 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-MustScanner_GetMono16BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+MustScanner_GetMono16BitLine1200DPI (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 				     unsigned short * wLinesCount)
 {
   unsigned short wWantedTotalLines;
@@ -2238,8 +2244,7 @@ MustScanner_GetMono16BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert
 
   if (g_bFirstReadImage)
     {
-      pthread_create (&g_threadid_readimage, NULL,
-		      MustScanner_ReadDataFromScanner, NULL);
+      StartReadImageThread (ring);
       DBG (DBG_FUNC, "MustScanner_GetMono16BitLine1200DPI: thread create\n");
       g_bFirstReadImage = FALSE;
     }
@@ -2248,8 +2253,7 @@ MustScanner_GetMono16BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert
     {
       if (g_dwTotalTotalXferLines >= g_SWHeight)
 	{
-	  pthread_cancel (g_threadid_readimage);
-	  pthread_join (g_threadid_readimage, NULL);
+	  StopReadImageThread (ring);
 	  DBG (DBG_FUNC,
 	       "MustScanner_GetMono16BitLine1200DPI: thread exit\n");
 
@@ -2258,19 +2262,19 @@ MustScanner_GetMono16BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert
 	  return TRUE;
 	}
 
-      if (GetScannedLines () > g_wtheReadyLines)
+      if (WaitScannedLines (ring))
 	{
 	  if (ST_Reflective == g_ScanType)
 	    {
 	      wLinePosOdd =
-		(g_wtheReadyLines - g_wPixelDistance) % g_wMaxScanLines;
-	      wLinePosEven = (g_wtheReadyLines) % g_wMaxScanLines;
+		(ring->dwReadyLines - g_wPixelDistance) % ring->wMaxLines;
+	      wLinePosEven = (ring->dwReadyLines) % ring->wMaxLines;
 	    }
 	  else
 	    {
 	      wLinePosEven =
-		(g_wtheReadyLines - g_wPixelDistance) % g_wMaxScanLines;
-	      wLinePosOdd = (g_wtheReadyLines) % g_wMaxScanLines;
+		(ring->dwReadyLines - g_wPixelDistance) % ring->wMaxLines;
+	      wLinePosOdd = (ring->dwReadyLines) % ring->wMaxLines;
 	    }
 
 
@@ -2280,20 +2284,20 @@ MustScanner_GetMono16BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert
 		{
 		  dwTempData =
 		    (unsigned int) (*
-			     (g_lpReadImageHead +
+			     (ring->lpImage +
 			      wLinePosOdd * g_BytesPerRow + i * 2 + 0));
 		  dwTempData +=
 		    (unsigned int) (*
-			     (g_lpReadImageHead +
+			     (ring->lpImage +
 			      wLinePosOdd * g_BytesPerRow + i * 2 + 1) << 8);
 		  dwTempData +=
 		    (unsigned int) (*
-			     (g_lpReadImageHead +
+			     (ring->lpImage +
 			      wLinePosEven * g_BytesPerRow + (i + 1) * 2 +
 			      0));
 		  dwTempData +=
 		    (unsigned int) (*
-			     (g_lpReadImageHead +
+			     (ring->lpImage +
 			      wLinePosEven * g_BytesPerRow + (i + 1) * 2 +
 			      1) << 8);
 		  dwTempData = g_pGammaTable[dwTempData >> 1];
@@ -2307,19 +2311,19 @@ MustScanner_GetMono16BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert
 
 		  dwTempData =
 		    (unsigned int) (*
-			     (g_lpReadImageHead +
+			     (ring->lpImage +
 			      wLinePosEven * g_BytesPerRow + i * 2 + 0));
 		  dwTempData +=
 		    (unsigned int) (*
-			     (g_lpReadImageHead +
+			     (ring->lpImage +
 			      wLinePosEven * g_BytesPerRow + i * 2 + 1) << 8);
 		  dwTempData +=
 		    (unsigned int) (*
-			     (g_lpReadImageHead +
+			     (ring->lpImage +
 			      wLinePosOdd * g_BytesPerRow + (i + 1) * 2 + 0));
 		  dwTempData +=
 		    (unsigned int) (*
-			     (g_lpReadImageHead +
+			     (ring->lpImage +
 			      wLinePosOdd * g_BytesPerRow + (i + 1) * 2 +
 			      1) << 8);
 		  dwTempData = g_pGammaTable[dwTempData >> 1];
@@ -2332,12 +2336,11 @@ MustScanner_GetMono16BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert
 	  TotalXferLines++;
 	  g_dwTotalTotalXferLines++;
 	  lpLine += g_SWBytesPerRow;
-	  AddReadyLines ();
+	  AddReadyLines (ring);
 	}
       if (g_isCanceled)
 	{
-	  pthread_cancel (g_threadid_readimage);
-	  pthread_join (g_threadid_readimage, NULL);
+	  StopReadImageThread (ring);
 	  DBG (DBG_FUNC,
 	       "MustScanner_GetMono16BitLine1200DPI: thread exit\n");
 
@@ -2348,6 +2351,12 @@ MustScanner_GetMono16BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert
   *wLinesCount = TotalXferLines;
   g_isScanning = FALSE;
 
+  if (ReadImageFailed (ring))
+    {
+      DBG (DBG_ERR, "MustScanner_GetMono16BitLine1200DPI: reading the image failed\n");
+      return FALSE;
+    }
+
   /*for modify the last point */
   if (g_bIsFirstReadBefData)
     {
@@ -2388,6 +2397,7 @@ Author: Jack             Date: 2005/05/15
 Routine Description:
 	Repair line when single CCD and color is 8bit
 Parameters:
+	ring: the image ring
 	lpLine: point to image be repaired
 	isOrderInvert: RGB or BGR
 	wLinesCount: how many line be repaired
@@ -2398,7 +2408,7 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-MustScanner_GetMono8BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+MustScanner_GetMono8BitLine (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 			     unsigned short * wLinesCount)
 {
   unsigned short wWantedTotalLines;
@@ -2417,8 +2427,7 @@ MustScanner_GetMono8BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 
   if (g_bFirstReadImage)
     {
-      pthread_create (&g_threadid_readimage, NULL,
-		      MustScanner_ReadDataFromScanner, NULL);
+      StartReadImageThread (ring);
       DBG (DBG_FUNC, "MustScanner_GetMono8BitLine: thread create\n");
       g_bFirstReadImage = FALSE;
     }
@@ -2427,8 +2436,7 @@ MustScanner_GetMono8BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
     {
       if (g_dwTotalTotalXferLines >= g_SWHeight)
 	{
-	  pthread_cancel (g_threadid_readimage);
-	  pthread_join (g_threadid_readimage, NULL);
+	  StopReadImageThread (ring);
 	  DBG (DBG_FUNC, "MustScanner_GetMono8BitLine: thread exit\n");
 
 	  *wLinesCount = TotalXferLines;
@@ -2436,16 +2444,16 @@ MustScanner_GetMono8BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	  return TRUE;
 	}
 
-      if (GetScannedLines () > g_wtheReadyLines)
+      if (WaitScannedLines (ring))
 	{
-	  wLinePos = g_wtheReadyLines % g_wMaxScanLines;
+	  wLinePos = ring->dwReadyLines % ring->wMaxLines;
 
 	  for (i = 0; i < g_SWWidth; i++)
 	    {
 	      *(lpLine + i) =
 		(SANE_Byte) * (g_pGammaTable +
 			  (unsigned short) ((*
-				   (g_lpReadImageHead +
+				   (ring->lpImage +
 				    wLinePos * g_BytesPerRow +
 				    i) << 4) | (rand () & 0x0f)));
 	    }
@@ -2453,13 +2461,12 @@ MustScanner_GetMono8BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	  TotalXferLines++;
 	  g_dwTotalTotalXferLines++;
 	  lpLine += g_SWBytesPerRow;
-	  AddReadyLines ();
+	  AddReadyLines (ring);
 
 	}
       if (g_isCanceled)
 	{
-	  pthread_cancel (g_threadid_readimage);
-	  pthread_join (g_threadid_readimage, NULL);
+	  StopReadImageThread (ring);
 	  DBG (DBG_FUNC, "MustScanner_GetMono8BitLine: thread exit\n");
 
 	  break;
@@ -2469,6 +2476,12 @@ MustScanner_GetMono8BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
   *wLinesCount = TotalXferLines;
   g_isScanning = FALSE;
 
+  if (ReadImageFailed (ring))
+    {
+      DBG (DBG_ERR, "MustScanner_GetMono8BitLine: reading the image failed\n");
+      return FALSE;
+    }
+
   DBG (DBG_FUNC,
        "MustScanner_GetMono8BitLine: leave MustScanner_GetMono8BitLine\n");
   return TRUE;
@@ -2479,6 +2492,7 @@ Author: Jack             Date: 2005/05/15
 Routine Description:
 	Repair line when double CCD and color is 8bit
 Parameters:
+	ring: the image ring
 	lpLine: point to image be repaired
 	isOrderInvert: RGB or BGR
 	wLinesCount: how many line be repaired
@@ -2489,7 +2503,7 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-MustScanner_GetMono8BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+MustScanner_GetMono8BitLine1200DPI (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 				    unsigned short * wLinesCount)
 {
   SANE_Byte *lpTemp;
@@ -2513,8 +2527,7 @@ MustScanner_GetMono8BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 
   if (g_bFirstReadImage)
     {
-      pthread_create (&g_threadid_readimage, NULL,
-		      MustScanner_ReadDataFromScanner, NULL);
+      StartReadImageThread (ring);
       DBG (DBG_FUNC, "MustScanner_GetMono8BitLine1200DPI: thread create\n");
       g_bFirstReadImage = FALSE;
     }
@@ -2523,8 +2536,7 @@ MustScanner_GetMono8BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
     {
       if (g_dwTotalTotalXferLines >= g_SWHeight)
 	{
-	  pthread_cancel (g_threadid_readimage);
-	  pthread_join (g_threadid_readimage, NULL);
+	  StopReadImageThread (ring);
 	  DBG (DBG_FUNC, "MustScanner_GetMono8BitLine1200DPI: thread exit\n");
 
 	  *wLinesCount = TotalXferLines;
@@ -2532,20 +2544,20 @@ MustScanner_GetMono8BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	  return TRUE;
 	}
 
-      if (GetScannedLines () > g_wtheReadyLines)
+      if (WaitScannedLines (ring))
 	{
 	  if (ST_Reflective == g_ScanType)
 
 	    {
 	      wLinePosOdd =
-		(g_wtheReadyLines - g_wPixelDistance) % g_wMaxScanLines;
-	      wLinePosEven = (g_wtheReadyLines) % g_wMaxScanLines;
+		(ring->dwReadyLines - g_wPixelDistance) % ring->wMaxLines;
+	      wLinePosEven = (ring->dwReadyLines) % ring->wMaxLines;
 	    }
 	  else
 	    {
 	      wLinePosEven =
-		(g_wtheReadyLines - g_wPixelDistance) % g_wMaxScanLines;
-	      wLinePosOdd = (g_wtheReadyLines) % g_wMaxScanLines;
+		(ring->dwReadyLines - g_wPixelDistance) % ring->wMaxLines;
+	      wLinePosOdd = (ring->dwReadyLines) % ring->wMaxLines;
 	    }
 
 
@@ -2554,9 +2566,9 @@ MustScanner_GetMono8BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	      if ((i + 1) != g_SWWidth)
 		{
 		  byGray =
-		    *(g_lpReadImageHead + wLinePosOdd * g_BytesPerRow + i);
+		    *(ring->lpImage + wLinePosOdd * g_BytesPerRow + i);
 		  bNextPixel =
-		    *(g_lpReadImageHead + wLinePosEven * g_BytesPerRow +
+		    *(ring->lpImage + wLinePosEven * g_BytesPerRow +
 		      (i + 1));
 		  byGray = (byGray + bNextPixel) >> 1;
 
@@ -2570,9 +2582,9 @@ MustScanner_GetMono8BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 		    }
 
 		  byGray =
-		    *(g_lpReadImageHead + wLinePosEven * g_BytesPerRow + i);
+		    *(ring->lpImage + wLinePosEven * g_BytesPerRow + i);
 		  bNextPixel =
-		    *(g_lpReadImageHead + wLinePosOdd * g_BytesPerRow +
+		    *(ring->lpImage + wLinePosOdd * g_BytesPerRow +
 		      (i + 1));
 		  byGray = (byGray + bNextPixel) >> 1;
 
@@ -2586,12 +2598,11 @@ MustScanner_GetMono8BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	  TotalXferLines++;
 	  g_dwTotalTotalXferLines++;
 	  lpLine += g_SWBytesPerRow;
-	  AddReadyLines ();
+	  AddReadyLines (ring);
 	}
       if (g_isCanceled)
 	{
-	  pthread_cancel (g_threadid_readimage);
-	  pthread_join (g_threadid_readimage, NULL);
+	  StopReadImageThread (ring);
 	  DBG (DBG_FUNC, "MustScanner_GetMono8BitLine1200DPI: thread exit\n");
 
 	  break;
@@ -2602,6 +2613,12 @@ MustScanner_GetMono8BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
   *wLinesCount = TotalXferLines;
   g_isScanning = FALSE;
 
+  if (ReadImageFailed (ring))
+    {
+      DBG (DBG_ERR, "MustScanner_GetMono8BitLine1200DPI: reading the image failed\n");
+      return FALSE;
+    }
+
   /*for modify the last point */
   if (g_bIsFirstReadBefData)
     {
@@ -2642,6 +2659,7 @@ Author: Jack             Date: 2005/05/15
 Routine Description:
 	Repair line when single CCD and color is 1bit
 Parameters:
+	ring: the image ring
 	lpLine: point to image be repaired
 	isOrderInvert: RGB or BGR
 	wLinesCount: how many line be repaired
@@ -2652,7 +2670,7 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-MustScanner_GetMono1BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+MustScanner_GetMono1BitLine (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 			     unsigned short * wLinesCount)
 {
   unsigned short wWantedTotalLines;
@@ -2670,8 +2688,7 @@ MustScanner_GetMono1BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 
   if (g_bFirstReadImage)
     {
-      pthread_create (&g_threadid_readimage, NULL,
-		      MustScanner_ReadDataFromScanner, NULL);
+      StartReadImageThread (ring);
       DBG (DBG_FUNC, "MustScanner_GetMono1BitLine: thread create\n");
       g_bFirstReadImage = FALSE;
     }
@@ -2683,8 +2700,7 @@ MustScanner_GetMono1BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
     {
       if (g_dwTotalTotalXferLines >= g_SWHeight)
 	{
-	  pthread_cancel (g_threadid_readimage);
-	  pthread_join (g_threadid_readimage, NULL);
+	  StopReadImageThread (ring);
 	  DBG (DBG_FUNC, "MustScanner_GetMono1BitLine: thread exit\n");
 
 	  *wLinesCount = TotalXferLines;
@@ -2692,13 +2708,13 @@ MustScanner_GetMono1BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	  return TRUE;
 	}
 
-      if (GetScannedLines () > g_wtheReadyLines)
+      if (WaitScannedLines (ring))
 	{
-	  wLinePos = g_wtheReadyLines % g_wMaxScanLines;
+	  wLinePos = ring->dwReadyLines % ring->wMaxLines;
 
 	  for (i = 0; i < g_SWWidth; i++)
 	    {
-	      if (*(g_lpReadImageHead + wLinePos * g_BytesPerRow + i) >
+	      if (*(ring->lpImage + wLinePos * g_BytesPerRow + i) >
 		  g_wLineartThreshold)
 		{
 		  *(lpLine + i / 8) += (0x80 >> (i % 8));
@@ -2708,12 +2724,11 @@ MustScanner_GetMono1BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	  TotalXferLines++;
 	  g_dwTotalTotalXferLines++;
 	  lpLine += (g_SWBytesPerRow / 8);
-	  AddReadyLines ();
+	  AddReadyLines (ring);
 	}
       if (g_isCanceled)
 	{
-	  pthread_cancel (g_threadid_readimage);
-	  pthread_join (g_threadid_readimage, NULL);
+	  StopReadImageThread (ring);
 	  DBG (DBG_FUNC, "MustScanner_GetMono1BitLine: thread exit\n");
 
 	  break;
@@ -2723,6 +2738,12 @@ MustScanner_GetMono1BitLine (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
   *wLinesCount = TotalXferLines;
   g_isScanning = FALSE;
 
+  if (ReadImageFailed (ring))
+    {
+      DBG (DBG_ERR, "MustScanner_GetMono1BitLine: reading the image failed\n");
+      return FALSE;
+    }
+
   DBG (DBG_FUNC,
        "MustScanner_GetMono1BitLine: leave MustScanner_GetMono1BitLine\n");
   return TRUE;
@@ -2733,6 +2754,7 @@ Author: Jack             Date: 2005/05/15
 Routine Description:
 	Repair line when double CCD and color is 1bit
 Parameters:
+	ring: the image ring
 	lpLine: point to image be repaired
 	isOrderInvert: RGB or BGR
 	wLinesCount: how many line be repaired
@@ -2743,7 +2765,7 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-MustScanner_GetMono1BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
+MustScanner_GetMono1BitLine1200DPI (ImageRing * ring, SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 				    unsigned short * wLinesCount)
 {
   unsigned short wWantedTotalLines;
@@ -2762,8 +2784,7 @@ MustScanner_GetMono1BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 
   if (g_bFirstReadImage)
     {
-      pthread_create (&g_threadid_readimage, NULL,
-		      MustScanner_ReadDataFromScanner, NULL);
+      StartReadImageThread (ring);
       DBG (DBG_FUNC, "MustScanner_GetMono1BitLine1200DPI: thread create\n");
       g_bFirstReadImage = FALSE;
     }
@@ -2774,8 +2795,7 @@ MustScanner_GetMono1BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
     {
       if (g_dwTotalTotalXferLines >= g_SWHeight)
 	{
-	  pthread_cancel (g_threadid_readimage);
-	  pthread_join (g_threadid_readimage, NULL);
+	  StopReadImageThread (ring);
 	  DBG (DBG_FUNC, "MustScanner_GetMono1BitLine1200DPI: thread exit\n");
 
 	  *wLinesCount = TotalXferLines;
@@ -2783,19 +2803,19 @@ MustScanner_GetMono1BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	  return TRUE;
 	}
 
-      if (GetScannedLines () > g_wtheReadyLines)
+      if (WaitScannedLines (ring))
 	{
 	  if (ST_Reflective == g_ScanType)
 	    {
-	      wLinePosEven = (g_wtheReadyLines) % g_wMaxScanLines;
+	      wLinePosEven = (ring->dwReadyLines) % ring->wMaxLines;
 	      wLinePosOdd =
-		(g_wtheReadyLines - g_wPixelDistance) % g_wMaxScanLines;
+		(ring->dwReadyLines - g_wPixelDistance) % ring->wMaxLines;
 	    }
 	  else
 	    {
-	      wLinePosOdd = (g_wtheReadyLines) % g_wMaxScanLines;
+	      wLinePosOdd = (ring->dwReadyLines) % ring->wMaxLines;
 	      wLinePosEven =
-		(g_wtheReadyLines - g_wPixelDistance) % g_wMaxScanLines;
+		(ring->dwReadyLines - g_wPixelDistance) % ring->wMaxLines;
 	    }
 
 
@@ -2804,7 +2824,7 @@ MustScanner_GetMono1BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	    {
 	      if ((i + 1) != g_SWWidth)
 		{
-		  if (*(g_lpReadImageHead + wLinePosOdd * g_BytesPerRow + i) >
+		  if (*(ring->lpImage + wLinePosOdd * g_BytesPerRow + i) >
 		      g_wLineartThreshold)
 		    *(lpLine + i / 8) += (0x80 >> (i % 8));
 		  i++;
@@ -2813,7 +2833,7 @@ MustScanner_GetMono1BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 		      break;
 		    }
 
-		  if (*(g_lpReadImageHead + wLinePosEven * g_BytesPerRow + i)
+		  if (*(ring->lpImage + wLinePosEven * g_BytesPerRow + i)
 		      > g_wLineartThreshold)
 		    *(lpLine + i / 8) += (0x80 >> (i % 8));
 		  i++;
@@ -2823,14 +2843,13 @@ MustScanner_GetMono1BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
 	  TotalXferLines++;
 	  g_dwTotalTotalXferLines++;
 	  lpLine += g_SWBytesPerRow / 8;
-	  AddReadyLines ();
+	  AddReadyLines (ring);
 
 
 	}
       if (g_isCanceled)
 	{
-	  pthread_cancel (g_threadid_readimage);
-	  pthread_join (g_threadid_readimage, NULL);
+	  StopReadImageThread (ring);
 	  DBG (DBG_FUNC, "MustScanner_GetMono1BitLine1200DPI: thread exit\n");
 
 	  break;
@@ -2840,6 +2859,12 @@ MustScanner_GetMono1BitLine1200DPI (SANE_Byte * lpLine, SANE_Bool isOrderInvert,
   *wLinesCount = TotalXferLines;
   g_isScanning = FALSE;
 
+  if (ReadImageFailed (ring))
+    {
+      DBG (DBG_ERR, "MustScanner_GetMono1BitLine1200DPI: reading the image failed\n");
+      return FALSE;
+    }
+
   DBG (DBG_FUNC,
        "MustScanner_GetMono1BitLine1200DPI: leave MustScanner_GetMono1BitLine1200DPI\n");
   return TRUE;
@@ -2982,89 +3007,79 @@ Author: Jack             Date: 2005/05/15
 Routine Description:
 	Read the data from scanner
 Parameters:
-	none
+	arg: the image ring to fill
 Return value:
-	if operation is success
-	return TRUE
-	else
-	return FALSE
+	NULL
 ***********************************************************************/
 static void *
-MustScanner_ReadDataFromScanner (void * dummy)
+MustScanner_ReadDataFromScanner (void * arg)
 {
+  ImageRing *ring = arg;
   unsigned short wTotalReadImageLines = 0;
   unsigned short wWantedLines = g_Height;
-  SANE_Byte * lpReadImage = g_lpReadImageHead;
-  SANE_Bool isWaitImageLineDiff = FALSE;
-  unsigned int wMaxScanLines = g_wMaxScanLines;
+  SANE_Byte * lpReadImage = ring->lpImage;
+  unsigned int wMaxScanLines = ring->wMaxLines;
+  SANE_Bool isError = FALSE;
   unsigned short wReadImageLines = 0;
   unsigned short wScanLinesThisBlock;
   unsigned short wBufferLines = g_wLineDistance * 2 + g_wPixelDistance;
 
-  dummy = dummy;
   DBG (DBG_FUNC,
        "MustScanner_ReadDataFromScanner: call in, and in new thread\n");
 
-  while (wTotalReadImageLines < wWantedLines && g_lpReadImageHead)
+  while (wTotalReadImageLines < wWantedLines && ring->lpImage)
     {
-      if (!isWaitImageLineDiff)
-	{
-	  wScanLinesThisBlock =
-	    (wWantedLines - wTotalReadImageLines) <
-	    g_wScanLinesPerBlock ? (wWantedLines -
-				    wTotalReadImageLines) :
-	    g_wScanLinesPerBlock;
-
-	  DBG (DBG_FUNC,
-	       "MustScanner_ReadDataFromScanner: wWantedLines=%d\n",
-	       wWantedLines);
+      wScanLinesThisBlock =
+	(wWantedLines - wTotalReadImageLines) <
+	ring->wLinesPerBlock ? (wWantedLines -
+				wTotalReadImageLines) :
+	ring->wLinesPerBlock;
 
-	  DBG (DBG_FUNC,
-	       "MustScanner_ReadDataFromScanner: wScanLinesThisBlock=%d\n",
-	       wScanLinesThisBlock);
+      DBG (DBG_FUNC,
+	   "MustScanner_ReadDataFromScanner: wWantedLines=%d\n",
+	   wWantedLines);
 
-	  if (STATUS_GOOD !=
-	      Asic_ReadImage (&g_chip, lpReadImage, wScanLinesThisBlock))
-	    {
-	      DBG (DBG_FUNC,
-		   "MustScanner_ReadDataFromScanner:Asic_ReadImage return error\n");
-	      DBG (DBG_FUNC, "MustScanner_ReadDataFromScanner:thread exit\n");
-	      return NULL;
-	    }
+      DBG (DBG_FUNC,
+	   "MustScanner_ReadDataFromScanner: wScanLinesThisBlock=%d\n",
+	   wScanLinesThisBlock);
 
-	  /*has read in memory Buffer */
-	  wReadImageLines += wScanLinesThisBlock;
+      if (STATUS_GOOD !=
+	  Asic_ReadImage (&g_chip, lpReadImage, wScanLinesThisBlock))
+	{
+	  DBG (DBG_FUNC,
+	       "MustScanner_ReadDataFromScanner:Asic_ReadImage return error\n");
+	  isError = TRUE;
+	  break;
+	}
 
-	  AddScannedLines (wScanLinesThisBlock);
+      /*has read in memory Buffer */
+      wReadImageLines += wScanLinesThisBlock;
 
-	  wTotalReadImageLines += wScanLinesThisBlock;
+      AddScannedLines (ring, wScanLinesThisBlock);
 
-	  lpReadImage += wScanLinesThisBlock * g_BytesPerRow;
+      wTotalReadImageLines += wScanLinesThisBlock;
 
-	  /*Buffer is full */
-	  if (wReadImageLines >= wMaxScanLines)
-	    {
-	      lpReadImage = g_lpReadImageHead;
-	      wReadImageLines = 0;
-	    }
+      lpReadImage += wScanLinesThisBlock * g_BytesPerRow;
 
-	  if ((g_dwScannedTotalLines - GetReadyLines ())
-	      >= (wMaxScanLines - (wBufferLines + g_wScanLinesPerBlock))
-	      && g_dwScannedTotalLines > GetReadyLines ())
-	    {
-	      isWaitImageLineDiff = TRUE;
-	    }
-	}
-      else if (g_dwScannedTotalLines <=
-	       GetReadyLines () + wBufferLines + g_wScanLinesPerBlock)
+      /*Buffer is full */
+      if (wReadImageLines >= wMaxScanLines)
 	{
-	  isWaitImageLineDiff = FALSE;
+	  lpReadImage = ring->lpImage;
+	  wReadImageLines = 0;
 	}
 
-      pthread_testcancel ();
+      /* when the ring is nearly full, sleep until it has been drained */
+      if (!WaitReadyLines (ring, wMaxScanLines - (wBufferLines + ring->wLinesPerBlock),
+			   wBufferLines + ring->wLinesPerBlock))
+	break;
     }
 
-  DBG (DBG_FUNC, "MustScanner_ReadDataFromScanner: Read image ok\n");
+  pthread_mutex_lock (&ring->mutex);
+  ring->bError = isError;
+  ring->bDone = TRUE;
+  pthread_cond_broadcast (&ring->cond);
+  pthread_mutex_unlock (&ring->mutex);
+
   DBG (DBG_FUNC, "MustScanner_ReadDataFromScanner: thread exit\n");
   DBG (DBG_FUNC,
        "MustScanner_ReadDataFromScanner: leave MustScanner_ReadDataFromScanner\n");
@@ -3072,46 +3087,187 @@ MustScanner_ReadDataFromScanner (void * dummy)
 }
 
 /**********************************************************************
-Author: Jack            Date: 2005/05/26
 Routine Description:
-	get the lines of scanned
+	start the thread reading the image into the ring
 Parameters:
-	none
+	ring: the image ring
 Return value:
-	the lines of scanned
+	if the thread has been started
+	return TRUE
+	else
+	return FALSE
 ***********************************************************************/
-static unsigned int
-GetScannedLines ()
+static SANE_Bool
+StartReadImageThread (ImageRing * ring)
 {
-  unsigned int dwScannedLines = 0;
+  ring->bStop = FALSE;
+  ring->bDone = FALSE;
+  ring->bError = FALSE;
 
-  pthread_mutex_lock (&g_scannedLinesMutex);
-  dwScannedLines = g_dwScannedTotalLines;
-  pthread_mutex_unlock (&g_scannedLinesMutex);
+  if (pthread_create (&ring->thread, NULL,
+		      MustScanner_ReadDataFromScanner, ring) != 0)
+    {
+      DBG (DBG_ERR, "StartReadImageThread: pthread_create failed\n");
+      ring->bDone = TRUE;
+      return FALSE;
+    }
 
-  return dwScannedLines;
+  ring->bRunning = TRUE;
+  return TRUE;
 }
 
 /**********************************************************************
-Author: Jack            Date: 2005/05/26
+Routine Description:
+	stop the reader thread and wait until it has exited. The thread
+	finishes the USB transfer in progress, if any. Safe to call when
+	no thread is running or from two threads at once.
+Parameters:
+	ring: the image ring
+Return value:
+	none
+***********************************************************************/
+static void
+StopReadImageThread (ImageRing * ring)
+{
+  SANE_Bool isRunning;
+
+  pthread_mutex_lock (&ring->mutex);
+  ring->bStop = TRUE;
+  pthread_cond_broadcast (&ring->cond);
+  while (!ring->bDone)
+    pthread_cond_wait (&ring->cond, &ring->mutex);
+  isRunning = ring->bRunning;
+  ring->bRunning = FALSE;
+  pthread_mutex_unlock (&ring->mutex);
+
+  if (isRunning)
+    pthread_join (ring->thread, NULL);
+}
 
+/**********************************************************************
 Routine Description:
-	get lines which pass to superstratum
+	initialize the image ring of a scanner handle
 Parameters:
+	ring: the image ring
+Return value:
 	none
+***********************************************************************/
+static void
+MustScanner_InitImageRing (ImageRing * ring)
+{
+  memset (ring, 0, sizeof (*ring));
+  ring->dwBufferSize = 24L * 1024L * 1024L;
+  ring->bDone = TRUE;
+  pthread_mutex_init (&ring->mutex, NULL);
+  pthread_cond_init (&ring->cond, NULL);
+}
+
+/**********************************************************************
+Routine Description:
+	stop the reader thread and free the image ring of a scanner handle
+Parameters:
+	ring: the image ring
+Return value:
+	none
+***********************************************************************/
+static void
+MustScanner_FreeImageRing (ImageRing * ring)
+{
+  StopReadImageThread (ring);
+  if (NULL != ring->lpImage)
+    {
+      free (ring->lpImage);
+      ring->lpImage = NULL;
+    }
+  pthread_cond_destroy (&ring->cond);
+  pthread_mutex_destroy (&ring->mutex);
+}
+
+/**********************************************************************
+Routine Description:
+	wait until the reader thread has scanned a line that has not been
+	passed to superstratum yet
+Parameters:
+	ring: the image ring
+Return value:
+	if a line is available
+	return TRUE
+	else the scan has been canceled or the reader thread stopped early,
+	g_isCanceled is set and FALSE is returned
+***********************************************************************/
+static SANE_Bool
+WaitScannedLines (ImageRing * ring)
+{
+  SANE_Bool isReady;
+
+  pthread_mutex_lock (&ring->mutex);
+  while (ring->dwScannedLines <= ring->dwReadyLines && !g_isCanceled
+	 && !ring->bDone)
+    pthread_cond_wait (&ring->cond, &ring->mutex);
+
+  isReady = ring->dwScannedLines > ring->dwReadyLines;
+  if (!isReady)
+    g_isCanceled = TRUE;
+  pthread_mutex_unlock (&ring->mutex);
+
+  return isReady;
+}
+
+/**********************************************************************
+Routine Description:
+	check whether the reader thread stopped because reading the image
+	from the scanner failed
+Parameters:
+	ring: the image ring
 Return value:
-	the lines which pass to superstratum
+	if Asic_ReadImage failed
+	return TRUE
+	else
+	return FALSE
 ***********************************************************************/
-static unsigned int
-GetReadyLines ()
+static SANE_Bool
+ReadImageFailed (ImageRing * ring)
 {
-  unsigned int dwReadyLines = 0;
+  SANE_Bool isError;
 
-  pthread_mutex_lock (&g_readyLinesMutex);
-  dwReadyLines = g_wtheReadyLines;
-  pthread_mutex_unlock (&g_readyLinesMutex);
+  pthread_mutex_lock (&ring->mutex);
+  isError = ring->bError;
+  pthread_mutex_unlock (&ring->mutex);
 
-  return dwReadyLines;
+  return isError;
+}
+
+/**********************************************************************
+Routine Description:
+	called by the reader thread: if at least dwHighLines lines are
+	waiting in the buffer, wait until no more than dwLowLines are left
+Parameters:
+	ring: the image ring
+	dwHighLines: the lines at which the buffer counts as full
+	dwLowLines: the lines at which reading resumes
+Return value:
+	if the thread should go on reading
+	return TRUE
+	else
+	return FALSE
+***********************************************************************/
+static SANE_Bool
+WaitReadyLines (ImageRing * ring, unsigned int dwHighLines, unsigned int dwLowLines)
+{
+  SANE_Bool isGoOn;
+
+  pthread_mutex_lock (&ring->mutex);
+  if (ring->dwScannedLines > ring->dwReadyLines
+      && ring->dwScannedLines - ring->dwReadyLines >= dwHighLines)
+    {
+      while (!ring->bStop
+	     && ring->dwScannedLines > ring->dwReadyLines + dwLowLines)
+	pthread_cond_wait (&ring->cond, &ring->mutex);
+    }
+  isGoOn = !ring->bStop;
+  pthread_mutex_unlock (&ring->mutex);
+
+  return isGoOn;
 }
 
 /**********************************************************************
@@ -3119,18 +3275,20 @@ Author: Jack            Date: 2005/05/26
 Routine Description:
 	add the scanned total lines
 Parameters:
+	ring: the image ring
 	wAddLines: add the lines
 Return value:
 	none
 ***********************************************************************/
 static void
-AddScannedLines (unsigned short wAddLines)
+AddScannedLines (ImageRing * ring, unsigned short wAddLines)
 {
-  pthread_mutex_lock (&g_scannedLinesMutex);
+  pthread_mutex_lock (&ring->mutex);
 
-  g_dwScannedTotalLines += wAddLines;
+  ring->dwScannedLines += wAddLines;
+  pthread_cond_broadcast (&ring->cond);
 
-  pthread_mutex_unlock (&g_scannedLinesMutex);
+  pthread_mutex_unlock (&ring->mutex);
 }
 
 /**********************************************************************
@@ -3138,16 +3296,17 @@ Author: Jack            Date: 2005/05/26
 Routine Description:
 	add the ready lines
 Parameters:
-	none
+	ring: the image ring
 Return value:
 	none
 ***********************************************************************/
 static void
-AddReadyLines ()
+AddReadyLines (ImageRing * ring)
 {
-  pthread_mutex_lock (&g_readyLinesMutex);
-  g_wtheReadyLines++;
-  pthread_mutex_unlock (&g_readyLinesMutex);
+  pthread_mutex_lock (&ring->mutex);
+  ring->dwReadyLines++;
+  pthread_cond_broadcast (&ring->cond);
+  pthread_mutex_unlock (&ring->mutex);
 }
 
 /**********************************************************************
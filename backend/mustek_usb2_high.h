@@ -46,6 +46,8 @@
 #ifndef MUSTEK_USB2_HIGH_H
 #define MUSTEK_USB2_HIGH_H
 
+#include <pthread.h>
+
 /* const use in structures*/
 
 /*scan mode*/
@@ -256,6 +258,29 @@ typedef struct tagSUGGESTSETTING
   unsigned int dwBytesPerRow;
 } SUGGESTSETTING, *PSUGGESTSETTING;
 
+/* image ring of one scanner handle. The reader thread fills lpImage as a
+   ring of wMaxLines lines, dwScannedLines and dwReadyLines are its write
+   and read positions. Both are protected by mutex, and cond is signalled
+   whenever one of them or the state of the reader thread changes, so
+   neither side has to poll. */
+typedef struct tagIMAGERING
+{
+  SANE_Byte *lpImage;
+  unsigned int dwBufferSize;
+  unsigned int wMaxLines;
+  unsigned short wLinesPerBlock;
+  unsigned int dwScannedLines;
+  unsigned int dwReadyLines;
+
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  SANE_Bool bRunning;		/* thread not joined yet */
+  SANE_Bool bStop;		/* thread should stop */
+  SANE_Bool bDone;		/* thread has finished */
+  SANE_Bool bError;		/* thread stopped on an error */
+} ImageRing;
+
 
 
 #endif
@@ -47,15 +47,15 @@
 
 static SANE_Bool Reflective_Reset (void);
 static SANE_Bool Reflective_ScanSuggest (PTARGETIMAGE pTarget, PSUGGESTSETTING pSuggest);
-static SANE_Bool Reflective_SetupScan (COLORMODE ColorMode, unsigned short XDpi, unsigned short YDpi,
+static SANE_Bool Reflective_SetupScan (ImageRing * ring, COLORMODE ColorMode, unsigned short XDpi, unsigned short YDpi,
 				  SANE_Bool isInvert, unsigned short X, unsigned short Y, unsigned short Width,
 				  unsigned short Height);
-static SANE_Bool Reflective_StopScan (void);
-static SANE_Bool Reflective_GetRows (SANE_Byte * lpBlock, unsigned short * Rows, SANE_Bool isOrderInvert);
+static SANE_Bool Reflective_StopScan (ImageRing * ring);
+static SANE_Bool Reflective_GetRows (ImageRing * ring, SANE_Byte * lpBlock, unsigned short * Rows, SANE_Bool isOrderInvert);
 static SANE_Bool Reflective_AdjustAD (void);
 static SANE_Bool Reflective_FindTopLeft (unsigned short * lpwStartX, unsigned short * lpwStartY);
 static SANE_Bool Reflective_LineCalibration16Bits (void);
-static SANE_Bool Reflective_PrepareScan (void);
+static SANE_Bool Reflective_PrepareScan (ImageRing * ring);
 
 /*function description*/
 
@@ -342,6 +342,7 @@ Author: Jack            Date: 2005/05/13
 Routine Description:
 	setup scanning process
 Parameters:
+	ring: the image ring
 	ColorMode: ScanMode of Scanning, CM_RGB48, CM_GRAY and so on
 	XDpi: X Resolution
 	YDpi: Y Resolution
@@ -357,7 +358,7 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-Reflective_SetupScan (COLORMODE ColorMode,
+Reflective_SetupScan (ImageRing * ring, COLORMODE ColorMode,
 		      unsigned short XDpi,
 		      unsigned short YDpi,
 		      SANE_Bool isInvert, unsigned short X, unsigned short Y, unsigned short Width, unsigned short Height)
@@ -560,7 +561,7 @@ Reflective_SetupScan (COLORMODE ColorMode,
 		  g_Height);
 
   DBG (DBG_FUNC, "Reflective_SetupScan: leave Reflective_SetupScan\n");
-  return Reflective_PrepareScan ();
+  return Reflective_PrepareScan (ring);
 }
 
 /**********************************************************************
@@ -1285,7 +1286,7 @@ Author: Jack             Date: 2005/05/14
 Routine Description:
 	Stop scan
 Parameters:
-	none
+	ring: the image ring
 Return value:
 	if operation is success
 	return TRUE
@@ -1293,7 +1294,7 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-Reflective_StopScan ()
+Reflective_StopScan (ImageRing * ring)
 {
   DBG (DBG_FUNC, "Reflective_StopScan: call in\n");
   if (!g_bOpened)
@@ -1311,8 +1312,7 @@ Reflective_StopScan ()
 
   g_isCanceled = TRUE;		/*tell parent process stop read image */
 
-  pthread_cancel (g_threadid_readimage);
-  pthread_join (g_threadid_readimage, NULL);
+  StopReadImageThread (ring);
 
   DBG (DBG_FUNC, "Reflective_StopScan: thread exit\n");
 
@@ -1750,7 +1750,7 @@ Author: Jack             Date: 2005/05/14
 Routine Description:
 	Prepare scan image
 Parameters:
-	none
+	ring: the image ring
 Return value:
 	if operation is success
 	return TRUE
@@ -1758,18 +1758,18 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-Reflective_PrepareScan ()
+Reflective_PrepareScan (ImageRing * ring)
 {
-  g_wScanLinesPerBlock = g_dwBufferSize / g_BytesPerRow;
-  g_wMaxScanLines = g_dwImageBufferSize / g_BytesPerRow;
-  g_wMaxScanLines =
-    (g_wMaxScanLines / g_wScanLinesPerBlock) * g_wScanLinesPerBlock;
+  ring->wLinesPerBlock = g_dwBufferSize / g_BytesPerRow;
+  ring->wMaxLines = ring->dwBufferSize / g_BytesPerRow;
+  ring->wMaxLines =
+    (ring->wMaxLines / ring->wLinesPerBlock) * ring->wLinesPerBlock;
 
   g_isCanceled = FALSE;
 
-  g_dwScannedTotalLines = 0;
+  ring->dwScannedLines = 0;
   g_wReadedLines = 0;
-  g_wtheReadyLines = 0;
+  ring->dwReadyLines = 0;
   g_wReadImageLines = 0;
 
   g_wReadyShadingLine = 0;
@@ -1778,83 +1778,83 @@ Reflective_PrepareScan ()
   switch (g_ScanMode)
     {
     case CM_RGB48:
-      g_wtheReadyLines = g_wLineDistance * 2 + g_wPixelDistance;
-      DBG (DBG_FUNC, "Reflective_PrepareScan:g_wtheReadyLines=%d\n",
-	   g_wtheReadyLines);
+      ring->dwReadyLines = g_wLineDistance * 2 + g_wPixelDistance;
+      DBG (DBG_FUNC, "Reflective_PrepareScan:dwReadyLines=%d\n",
+	   ring->dwReadyLines);
 
       DBG (DBG_FUNC,
-	   "Reflective_PrepareScan:g_lpReadImageHead malloc %d Bytes\n",
-	   g_dwImageBufferSize);
-      g_lpReadImageHead = (SANE_Byte *) malloc (g_dwImageBufferSize);
-      if (g_lpReadImageHead == NULL)
+	   "Reflective_PrepareScan:lpImage malloc %d Bytes\n",
+	   ring->dwBufferSize);
+      ring->lpImage = (SANE_Byte *) malloc (ring->dwBufferSize);
+      if (ring->lpImage == NULL)
 	{
 	  DBG (DBG_FUNC,
-	       "Reflective_PrepareScan: g_lpReadImageHead malloc error \n");
+	       "Reflective_PrepareScan: lpImage malloc error \n");
 	  return FALSE;
 	}
       break;
 
     case CM_RGB24ext:
-      g_wtheReadyLines = g_wLineDistance * 2 + g_wPixelDistance;
-      DBG (DBG_FUNC, "Reflective_PrepareScan:g_wtheReadyLines=%d\n",
-	   g_wtheReadyLines);
+      ring->dwReadyLines = g_wLineDistance * 2 + g_wPixelDistance;
+      DBG (DBG_FUNC, "Reflective_PrepareScan:dwReadyLines=%d\n",
+	   ring->dwReadyLines);
 
       DBG (DBG_FUNC,
-	   "Reflective_PrepareScan:g_lpReadImageHead malloc %d Bytes\n",
-	   g_dwImageBufferSize);
-      g_lpReadImageHead = (SANE_Byte *) malloc (g_dwImageBufferSize);
-      if (g_lpReadImageHead == NULL)
+	   "Reflective_PrepareScan:lpImage malloc %d Bytes\n",
+	   ring->dwBufferSize);
+      ring->lpImage = (SANE_Byte *) malloc (ring->dwBufferSize);
+      if (ring->lpImage == NULL)
 	{
 	  DBG (DBG_FUNC,
-	       "Reflective_PrepareScan: g_lpReadImageHead malloc error \n");
+	       "Reflective_PrepareScan: lpImage malloc error \n");
 	  return FALSE;
 	}
       break;
     case CM_GRAY16ext:
-      g_wtheReadyLines = g_wPixelDistance;
-      DBG (DBG_FUNC, "Reflective_PrepareScan:g_wtheReadyLines=%d\n",
-	   g_wtheReadyLines);
+      ring->dwReadyLines = g_wPixelDistance;
+      DBG (DBG_FUNC, "Reflective_PrepareScan:dwReadyLines=%d\n",
+	   ring->dwReadyLines);
 
       DBG (DBG_FUNC,
-	   "Reflective_PrepareScan:g_lpReadImageHead malloc %d Bytes\n",
-	   g_dwImageBufferSize);
-      g_lpReadImageHead = (SANE_Byte *) malloc (g_dwImageBufferSize);
-      if (g_lpReadImageHead == NULL)
+	   "Reflective_PrepareScan:lpImage malloc %d Bytes\n",
+	   ring->dwBufferSize);
+      ring->lpImage = (SANE_Byte *) malloc (ring->dwBufferSize);
+      if (ring->lpImage == NULL)
 	{
 	  DBG (DBG_FUNC,
-	       "Reflective_PrepareScan: g_lpReadImageHead malloc error \n");
+	       "Reflective_PrepareScan: lpImage malloc error \n");
 	  return FALSE;
 	}
       break;
     case CM_GRAY8ext:
-      g_wtheReadyLines = g_wPixelDistance;
-      DBG (DBG_FUNC, "Reflective_PrepareScan:g_wtheReadyLines=%d\n",
-	   g_wtheReadyLines);
+      ring->dwReadyLines = g_wPixelDistance;
+      DBG (DBG_FUNC, "Reflective_PrepareScan:dwReadyLines=%d\n",
+	   ring->dwReadyLines);
 
       DBG (DBG_FUNC,
-	   "Reflective_PrepareScan:g_lpReadImageHead malloc %d Bytes\n",
-	   g_dwImageBufferSize);
-      g_lpReadImageHead = (SANE_Byte *) malloc (g_dwImageBufferSize);
-      if (g_lpReadImageHead == NULL)
+	   "Reflective_PrepareScan:lpImage malloc %d Bytes\n",
+	   ring->dwBufferSize);
+      ring->lpImage = (SANE_Byte *) malloc (ring->dwBufferSize);
+      if (ring->lpImage == NULL)
 	{
 	  DBG (DBG_FUNC,
-	       "Reflective_PrepareScan: g_lpReadImageHead malloc error \n");
+	       "Reflective_PrepareScan: lpImage malloc error \n");
 	  return FALSE;
 	}
       break;
     case CM_TEXT:
-      g_wtheReadyLines = g_wPixelDistance;
-      DBG (DBG_FUNC, "Reflective_PrepareScan:g_wtheReadyLines=%d\n",
-	   g_wtheReadyLines);
+      ring->dwReadyLines = g_wPixelDistance;
+      DBG (DBG_FUNC, "Reflective_PrepareScan:dwReadyLines=%d\n",
+	   ring->dwReadyLines);
 
       DBG (DBG_FUNC,
-	   "Reflective_PrepareScan:g_lpReadImageHead malloc %d Bytes\n",
-	   g_dwImageBufferSize);
-      g_lpReadImageHead = (SANE_Byte *) malloc (g_dwImageBufferSize);
-      if (g_lpReadImageHead == NULL)
+	   "Reflective_PrepareScan:lpImage malloc %d Bytes\n",
+	   ring->dwBufferSize);
+      ring->lpImage = (SANE_Byte *) malloc (ring->dwBufferSize);
+      if (ring->lpImage == NULL)
 	{
 	  DBG (DBG_FUNC,
-	       "Reflective_PrepareScan: g_lpReadImageHead malloc error \n");
+	       "Reflective_PrepareScan: lpImage malloc error \n");
 	  return FALSE;
 	}
       break;
@@ -1871,6 +1871,7 @@ Author: Jack             Date: 2005/05/15
 Routine Description:
 	Get the data of image
 Parameters:
+	ring: the image ring
 	lpBlock: the data of image
 	Rows: the rows of image
 
@@ -1882,7 +1883,7 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-Reflective_GetRows (SANE_Byte * lpBlock, unsigned short * Rows, SANE_Bool isOrderInvert)
+Reflective_GetRows (ImageRing * ring, SANE_Byte * lpBlock, unsigned short * Rows, SANE_Bool isOrderInvert)
 {
   DBG (DBG_FUNC, "Reflective_GetRows: call in \n");
   if (!g_bOpened)
@@ -1900,38 +1901,38 @@ Reflective_GetRows (SANE_Byte * lpBlock, unsigned short * Rows, SANE_Bool isOrde
     {
     case CM_RGB48:
       if (g_XDpi == 1200)
-	return MustScanner_GetRgb48BitLine1200DPI (lpBlock, isOrderInvert,
+	return MustScanner_GetRgb48BitLine1200DPI (ring, lpBlock, isOrderInvert,
 						   Rows);
       else
-	return MustScanner_GetRgb48BitLine (lpBlock, isOrderInvert, Rows);
+	return MustScanner_GetRgb48BitLine (ring, lpBlock, isOrderInvert, Rows);
 
     case CM_RGB24ext:
       if (g_XDpi == 1200)
-	return MustScanner_GetRgb24BitLine1200DPI (lpBlock, isOrderInvert,
+	return MustScanner_GetRgb24BitLine1200DPI (ring, lpBlock, isOrderInvert,
 						   Rows);
       else
-	return MustScanner_GetRgb24BitLine (lpBlock, isOrderInvert, Rows);
+	return MustScanner_GetRgb24BitLine (ring, lpBlock, isOrderInvert, Rows);
 
     case CM_GRAY16ext:
       if (g_XDpi == 1200)
-	return MustScanner_GetMono16BitLine1200DPI (lpBlock, isOrderInvert,
+	return MustScanner_GetMono16BitLine1200DPI (ring, lpBlock, isOrderInvert,
 						    Rows);
       else
-	return MustScanner_GetMono16BitLine (lpBlock, isOrderInvert, Rows);
+	return MustScanner_GetMono16BitLine (ring, lpBlock, isOrderInvert, Rows);
 
     case CM_GRAY8ext:
       if (g_XDpi == 1200)
-	return MustScanner_GetMono8BitLine1200DPI (lpBlock, isOrderInvert,
+	return MustScanner_GetMono8BitLine1200DPI (ring, lpBlock, isOrderInvert,
 						   Rows);
       else
-	return MustScanner_GetMono8BitLine (lpBlock, isOrderInvert, Rows);
+	return MustScanner_GetMono8BitLine (ring, lpBlock, isOrderInvert, Rows);
 
     case CM_TEXT:
       if (g_XDpi == 1200)
-	return MustScanner_GetMono1BitLine1200DPI (lpBlock, isOrderInvert,
+	return MustScanner_GetMono1BitLine1200DPI (ring, lpBlock, isOrderInvert,
 						   Rows);
       else
-	return MustScanner_GetMono1BitLine (lpBlock, isOrderInvert, Rows);
+	return MustScanner_GetMono1BitLine (ring, lpBlock, isOrderInvert, Rows);
     default:
       return FALSE;
     }
@@ -47,15 +47,15 @@
 /* forward declarations */
 static SANE_Bool Transparent_Reset (void);
 static SANE_Bool Transparent_ScanSuggest (PTARGETIMAGE pTarget, PSUGGESTSETTING pSuggest);
-static SANE_Bool Transparent_SetupScan (COLORMODE ColorMode, unsigned short XDpi, unsigned short YDpi,
+static SANE_Bool Transparent_SetupScan (ImageRing * ring, COLORMODE ColorMode, unsigned short XDpi, unsigned short YDpi,
 				   SANE_Bool isInvert, unsigned short X, unsigned short Y, unsigned short Width,
 				   unsigned short Height);
-static SANE_Bool Transparent_StopScan (void);
-static SANE_Bool Transparent_GetRows (SANE_Byte * lpBlock, unsigned short * Rows, SANE_Bool isOrderInvert);
+static SANE_Bool Transparent_StopScan (ImageRing * ring);
+static SANE_Bool Transparent_GetRows (ImageRing * ring, SANE_Byte * lpBlock, unsigned short * Rows, SANE_Bool isOrderInvert);
 static SANE_Bool Transparent_AdjustAD (void);
 static SANE_Bool Transparent_FindTopLeft (unsigned short * lpwStartX, unsigned short * lpwStartY);
 static SANE_Bool Transparent_LineCalibration16Bits (unsigned short wTAShadingMinus);
-static SANE_Bool Transparent_PrepareScan (void);
+static SANE_Bool Transparent_PrepareScan (ImageRing * ring);
 
 
 /*function description*/
@@ -284,6 +284,7 @@ Author: Jack            Date: 2005/05/13
 Routine Description:
 	setup scanning process
 Parameters:
+	ring: the image ring
 	ColorMode: ScanMode of Scanning, CM_RGB48, CM_GRAY and so on
 	XDpi: X Resolution
 	YDpi: Y Resolution
@@ -299,7 +300,7 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-Transparent_SetupScan (COLORMODE ColorMode, unsigned short XDpi, unsigned short YDpi,
+Transparent_SetupScan (ImageRing * ring, COLORMODE ColorMode, unsigned short XDpi, unsigned short YDpi,
 		       SANE_Bool isInvert, unsigned short X, unsigned short Y, unsigned short Width, unsigned short Height)
 {
   SANE_Bool hasTA;
@@ -486,7 +487,7 @@ Transparent_SetupScan (COLORMODE ColorMode, unsigned short XDpi, unsigned short
 		  g_Height);
 
   DBG (DBG_FUNC, "Transparent_SetupScan: leave Transparent_SetupScan\n");
-  return Transparent_PrepareScan ();
+  return Transparent_PrepareScan (ring);
 }
 
 /**********************************************************************
@@ -494,7 +495,7 @@ Author: Jack             Date: 2005/05/14
 Routine Description:
 	Stop scan
 Parameters:
-	none
+	ring: the image ring
 Return value:
 	if operation is success
 	return TRUE
@@ -502,7 +503,7 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-Transparent_StopScan ()
+Transparent_StopScan (ImageRing * ring)
 {
   DBG (DBG_FUNC, "Transparent_StopScan: call in\n");
 
@@ -517,8 +518,7 @@ Transparent_StopScan ()
 
   g_isCanceled = TRUE;
 
-  pthread_cancel (g_threadid_readimage);
-  pthread_join (g_threadid_readimage, NULL);
+  StopReadImageThread (ring);
 
   DBG (DBG_FUNC, "Transparent_StopScan: thread exit\n");
 
@@ -535,6 +535,7 @@ Author: Jack             Date: 2005/05/15
 Routine Description:
 	Get the data of image
 Parameters:
+	ring: the image ring
 	lpBlock: the data of image
 	Rows: the rows of image
 	isOrderInvert: the RGB order
@@ -545,7 +546,7 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-Transparent_GetRows (SANE_Byte * lpBlock, unsigned short * Rows, SANE_Bool isOrderInvert)
+Transparent_GetRows (ImageRing * ring, SANE_Byte * lpBlock, unsigned short * Rows, SANE_Bool isOrderInvert)
 {
   DBG (DBG_FUNC, "Transparent_GetRows: call in\n");
 
@@ -562,38 +563,38 @@ Transparent_GetRows (SANE_Byte * lpBlock, unsigned short * Rows, SANE_Bool isOrd
     {
     case CM_RGB48:
       if (g_XDpi == 1200)
-	return MustScanner_GetRgb48BitLine1200DPI (lpBlock, isOrderInvert,
+	return MustScanner_GetRgb48BitLine1200DPI (ring, lpBlock, isOrderInvert,
 						   Rows);
       else
-	return MustScanner_GetRgb48BitLine (lpBlock, isOrderInvert, Rows);
+	return MustScanner_GetRgb48BitLine (ring, lpBlock, isOrderInvert, Rows);
 
     case CM_RGB24ext:
       if (g_XDpi == 1200)
-	return MustScanner_GetRgb24BitLine1200DPI (lpBlock, isOrderInvert,
+	return MustScanner_GetRgb24BitLine1200DPI (ring, lpBlock, isOrderInvert,
 						   Rows);
       else
-	return MustScanner_GetRgb24BitLine (lpBlock, isOrderInvert, Rows);
+	return MustScanner_GetRgb24BitLine (ring, lpBlock, isOrderInvert, Rows);
 
     case CM_GRAY16ext:
       if (g_XDpi == 1200)
-	return MustScanner_GetMono16BitLine1200DPI (lpBlock, isOrderInvert,
+	return MustScanner_GetMono16BitLine1200DPI (ring, lpBlock, isOrderInvert,
 						    Rows);
       else
-	return MustScanner_GetMono16BitLine (lpBlock, isOrderInvert, Rows);
+	return MustScanner_GetMono16BitLine (ring, lpBlock, isOrderInvert, Rows);
 
     case CM_GRAY8ext:
       if (g_XDpi == 1200)
-	return MustScanner_GetMono8BitLine1200DPI (lpBlock, isOrderInvert,
+	return MustScanner_GetMono8BitLine1200DPI (ring, lpBlock, isOrderInvert,
 						   Rows);
       else
-	return MustScanner_GetMono8BitLine (lpBlock, isOrderInvert, Rows);
+	return MustScanner_GetMono8BitLine (ring, lpBlock, isOrderInvert, Rows);
 
     case CM_TEXT:
       if (g_XDpi == 1200)
-	return MustScanner_GetMono1BitLine1200DPI (lpBlock, isOrderInvert,
+	return MustScanner_GetMono1BitLine1200DPI (ring, lpBlock, isOrderInvert,
 						   Rows);
       else
-	return MustScanner_GetMono1BitLine (lpBlock, isOrderInvert, Rows);
+	return MustScanner_GetMono1BitLine (ring, lpBlock, isOrderInvert, Rows);
     default:
       return FALSE;
     }
@@ -1651,7 +1652,7 @@ Author: Jack             Date: 2005/05/14
 Routine Description:
 	Prepare scan image
 Parameters:
-	none
+	ring: the image ring
 Return value:
 	if operation is success
 	return TRUE
@@ -1659,19 +1660,19 @@ Return value:
 	return FALSE
 ***********************************************************************/
 static SANE_Bool
-Transparent_PrepareScan ()
+Transparent_PrepareScan (ImageRing * ring)
 {
   DBG (DBG_FUNC, "Transparent_PrepareScan: call in\n");
 
-  g_wScanLinesPerBlock = g_dwBufferSize / g_BytesPerRow;
-  g_wMaxScanLines = g_dwImageBufferSize / g_BytesPerRow;
-  g_wMaxScanLines =
-    (g_wMaxScanLines / g_wScanLinesPerBlock) * g_wScanLinesPerBlock;
+  ring->wLinesPerBlock = g_dwBufferSize / g_BytesPerRow;
+  ring->wMaxLines = ring->dwBufferSize / g_BytesPerRow;
+  ring->wMaxLines =
+    (ring->wMaxLines / ring->wLinesPerBlock) * ring->wLinesPerBlock;
   g_isCanceled = FALSE;
 
-  g_dwScannedTotalLines = 0;
+  ring->dwScannedLines = 0;
   g_wReadedLines = 0;
-  g_wtheReadyLines = 0;
+  ring->dwReadyLines = 0;
   g_wReadImageLines = 0;
 
   g_wReadyShadingLine = 0;
@@ -1682,10 +1683,10 @@ Transparent_PrepareScan ()
 
     case CM_RGB48:
 
-      g_wtheReadyLines = g_wLineDistance * 2 + g_wPixelDistance;
+      ring->dwReadyLines = g_wLineDistance * 2 + g_wPixelDistance;
 
-      g_lpReadImageHead = (SANE_Byte *) malloc (g_dwImageBufferSize);
-      if (g_lpReadImageHead == NULL)
+      ring->lpImage = (SANE_Byte *) malloc (ring->dwBufferSize);
+      if (ring->lpImage == NULL)
 	{
 	  DBG (DBG_FUNC, "Transparent_PrepareScan:malloc fail\n");
 	  return FALSE;
@@ -1693,10 +1694,10 @@ Transparent_PrepareScan ()
       break;
 
     case CM_RGB24ext:
-      g_wtheReadyLines = g_wLineDistance * 2 + g_wPixelDistance;
-      g_lpReadImageHead = (SANE_Byte *) malloc (g_dwImageBufferSize);
+      ring->dwReadyLines = g_wLineDistance * 2 + g_wPixelDistance;
+      ring->lpImage = (SANE_Byte *) malloc (ring->dwBufferSize);
 
-      if (g_lpReadImageHead == NULL)
+      if (ring->lpImage == NULL)
 	{
 	  DBG (DBG_FUNC, "Transparent_PrepareScan:malloc fail\n");
 	  return FALSE;
@@ -1704,9 +1705,9 @@ Transparent_PrepareScan ()
       break;
 
     case CM_GRAY16ext:
-      g_wtheReadyLines = g_wPixelDistance;
-      g_lpReadImageHead = (SANE_Byte *) malloc (g_dwImageBufferSize);
-      if (g_lpReadImageHead == NULL)
+      ring->dwReadyLines = g_wPixelDistance;
+      ring->lpImage = (SANE_Byte *) malloc (ring->dwBufferSize);
+      if (ring->lpImage == NULL)
 	{
 	  DBG (DBG_FUNC, "Transparent_PrepareScan:malloc fail\n");
 	  return FALSE;
@@ -1714,9 +1715,9 @@ Transparent_PrepareScan ()
       break;
 
     case CM_GRAY8ext:
-      g_wtheReadyLines = g_wPixelDistance;
-      g_lpReadImageHead = (SANE_Byte *) malloc (g_dwImageBufferSize);
-      if (g_lpReadImageHead == NULL)
+      ring->dwReadyLines = g_wPixelDistance;
+      ring->lpImage = (SANE_Byte *) malloc (ring->dwBufferSize);
+      if (ring->lpImage == NULL)
 	{
 	  DBG (DBG_FUNC, "Transparent_PrepareScan:malloc fail\n");
 	  return FALSE;
@@ -1724,9 +1725,9 @@ Transparent_PrepareScan ()
       break;
 
     case CM_TEXT:
-      g_wtheReadyLines = g_wPixelDistance;
-      g_lpReadImageHead = (SANE_Byte *) malloc (g_dwImageBufferSize);
-      if (g_lpReadImageHead == NULL)
+      ring->dwReadyLines = g_wPixelDistance;
+      ring->lpImage = (SANE_Byte *) malloc (ring->dwBufferSize);
+      if (ring->lpImage == NULL)
 	{
 	  DBG (DBG_FUNC, "Transparent_PrepareScan:malloc fail\n");
 	  return FALSE;
@@ -82,6 +82,7 @@ static AvahiServiceBrowser *avahi_browser = NULL;
 
 #include "../include/sane/sane.h"
 #include "../include/sane/sanei.h"
+#include "../include/sane/sanei_frame.h"
 #include "../include/sane/sanei_net.h"
 #include "../include/sane/sanei_codec_bin.h"
 #include "net.h"
@@ -1863,6 +1864,9 @@ sane_get_parameters (SANE_Handle handle, SANE_Parameters * params)
   status = reply.status;
   *params = reply.params;
   depth = reply.params.depth;
+  /* compressed frames are byte streams, never swap their bytes */
+  if (reply.params.format == SANE_FRAME_JPEG)
+    depth = 8;
   sanei_w_free (&s->hw->wire,
 		(WireCodecFunc) sanei_w_get_parameters_reply, &reply);
 
@@ -26,6 +26,7 @@
 #include "../include/sane/sanei.h"
 #include "../include/sane/sanei_backend.h"
 #include "../include/sane/sanei_config.h"
+#include "../include/sane/sanei_pipeline.h"
 #include "../include/sane/saneopts.h"
 
 #include <stdlib.h>             /* malloc, free */
@@ -108,9 +109,7 @@ typedef struct
   THWParams HWParams;
 
   TDataPipe DataPipe;
-  int iLinesLeft;               /* lines to scan */
-  int iBytesLeft;               /* bytes to read */
-  int iPixelsPerLine;           /* pixels in one scan line */
+  SANEI_Pipeline *pPipeline;    /* converts the RGB lines to the scan mode */
 
   SANE_Int aGammaTable[SANE_GAMMA_SIZE];        /* a 12-to-8 bit color lookup table */
 
@@ -256,83 +255,21 @@ _bytesPerLineColor (int pixelsPerLine)
 }
 
 
-/* dummy*/
-static void
-_rgb2rgb (unsigned char __sane_unused__ *buffer, int __sane_unused__ pixels, int __sane_unused__ threshold)
-{
-  /* make the compiler content */
-}
-
-
-/* convert 24bit RGB to 8bit GRAY */
-static void
-_rgb2gray (unsigned char *buffer, int pixels, int __sane_unused__ threshold)
-{
-#define WEIGHT_R 27
-#define WEIGHT_G 54
-#define WEIGHT_B 19
-#define WEIGHT_W (WEIGHT_R + WEIGHT_G + WEIGHT_B)
-  static int aWeight[BYTES_PER_PIXEL_COLOR] =
-    { WEIGHT_R, WEIGHT_G, WEIGHT_B };
-  int nbyte = pixels * BYTES_PER_PIXEL_COLOR;
-  int acc = 0;
-  int x;
-
-  for (x = 0; x < nbyte; ++x)
-    {
-      acc += aWeight[x % BYTES_PER_PIXEL_COLOR] * buffer[x];
-      if ((x + 1) % BYTES_PER_PIXEL_COLOR == 0)
-        {
-          buffer[x / BYTES_PER_PIXEL_COLOR] =
-            (unsigned char) (acc / WEIGHT_W);
-          acc = 0;
-        }
-    }
-#undef WEIGHT_R
-#undef WEIGHT_G
-#undef WEIGHT_B
-#undef WEIGHT_W
-}
-
-/* convert 24bit RGB to 1bit B/W */
-static void
-_rgb2lineart (unsigned char *buffer, int pixels, int threshold)
-{
-  static const int aMask[BITS_PER_BYTE] = { 128, 64, 32, 16, 8, 4, 2, 1 };
-  int acc = 0;
-  int nx;
-  int x;
-  int thresh;
-  _rgb2gray (buffer, pixels, 0);
-  nx = ((pixels + BITS_PADDING) / BITS_PER_BYTE) * BITS_PER_BYTE;
-  thresh = 255 * threshold / rangeThreshold.max;
-  for (x = 0; x < nx; ++x)
-    {
-      if (x < pixels && buffer[x] < thresh)
-        {
-          acc |= aMask[x % BITS_PER_BYTE];
-        }
-      if ((x + 1) % BITS_PER_BYTE == 0)
-        {
-          buffer[x / BITS_PER_BYTE] = (unsigned char) (acc);
-          acc = 0;
-        }
-    }
-}
+/* weights of the RGB to gray conversion */
+static const int aGrayWeights[3] = { 27, 54, 19 };
 
 typedef struct tgModeParam
 {
   SANE_Int depth;
   SANE_Frame format;
   int (*bytesPerLine) (int pixelsPerLine);
-  void (*adaptFormat) (unsigned char *rgbBuffer, int pixels, int threshold);
 
 } TModeParam;
 
 static const TModeParam modeParam[] = {
-  {DEPTH_COLOR, SANE_FRAME_RGB, _bytesPerLineColor, _rgb2rgb},
-  {DEPTH_GRAY, SANE_FRAME_GRAY, _bytesPerLineGray, _rgb2gray},
-  {DEPTH_LINEART, SANE_FRAME_GRAY, _bytesPerLineLineart, _rgb2lineart}
+  {DEPTH_COLOR, SANE_FRAME_RGB, _bytesPerLineColor},
+  {DEPTH_GRAY, SANE_FRAME_GRAY, _bytesPerLineGray},
+  {DEPTH_LINEART, SANE_FRAME_GRAY, _bytesPerLineLineart}
 };
 
 
@@ -1257,6 +1194,53 @@ sane_get_parameters (SANE_Handle h, SANE_Parameters * p)
 }
 
 
+/* supplies the RGB lines from the circular buffer to the pipeline */
+static SANE_Status
+_ReadPipelineLine (void *arg, SANE_Byte * row,
+                   size_t __sane_unused__ row_bytes)
+{
+  TScanner *s = (TScanner *) arg;
+
+  if (!CircBufferGetLineEx (s->HWParams.iXferHandle, &s->DataPipe, row,
+                            s->HWParams.iReversedHead, SANE_TRUE))
+    {
+      /* we try to read after the end of the buffer */
+      DBG (DBG_MSG, "_ReadPipelineLine: read after end of buffer\n");
+      return SANE_STATUS_EOF;
+    }
+  return SANE_STATUS_GOOD;
+}
+
+
+/* builds the pipeline converting the scanned RGB lines to the scan mode */
+static SANE_Status
+_CreatePipeline (TScanner * s, const SANE_Parameters * pPar)
+{
+  SANE_Parameters rgb;
+  SANE_Status status;
+
+  rgb = *pPar;
+  rgb.format = SANE_FRAME_RGB;
+  rgb.depth = DEPTH_COLOR;
+  rgb.bytes_per_line = _bytesPerLineColor (pPar->pixels_per_line);
+
+  status = sanei_pipeline_new (&rgb, _ReadPipelineLine, s, &s->pPipeline);
+  if (status == SANE_STATUS_GOOD && s->aValues[optMode].w != MODE_COLOR)
+    status = sanei_pipeline_add_rgb_to_gray_weighted (s->pPipeline,
+                                                      aGrayWeights);
+  if (status == SANE_STATUS_GOOD && s->aValues[optMode].w == MODE_LINEART)
+    status = sanei_pipeline_add_threshold (s->pPipeline,
+                                           255 * s->aValues[optThreshold].w /
+                                           rangeThreshold.max);
+  if (status != SANE_STATUS_GOOD)
+    {
+      sanei_pipeline_free (s->pPipeline);
+      s->pPipeline = NULL;
+    }
+  return status;
+}
+
+
 /* get the scale down factor for a resolution that is
   not supported by hardware */
 static int
@@ -1289,7 +1273,6 @@ sane_start (SANE_Handle h)
       return SANE_STATUS_INVAL;
     }
   iScaleDown = _SaneEmulateScaling (s->aValues[optDPI].w);
-  s->iLinesLeft = par.lines;
 
   /* fill in the scanparams using the option values */
   s->ScanParams.iDpi = s->aValues[optDPI].w * iScaleDown;
@@ -1345,11 +1328,13 @@ sane_start (SANE_Handle h)
         MM_TO_PIXEL (s->aValues[optTLY].w + s->HWParams.iTopLeftY,
                      s->aValues[optDPI].w * iScaleDown);
     }
-  s->iBytesLeft = 0;
-  s->iPixelsPerLine = par.pixels_per_line;
+  if (_CreatePipeline (s, &par) != SANE_STATUS_GOOD)
+    {
+      DBG (DBG_ERR, "sane_start: could not create the pipeline\n");
+      FinishScan (&s->HWParams);
+      return SANE_STATUS_NO_MEM;
+    }
 
-  /* hack */
-  s->DataPipe.pabLineBuf = (unsigned char *) malloc (HW_PIXELS * 3);
   CircBufferInit (s->HWParams.iXferHandle, &s->DataPipe,
                   par.pixels_per_line, s->ScanParams.iHeight,
                   s->ScanParams.iLpi * s->HWParams.iSensorSkew / HW_LPI,
@@ -1365,15 +1350,12 @@ SANE_Status
 sane_read (SANE_Handle h, SANE_Byte * buf, SANE_Int maxlen, SANE_Int * len)
 {
   TScanner *s;
-  TDataPipe *p;
-  TModeParam const *pMode;
+  SANE_Status status;
 
   DBG (DBG_MSG, "sane_read: buf=%p, maxlen=%d, ", buf, maxlen);
 
   s = (TScanner *) h;
 
-  pMode = &modeParam[s->aValues[optMode].w];
-
   /* sane_read only allowed after sane_start */
   if (!s->fScanning)
     {
@@ -1392,16 +1374,14 @@ sane_read (SANE_Handle h, SANE_Byte * buf, SANE_Int maxlen, SANE_Int * len)
         }
     }
 
-  p = &s->DataPipe;
-
-  /* anything left to read? */
-  if ((s->iLinesLeft == 0) && (s->iBytesLeft == 0))
+  /* copy (part of) a line, the pipeline reads and converts lines as needed */
+  status = sanei_pipeline_read (s->pPipeline, buf, maxlen, len);
+  if (status == SANE_STATUS_EOF)
     {
-      CircBufferExit (p);
-      free (p->pabLineBuf);
-      p->pabLineBuf = NULL;
       FinishScan (&s->HWParams);
-      *len = 0;
+      CircBufferExit (&s->DataPipe);
+      sanei_pipeline_free (s->pPipeline);
+      s->pPipeline = NULL;
       DBG (DBG_MSG, "\n");
       DBG (DBG_MSG, "sane_read: end of scan\n");
       s->fCancelled = SANE_FALSE;
@@ -1409,46 +1389,9 @@ sane_read (SANE_Handle h, SANE_Byte * buf, SANE_Int maxlen, SANE_Int * len)
       return SANE_STATUS_EOF;
     }
 
-  /* time to read the next line? */
-  if (s->iBytesLeft == 0)
-    {
-      /* read a line from the transfer buffer */
-      if (CircBufferGetLineEx (s->HWParams.iXferHandle, p, p->pabLineBuf,
-                               s->HWParams.iReversedHead, SANE_TRUE))
-        {
-          pMode->adaptFormat (p->pabLineBuf, s->iPixelsPerLine,
-                              s->aValues[optThreshold].w);
-          s->iBytesLeft = pMode->bytesPerLine (s->iPixelsPerLine);
-          s->iLinesLeft--;
-        }
-      /* stop scanning further, when the read action fails
-         because we try read after the end of the buffer */
-      else
-        {
-          FinishScan (&s->HWParams);
-          CircBufferExit (p);
-          free (p->pabLineBuf);
-          p->pabLineBuf = NULL;
-          *len = 0;
-          DBG (DBG_MSG, "\n");
-          DBG (DBG_MSG, "sane_read: read after end of buffer\n");
-          s->fCancelled = SANE_FALSE;
-          s->fScanning = SANE_FALSE;
-          return SANE_STATUS_EOF;
-        }
-
-    }
-
-  /* copy (part of) a line */
-  *len = MIN (maxlen, s->iBytesLeft);
-  memcpy (buf,
-          &p->pabLineBuf[pMode->bytesPerLine (s->iPixelsPerLine) -
-                         s->iBytesLeft], *len);
-  s->iBytesLeft -= *len;
-
   DBG (DBG_MSG, " read=%d    \n", *len);
 
-  return SANE_STATUS_GOOD;
+  return status;
 }
 
 
@@ -1466,8 +1409,8 @@ sane_cancel (SANE_Handle h)
   if (s->fScanning)
     {
       CircBufferExit (&s->DataPipe);
-      free (s->DataPipe.pabLineBuf);
-      s->DataPipe.pabLineBuf = NULL;
+      sanei_pipeline_free (s->pPipeline);
+      s->pPipeline = NULL;
       DBG (DBG_MSG, "sane_cancel: freeing buffers\n");
     }
   s->fCancelled = SANE_TRUE;
@@ -83,7 +83,6 @@ typedef struct
   int iLinesPerCircBuf;		/* lines held in the circular buffer */
   int iRedLine, iGrnLine,	/* start indices for the color information */
     iBluLine;			/* in the circular buffer */
-  unsigned char *pabLineBuf;	/* buffer used to pass data to SANE */
 } TDataPipe;
 
 
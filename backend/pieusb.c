@@ -280,6 +280,8 @@ sane_exit (void)
         free (devlist);
         devlist = NULL;
     }
+
+    sanei_ir_exit ();
 }
 
 /**
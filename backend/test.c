@@ -43,7 +43,7 @@
    This backend is for testing frontends.
 */
 
-#define BUILD 28
+#define BUILD 29
 
 #include "../include/sane/config.h"
 
@@ -53,6 +53,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -108,6 +109,24 @@ static SANE_Range read_delay_duration_range = {
   1000
 };
 
+static SANE_Range adf_pages_range = {
+  1,
+  10000,
+  1
+};
+
+static SANE_Range start_delay_duration_range = {
+  0,
+  10 * 1000 * 1000,		/* 10 sec */
+  1000
+};
+
+static SANE_Range kilobyte_duration_range = {
+  0,
+  1000 * 1000,			/* 1 KB/s */
+  1
+};
+
 static SANE_Range int_constraint_range = {
   4,
   192,
@@ -248,6 +267,7 @@ static SANE_Bool init_hand_scanner = SANE_FALSE;
 static SANE_Bool init_three_pass = SANE_FALSE;
 static SANE_String init_three_pass_order = NULL;
 static SANE_String init_scan_source = NULL;
+static SANE_Word init_adf_pages = 10;
 static SANE_String init_test_picture = NULL;
 static SANE_Bool init_invert_endianess = SANE_FALSE;
 static SANE_Bool init_read_limit = SANE_FALSE;
@@ -259,6 +279,9 @@ static SANE_Bool init_fuzzy_parameters = SANE_FALSE;
 static SANE_Word init_ppl_loss = 0;
 static SANE_Bool init_non_blocking = SANE_FALSE;
 static SANE_Bool init_select_fd = SANE_FALSE;
+static SANE_Bool init_fast_path = SANE_FALSE;
+static SANE_Word init_start_delay_duration = 0;
+static SANE_Word init_kilobyte_duration = 0;
 static SANE_Bool init_enable_test_options = SANE_FALSE;
 static SANE_String init_string = NULL;
 static SANE_String init_string_constraint_string_list = NULL;
@@ -484,7 +507,7 @@ init_options (Test_Device * test_device)
   od = &test_device->opt[opt_scan_source];
   od->name = SANE_NAME_SCAN_SOURCE;
   od->title = SANE_TITLE_SCAN_SOURCE;
-  od->desc = SANE_I18N("If Automatic Document Feeder is selected, the feeder will be 'empty' after 10 scans.");
+  od->desc = SANE_I18N("If Automatic Document Feeder is selected, the feeder will be 'empty' after the number of scans set by adf-pages.");
   od->type = SANE_TYPE_STRING;
   od->unit = SANE_UNIT_NONE;
   od->size = max_string_size (source_list);
@@ -496,6 +519,20 @@ init_options (Test_Device * test_device)
     goto fail;
   strcpy (test_device->val[opt_scan_source].s, init_scan_source);
 
+  /* opt_adf_pages */
+  od = &test_device->opt[opt_adf_pages];
+  od->name = "adf-pages";
+  od->title = SANE_I18N ("Pages in document feeder");
+  od->desc = SANE_I18N ("The number of pages that can be scanned from the "
+			"Automatic Document Feeder before it is 'empty'.");
+  od->type = SANE_TYPE_INT;
+  od->unit = SANE_UNIT_NONE;
+  od->size = sizeof (SANE_Word);
+  od->cap = SANE_CAP_SOFT_DETECT | SANE_CAP_SOFT_SELECT;
+  od->constraint_type = SANE_CONSTRAINT_RANGE;
+  od->constraint.range = &adf_pages_range;
+  test_device->val[opt_adf_pages].w = init_adf_pages;
+
   /* opt_special_group */
   od = &test_device->opt[opt_special_group];
   od->name = "";
@@ -684,6 +721,51 @@ init_options (Test_Device * test_device)
   od->constraint.range = 0;
   test_device->val[opt_select_fd].w = init_select_fd;
 
+  /* opt_fast_path */
+  od = &test_device->opt[opt_fast_path];
+  od->name = "fast-path";
+  od->title = SANE_I18N ("Fast path");
+  od->desc = SANE_I18N ("Copy the data directly from a test picture that is "
+			"kept in memory between scans, without a reader "
+			"process and pipe. Useful as a data source for "
+			"benchmarking frontends and the network backends.");
+  od->type = SANE_TYPE_BOOL;
+  od->unit = SANE_UNIT_NONE;
+  od->size = sizeof (SANE_Word);
+  od->cap = SANE_CAP_SOFT_DETECT | SANE_CAP_SOFT_SELECT;
+  od->constraint_type = SANE_CONSTRAINT_NONE;
+  od->constraint.range = 0;
+  test_device->val[opt_fast_path].w = init_fast_path;
+
+  /* opt_start_delay_duration */
+  od = &test_device->opt[opt_start_delay_duration];
+  od->name = "start-delay-duration";
+  od->title = SANE_I18N ("Duration of start delay");
+  od->desc = SANE_I18N ("How long sane_start() takes, to simulate the "
+			"latency of a device, e.g. for lamp warm-up.");
+  od->type = SANE_TYPE_INT;
+  od->unit = SANE_UNIT_MICROSECOND;
+  od->size = sizeof (SANE_Word);
+  od->cap = SANE_CAP_SOFT_DETECT | SANE_CAP_SOFT_SELECT;
+  od->constraint_type = SANE_CONSTRAINT_RANGE;
+  od->constraint.range = &start_delay_duration_range;
+  test_device->val[opt_start_delay_duration].w = init_start_delay_duration;
+
+  /* opt_kilobyte_duration */
+  od = &test_device->opt[opt_kilobyte_duration];
+  od->name = "kilobyte-duration";
+  od->title = SANE_I18N ("Duration per kilobyte");
+  od->desc = SANE_I18N ("How long the transfer of each kilobyte takes at "
+			"least, to simulate the bandwidth of a device, e.g. "
+			"1000 for about 1 MB/s. 0 means unlimited.");
+  od->type = SANE_TYPE_INT;
+  od->unit = SANE_UNIT_MICROSECOND;
+  od->size = sizeof (SANE_Word);
+  od->cap = SANE_CAP_SOFT_DETECT | SANE_CAP_SOFT_SELECT;
+  od->constraint_type = SANE_CONSTRAINT_RANGE;
+  od->constraint.range = &kilobyte_duration_range;
+  test_device->val[opt_kilobyte_duration].w = init_kilobyte_duration;
+
   /* opt_enable_test_options */
   od = &test_device->opt[opt_enable_test_options];
   od->name = "enable-test-options";
@@ -1259,10 +1341,23 @@ cleanup_initial_string_values ()
   init_string_constraint_long_string_list = NULL;
 }
 
+static void
+free_picture_buffer (Test_Device * test_device)
+{
+  if (test_device->picture_buffer)
+    {
+      DBG (4, "free_picture_buffer: freeing cached picture\n");
+      free (test_device->picture_buffer);
+      test_device->picture_buffer = 0;
+      test_device->picture_buffer_size = 0;
+    }
+}
+
 static void
 cleanup_test_device (Test_Device * test_device)
 {
   DBG (2, "cleanup_test_device: test_device=%p\n", (void *) test_device);
+  free_picture_buffer (test_device);
   if (test_device->options_initialized)
     cleanup_options (test_device);
   if (test_device->name)
@@ -1415,6 +1510,26 @@ read_option (SANE_String line, SANE_String option_string,
   return SANE_STATUS_GOOD;
 }
 
+/* sleep until the data transferred since start_time fits the bandwidth */
+static void
+limit_bandwidth (Test_Device * test_device, struct timeval *start_time,
+		 SANE_Word byte_count)
+{
+  struct timeval now;
+  double elapsed, expected;
+
+  if (test_device->val[opt_kilobyte_duration].w == 0)
+    return;
+
+  gettimeofday (&now, 0);
+  elapsed = (now.tv_sec - start_time->tv_sec) * 1000000.0
+    + (now.tv_usec - start_time->tv_usec);
+  expected = byte_count / 1024.0
+    * test_device->val[opt_kilobyte_duration].w;
+  if (expected > elapsed)
+    usleep (expected - elapsed);
+}
+
 static SANE_Status
 reader_process (Test_Device * test_device, SANE_Int fd)
 {
@@ -1445,6 +1560,8 @@ reader_process (Test_Device * test_device, SANE_Int fd)
 
 	  if (test_device->val[opt_read_delay].w == SANE_TRUE)
 	    usleep (test_device->val[opt_read_delay_duration].w);
+	  limit_bandwidth (test_device, &test_device->start_time,
+			   byte_count + write_count);
 	}
       bytes_written = write (fd, buffer, write_count);
       if (bytes_written < 0)
@@ -1751,6 +1868,9 @@ sane_init (SANE_Int * __sane_unused__ version_code, SANE_Auth_Callback __sane_un
 	  if (read_option (line, "scan-source", param_string,
 			   &init_scan_source) == SANE_STATUS_GOOD)
 	    continue;
+	  if (read_option (line, "adf-pages", param_int,
+			   &init_adf_pages) == SANE_STATUS_GOOD)
+	    continue;
 	  if (read_option (line, "test-picture", param_string,
 			   &init_test_picture) == SANE_STATUS_GOOD)
 	    continue;
@@ -1784,6 +1904,15 @@ sane_init (SANE_Int * __sane_unused__ version_code, SANE_Auth_Callback __sane_un
 	  if (read_option (line, "select-fd", param_bool,
 			   &init_select_fd) == SANE_STATUS_GOOD)
 	    continue;
+	  if (read_option (line, "fast-path", param_bool,
+			   &init_fast_path) == SANE_STATUS_GOOD)
+	    continue;
+	  if (read_option (line, "start-delay-duration", param_int,
+			   &init_start_delay_duration) == SANE_STATUS_GOOD)
+	    continue;
+	  if (read_option (line, "kilobyte-duration", param_int,
+			   &init_kilobyte_duration) == SANE_STATUS_GOOD)
+	    continue;
 	  if (read_option (line, "enable-test-options", param_bool,
 			   &init_enable_test_options) == SANE_STATUS_GOOD)
 	    continue;
@@ -1856,6 +1985,8 @@ sane_init (SANE_Int * __sane_unused__ version_code, SANE_Auth_Callback __sane_un
       test_device->options_initialized = SANE_FALSE;
       sanei_thread_initialize (test_device->reader_pid);
       test_device->pipe = -1;
+      test_device->picture_buffer = 0;
+      test_device->picture_buffer_size = 0;
       DBG (4, "sane_init: new device: `%s' is a %s %s %s\n",
 	   test_device->sane.name, test_device->sane.vendor,
 	   test_device->sane.model, test_device->sane.type);
@@ -2028,6 +2159,7 @@ sane_close (SANE_Handle handle)
       DBG (1, "sane_close: handle %p not open\n", (void *) handle);
       return;
     }
+  free_picture_buffer (test_device);
   test_device->open = SANE_FALSE;
   return;
 }
@@ -2168,6 +2300,8 @@ sane_control_option (SANE_Handle handle, SANE_Int option, SANE_Action action,
 	       sane_strstatus (status));
 	  return status;
 	}
+      /* the cached picture may not match the new settings */
+      free_picture_buffer (test_device);
       switch (option)
 	{
 	case opt_tl_x:		/* Fixed with parameter reloading */
@@ -2204,6 +2338,9 @@ sane_control_option (SANE_Handle handle, SANE_Int option, SANE_Action action,
 	case opt_read_limit_size:	/* Int */
 	case opt_ppl_loss:
 	case opt_read_delay_duration:
+	case opt_adf_pages:
+	case opt_start_delay_duration:
+	case opt_kilobyte_duration:
 	case opt_int:
 	case opt_int_constraint_range:
 	  if (test_device->val[option].w == *(SANE_Int *) value)
@@ -2232,6 +2369,7 @@ sane_control_option (SANE_Handle handle, SANE_Int option, SANE_Action action,
 	case opt_invert_endianess:	/* Bool */
 	case opt_non_blocking:
 	case opt_select_fd:
+	case opt_fast_path:
 	case opt_bool_soft_select_soft_detect:
 	case opt_bool_soft_select_soft_detect_auto:
 	case opt_bool_soft_select_soft_detect_emulated:
@@ -2506,6 +2644,7 @@ sane_control_option (SANE_Handle handle, SANE_Int option, SANE_Action action,
 	case opt_fuzzy_parameters:
 	case opt_non_blocking:
 	case opt_select_fd:
+	case opt_fast_path:
 	case opt_bool_soft_select_soft_detect:
 	case opt_bool_hard_select_soft_detect:
 	case opt_bool_soft_detect:
@@ -2534,6 +2673,9 @@ sane_control_option (SANE_Handle handle, SANE_Int option, SANE_Action action,
 	case opt_read_limit_size:
 	case opt_ppl_loss:
 	case opt_read_delay_duration:
+	case opt_adf_pages:
+	case opt_start_delay_duration:
+	case opt_kilobyte_duration:
 	case opt_int:
 	case opt_int_constraint_range:
 	case opt_int_constraint_word_list:
@@ -2772,7 +2914,8 @@ sane_start (SANE_Handle handle)
       DBG (3, "sane_start: scanning page %d\n", test_device->number_of_scans);
 
       if ((strcmp (test_device->val[opt_scan_source].s, "Automatic Document Feeder") == 0) &&
-	  (((test_device->number_of_scans) % 11) == 0))
+	  (((test_device->number_of_scans)
+	    % (test_device->val[opt_adf_pages].w + 1)) == 0))
 	{
 	  DBG (1, "sane_start: Document feeder is out of documents!\n");
 	  return SANE_STATUS_NO_DOCS;
@@ -2805,6 +2948,38 @@ sane_start (SANE_Handle handle)
       return SANE_STATUS_INVAL;
     }
 
+  if (test_device->val[opt_start_delay_duration].w > 0)
+    usleep (test_device->val[opt_start_delay_duration].w);
+  gettimeofday (&test_device->start_time, 0);
+
+  if (test_device->val[opt_fast_path].w == SANE_TRUE)
+    {
+      SANE_Status status;
+
+      /* the picture only depends on the options and the pass */
+      if (test_device->picture_buffer
+	  && test_device->picture_pass != test_device->pass)
+	free_picture_buffer (test_device);
+      if (!test_device->picture_buffer)
+	{
+	  status = init_picture_buffer (test_device,
+					&test_device->picture_buffer,
+					&test_device->picture_buffer_size);
+	  if (status != SANE_STATUS_GOOD)
+	    {
+	      test_device->picture_buffer = 0;
+	      test_device->scanning = SANE_FALSE;
+	      return status;
+	    }
+	  test_device->picture_pass = test_device->pass;
+	}
+      DBG (2, "sane_start: fast path, picture of %lu bytes\n",
+	   (u_long) test_device->picture_buffer_size);
+      test_device->pipe = -1;
+      test_device->reader_fds = -1;
+      return SANE_STATUS_GOOD;
+    }
+
   if (pipe (pipe_descriptor) < 0)
     {
       DBG (1, "sane_start: pipe failed (%s)\n", strerror (errno));
@@ -2929,7 +3104,25 @@ sane_read (SANE_Handle handle, SANE_Byte * data,
     }
   read_count = max_scan_length;
 
-  bytes_read = read (test_device->pipe, data, read_count);
+  if (test_device->val[opt_fast_path].w == SANE_TRUE)
+    {
+      /* the data is the picture buffer repeated, as in reader_process() */
+      size_t offset = test_device->bytes_total
+	% test_device->picture_buffer_size;
+
+      if (read_count > (size_t) (bytes_total - test_device->bytes_total))
+	read_count = bytes_total - test_device->bytes_total;
+      if (read_count > test_device->picture_buffer_size - offset)
+	read_count = test_device->picture_buffer_size - offset;
+      if (test_device->val[opt_read_delay].w == SANE_TRUE)
+	usleep (test_device->val[opt_read_delay_duration].w);
+      limit_bandwidth (test_device, &test_device->start_time,
+		       test_device->bytes_total + read_count);
+      memcpy (data, test_device->picture_buffer + offset, read_count);
+      bytes_read = read_count;
+    }
+  else
+    bytes_read = read (test_device->pipe, data, read_count);
   if (bytes_read == 0
       || (bytes_read + test_device->bytes_total >= bytes_total))
     {
@@ -3040,6 +3233,11 @@ sane_set_io_mode (SANE_Handle handle, SANE_Bool non_blocking)
       DBG (1, "sane_set_io_mode: not scanning\n");
       return SANE_STATUS_INVAL;
     }
+  if (test_device->val[opt_fast_path].w == SANE_TRUE)
+    {
+      /* data is always available */
+      return SANE_STATUS_GOOD;
+    }
   if (test_device->val[opt_non_blocking].w == SANE_TRUE)
     {
       if (fcntl (test_device->pipe,
@@ -3084,7 +3282,8 @@ sane_get_select_fd (SANE_Handle handle, SANE_Int * fd)
       DBG (1, "sane_get_select_fd: not scanning\n");
       return SANE_STATUS_INVAL;
     }
-  if (test_device->val[opt_select_fd].w == SANE_TRUE)
+  if (test_device->val[opt_select_fd].w == SANE_TRUE
+      && test_device->val[opt_fast_path].w == SANE_FALSE)
     {
       *fd = test_device->pipe;
       return SANE_STATUS_GOOD;
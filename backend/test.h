@@ -66,6 +66,7 @@ typedef enum
   opt_three_pass_order,
   opt_resolution,
   opt_scan_source,
+  opt_adf_pages,
   opt_special_group,
   opt_test_picture,
   opt_invert_endianess,
@@ -78,6 +79,9 @@ typedef enum
   opt_fuzzy_parameters,
   opt_non_blocking,
   opt_select_fd,
+  opt_fast_path,
+  opt_start_delay_duration,
+  opt_kilobyte_duration,
   opt_enable_test_options,
   opt_print_options,
   opt_geometry_group,
@@ -143,6 +147,10 @@ typedef struct Test_Device
   SANE_Bool eof;
   SANE_Bool options_initialized;
   SANE_Int number_of_scans;
+  SANE_Byte *picture_buffer;	/* cached picture for the fast path */
+  size_t picture_buffer_size;
+  SANE_Word picture_pass;
+  struct timeval start_time;	/* for the bandwidth limit */
 }
 Test_Device;
 
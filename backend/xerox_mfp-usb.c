@@ -45,6 +45,13 @@ usb_dev_request(struct device *dev,
     }
 
     if (resp && resplen) {
+        if (!cmd) {
+            /* image data: let sanei_usb pick the chunk size for this bus */
+            size_t chunk = sanei_usb_get_bulk_size(dev->dn, USB_DIR_IN,
+                                                   USB_BLOCK_SIZE, DATASIZE);
+            if (*resplen > chunk)
+                *resplen = chunk;
+        }
         status = sanei_usb_read_bulk(dev->dn, resp, resplen);
         if (status != SANE_STATUS_GOOD) {
             DBG(1, "%s: sanei_usb_read_bulk: %s\n", __func__,
@@ -93,70 +93,9 @@ static char *str_cmd(int cmd)
 }
 
 #define MAX_DUMP 70
-const char *encTmpFileName = "/tmp/stmp_enc.tmp";
 
-/*
- * Decode jpeg from `infilename` into dev->decData of dev->decDataSize size.
- */
-static int decompress(struct device __sane_unused__ *dev,
-                      const char __sane_unused__ *infilename)
-{
 #ifdef HAVE_LIBJPEG
-    int rc;
-    int row_stride, width, height, pixel_size;
-    struct jpeg_decompress_struct cinfo;
-    struct jpeg_error_mgr jerr;
-    unsigned long bmp_size = 0;
-    FILE *pInfile = NULL;
-    JSAMPARRAY buffer;
-
-    if ((pInfile = fopen(infilename, "rb")) == NULL) {
-        fprintf(stderr, "can't open %s\n", infilename);
-        return -1;
-    }
-
-    cinfo.err = jpeg_std_error(&jerr);
-
-    jpeg_create_decompress(&cinfo);
-
-    jpeg_stdio_src(&cinfo, pInfile);
-
-    rc = jpeg_read_header(&cinfo, TRUE);
-    if (rc != 1) {
-        jpeg_destroy_decompress(&cinfo);
-        fclose(pInfile);
-        return -1;
-    }
-
-    jpeg_start_decompress(&cinfo);
-
-    width = cinfo.output_width;
-    height = cinfo.output_height;
-    pixel_size = cinfo.output_components;
-    bmp_size = width * height * pixel_size;
-    assert(bmp_size <= POST_DATASIZE);
-    dev->decDataSize = bmp_size;
-
-    row_stride = width * pixel_size;
-
-    buffer = (*cinfo.mem->alloc_sarray)
-             ((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
-
-    while (cinfo.output_scanline < cinfo.output_height) {
-        buffer[0] = dev->decData + \
-                    (cinfo.output_scanline) * row_stride;
-        jpeg_read_scanlines(&cinfo, buffer, 1);
-    }
-    jpeg_finish_decompress(&cinfo);
-    jpeg_destroy_decompress(&cinfo);
-    fclose(pInfile);
-    return 0;
-#else
-    return -1;
-#endif
-}
-
-/* copy from decoded jpeg image (dev->decData) into user's buffer (pDest) */
+/* copy from decoded jpeg scanline (dev->decData) into user's buffer (pDest) */
 /* returns 0 if there is no data to copy */
 static int copy_decompress_data(struct device *dev, unsigned char *pDest, int maxlen, int *destLen)
 {
@@ -182,27 +121,260 @@ static int copy_decompress_data(struct device *dev, unsigned char *pDest, int ma
     return 1;
 }
 
-static int decompress_tempfile(struct device *dev)
+/*
+ * Incremental decoder for JPEG compressed color blocks. Each image block
+ * is a separate JPEG stream. Compressed data stays in the cyclic buffer
+ * until libjpeg runs out of input; then the source manager suspends it and
+ * the data received so far is fed in, so that no more input is taken than
+ * the output requested by the frontend needs. Only the not yet consumed
+ * input and one decoded scanline (dev->decData) are kept in memory.
+ */
+struct jpeg_decoder {
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    struct jpeg_source_mgr src;
+    int header;			/* jpeg_read_header() is done */
+    int started;		/* jpeg_start_decompress() is done */
+    int finished;		/* whole block is decoded */
+    int eob;			/* all data of the block is fed */
+    int starved;		/* libjpeg is suspended waiting for input */
+    int row_stride;		/* decoded scanline size */
+    int row_size;		/* allocated size of dev->decData */
+    SANE_Byte *in;		/* compressed data not consumed yet */
+    size_t inlen;
+    size_t insize;
+    long skip;			/* bytes to skip from next feed */
+};
+
+static void jdec_init_source(j_decompress_ptr __sane_unused__ cinfo)
+{
+}
+
+static boolean jdec_fill_input_buffer(j_decompress_ptr cinfo)
+{
+    static const JOCTET eoi[] = { 0xFF, JPEG_EOI };
+    struct jpeg_decoder *jd = (struct jpeg_decoder *)cinfo;
+
+    if (!jd->eob) {
+        jd->starved = 1;
+        return FALSE;	/* suspend until more data is fed */
+    }
+
+    /* block is truncated, terminate the image */
+    DBG(1, "%s: premature end of jpeg data\n", __func__);
+    cinfo->src->next_input_byte = eoi;
+    cinfo->src->bytes_in_buffer = sizeof(eoi);
+    return TRUE;
+}
+
+static void jdec_skip_input_data(j_decompress_ptr cinfo, long num_bytes)
+{
+    struct jpeg_decoder *jd = (struct jpeg_decoder *)cinfo;
+
+    if (num_bytes <= 0)
+        return;
+    if ((size_t)num_bytes > cinfo->src->bytes_in_buffer) {
+        /* rest is skipped when it arrives */
+        jd->skip += num_bytes - cinfo->src->bytes_in_buffer;
+        num_bytes = cinfo->src->bytes_in_buffer;
+    }
+    cinfo->src->next_input_byte += num_bytes;
+    cinfo->src->bytes_in_buffer -= num_bytes;
+}
+
+static void jdec_term_source(j_decompress_ptr __sane_unused__ cinfo)
+{
+}
+
+static int jdec_new(struct device *dev)
 {
-    decompress(dev, encTmpFileName);
-    remove(encTmpFileName);
+    struct jpeg_decoder *jd;
+
+    if (!(jd = calloc(1, sizeof(*jd))))
+        return -1;
+    jd->cinfo.err = jpeg_std_error(&jd->jerr);
+    jpeg_create_decompress(&jd->cinfo);
+    jd->src.init_source = jdec_init_source;
+    jd->src.fill_input_buffer = jdec_fill_input_buffer;
+    jd->src.skip_input_data = jdec_skip_input_data;
+    jd->src.resync_to_restart = jpeg_resync_to_restart;
+    jd->src.term_source = jdec_term_source;
+    jd->cinfo.src = &jd->src;
+    dev->jpeg = jd;
     return 0;
 }
 
-static int dump_to_tmp_file(struct device *dev)
+static void jdec_free(struct device *dev)
 {
-    unsigned char *pSrc = dev->data;
-    int srcLen = dev->datalen;
-    FILE *pInfile;
-    if ((pInfile = fopen(encTmpFileName, "a")) == NULL) {
-        fprintf(stderr, "can't open %s\n", encTmpFileName);
-        return 0;
+    struct jpeg_decoder *jd = dev->jpeg;
+
+    if (!jd)
+        return;
+    jpeg_destroy_decompress(&jd->cinfo);
+    free(jd->in);
+    free(jd);
+    dev->jpeg = NULL;
+}
+
+/* prepare decoder for next image block */
+static void jdec_reset(struct device *dev)
+{
+    struct jpeg_decoder *jd = dev->jpeg;
+
+    if (!jd)
+        return;
+    jpeg_abort_decompress(&jd->cinfo);
+    jd->header = jd->started = jd->finished = jd->eob = 0;
+    jd->starved = 1;
+    jd->inlen = 0;
+    jd->skip = 0;
+    jd->src.next_input_byte = jd->in;
+    jd->src.bytes_in_buffer = 0;
+    dev->decDataSize = 0;
+    dev->currentDecDataIndex = 0;
+}
+
+/* move all compressed data from cyclic buffer into decoder */
+/* returns length of data taken, -1 on error */
+static int jdec_feed(struct device *dev)
+{
+    struct jpeg_decoder *jd = dev->jpeg;
+    int off = dev->dataoff;
+    int len = dev->datalen;
+    int n;
+
+    jd->eob = !dev->blocklen;
+    if (jd->finished)
+        return dev->datalen;	/* padding after end of image */
+
+    /* keep only what libjpeg has not consumed yet */
+    if (jd->src.bytes_in_buffer && jd->src.next_input_byte != jd->in)
+        memmove(jd->in, jd->src.next_input_byte, jd->src.bytes_in_buffer);
+    jd->inlen = jd->src.bytes_in_buffer;
+
+    n = MIN(len, jd->skip);
+    jd->skip -= n;
+    off = (off + n) & DATAMASK;
+    len -= n;
+
+    if (jd->inlen + len > jd->insize) {
+        SANE_Byte *in = realloc(jd->in, jd->inlen + len);
+
+        if (!in)
+            return -1;
+        jd->in = in;
+        jd->insize = jd->inlen + len;
+    }
+    while (len) {
+        n = MIN(len, DATASIZE - off);
+        memcpy(jd->in + jd->inlen, dev->data + off, n);
+        jd->inlen += n;
+        off = (off + n) & DATAMASK;
+        len -= n;
+    }
+
+    jd->src.next_input_byte = jd->in;
+    jd->src.bytes_in_buffer = jd->inlen;
+    jd->starved = 0;
+    return dev->datalen;
+}
+
+/* decode as much as available input and user's buffer (pDest) allow */
+/* returns -1 on error */
+static int jdec_decode(struct device *dev, unsigned char *pDest, int maxlen, int *destLen)
+{
+    struct jpeg_decoder *jd = dev->jpeg;
+    j_decompress_ptr cinfo = &jd->cinfo;
+    int olen;
+
+    *destLen = 0;
+    for (;;) {
+        /* output rest of previously decoded scanline first */
+        copy_decompress_data(dev, pDest, maxlen, &olen);
+        pDest += olen;
+        maxlen -= olen;
+        *destLen += olen;
+        if (maxlen <= 0 || jd->finished)
+            return 0;
+
+        if (!jd->header) {
+            if (jpeg_read_header(cinfo, TRUE) == JPEG_SUSPENDED)
+                return 0;
+            jd->header = 1;
+        }
+
+        if (!jd->started) {
+            if (!jpeg_start_decompress(cinfo))
+                return 0;
+            jd->started = 1;
+            jd->row_stride = cinfo->output_width * cinfo->output_components;
+            if (jd->row_stride > jd->row_size) {
+                SANE_Byte *row = realloc(dev->decData, jd->row_stride);
+
+                if (!row)
+                    return -1;
+                dev->decData = row;
+                jd->row_size = jd->row_stride;
+            }
+        }
+
+        if (cinfo->output_scanline < cinfo->output_height) {
+            JSAMPROW row = dev->decData;
+
+            if (jpeg_read_scanlines(cinfo, &row, 1) != 1)
+                return 0;
+            dev->decDataSize = jd->row_stride;
+            dev->currentDecDataIndex = 0;
+        } else {
+            if (!jpeg_finish_decompress(cinfo))
+                return 0;
+            jd->finished = 1;
+        }
+    }
+}
+
+/* decode into pDest, feeding data from cyclic buffer only when libjpeg
+ * is waiting for it */
+/* returns length of data taken, -1 on error */
+static int jdec_read(struct device *dev, unsigned char *pDest, int maxlen, int *destLen)
+{
+    struct jpeg_decoder *jd = dev->jpeg;
+    int clrlen = 0;
+    int olen;
+
+    if (jdec_decode(dev, pDest, maxlen, destLen) < 0)
+        return -1;
+    if (*destLen < maxlen && (jd->starved || jd->finished)) {
+        clrlen = jdec_feed(dev);
+        if (clrlen < 0 ||
+            jdec_decode(dev, pDest + *destLen, maxlen - *destLen, &olen) < 0)
+            return -1;
+        *destLen += olen;
     }
+    return clrlen;
+}
+#else
+static int jdec_new(struct device __sane_unused__ *dev)
+{
+    return -1;
+}
+
+static void jdec_free(struct device __sane_unused__ *dev)
+{
+}
+
+static void jdec_reset(struct device __sane_unused__ *dev)
+{
+}
 
-    fwrite(pSrc, 1, srcLen, pInfile);
-    fclose(pInfile);
-    return srcLen;
+static int jdec_read(struct device __sane_unused__ *dev,
+                     unsigned char __sane_unused__ *pDest,
+                     int __sane_unused__ maxlen, int *destLen)
+{
+    *destLen = 0;
+    return -1;
 }
+#endif
 
 static int isSupportedDevice(struct device __sane_unused__ *dev)
 {
@@ -954,6 +1126,7 @@ dev_free(struct device *dev)
         free(dev->decData);
         dev->decData = NULL;
     }
+    jdec_free(dev);
     memset(dev, 0, sizeof(*dev));
     free(dev);
 }
@@ -1197,6 +1370,8 @@ static int dev_acquire(struct device *dev)
     dev->datalen = 0;
     dev->dataoff = 0;
 
+    jdec_reset(dev);
+
     return 1;
 }
 
@@ -1292,17 +1467,22 @@ sane_read(SANE_Handle h, SANE_Byte *buf, SANE_Int maxlen, SANE_Int *lenp)
     /* if there is no data to read or output from buffer */
     if (!dev->blocklen && dev->datalen <= PADDING_SIZE) {
 
-        /* copying uncompressed data */
+        /* decoding rest of the block, all its data is received */
         if (dev->composition == MODE_RGB24 &&
-            isSupportedDevice(dev) &&
-            dev->decDataSize > 0) {
+            isSupportedDevice(dev) && buf && lenp) {
             int diff = dev->total_img_size - dev->total_out_size;
             int bufLen = (diff < maxlen) ? diff : maxlen;
-            if (diff &&
-                copy_decompress_data(dev, buf, bufLen, lenp)) {
-		if (lenp)
-		    dev->total_out_size += *lenp;
-                return SANE_STATUS_GOOD;
+            if (diff) {
+                int clrlen = jdec_read(dev, buf, bufLen, lenp);
+
+                if (clrlen < 0)
+                    return ret_cancel(dev, SANE_STATUS_NO_MEM);
+                dev->datalen -= clrlen;
+                dev->dataoff = (dev->dataoff + clrlen) & DATAMASK;
+                if (*lenp) {
+                    dev->total_out_size += *lenp;
+                    return SANE_STATUS_GOOD;
+                }
             }
         }
 
@@ -1321,10 +1501,6 @@ sane_read(SANE_Handle h, SANE_Byte *buf, SANE_Int maxlen, SANE_Int *lenp)
                 /* this will never happen */
                 DBG(1, "image overflow %d bytes\n", dev->total_img_size - dev->total_out_size);
             }
-            if (isSupportedDevice(dev) &&
-                dev->composition == MODE_RGB24) {
-                remove(encTmpFileName);
-            }
             /* that's all */
             dev_stop(dev);
             return SANE_STATUS_EOF;
@@ -1377,12 +1553,10 @@ sane_read(SANE_Handle h, SANE_Byte *buf, SANE_Int maxlen, SANE_Int *lenp)
             /* copy will do minimal of valid data */
             if (dev->para.format == SANE_FRAME_RGB && dev->line_order) {
                 if (isSupportedDevice(dev)) {
-                    clrlen = dump_to_tmp_file(dev);
-                    /* decompress after reading entire block data*/
-                    if (0 == dev->blocklen) {
-                        decompress_tempfile(dev);
-                    }
-                    copy_decompress_data(dev, buf, maxlen, &olen);
+                    /* decode while the block is still arriving */
+                    clrlen = jdec_read(dev, buf, maxlen, &olen);
+                    if (clrlen < 0)
+                        return ret_cancel(dev, SANE_STATUS_NO_MEM);
                 } else {
                     clrlen = copy_mix_bands_trim(dev, buf, maxlen, &olen);
                 }
@@ -1391,6 +1565,9 @@ sane_read(SANE_Handle h, SANE_Byte *buf, SANE_Int maxlen, SANE_Int *lenp)
 
             dev->datalen -= clrlen;
             dev->dataoff = (dev->dataoff + clrlen) & DATAMASK;
+            /* buffer is empty, keep next request large */
+            if (!dev->datalen)
+                dev->dataoff = 0;
             buf += olen;
             maxlen -= olen;
             *lenp += olen;
@@ -1466,7 +1643,9 @@ sane_start(SANE_Handle h)
         return ret_cancel(dev, SANE_STATUS_NO_MEM);
 
     /* this is for jpeg mode only */
-    if (!dev->decData && !(dev->decData = malloc(POST_DATASIZE)))
+    if (isSupportedDevice(dev) &&
+        dev->composition == MODE_RGB24 &&
+        !dev->jpeg && jdec_new(dev))
         return ret_cancel(dev, SANE_STATUS_NO_MEM);
 
     if (!dev_acquire(dev))
@@ -1490,20 +1669,6 @@ sane_start(SANE_Handle h)
 
     dev->total_img_size = dev->para.bytes_per_line * dev->para.lines;
 
-    if (isSupportedDevice(dev) &&
-        dev->composition == MODE_RGB24) {
-	int fd;
-        remove(encTmpFileName);
-
-	/* Precreate temporary file in exclusive mode. */
-	fd = open(encTmpFileName, O_CREAT|O_EXCL, 0600);
-	if (fd == -1) {
-	    DBG(3, "%s: %p, can't create temporary file %s: %s\n", __func__,
-		(void *)dev, encTmpFileName, strerror(errno));
-	    return ret_cancel(dev, SANE_STATUS_ACCESS_DENIED);
-	}
-	close(fd);
-    }
     dev->currentDecDataIndex = 0;
 
     return SANE_STATUS_GOOD;
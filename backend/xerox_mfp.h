@@ -47,6 +47,7 @@ enum options {
 };
 
 typedef struct transport transport;
+struct jpeg_decoder;
 
 struct device {
     struct device *next;
@@ -74,10 +75,10 @@ struct device {
 #define DATATAIL(dev) ((dev->dataoff + dev->datalen) & DATAMASK)
 #define DATAROOM(dev) dataroom(dev)
 
-#define POST_DATASIZE 0xFFFFFF	/* 16777215 bytes */
-    SANE_Byte *decData;		/* static buffer of POST_DATASIZE bytes */
+    SANE_Byte *decData;		/* decoded jpeg scanline */
     int decDataSize;
     int currentDecDataIndex;
+    struct jpeg_decoder *jpeg;	/* incremental jpeg decoder of block */
     /* data from CMD_INQUIRY: */
     int resolutions;		/* supported resolution bitmask */
     int compositions;		/* supported image compositions bitmask */
@@ -221,13 +221,32 @@ static AvahiEntryGroup *avahi_group = NULL;
 # define PATH_MAX 1024
 #endif
 
+/* Pre-initialized workers need connection handover (SCM_RIGHTS) and a
+   message based control channel; without them every connection is
+   served by a freshly forked child. */
+#if defined(SCM_RIGHTS) && defined(SOCK_SEQPACKET)
+# define SANED_USES_WORKERS
+#endif
+
 struct saned_child {
   pid_t pid;
+  int ctl_fd;			/* control channel to the child, or -1 */
+  int idle;			/* pre-initialized worker waiting for a client */
+  time_t started;		/* when the child was spawned */
   struct saned_child *next;
 };
 struct saned_child *children;
 int numchildren;
 
+/* devices opened by the children, see broker_request() */
+struct saned_device_owner {
+  char *name;
+  pid_t pid;
+  int count;			/* number of handles the owner has open */
+  struct saned_device_owner *next;
+};
+static struct saned_device_owner *device_owners;
+
 #define SANED_CONFIG_FILE "saned.conf"
 #define SANED_PID_FILE    "/var/run/saned.pid"
 
@@ -241,6 +260,7 @@ typedef struct
   u_int scanning:1;		/* are we scanning? */
   u_int docancel:1;		/* cancel the current scan */
   SANE_Handle handle;		/* backends handle */
+  char *device;			/* device name locked with the broker */
 }
 Handle;
 
@@ -254,6 +274,13 @@ static int run_mode;
 static int run_foreground;
 static int run_once;
 static int data_connect_timeout = 4000;
+static int standby_workers;	/* number of pre-initialized workers */
+static int standby_timeout = 300;	/* seconds before an idle worker is
+					   replaced by a fresh one */
+static time_t last_client_time;	/* when the last client was accepted */
+static int broker_fd = -1;	/* control channel to the parent */
+static int backend_ready;	/* sane_init() has been done in advance */
+static SANE_Word backend_version_code;
 static Handle *handle;
 static char *bind_addr;
 static short bind_port = -1;
@@ -488,6 +515,60 @@ quit (int signum)
   exit (EXIT_SUCCESS);		/* This is a nowait-daemon. */
 }
 
+/* Ask the parent for the use of a device.  Returns SANE_FALSE if a
+   client served by another child has it open. */
+static SANE_Bool
+broker_lock (const char *name)
+{
+#ifdef SANED_USES_WORKERS
+  char msg[PATH_MAX];
+  char reply;
+  int len;
+
+  if (broker_fd < 0)
+    return SANE_TRUE;
+
+  len = snprintf (msg, sizeof (msg), "L%s", name);
+  if (len >= (int) sizeof (msg))
+    len = sizeof (msg) - 1;
+
+  if (send (broker_fd, msg, len, 0) != len
+      || recv (broker_fd, &reply, 1, 0) != 1)
+    {
+      DBG (DBG_WARN, "broker_lock: no reply from parent: %s\n",
+	   strerror (errno));
+      return SANE_TRUE;
+    }
+
+  return (reply == '1') ? SANE_TRUE : SANE_FALSE;
+#else
+  (void) name;
+  return SANE_TRUE;
+#endif /* SANED_USES_WORKERS */
+}
+
+static void
+broker_unlock (const char *name)
+{
+#ifdef SANED_USES_WORKERS
+  char msg[PATH_MAX];
+  int len;
+
+  if (broker_fd < 0)
+    return;
+
+  len = snprintf (msg, sizeof (msg), "U%s", name);
+  if (len >= (int) sizeof (msg))
+    len = sizeof (msg) - 1;
+
+  if (send (broker_fd, msg, len, 0) != len)
+    DBG (DBG_WARN, "broker_unlock: failed to notify parent: %s\n",
+	 strerror (errno));
+#else
+  (void) name;
+#endif /* SANED_USES_WORKERS */
+}
+
 static SANE_Word
 get_free_handle (void)
 {
@@ -535,6 +616,12 @@ close_handle (int h)
     {
       sane_close (handle[h].handle);
       handle[h].inuse = 0;
+      if (handle[h].device)
+	{
+	  broker_unlock (handle[h].device);
+	  free (handle[h].device);
+	  handle[h].device = NULL;
+	}
     }
 }
 
@@ -1393,10 +1480,18 @@ init (Wire * w)
 
   if (status == SANE_STATUS_GOOD)
     {
-      status = sane_init (&be_version_code, auth_callback);
-      if (status != SANE_STATUS_GOOD)
-	DBG (DBG_ERR, "init: failed to initialize backend (%s)\n",
-	     sane_strstatus (status));
+      if (backend_ready)
+	{
+	  /* pre-initialized worker */
+	  be_version_code = backend_version_code;
+	}
+      else
+	{
+	  status = sane_init (&be_version_code, auth_callback);
+	  if (status != SANE_STATUS_GOOD)
+	    DBG (DBG_ERR, "init: failed to initialize backend (%s)\n",
+		 sane_strstatus (status));
+	}
 
       if (SANE_VERSION_MAJOR (be_version_code) != V_MAJOR)
 	{
@@ -1652,9 +1747,10 @@ static void
 do_scan (Wire * w, int h, int data_fd)
 {
   int num_fds, be_fd = -1, reader, writer, bytes_in_buf, status_dirty = 0;
+  int want_read, idle_reads = 0;
   SANE_Handle be_handle = handle[h].handle;
-  struct timeval tv, *timeout = 0;
-  fd_set rd_set, rd_mask, wr_set, wr_mask;
+  struct timeval tv, *timeout;
+  fd_set rd_set, rd_mask, wr_set;
   SANE_Byte buf[8192];
   SANE_Status status;
   long int nwritten;
@@ -1667,30 +1763,48 @@ do_scan (Wire * w, int h, int data_fd)
   FD_SET (w->io.fd, &rd_mask);
   num_fds = w->io.fd + 1;
 
-  FD_ZERO (&wr_mask);
-  FD_SET (data_fd, &wr_mask);
   if (data_fd >= num_fds)
     num_fds = data_fd + 1;
 
   sane_set_io_mode (be_handle, SANE_TRUE);
   if (sane_get_select_fd (be_handle, &be_fd) == SANE_STATUS_GOOD)
     {
-      FD_SET (be_fd, &rd_mask);
       if (be_fd >= num_fds)
 	num_fds = be_fd + 1;
     }
   else
-    {
-      memset (&tv, 0, sizeof (tv));
-      timeout = &tv;
-    }
+    be_fd = -1;
 
   status = SANE_STATUS_GOOD;
   reader = writer = bytes_in_buf = 0;
   do
     {
       rd_set = rd_mask;
-      wr_set = wr_mask;
+
+      /* The data connection is almost always writable, so only watch it
+	 while there is something to send, otherwise select returns
+	 immediately. */
+      FD_ZERO (&wr_set);
+      if (bytes_in_buf > 0)
+	FD_SET (data_fd, &wr_set);
+
+      /* Only wait for the backend when the buffer is empty and there is
+	 something left to read.  Otherwise sleep until the client can
+	 take more data or sends a request: watching a readable select fd
+	 (or using a zero timeout) while the client is slow would spin. */
+      want_read = (status == SANE_STATUS_GOOD && bytes_in_buf == 0);
+      timeout = 0;
+      if (want_read && be_fd >= 0)
+	FD_SET (be_fd, &rd_set);
+      else if (want_read)
+	{
+	  /* No select fd: poll the backend, backing off while a
+	     non-blocking backend has no data for us (up to 64 ms). */
+	  tv.tv_sec = 0;
+	  tv.tv_usec = idle_reads ? 1000L << (idle_reads - 1) : 0;
+	  timeout = &tv;
+	}
+
       if (select (num_fds, &rd_set, &wr_set, 0, timeout) < 0)
 	{
 	  if (be_fd >= 0 && errno == EBADF)
@@ -1698,14 +1812,18 @@ do_scan (Wire * w, int h, int data_fd)
 	      /* This normally happens when a backend closes a select
 		 filedescriptor when reaching the end of file.  So
 		 pass back this status to the client: */
-	      FD_CLR (be_fd, &rd_mask);
 	      be_fd = -1;
 	      /* only set status_dirty if EOF hasn't been already detected */
 	      if (status == SANE_STATUS_GOOD)
 		status_dirty = 1;
 	      status = SANE_STATUS_EOF;
 	      DBG (DBG_INFO, "do_scan: select_fd was closed --> EOF\n");
-	      continue;
+	      /* The fd sets are undefined after a failed select.  Nothing
+		 is watched on the next pass while the buffer is empty, so
+		 queue the status record below right away. */
+	      FD_ZERO (&rd_set);
+	      FD_ZERO (&wr_set);
+	      want_read = 0;
 	    }
 	  else
 	    {
@@ -1746,8 +1864,7 @@ do_scan (Wire * w, int h, int data_fd)
 		}
 	    }
 	}
-      else if (status == SANE_STATUS_GOOD
-	       && (timeout || FD_ISSET (be_fd, &rd_set)))
+      else if (want_read && (be_fd < 0 || FD_ISSET (be_fd, &rd_set)))
 	{
 	  int i;
 
@@ -1772,6 +1889,14 @@ do_scan (Wire * w, int h, int data_fd)
 
 	  reset_watchdog ();
 
+	  if (status == SANE_STATUS_GOOD && length == 0)
+	    {
+	      if (idle_reads < 7)
+		idle_reads++;
+	    }
+	  else
+	    idle_reads = 0;
+
 	  reader += length;
 	  if (reader >= (int) sizeof (buf))
 	    reader = 0;
@@ -1859,6 +1984,7 @@ process_request (Wire * w)
 	SANE_Open_Reply reply;
 	SANE_Handle be_handle;
 	SANE_String name, resource;
+	char *device;
 
 	sanei_w_string (w, &name);
 	if (w->status)
@@ -1910,6 +2036,8 @@ process_request (Wire * w)
 	  resource = strdup (device_list[0]->name);
 	}
 
+	device = strdup (resource);
+
 	if (strchr (resource, ':'))
 	  *(strchr (resource, ':')) = 0;
 
@@ -1922,6 +2050,14 @@ process_request (Wire * w)
 	    memset (&reply, 0, sizeof (reply));	/* avoid leaking bits */
 	    reply.status = SANE_STATUS_ACCESS_DENIED;
 	  }
+	else if (!broker_lock (device))
+	  {
+	    DBG (DBG_MSG, "process_request: device `%s' is in use by another "
+		 "client\n", device);
+	    free (resource);
+	    memset (&reply, 0, sizeof (reply));	/* avoid leaking bits */
+	    reply.status = SANE_STATUS_DEVICE_BUSY;
+	  }
 	else
 	  {
 	    DBG (DBG_MSG, "process_request: access to resource `%s' granted\n",
@@ -1931,20 +2067,31 @@ process_request (Wire * w)
 	    reply.status = sane_open (name, &be_handle);
 	    DBG (DBG_MSG, "process_request: sane_open returned: %s\n",
 		 sane_strstatus (reply.status));
+	    if (reply.status != SANE_STATUS_GOOD)
+	      broker_unlock (device);
 	  }
 
 	if (reply.status == SANE_STATUS_GOOD)
 	  {
 	    h = get_free_handle ();
 	    if (h < 0)
-	      reply.status = SANE_STATUS_NO_MEM;
+	      {
+		sane_close (be_handle);
+		broker_unlock (device);
+		reply.status = SANE_STATUS_NO_MEM;
+	      }
 	    else
 	      {
 		handle[h].handle = be_handle;
+		handle[h].device = device;
+		device = NULL;
 		reply.handle = h;
 	      }
 	  }
 
+	if (device)
+	  free (device);
+
 	can_authorize = 0;
 
 	sanei_w_reply (w, (WireCodecFunc) sanei_w_open_reply, &reply);
@@ -2275,6 +2422,27 @@ process_request (Wire * w)
 }
 
 
+/* forget the devices a child had open */
+static void
+release_devices (pid_t pid)
+{
+  struct saned_device_owner *o, **po;
+
+  for (po = &device_owners; (o = *po) != NULL; )
+    {
+      if (o->pid == pid)
+	{
+	  DBG (DBG_DBG, "release_devices: %s released by %d\n", o->name,
+	       (int) pid);
+	  *po = o->next;
+	  free (o->name);
+	  free (o);
+	}
+      else
+	po = &o->next;
+    }
+}
+
 static int
 wait_child (pid_t pid, int *status, int options)
 {
@@ -2296,7 +2464,7 @@ wait_child (pid_t pid, int *status, int options)
     }
 #endif /* WITH_AVAHI */
 
-  for (c = children; (c != NULL) && (c->next != NULL); p = c, c = c->next)
+  for (c = children; c != NULL; p = c, c = c->next)
     {
       if (c->pid == ret)
 	{
@@ -2305,6 +2473,10 @@ wait_child (pid_t pid, int *status, int options)
 	  else if (p != NULL)
 	    p->next = c->next;
 
+	  if (c->ctl_fd >= 0)
+	    close (c->ctl_fd);
+	  release_devices (c->pid);
+
 	  free(c);
 
 	  numchildren--;
@@ -2317,7 +2489,7 @@ wait_child (pid_t pid, int *status, int options)
 }
 
 static int
-add_child (pid_t pid)
+add_child (pid_t pid, int ctl_fd, int idle)
 {
   struct saned_child *c;
 
@@ -2330,13 +2502,208 @@ add_child (pid_t pid)
     }
 
   c->pid = pid;
+  c->ctl_fd = ctl_fd;
+  c->idle = idle;
+  c->started = time (NULL);
   c->next = children;
 
   children = c;
+  numchildren++;
 
   return 0;
 }
 
+/* Common setup of a freshly forked child: drop what belongs to the
+   parent. */
+static void
+child_setup (void)
+{
+  struct saned_child *c;
+  struct saned_device_owner *o;
+
+  if (log_to_syslog)
+    {
+      closelog ();
+      openlog ("saned", LOG_PID | LOG_CONS, LOG_DAEMON);
+    }
+
+  /* the parent's signal handlers wait for its children */
+  signal (SIGINT, NULL);
+  signal (SIGTERM, NULL);
+
+  while (children)
+    {
+      c = children;
+      children = c->next;
+      if (c->ctl_fd >= 0)
+	close (c->ctl_fd);
+      free (c);
+    }
+  numchildren = 0;
+
+  while (device_owners)
+    {
+      o = device_owners;
+      device_owners = o->next;
+      free (o->name);
+      free (o);
+    }
+}
+
+#ifdef SANED_USES_WORKERS
+/* hand a client connection over to a worker */
+static int
+send_fd (int sock, int fd)
+{
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE (sizeof (int))];
+  } control;
+  char c = 'C';
+
+  memset (&msg, 0, sizeof (msg));
+  memset (&control, 0, sizeof (control));
+
+  iov.iov_base = &c;
+  iov.iov_len = 1;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof (control.buf);
+
+  cmsg = CMSG_FIRSTHDR (&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN (sizeof (int));
+  memcpy (CMSG_DATA (cmsg), &fd, sizeof (int));
+
+  return (sendmsg (sock, &msg, 0) == 1) ? 0 : -1;
+}
+
+/* wait for a client connection from the parent, returns -1 when the
+   parent has closed the channel */
+static int
+recv_fd (int sock)
+{
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  union
+  {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE (sizeof (int))];
+  } control;
+  char c;
+  int fd = -1;
+  ssize_t n;
+
+  memset (&msg, 0, sizeof (msg));
+
+  iov.iov_base = &c;
+  iov.iov_len = 1;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof (control.buf);
+
+  do
+    n = recvmsg (sock, &msg, 0);
+  while (n < 0 && errno == EINTR);
+
+  if (n <= 0)
+    return -1;
+
+  cmsg = CMSG_FIRSTHDR (&msg);
+  if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+    memcpy (&fd, CMSG_DATA (cmsg), sizeof (int));
+
+  return fd;
+}
+
+/* Serve a lock request of a child.  A device can only be used by one
+   child at a time; a child may open it several times. */
+static void
+broker_request (struct saned_child *c)
+{
+  struct saned_device_owner *o;
+  char msg[PATH_MAX + 1];
+  char reply;
+  ssize_t n;
+
+  n = recv (c->ctl_fd, msg, sizeof (msg) - 1, MSG_DONTWAIT);
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+    {
+      /* child is gone, wait_child() will clean up */
+      close (c->ctl_fd);
+      c->ctl_fd = -1;
+      release_devices (c->pid);
+      return;
+    }
+  if (n < 2)
+    return;
+  msg[n] = '\0';
+
+  for (o = device_owners; o != NULL; o = o->next)
+    if (strcmp (o->name, msg + 1) == 0)
+      break;
+
+  if (msg[0] == 'L')
+    {
+      if (o == NULL)
+	{
+	  o = malloc (sizeof (*o));
+	  if (o && !(o->name = strdup (msg + 1)))
+	    {
+	      free (o);
+	      o = NULL;
+	    }
+	  if (o)
+	    {
+	      o->pid = c->pid;
+	      o->count = 0;
+	      o->next = device_owners;
+	      device_owners = o;
+	    }
+	}
+
+      if (o == NULL || o->pid == c->pid)
+	{
+	  if (o)
+	    o->count++;
+	  reply = '1';
+	}
+      else
+	reply = '0';
+
+      DBG (DBG_DBG, "broker_request: %s %s to %d\n", msg + 1,
+	   (reply == '1') ? "granted" : "denied", (int) c->pid);
+
+      if (send (c->ctl_fd, &reply, 1, 0) != 1)
+	DBG (DBG_WARN, "broker_request: failed to reply: %s\n",
+	     strerror (errno));
+    }
+  else if (msg[0] == 'U' && o != NULL && o->pid == c->pid)
+    {
+      if (--o->count <= 0)
+	{
+	  struct saned_device_owner **po;
+
+	  for (po = &device_owners; *po != o; po = &(*po)->next)
+	    ;
+	  *po = o->next;
+	  DBG (DBG_DBG, "broker_request: %s released by %d\n", o->name,
+	       (int) c->pid);
+	  free (o->name);
+	  free (o);
+	}
+    }
+}
+#endif /* SANED_USES_WORKERS */
+
 
 static void
 handle_connection (int fd)
@@ -2386,26 +2753,191 @@ handle_connection (int fd)
     }
 }
 
+#ifdef SANED_USES_WORKERS
+/* Pre-initialized worker: load and initialize the backends, then wait
+   for the parent to hand over a client connection. */
+static void
+run_worker (int ctl_fd)
+{
+  const SANE_Device **device_list;
+  SANE_Status status;
+  int fd;
+
+  broker_fd = ctl_fd;
+
+  status = sane_init (&backend_version_code, auth_callback);
+  if (status == SANE_STATUS_GOOD)
+    {
+      backend_ready = 1;
+      /* let the backends find their devices now, not when a client asks */
+      sane_get_devices (&device_list, SANE_TRUE);
+    }
+  else
+    DBG (DBG_ERR, "run_worker: failed to initialize backend (%s)\n",
+	 sane_strstatus (status));
+
+  DBG (DBG_DBG, "run_worker: waiting for a client connection\n");
+
+  fd = recv_fd (ctl_fd);
+  if (fd < 0)
+    {
+      DBG (DBG_DBG, "run_worker: retired\n");
+      if (backend_ready)
+	sane_exit ();
+      exit (EXIT_SUCCESS);
+    }
+
+  handle_connection (fd);
+  quit (0);
+}
+
+/* fork a pre-initialized worker */
+static void
+spawn_worker (struct pollfd *fds, int nfds)
+{
+  int sv[2];
+  pid_t pid;
+  int i;
+
+  if (socketpair (AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0)
+    {
+      DBG (DBG_ERR, "spawn_worker: socketpair() failed: %s\n",
+	   strerror (errno));
+      standby_workers = 0;
+      return;
+    }
+
+  pid = fork ();
+  if (pid == 0)
+    {
+      /* child */
+      close (sv[0]);
+      for (i = 0; i < nfds; i++)
+	close (fds[i].fd);
+
+      child_setup ();
+      run_worker (sv[1]);
+      /* NOT REACHED */
+    }
+
+  close (sv[1]);
+
+  if (pid < 0)
+    {
+      DBG (DBG_ERR, "spawn_worker: fork() failed: %s\n", strerror (errno));
+      close (sv[0]);
+      return;
+    }
+
+  if (add_child (pid, sv[0], 1) < 0)
+    close (sv[0]);
+}
+
+/* seconds after accepting a client before a new standby worker is
+   started, so it does not probe the devices while the client opens one */
+#define STANDBY_RESPAWN_DELAY 10
+
+/* Keep standby_workers idle workers around; idle workers that are older
+   than standby_timeout are replaced, so they don't serve stale device
+   lists.  A new worker searches for devices right away, which may
+   disturb a scan in progress, so none is started while a client holds
+   a device or has just connected. */
+static void
+maintain_workers (struct pollfd *fds, int nfds)
+{
+  struct saned_child *c;
+  time_t now = time (NULL);
+  int idle = 0;
+
+  for (c = children; c != NULL; c = c->next)
+    {
+      if (!c->idle || c->ctl_fd < 0)
+	continue;
+
+      if (standby_timeout > 0 && now - c->started > standby_timeout)
+	{
+	  DBG (DBG_DBG, "maintain_workers: retiring worker %d\n",
+	       (int) c->pid);
+	  close (c->ctl_fd);
+	  c->ctl_fd = -1;
+	  c->idle = 0;
+	}
+      else
+	idle++;
+    }
+
+  if (idle >= standby_workers)
+    return;
+
+  if (device_owners != NULL || now - last_client_time < STANDBY_RESPAWN_DELAY)
+    return;
+
+  while (idle++ < standby_workers)
+    spawn_worker (fds, nfds);
+}
+
+/* Hand a connection over to an idle worker.  Returns -1 if there is none. */
+static int
+dispatch_to_worker (int fd)
+{
+  struct saned_child *c;
+
+  for (c = children; c != NULL; c = c->next)
+    {
+      if (!c->idle || c->ctl_fd < 0)
+	continue;
+
+      c->idle = 0;
+      if (send_fd (c->ctl_fd, fd) < 0)
+	{
+	  DBG (DBG_ERR, "dispatch_to_worker: handover to %d failed: %s\n",
+	       (int) c->pid, strerror (errno));
+	  close (c->ctl_fd);
+	  c->ctl_fd = -1;
+	  continue;
+	}
+
+      DBG (DBG_DBG, "dispatch_to_worker: connection handed to %d\n",
+	   (int) c->pid);
+      close (fd);
+      return 0;
+    }
+
+  return -1;
+}
+#endif /* SANED_USES_WORKERS */
+
 static void
 handle_client (int fd)
 {
   pid_t pid;
   int i;
+  int sv[2] = { -1, -1 };
 
   DBG (DBG_DBG, "handle_client: spawning child process\n");
 
+#ifdef SANED_USES_WORKERS
+  /* control channel for the device broker */
+  if (socketpair (AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0)
+    {
+      DBG (DBG_WARN, "handle_client: socketpair() failed: %s\n",
+	   strerror (errno));
+      sv[0] = sv[1] = -1;
+    }
+#endif /* SANED_USES_WORKERS */
+
   pid = fork ();
   if (pid == 0)
     {
       /* child */
-      if (log_to_syslog)
-	closelog();
-
       for (i = 3; i < fd; i++)
-	close(i);
+	if (i != sv[1])
+	  close(i);
+      if (sv[0] >= 0)
+	close (sv[0]);
 
-      if (log_to_syslog)
-	openlog ("saned", LOG_PID | LOG_CONS, LOG_DAEMON);
+      child_setup ();
+      broker_fd = sv[1];
 
       handle_connection (fd);
       quit (0);
@@ -2413,13 +2945,21 @@ handle_client (int fd)
   else if (pid > 0)
     {
       /* parent */
-      add_child (pid);
+      if (sv[1] >= 0)
+	close (sv[1]);
+      if (add_child (pid, sv[0], 0) < 0 && sv[0] >= 0)
+	close (sv[0]);
       close(fd);
     }
   else
     {
       /* FAILED */
       DBG (DBG_ERR, "handle_client: fork() failed: %s\n", strerror (errno));
+      if (sv[0] >= 0)
+	{
+	  close (sv[0]);
+	  close (sv[1]);
+	}
       close(fd);
     }
 }
@@ -2427,6 +2967,8 @@ handle_client (int fd)
 static void
 bail_out (int error)
 {
+  struct saned_child *c;
+
   DBG (DBG_ERR, "%sbailing out, waiting for children...\n", (error) ? "FATAL ERROR; " : "");
 
 #if WITH_AVAHI
@@ -2434,8 +2976,17 @@ bail_out (int error)
     kill (avahi_pid, SIGTERM);
 #endif /* WITH_AVAHI */
 
+  /* idle workers exit when their control channel is closed */
+  for (c = children; c != NULL; c = c->next)
+    if (c->idle && c->ctl_fd >= 0)
+      {
+	close (c->ctl_fd);
+	c->ctl_fd = -1;
+      }
+
   while (numchildren > 0)
-    wait_child (-1, NULL, 0);
+    if (wait_child (-1, NULL, 0) < 0 && errno == ECHILD)
+      break;
 
   DBG (DBG_ERR, "bail_out: all children exited\n");
 
@@ -2821,6 +3372,46 @@ read_config (void)
                 DBG (DBG_INFO, "read_config: data connect timeout: %d\n", data_connect_timeout);
               }
             }
+            else if(strstr(config_line, "standby_workers") != NULL)
+            {
+              optval = sanei_config_skip_whitespace (++optval);
+              if ((optval != NULL) && (*optval != '\0'))
+              {
+                val = strtol (optval, &endval, 10);
+                if (optval == endval)
+                {
+                  DBG (DBG_ERR, "read_config: invalid value for standby_workers\n");
+                  continue;
+                }
+                else if ((val < 0) || (val > 64))
+                {
+                  DBG (DBG_ERR, "read_config: standby_workers is invalid\n");
+                  continue;
+                }
+                standby_workers = val;
+                DBG (DBG_INFO, "read_config: standby workers: %d\n", standby_workers);
+              }
+            }
+            else if(strstr(config_line, "standby_timeout") != NULL)
+            {
+              optval = sanei_config_skip_whitespace (++optval);
+              if ((optval != NULL) && (*optval != '\0'))
+              {
+                val = strtol (optval, &endval, 10);
+                if (optval == endval)
+                {
+                  DBG (DBG_ERR, "read_config: invalid value for standby_timeout\n");
+                  continue;
+                }
+                else if ((val < 0) || (val > 86400))
+                {
+                  DBG (DBG_ERR, "read_config: standby_timeout is invalid\n");
+                  continue;
+                }
+                standby_timeout = val;
+                DBG (DBG_INFO, "read_config: standby timeout: %d\n", standby_timeout);
+              }
+            }
         }
       fclose (fp);
       DBG (DBG_INFO, "read_config: done reading config\n");
@@ -3191,7 +3782,11 @@ run_standalone (char *user)
 {
   struct pollfd *fds = NULL;
   struct pollfd *fdp = NULL;
+  struct pollfd *pollfds = NULL;
+  struct saned_child *c;
   int nfds;
+  int npollfds;
+  int pollfds_size = 0;
   int fd = -1;
   int i;
   int ret;
@@ -3258,11 +3853,56 @@ run_standalone (char *user)
   /* NOT REACHED (Avahi process) */
 #endif /* WITH_AVAHI */
 
+#ifdef SANED_USES_WORKERS
+  if (run_once == SANE_TRUE)
+    standby_workers = 0;
+#else
+  if (standby_workers > 0)
+    {
+      DBG (DBG_WARN, "run_standalone: standby workers are not supported on this platform\n");
+      standby_workers = 0;
+    }
+#endif /* SANED_USES_WORKERS */
+
   DBG (DBG_MSG, "run_standalone: waiting for control connection\n");
 
   while (1)
     {
-      ret = poll (fds, nfds, 500);
+#ifdef SANED_USES_WORKERS
+      maintain_workers (fds, nfds);
+#endif /* SANED_USES_WORKERS */
+
+      /* poll the listening sockets and the control channels of the children */
+      npollfds = nfds;
+      for (c = children; c != NULL; c = c->next)
+	if (c->ctl_fd >= 0)
+	  npollfds++;
+
+      if (npollfds > pollfds_size)
+	{
+	  fdp = realloc (pollfds, npollfds * sizeof (struct pollfd));
+	  if (fdp == NULL)
+	    {
+	      DBG (DBG_ERR, "run_standalone: out of memory\n");
+	      free (pollfds);
+	      free (fds);
+	      bail_out (1);
+	    }
+	  pollfds = fdp;
+	  pollfds_size = npollfds;
+	}
+
+      memcpy (pollfds, fds, nfds * sizeof (struct pollfd));
+      for (c = children, fdp = pollfds + nfds; c != NULL; c = c->next)
+	if (c->ctl_fd >= 0)
+	  {
+	    fdp->fd = c->ctl_fd;
+	    fdp->events = POLLIN;
+	    fdp->revents = 0;
+	    fdp++;
+	  }
+
+      ret = poll (pollfds, npollfds, 500);
       if (ret < 0)
 	{
 	  if (errno == EINTR)
@@ -3270,11 +3910,15 @@ run_standalone (char *user)
 	  else
 	    {
 	      DBG (DBG_ERR, "run_standalone: poll failed: %s\n", strerror (errno));
+	      free (pollfds);
 	      free (fds);
 	      bail_out (1);
 	    }
 	}
 
+      for (i = 0; i < nfds; i++)
+	fds[i].revents = pollfds[i].revents;
+
       /* Wait for children */
       while (wait_child (-1, NULL, WNOHANG) > 0)
 	;
@@ -3282,6 +3926,22 @@ run_standalone (char *user)
       if (ret == 0)
 	continue;
 
+#ifdef SANED_USES_WORKERS
+      /* device broker requests */
+      for (i = nfds, fdp = pollfds + nfds; i < npollfds; i++, fdp++)
+	{
+	  if (!fdp->revents)
+	    continue;
+
+	  for (c = children; c != NULL; c = c->next)
+	    if (c->ctl_fd == fdp->fd)
+	      {
+		broker_request (c);
+		break;
+	      }
+	}
+#endif /* SANED_USES_WORKERS */
+
       for (i = 0, fdp = fds; i < nfds; i++, fdp++)
 	{
 	  /* Error on an fd */
@@ -3309,6 +3969,12 @@ run_standalone (char *user)
 	      continue;
 	    }
 
+#ifdef SANED_USES_WORKERS
+	  last_client_time = time (NULL);
+	  if (dispatch_to_worker (fd) == 0)
+	    continue;
+#endif /* SANED_USES_WORKERS */
+
 	  handle_client (fd);
 
 	  if (run_once == SANE_TRUE)
@@ -3323,6 +3989,7 @@ run_standalone (char *user)
     close (fdp->fd);
 
   free (fds);
+  free (pollfds);
 }
 
 
@@ -55,6 +55,7 @@
 
 #include "../include/sane/sane.h"
 #include "../include/sane/sanei.h"
+#include "../include/sane/sanei_frame.h"
 #include "../include/sane/saneopts.h"
 
 #include "sicc.h"
@@ -1331,6 +1332,7 @@ static SANE_Status
 scan_it (FILE *ofp)
 {
   int i, len, first_frame = 1, offset = 0, must_buffer = 0;
+  int passthrough = 0;
   uint64_t hundred_percent = 0;
   SANE_Byte min = 0xff, max = 0;
   SANE_Parameters parm;
@@ -1400,12 +1402,26 @@ scan_it (FILE *ofp)
 	    }
 
 	  fprintf (stderr, "%s: acquiring %s frame\n", prog_name,
-	   parm.format <= SANE_FRAME_BLUE ? format_name[parm.format]:"Unknown");
+	   parm.format <= SANE_FRAME_BLUE ? format_name[parm.format] :
+	   parm.format == SANE_FRAME_JPEG ? "JPEG" : "Unknown");
 	}
 
       if (first_frame)
 	{
           image.num_channels = 1;
+	  if (parm.format == SANE_FRAME_JPEG)
+	    {
+	      /* the backend delivers a complete JPEG file, it is written
+		 out as is without decoding and re-encoding it */
+	      if (output_format != OUTPUT_JPEG)
+		{
+		  fprintf (stderr, "%s: the backend delivers JPEG data, which "
+			   "can only be written with --format=jpeg\n",
+			   prog_name);
+		  return SANE_STATUS_INVAL;
+		}
+	      passthrough = 1;
+	    }
 	  switch (parm.format)
 	    {
 	    case SANE_FRAME_RED:
@@ -1465,7 +1481,7 @@ scan_it (FILE *ofp)
 	    pngbuf = malloc(parm.bytes_per_line);
 #endif
 #ifdef HAVE_LIBJPEG
-	  if(output_format == OUTPUT_JPEG)
+	  if(output_format == OUTPUT_JPEG && !passthrough)
 	    jpegbuf = malloc(parm.bytes_per_line);
 #endif
 
@@ -1503,7 +1519,8 @@ scan_it (FILE *ofp)
 	  image.x = image.y = 0;
 	}
       hundred_percent = ((uint64_t)parm.bytes_per_line) * parm.lines
-	* ((parm.format == SANE_FRAME_RGB || parm.format == SANE_FRAME_GRAY) ? 1:3);
+	* ((parm.format == SANE_FRAME_RGB || parm.format == SANE_FRAME_GRAY
+	    || passthrough) ? 1:3);
 
       while (1)
 	{
@@ -1589,6 +1606,9 @@ scan_it (FILE *ofp)
 	    }
 	  else			/* ! must_buffer */
 	    {
+	      if (passthrough)
+		fwrite (buffer, 1, len, ofp);
+	      else
 #ifdef HAVE_LIBPNG
 	      if (output_format == OUTPUT_PNG)
 	        {
@@ -1760,7 +1780,7 @@ scan_it (FILE *ofp)
 	png_write_end(png_ptr, info_ptr);
 #endif
 #ifdef HAVE_LIBJPEG
-    if(output_format == OUTPUT_JPEG)
+    if(output_format == OUTPUT_JPEG && !passthrough)
 	jpeg_finish_compress(&cinfo);
 #endif
 
@@ -1775,7 +1795,7 @@ cleanup:
   }
 #endif
 #ifdef HAVE_LIBJPEG
-  if(output_format == OUTPUT_JPEG) {
+  if(output_format == OUTPUT_JPEG && !passthrough) {
     jpeg_destroy_compress(&cinfo);
     free(jpegbuf);
   }
@@ -1787,7 +1807,7 @@ cleanup:
   expected_bytes = ((uint64_t)parm.bytes_per_line) * parm.lines *
     ((parm.format == SANE_FRAME_RGB
       || parm.format == SANE_FRAME_GRAY) ? 1 : 3);
-  if (parm.lines < 0)
+  if (parm.lines < 0 || passthrough)
     expected_bytes = 0;
   if (total_bytes > expected_bytes && expected_bytes != 0)
     {
@@ -51,6 +51,14 @@ SANEI_IR_bufptr;
  */
 extern void sanei_ir_init (void);
 
+/** Release memory held by sanei_ir.
+ *
+ * The temporary image maps are kept between calls to avoid allocating
+ * them again for every frame. Call this when no more images will be
+ * processed.
+ */
+extern void sanei_ir_exit (void);
+
 /**
  * @brief Create the normalized histogram of a grayscale image
  *
@@ -238,6 +246,9 @@ sanei_ir_spectral_clean (const SANE_Parameters * params, double *lut_ln,
  * - SANE_STATUS_NO_MEM - if out of memory
  * - SANE_STATUS_INVAL - wrong window size
  *
+ * With thread support the rows are split into bands which are filtered
+ * in parallel. The result does not depend on the number of bands.
+ *
  * @note At the image margins the size of the filtering window
  *       is adapted. So there is no need to pad the image.
  * @note Memory for the output image has to be allocated before
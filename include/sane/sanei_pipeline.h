@@ -0,0 +1,332 @@
+/* sane - Scanner Access Now Easy.
+
+   This file is part of the SANE package.
+
+   SANE is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   SANE is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with sane; see the file COPYING.
+   If not, see <https://www.gnu.org/licenses/>.
+
+   As a special exception, the authors of SANE give permission for
+   additional uses of the libraries contained in this release of SANE.
+
+   The exception is that, if you link a SANE library with other files
+   to produce an executable, this does not by itself cause the
+   resulting executable to be covered by the GNU General Public
+   License.  Your use of that executable is in no way restricted on
+   account of linking the SANE library code into it.
+
+   This exception does not, however, invalidate any other reasons why
+   the executable file might be covered by the GNU General Public
+   License.
+
+   If you submit changes to SANE to the maintainers to be included in
+   a subsequent release, you agree by submitting the changes that
+   those changes may be distributed with this exception intact.
+
+   If you write modifications of your own for SANE, it is your choice
+   whether to permit this exception to apply to your modifications.
+   If you do not wish that, delete this exception notice.
+*/
+
+/** @file sanei_pipeline.h
+ * Line-based image processing pipelines for backends.
+ *
+ * A pipeline is a chain of nodes. The first node pulls rows of raw image
+ * data from the backend via a callback, each following node transforms the
+ * rows produced by the node before it. The backend then reads transformed
+ * rows from the last node, either one row at a time or in arbitrarily sized
+ * chunks, as sane_read() needs.
+ *
+ * The image format at each stage is described by SANE_Parameters. 16-bit
+ * samples are in host byte order and 1-bit rows are packed MSB first, as in
+ * SANE frames.
+ *
+ * All row buffers are allocated when nodes are added and are reused for the
+ * whole lifetime of the pipeline, so reading does not allocate memory.
+ *
+ * The following stock nodes are provided:
+ * - color line shift (RGB sensors with line distance between colors)
+ * - conversion of planar RGB rows to pixel-interleaved rows
+ * - expansion of 1-bit data to 8 bits
+ * - conversion of RGB to gray
+ * - thresholding of gray data to lineart
+ * - horizontal mirroring
+ * - selection of one image from rows of several interlaced images, e.g. the
+ *   front side of an interlaced duplex scan
+ *
+ * Example:
+ * @code
+ * SANEI_Pipeline *p;
+ * int shifts[3] = { 0, 4, 8 };
+ *
+ * status = sanei_pipeline_new (&raw_params, read_raw_row, s, &p);
+ * if (status == SANE_STATUS_GOOD)
+ *   status = sanei_pipeline_add_color_shift (p, shifts);
+ * if (status == SANE_STATUS_GOOD && s->mode == MODE_GRAY)
+ *   status = sanei_pipeline_add_rgb_to_gray (p);
+ * sanei_pipeline_get_parameters (p, &s->params);
+ * ...
+ * status = sanei_pipeline_read (p, buf, max_len, len);
+ * ...
+ * sanei_pipeline_free (p);
+ * @endcode
+ */
+
+#ifndef SANEI_PIPELINE_H
+#define SANEI_PIPELINE_H
+
+#include <stddef.h>
+
+#include <sane/sane.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Opaque pipeline type */
+typedef struct SANEI_Pipeline SANEI_Pipeline;
+
+/** Callback that supplies raw rows to the pipeline
+ *
+ * @param arg the argument passed to sanei_pipeline_new()
+ * @param row buffer to fill
+ * @param row_bytes size of a row, always equal to bytes_per_line of the
+ * parameters passed to sanei_pipeline_new()
+ *
+ * @return
+ * - SANE_STATUS_GOOD - the row has been filled
+ * - SANE_STATUS_EOF - there are no more rows
+ * - any other status is passed through to the reader
+ */
+typedef SANE_Status (*SANEI_Pipeline_Read_Func) (void *arg, SANE_Byte * row,
+                                                 size_t row_bytes);
+
+/** Create a new pipeline
+ *
+ * @param params format of the raw rows. lines may be -1 if unknown
+ * @param read_func callback supplying the raw rows
+ * @param arg argument passed to read_func
+ * @param[out] pipeline the new pipeline
+ *
+ * @return
+ * - SANE_STATUS_GOOD - success
+ * - SANE_STATUS_INVAL - unsupported format, too many nodes or reading has
+ *   already started
+ * - SANE_STATUS_NO_MEM - not enough memory
+ */
+extern SANE_Status
+sanei_pipeline_new (const SANE_Parameters * params,
+                    SANEI_Pipeline_Read_Func read_func, void *arg,
+                    SANEI_Pipeline ** pipeline);
+
+/** Free the pipeline and all its buffers
+ *
+ * At debug level 4 and above statistics of each node are printed.
+ *
+ * @param pipeline the pipeline, may be NULL
+ */
+extern void sanei_pipeline_free (SANEI_Pipeline * pipeline);
+
+/** Reset the pipeline for reading the next image with the same format
+ *
+ * Buffered rows and counters are discarded, buffers are kept.
+ *
+ * @param pipeline the pipeline
+ */
+extern void sanei_pipeline_reset (SANEI_Pipeline * pipeline);
+
+/** Get the format of the rows produced by the last node
+ *
+ * @param pipeline the pipeline
+ * @param[out] params the output format
+ */
+extern void
+sanei_pipeline_get_parameters (SANEI_Pipeline * pipeline,
+                               SANE_Parameters * params);
+
+/** Add a node that removes the line distance between color channels
+ *
+ * The color channel c of image line y is taken from input row
+ * y + shifts[c]. The output thus has max(shifts) fewer lines than the input.
+ * The input must be pixel-interleaved RGB with depth 8 or 16.
+ *
+ * @param pipeline the pipeline
+ * @param shifts the line shift of the red, green and blue channels
+ *
+ * @return
+ * - SANE_STATUS_GOOD - success
+ * - SANE_STATUS_INVAL - unsupported format, negative shift, too many nodes
+ *   or reading has already started
+ * - SANE_STATUS_NO_MEM - not enough memory
+ */
+extern SANE_Status
+sanei_pipeline_add_color_shift (SANEI_Pipeline * pipeline,
+                                const int shifts[3]);
+
+/** Add a node that converts planar RGB rows to pixel-interleaved rows
+ *
+ * Each input row contains all red samples, followed by all green samples
+ * and then all blue samples. Depth must be 8 or 16.
+ *
+ * @param pipeline the pipeline
+ *
+ * @return
+ * - SANE_STATUS_GOOD - success
+ * - SANE_STATUS_INVAL - unsupported format, too many nodes or reading has
+ *   already started
+ * - SANE_STATUS_NO_MEM - not enough memory
+ */
+extern SANE_Status sanei_pipeline_add_planar_to_pixel (SANEI_Pipeline *
+                                                       pipeline);
+
+/** Add a node that expands 1-bit samples to 8 bits
+ *
+ * Set bits become 0xff and cleared bits 0x00, or the reverse if invert is
+ * set. Use invert to turn SANE lineart data, where set bits are black, into
+ * gray data.
+ *
+ * @param pipeline the pipeline
+ * @param invert whether to invert the samples
+ *
+ * @return
+ * - SANE_STATUS_GOOD - success
+ * - SANE_STATUS_INVAL - unsupported format, too many nodes or reading has
+ *   already started
+ * - SANE_STATUS_NO_MEM - not enough memory
+ */
+extern SANE_Status
+sanei_pipeline_add_expand_bits (SANEI_Pipeline * pipeline, SANE_Bool invert);
+
+/** Add a node that converts pixel-interleaved RGB to gray
+ *
+ * The Rec. 709 luma weights are used. Depth must be 8 or 16.
+ *
+ * @param pipeline the pipeline
+ *
+ * @return
+ * - SANE_STATUS_GOOD - success
+ * - SANE_STATUS_INVAL - unsupported format, too many nodes or reading has
+ *   already started
+ * - SANE_STATUS_NO_MEM - not enough memory
+ */
+extern SANE_Status sanei_pipeline_add_rgb_to_gray (SANEI_Pipeline * pipeline);
+
+/** Add a node that converts pixel-interleaved RGB to gray with given weights
+ *
+ * Each gray sample is the weighted sum of the red, green and blue samples
+ * divided by the sum of the weights, rounded down. Depth must be 8 or 16.
+ *
+ * @param pipeline the pipeline
+ * @param weights the non-negative weights of red, green and blue. At least
+ * one must not be zero
+ *
+ * @return
+ * - SANE_STATUS_GOOD - success
+ * - SANE_STATUS_INVAL - unsupported format or weights, too many nodes or
+ *   reading has already started
+ * - SANE_STATUS_NO_MEM - not enough memory
+ */
+extern SANE_Status
+sanei_pipeline_add_rgb_to_gray_weighted (SANEI_Pipeline * pipeline,
+                                         const int weights[3]);
+
+/** Add a node that converts 8-bit gray to lineart
+ *
+ * Samples below the threshold become set bits, i.e. black in SANE lineart
+ * data. The padding bits at the end of a row are cleared.
+ *
+ * @param pipeline the pipeline
+ * @param threshold the lowest sample value that becomes white
+ *
+ * @return
+ * - SANE_STATUS_GOOD - success
+ * - SANE_STATUS_INVAL - unsupported format, too many nodes or reading has
+ *   already started
+ * - SANE_STATUS_NO_MEM - not enough memory
+ */
+extern SANE_Status
+sanei_pipeline_add_threshold (SANEI_Pipeline * pipeline, SANE_Int threshold);
+
+/** Add a node that mirrors rows horizontally
+ *
+ * @param pipeline the pipeline
+ *
+ * @return
+ * - SANE_STATUS_GOOD - success
+ * - SANE_STATUS_INVAL - too many nodes or reading has already started
+ * - SANE_STATUS_NO_MEM - not enough memory
+ */
+extern SANE_Status sanei_pipeline_add_mirror (SANEI_Pipeline * pipeline);
+
+/** Add a node that selects one of several interlaced images
+ *
+ * The input rows cycle through the given number of images in groups of
+ * group_rows rows: the first group belongs to image 0, the next to image 1
+ * and so on. Only the rows of the selected image are passed on, the others
+ * are dropped. Scanners that interlace the front and rear side of a duplex
+ * scan line by line use group_rows 1, those that send stripes use the
+ * number of lines per stripe.
+ *
+ * @param pipeline the pipeline
+ * @param images the number of interlaced images
+ * @param image the index of the image to pass on
+ * @param group_rows the number of consecutive rows of one image
+ *
+ * @return
+ * - SANE_STATUS_GOOD - success
+ * - SANE_STATUS_INVAL - invalid arguments, too many nodes or reading has
+ *   already started
+ * - SANE_STATUS_NO_MEM - not enough memory
+ */
+extern SANE_Status
+sanei_pipeline_add_deinterlace (SANEI_Pipeline * pipeline, int images,
+                                int image, int group_rows);
+
+/** Read the next output row
+ *
+ * @param pipeline the pipeline
+ * @param row buffer of at least bytes_per_line bytes of the output format.
+ * It must be suitably aligned for 16-bit access if depth is 16
+ *
+ * @return
+ * - SANE_STATUS_GOOD - the row has been read
+ * - SANE_STATUS_EOF - there are no more rows
+ * - any error returned by the read callback
+ */
+extern SANE_Status
+sanei_pipeline_read_row (SANEI_Pipeline * pipeline, SANE_Byte * row);
+
+/** Read output data with sane_read() semantics
+ *
+ * Rows are split across calls as needed. SANE_STATUS_EOF is only returned
+ * when no data has been read.
+ *
+ * @param pipeline the pipeline
+ * @param buf buffer to fill
+ * @param max_len size of buf
+ * @param[out] len number of bytes stored into buf
+ *
+ * @return
+ * - SANE_STATUS_GOOD - data has been read
+ * - SANE_STATUS_EOF - there is no more data
+ * - any error returned by the read callback
+ */
+extern SANE_Status
+sanei_pipeline_read (SANEI_Pipeline * pipeline, SANE_Byte * buf,
+                     SANE_Int max_len, SANE_Int * len);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* SANEI_PIPELINE_H */
@@ -195,7 +195,14 @@ struct sanei_usb_dev_descriptor
     prepend all output commands before that node before an output command is
     encountered.
 
-    @param path Path to the XML data file.
+    The data file may also be a binary capture (see
+    sanei_usb_testing_convert_capture()), which is detected automatically.
+    Binary captures are memory-mapped and their transaction data is used
+    without hex decoding. Outside development mode, transactions are looked
+    up in the index of the capture as replay reaches them and are not
+    parsed up front, so loading a capture does not depend on its size.
+
+    @param path Path to the XML or binary data file.
     @param development_mode Enables development mode.
  */
 extern SANE_Status sanei_usb_testing_enable_replay(SANE_String_Const path,
@@ -206,6 +213,8 @@ extern SANE_Status sanei_usb_testing_enable_replay(SANE_String_Const path,
  * Initializes sanei_usb for recording communication with the scanner. This
  * function must be called before sanei_usb_init().
  *
+ * If path ends with ".usbcap", the capture is written in the binary format.
+ *
  * @param path Path to the XML data file.
  * @param be_name The name of the backend to enable recording for.
  */
@@ -224,6 +233,11 @@ extern SANE_String sanei_usb_testing_get_backend();
  */
 extern SANE_Bool sanei_usb_is_replay_mode_enabled();
 
+/** Returns SANE_TRUE if record testing mode is enabled, i.e. whether the communication with the
+ * scanner is being captured for a later replay.
+ */
+extern SANE_Bool sanei_usb_is_record_mode_enabled();
+
 /** Clears currently recorded data.
 
     This is useful on certain backends to clear the currently recorded data if it relates to
@@ -244,6 +258,26 @@ extern void sanei_usb_testing_record_clear();
  */
 extern void sanei_usb_testing_record_message(SANE_String_Const message);
 
+/** Converts a USB capture between the XML and binary formats.
+ *
+ * The format of the input file is detected automatically. The output is
+ * written in the binary format if out_path ends with ".usbcap" and as XML
+ * otherwise. Whitespace and comments in XML captures are not preserved by
+ * the binary format. The hex data of control, bulk and interrupt
+ * transactions is stored as binary data; other text is kept as is.
+ *
+ * @param in_path Path to the capture to read.
+ * @param out_path Path to the capture to write.
+ *
+ * @return
+ * - SANE_STATUS_GOOD - on success
+ * - SANE_STATUS_INVAL - if the input could not be loaded
+ * - SANE_STATUS_IO_ERROR - if the output could not be written
+ * - SANE_STATUS_UNSUPPORTED - if record-replay support is not compiled in
+ */
+extern SANE_Status sanei_usb_testing_convert_capture(SANE_String_Const in_path,
+                                                     SANE_String_Const out_path);
+
 /** Initialize sanei_usb.
  *
  * Call this before any other sanei_usb function.
@@ -362,11 +396,55 @@ extern void sanei_usb_set_endpoint (SANE_Int dn, SANE_Int ep_type, SANE_Int ep);
 extern SANE_Int sanei_usb_get_endpoint (SANE_Int dn, SANE_Int ep_type);
 
 /** Close a USB device.
+ *
+ * If transfer tracing is enabled, the statistics of the device are dumped.
  *
  * @param dn device number
  */
 extern void sanei_usb_close (SANE_Int dn);
 
+/** Dump the transfer statistics of a device.
+ *
+ * Transfer tracing is enabled by setting the SANE_USB_TRACE environment
+ * variable to 1 (dump to stderr) or to the path of a file the statistics are
+ * appended to. This function does nothing if tracing is disabled.
+ *
+ * @param dn device number, or -1 to dump all open devices
+ */
+extern void sanei_usb_trace_dump (SANE_Int dn);
+
+/** Get the bulk transfer size to use for a device.
+ *
+ * The size is adapted at run time: the candidates are the powers of two
+ * between min_size and max_size, and the throughput of complete transfers
+ * of each candidate is measured, starting with the largest. The smallest
+ * size that achieves nearly the best throughput is picked and stored per
+ * device model, direction and USB bus, so the next session starts with it.
+ * Until then the size changes every few transfers, so call this function
+ * before each transfer.
+ *
+ * The smallest candidate is min_size rounded up to a power of two, so all
+ * sizes except max_size are multiples of min_size only if min_size is a
+ * power of two. Backends that need transfers aligned to a power of two,
+ * e.g. the USB packet size, pass it as min_size.
+ *
+ * Tuning is disabled if SANE_USB_TUNING is set to 0. The results are stored
+ * in the file named by SANE_USB_TUNING_FILE, by default
+ * $XDG_CACHE_HOME/sane/usb-tuning or ~/.cache/sane/usb-tuning. An empty
+ * SANE_USB_TUNING_FILE disables storing them.
+ *
+ * @param dn device number
+ * @param ep_dir USB_DIR_IN or USB_DIR_OUT
+ * @param min_size smallest size to try
+ * @param max_size largest size the backend can handle
+ *
+ * @return the transfer size, at most max_size. max_size is returned if
+ * tuning is disabled or in USB record/replay mode.
+ */
+extern size_t
+sanei_usb_get_bulk_size (SANE_Int dn, SANE_Int ep_dir, size_t min_size,
+                         size_t max_size);
+
 /** Set the libusb timeout for bulk and interrupt reads.
  *
  * @param timeout the new timeout in ms
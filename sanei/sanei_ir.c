@@ -25,11 +25,19 @@
  * licensed under the GNU General Public License version 2 or later.
 */
 
+#include "../include/sane/config.h"
+
 #include <stdlib.h>
 #include <string.h>
 #include <float.h>
 #include <limits.h>
 #include <math.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef USE_PTHREAD
+#include <pthread.h>
+#endif
 
 #define BACKEND_NAME sanei_ir	/* name of this module for debugging */
 
@@ -44,6 +52,126 @@ sanei_ir_create_norm_histo (const SANE_Parameters * params, const SANE_Uint *img
 double * sanei_ir_accumulate_norm_histo (double * histo_data);
 
 
+#define IR_MAX_BANDS	8	/* maximal number of threads for filtering */
+#define IR_MIN_BAND_ROWS	64	/* do not split smaller images */
+
+
+/* Scratch memory which is kept between calls, so that the full image
+ * sized maps are not allocated again for every frame, internal
+ * A buffer is taken out of the arena while it is in use, so concurrent
+ * callers never share one; they fall back to a fresh allocation.
+ */
+enum
+{
+  IR_ARENA_SUMS = 0,
+  IR_ARENA_CORR,
+  IR_ARENA_DELTA,
+  IR_ARENA_MAD,
+  IR_ARENA_DIST,
+  IR_ARENA_IDX,
+  IR_ARENA_PLANE,
+  IR_ARENA_SLOTS
+};
+
+static struct
+{
+  void *buf;
+  size_t size;
+} ir_arena[IR_ARENA_SLOTS];
+
+#ifdef USE_PTHREAD
+static pthread_mutex_t ir_arena_lock = PTHREAD_MUTEX_INITIALIZER;
+#define IR_ARENA_LOCK()		pthread_mutex_lock (&ir_arena_lock)
+#define IR_ARENA_UNLOCK()	pthread_mutex_unlock (&ir_arena_lock)
+#else
+#define IR_ARENA_LOCK()
+#define IR_ARENA_UNLOCK()
+#endif
+
+static void *
+ir_arena_take (int slot, size_t size)
+{
+  void *buf = NULL;
+
+  IR_ARENA_LOCK ();
+  if (ir_arena[slot].buf && ir_arena[slot].size >= size)
+    {
+      buf = ir_arena[slot].buf;
+      ir_arena[slot].buf = NULL;
+    }
+  IR_ARENA_UNLOCK ();
+
+  if (!buf)
+    buf = malloc (size);
+  return buf;
+}
+
+/* size is the size requested from ir_arena_take, the largest
+ * buffer of a slot is kept */
+static void
+ir_arena_give (int slot, void *buf, size_t size)
+{
+  if (!buf)
+    return;
+
+  IR_ARENA_LOCK ();
+  if (!ir_arena[slot].buf || ir_arena[slot].size < size)
+    {
+      void *old = ir_arena[slot].buf;
+      ir_arena[slot].buf = buf;
+      ir_arena[slot].size = size;
+      buf = old;
+    }
+  IR_ARENA_UNLOCK ();
+
+  free (buf);
+}
+
+
+/* Number of row bands to process in parallel, internal
+ * SANE_IR_THREADS overrides the number of processors
+ */
+static int
+ir_num_bands (int rows)
+{
+  int bands = 1;
+
+#if defined (USE_PTHREAD) && defined (_SC_NPROCESSORS_ONLN)
+  const char *env = getenv ("SANE_IR_THREADS");
+  long ncpu = env ? atol (env) : sysconf (_SC_NPROCESSORS_ONLN);
+
+  if (ncpu > 1)
+    bands = ncpu;
+  if (bands > IR_MAX_BANDS)
+    bands = IR_MAX_BANDS;
+  if (bands > rows / IR_MIN_BAND_ROWS)
+    bands = rows / IR_MIN_BAND_ROWS;
+  if (bands < 1)
+    bands = 1;
+#else
+  (void) rows;
+#endif
+
+  return bands;
+}
+
+
+/* Cheap random choice for the distance transform, internal
+ * rand () is too slow to be called for every pixel
+ */
+static inline unsigned int
+ir_rand_bit (uint32_t *state)
+{
+  uint32_t x = *state;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x & 1;
+}
+
+
 /* Initialize sanei_ir
  */
 void
@@ -53,6 +181,26 @@ sanei_ir_init (void)
 }
 
 
+/* Release the scratch memory of sanei_ir
+ */
+void
+sanei_ir_exit (void)
+{
+  int i;
+
+  DBG (10, "sanei_ir_exit\n");
+
+  IR_ARENA_LOCK ();
+  for (i = 0; i < IR_ARENA_SLOTS; i++)
+    {
+      free (ir_arena[i].buf);
+      ir_arena[i].buf = NULL;
+      ir_arena[i].size = 0;
+    }
+  IR_ARENA_UNLOCK ();
+}
+
+
 /* Create a normalized histogram of a grayscale image, internal
  */
 double *
@@ -517,15 +665,13 @@ sanei_ir_spectral_clean (const SANE_Parameters * params, double *lut_ln,
 			const SANE_Uint *red_data,
 			SANE_Uint *ir_data)
 {
-  const SANE_Uint *rptr;
-  SANE_Uint *iptr;
   SANE_Int depth;
   double *llut;
   double rval, rsum, rrsum;
   double risum, rfac, radd;
   double *norm_histo;
   int64_t isum;
-  int *calc_buf, *calc_ptr;
+  int *corr, *delta;
   int ival, imin, imax;
   int itop, len, ssize;
   int thresh_low, thresh;
@@ -535,24 +681,16 @@ sanei_ir_spectral_clean (const SANE_Parameters * params, double *lut_ln,
   DBG (10, "sanei_ir_spectral_clean\n");
 
   itop = params->pixels_per_line * params->lines;
-  calc_buf = malloc (itop * sizeof (int));		/* could save this */
-  if (!calc_buf)
-    {
-      DBG (5, "sanei_ir_spectral_clean: no buffer\n");
-      return SANE_STATUS_NO_MEM;
-    }
-
   depth = params->depth;
   len = 1 << depth;
+
   if (lut_ln)
     llut = lut_ln;
   else
     {
       status = sanei_ir_ln_table (len, &llut);
-      if (status != SANE_STATUS_GOOD) {
-        free (calc_buf);
+      if (status != SANE_STATUS_GOOD)
         return status;
-      }
     }
 
   /* determine not transparent areas to exclude them later
@@ -564,7 +702,8 @@ sanei_ir_spectral_clean (const SANE_Parameters * params, double *lut_ln,
   if (status != SANE_STATUS_GOOD)
     {
       DBG (5, "sanei_ir_spectral_clean: no buffer\n");
-      free (calc_buf);
+      if (!lut_ln)
+        free (llut);
       return SANE_STATUS_NO_MEM;
     }
 
@@ -615,95 +754,107 @@ sanei_ir_spectral_clean (const SANE_Parameters * params, double *lut_ln,
   DBG (10, "sanei_ir_spectral_clean: n = %d, ired(red) = %f * ln(red) + %f\n",
             ssize, rfac, radd);
 
-  /* now calculate ired' = ired - a  * ln (red) */
+  corr = ir_arena_take (IR_ARENA_CORR, len * sizeof (int));
+  delta = ir_arena_take (IR_ARENA_DELTA, itop * sizeof (int));
+  if (!corr || !delta)
+    {
+      DBG (5, "sanei_ir_spectral_clean: no buffer\n");
+      ir_arena_give (IR_ARENA_DELTA, delta, itop * sizeof (int));
+      ir_arena_give (IR_ARENA_CORR, corr, len * sizeof (int));
+      if (!lut_ln)
+        free (llut);
+      free (norm_histo);
+      return SANE_STATUS_NO_MEM;
+    }
+
+  /* tabulate a * ln (red) for every possible red value */
+  for (i = 0; i < len; i++)
+    corr[i] = (int) (rfac * llut[i] + 0.5);
+
+  /* now calculate ired' = ired - a  * ln (red), the table lookup
+   * is kept out of the loops below, so that they vectorize */
+  for (i = 0; i < itop; i++)
+    delta[i] = ir_data[i] - corr[red_data[i]];
+
   imin = INT_MAX;
   imax = INT_MIN;
-  rptr = red_data;
-  iptr = ir_data;
-  calc_ptr = calc_buf;
-    for (i = itop; i > 0; i--)
-      {
-	ival = *iptr++ - (int) (rfac * llut[*rptr++] + 0.5);
-	if (ival > imax)
-	  imax = ival;
-	if (ival < imin)
-	  imin = ival;
-	*calc_ptr++ = ival;
-      }
+  for (i = 0; i < itop; i++)
+    {
+      imax = delta[i] > imax ? delta[i] : imax;
+      imin = delta[i] < imin ? delta[i] : imin;
+    }
 
-  /* scale the result back into the ired image */
-  calc_ptr = calc_buf;
-  iptr = ir_data;
-  rfac = (double) (len - 1) / (double) (imax - imin);
-    for (i = itop; i > 0; i--)
-      *iptr++ = (double) (*calc_ptr++ - imin) * rfac;
+  /* and scale the result back into the ired image, in double precision,
+   * as single precision rounds the maximum down for some ranges */
+  rfac = imax > imin ? (double) (len - 1) / (double) (imax - imin) : 0.0;
+  for (i = 0; i < itop; i++)
+    ir_data[i] = (double) (delta[i] - imin) * rfac;
 
+  ir_arena_give (IR_ARENA_DELTA, delta, itop * sizeof (int));
+  ir_arena_give (IR_ARENA_CORR, corr, len * sizeof (int));
   if (!lut_ln)
     free (llut);
-  free (calc_buf);
   free (norm_histo);
   return SANE_STATUS_GOOD;
 }
 
 
-/* Hopefully fast mean filter
- * JV: what does this do? Remove local mean?
+/* One band of rows of the mean filter, internal
  */
-SANE_Status
-sanei_ir_filter_mean (const SANE_Parameters * params,
-		      const SANE_Uint *in_img, SANE_Uint *out_img,
-		      int win_rows, int win_cols)
+typedef struct
 {
+  const SANE_Uint *in_img;
+  SANE_Uint *out_img;
+  int *sum;
+  int num_cols, num_rows;
+  int win_rows, win_cols;
+  int row_start, row_end;
+} ir_mean_band;
+
+static void
+ir_filter_mean_band (ir_mean_band * band)
+{
+  const SANE_Uint *in_img = band->in_img;
   const SANE_Uint *src;
   SANE_Uint *dest;
-  int num_cols, num_rows;
+  int num_cols = band->num_cols;
+  int num_rows = band->num_rows;
+  int win_cols = band->win_cols;
   int itop, iadd, isub;
   int ndiv, the_sum;
   int nrow, ncol;
   int hwr, hwc;
-  int *sum;
+  int *sum = band->sum;
+  int first, last;
   int i, j;
 
-  DBG (10, "sanei_ir_filter_mean, window: %d x%d\n", win_rows, win_cols);
-
-  if (((win_rows & 1) == 0) || ((win_cols & 1) == 0))
-    {
-      DBG (5, "sanei_ir_filter_mean: window even sized\n");
-      return SANE_STATUS_INVAL;
-    }
-
-  num_cols = params->pixels_per_line;
-  num_rows = params->lines;
-
-  sum = malloc (num_cols * sizeof (int));
-  if (!sum)
-    {
-      DBG (5, "sanei_ir_filter_mean: no buffer for sums\n");
-      return SANE_STATUS_NO_MEM;
-    }
-  dest = out_img;
-
-  hwr = win_rows / 2;		/* half window sizes */
+  hwr = band->win_rows / 2;	/* half window sizes */
   hwc = win_cols / 2;
 
-  /* pre-pre calculation */
+  /* pre-pre calculation, the column sums as they are
+   * before the first row of this band has been updated */
+  first = band->row_start - hwr - 1;
+  if (first < 0)
+    first = 0;
+  last = band->row_start + hwr;
+  if (last > num_rows)
+    last = num_rows;
   for (j = 0; j < num_cols; j++)
+    sum[j] = 0;
+  for (i = first; i < last; i++)
     {
-        sum[j] = 0;
-	src = in_img + j;
-	for (i = 0; i < hwr; i++)
-	  {
-	    sum[j] += *src;
-	    src += num_cols;
-	  }
+      src = in_img + i * num_cols;
+      for (j = 0; j < num_cols; j++)
+	sum[j] += src[j];
     }
+  nrow = last - first;
 
   itop = num_rows * num_cols;
-  iadd = hwr * num_cols;
-  isub = (hwr - win_rows) * num_cols;
-  nrow = hwr;
+  iadd = (band->row_start + hwr) * num_cols;
+  isub = (band->row_start - hwr - 1) * num_cols;
+  dest = band->out_img + band->row_start * num_cols;
 
-      for (i = 0; i < num_rows; i++)
+      for (i = band->row_start; i < band->row_end; i++)
 	{
 	  /* update row sums if possible */
 	  if (isub >= 0)	/* subtract old row */
@@ -711,7 +862,7 @@ sanei_ir_filter_mean (const SANE_Parameters * params,
 	      nrow--;
 	      src = in_img + isub;
 	      for (j = 0; j < num_cols; j++)
-		sum[j] -= *src++;
+		sum[j] -= src[j];
 	    }
 	  isub += num_cols;
 
@@ -720,7 +871,7 @@ sanei_ir_filter_mean (const SANE_Parameters * params,
 	      nrow++;
 	      src = in_img + iadd;
 	      for (j = 0; j < num_cols; j++)
-		sum[j] += *src++;
+		sum[j] += src[j];
 	    }
 	  iadd += num_cols;
 
@@ -756,7 +907,91 @@ sanei_ir_filter_mean (const SANE_Parameters * params,
 	      *dest++ = the_sum / (ncol * nrow);
 	    }
 	}
-  free (sum);
+}
+
+#ifdef USE_PTHREAD
+static void *
+ir_filter_mean_thread (void *arg)
+{
+  ir_filter_mean_band ((ir_mean_band *) arg);
+  return NULL;
+}
+#endif
+
+
+/* Hopefully fast mean filter
+ * JV: what does this do? Remove local mean?
+ * The rows are split into bands which are filtered in parallel.
+ */
+SANE_Status
+sanei_ir_filter_mean (const SANE_Parameters * params,
+		      const SANE_Uint *in_img, SANE_Uint *out_img,
+		      int win_rows, int win_cols)
+{
+  ir_mean_band band[IR_MAX_BANDS];
+#ifdef USE_PTHREAD
+  pthread_t thread[IR_MAX_BANDS];
+  int started[IR_MAX_BANDS];
+#endif
+  int num_cols, num_rows;
+  int nbands, rows_per_band;
+  int *sums;
+  int k;
+
+  DBG (10, "sanei_ir_filter_mean, window: %d x%d\n", win_rows, win_cols);
+
+  if (((win_rows & 1) == 0) || ((win_cols & 1) == 0))
+    {
+      DBG (5, "sanei_ir_filter_mean: window even sized\n");
+      return SANE_STATUS_INVAL;
+    }
+
+  num_cols = params->pixels_per_line;
+  num_rows = params->lines;
+
+  nbands = ir_num_bands (num_rows);
+  sums = ir_arena_take (IR_ARENA_SUMS, nbands * num_cols * sizeof (int));
+  if (!sums)
+    {
+      DBG (5, "sanei_ir_filter_mean: no buffer for sums\n");
+      return SANE_STATUS_NO_MEM;
+    }
+
+  rows_per_band = (num_rows + nbands - 1) / nbands;
+  for (k = 0; k < nbands; k++)
+    {
+      band[k].in_img = in_img;
+      band[k].out_img = out_img;
+      band[k].sum = sums + k * num_cols;
+      band[k].num_cols = num_cols;
+      band[k].num_rows = num_rows;
+      band[k].win_rows = win_rows;
+      band[k].win_cols = win_cols;
+      band[k].row_start = k * rows_per_band;
+      band[k].row_end = band[k].row_start + rows_per_band;
+      if (band[k].row_end > num_rows)
+	band[k].row_end = num_rows;
+    }
+
+#ifdef USE_PTHREAD
+  /* the last band is done by the calling thread */
+  for (k = 0; k < nbands - 1; k++)
+    {
+      started[k] = pthread_create (&thread[k], NULL, ir_filter_mean_thread,
+				   &band[k]) == 0;
+      if (!started[k])
+	ir_filter_mean_band (&band[k]);
+    }
+  ir_filter_mean_band (&band[nbands - 1]);
+  for (k = 0; k < nbands - 1; k++)
+    if (started[k])
+      pthread_join (thread[k], NULL);
+#else
+  for (k = 0; k < nbands; k++)
+    ir_filter_mean_band (&band[k]);
+#endif
+
+  ir_arena_give (IR_ARENA_SUMS, sums, nbands * num_cols * sizeof (int));
   return SANE_STATUS_GOOD;
 }
 
@@ -794,8 +1029,8 @@ sanei_ir_filter_madmean (const SANE_Parameters * params,
   itop = num_rows * num_cols;
   size = itop * sizeof (SANE_Uint);
   out_ij = malloc (size);
-  delta_ij = malloc (size);
-  mad_ij = malloc (size);
+  delta_ij = ir_arena_take (IR_ARENA_DELTA, size);
+  mad_ij = ir_arena_take (IR_ARENA_MAD, size);
 
   if (out_ij && delta_ij && mad_ij)
     {
@@ -844,8 +1079,10 @@ sanei_ir_filter_madmean (const SANE_Parameters * params,
   else
     DBG (5, "sanei_ir_filter_madmean: Cannot allocate buffers\n");
 
-  free (mad_ij);
-  free (delta_ij);
+  if (ret != SANE_STATUS_GOOD)
+    free (out_ij);
+  ir_arena_give (IR_ARENA_MAD, mad_ij, size);
+  ir_arena_give (IR_ARENA_DELTA, delta_ij, size);
   return ret;
 }
 
@@ -885,6 +1122,7 @@ sanei_ir_manhattan_dist (const SANE_Parameters * params,
 {
   const SANE_Uint *mask;
   unsigned int *index, *manhattan;
+  uint32_t seed = 0x9e3779b9;
   int rows, cols, itop;
   int i, j;
 
@@ -937,7 +1175,7 @@ sanei_ir_manhattan_dist (const SANE_Parameters * params,
 		    *index = index[-1];	/* index follows */
 		  }
 		if (manhattan[-1] + 1 == *manhattan)
-		  if (rand () % 2 == 0)	/* chose index */
+		  if (ir_rand_bit (&seed))	/* chose index */
 		    *index = index[-1];
 	      }
 	  }
@@ -961,7 +1199,7 @@ sanei_ir_manhattan_dist (const SANE_Parameters * params,
 		*index = index[+cols];	/* index follows */
 	      }
 	    if (manhattan[+cols] + 1 == *manhattan)
-	      if (rand () % 2 == 0)	/* chose index */
+	      if (ir_rand_bit (&seed))	/* chose index */
 		*index = index[+cols];
 	  }
 	if (j < cols - 1)
@@ -973,7 +1211,7 @@ sanei_ir_manhattan_dist (const SANE_Parameters * params,
 		*index = index[1];	/* index follows */
 	      }
 	    if (manhattan[1] + 1 == *manhattan)
-	      if (rand () % 2 == 0)	/* chose index */
+	      if (ir_rand_bit (&seed))	/* chose index */
 		*index = index[1];
 	  }
 	manhattan--;
@@ -1134,9 +1372,9 @@ sanei_ir_dilate_mean (const SANE_Parameters * params,
   cols = params->pixels_per_line;
   rows = params->lines;
   itop = rows * cols;
-  idx_map = malloc (itop * sizeof (unsigned int));
-  dist_map = malloc (itop * sizeof (unsigned int));
-  plane = malloc (itop * sizeof (SANE_Uint));
+  idx_map = ir_arena_take (IR_ARENA_IDX, itop * sizeof (unsigned int));
+  dist_map = ir_arena_take (IR_ARENA_DIST, itop * sizeof (unsigned int));
+  plane = ir_arena_take (IR_ARENA_PLANE, itop * sizeof (SANE_Uint));
 
   if (!idx_map || !dist_map || !plane)
     DBG (5, "sanei_ir_dilate_mean: Cannot allocate buffers\n");
@@ -1196,9 +1434,9 @@ sanei_ir_dilate_mean (const SANE_Parameters * params,
               }
       }
     }
-  free (plane);
-  free (dist_map);
-  free (idx_map);
 
+  ir_arena_give (IR_ARENA_PLANE, plane, itop * sizeof (SANE_Uint));
+  ir_arena_give (IR_ARENA_DIST, dist_map, itop * sizeof (unsigned int));
+  ir_arena_give (IR_ARENA_IDX, idx_map, itop * sizeof (unsigned int));
   return ret;
 }
@@ -0,0 +1,783 @@
+/* sane - Scanner Access Now Easy.
+
+   This file is part of the SANE package.
+
+   SANE is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   SANE is distributed in the hope that it will be useful, but WITHOUT
+   ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+   or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+   License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with sane; see the file COPYING.
+   If not, see <https://www.gnu.org/licenses/>.
+
+   As a special exception, the authors of SANE give permission for
+   additional uses of the libraries contained in this release of SANE.
+
+   The exception is that, if you link a SANE library with other files
+   to produce an executable, this does not by itself cause the
+   resulting executable to be covered by the GNU General Public
+   License.  Your use of that executable is in no way restricted on
+   account of linking the SANE library code into it.
+
+   This exception does not, however, invalidate any other reasons why
+   the executable file might be covered by the GNU General Public
+   License.
+
+   If you submit changes to SANE to the maintainers to be included in
+   a subsequent release, you agree by submitting the changes that
+   those changes may be distributed with this exception intact.
+
+   If you write modifications of your own for SANE, it is your choice
+   whether to permit this exception to apply to your modifications.
+   If you do not wish that, delete this exception notice.
+*/
+
+#include "../include/sane/config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define BACKEND_NAME sanei_pipeline    /* name of this module for debugging */
+
+#include "../include/sane/sane.h"
+#include "../include/sane/sanei_debug.h"
+#include "../include/sane/sanei_pipeline.h"
+
+#define MAX_NODES 16
+
+/* level at which node statistics are collected and printed */
+#define DBG_STATS 4
+
+typedef struct Node Node;
+
+/* produces the next output row of the node at the given index */
+typedef SANE_Status (*Node_Get_Row) (SANEI_Pipeline * p, int index,
+                                     SANE_Byte * out);
+
+struct Node
+{
+  const char *name;
+  SANE_Parameters params;       /* format of the rows produced by the node */
+  Node_Get_Row get_row;
+
+  SANE_Byte *in_row;            /* row read from the previous node */
+
+  /* color shift */
+  int shifts[3];
+  int max_shift;
+  SANE_Byte *ring;              /* the last ring_rows input rows */
+  int ring_rows;
+  SANE_Int rows_in;
+
+  /* expand bits */
+  SANE_Byte bit_values[2];
+
+  /* rgb to gray */
+  unsigned int weights[3];
+  unsigned int weight_sum;
+
+  /* threshold */
+  SANE_Int threshold;
+
+  /* deinterlace */
+  int images;
+  int image;
+  int group_rows;
+
+  /* statistics */
+  SANE_Int rows_out;
+  double total_time;            /* includes the time spent in previous nodes */
+};
+
+/* all buffers of a pipeline are kept in a single list and freed together */
+typedef struct Pool_Block
+{
+  struct Pool_Block *next;
+  double align;
+} Pool_Block;
+
+struct SANEI_Pipeline
+{
+  SANEI_Pipeline_Read_Func read_func;
+  void *arg;
+
+  Node nodes[MAX_NODES];
+  int num_nodes;
+
+  Pool_Block *pool;
+
+  /* partially consumed output row for sanei_pipeline_read() */
+  SANE_Byte *out_row;
+  SANE_Int out_pos;
+  SANE_Int out_len;
+};
+
+static SANE_Byte *
+pool_alloc (SANEI_Pipeline * p, size_t size)
+{
+  Pool_Block *block = malloc (sizeof (Pool_Block) + size);
+  if (!block)
+    return NULL;
+  block->next = p->pool;
+  p->pool = block;
+  return (SANE_Byte *) (block + 1);
+}
+
+static int
+get_channels (const SANE_Parameters * params)
+{
+  return params->format == SANE_FRAME_RGB ? 3 : 1;
+}
+
+static SANE_Int
+get_row_bytes (const SANE_Parameters * params)
+{
+  return (params->pixels_per_line * get_channels (params) * params->depth
+          + 7) / 8;
+}
+
+static double
+get_time (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static SANE_Status
+node_get_row (SANEI_Pipeline * p, int index, SANE_Byte * out)
+{
+  Node *node = &p->nodes[index];
+  SANE_Status status;
+  double start = 0;
+
+  if (node->params.lines >= 0 && node->rows_out >= node->params.lines)
+    return SANE_STATUS_EOF;
+
+  if (DBG_LEVEL >= DBG_STATS)
+    start = get_time ();
+
+  status = node->get_row (p, index, out);
+
+  if (DBG_LEVEL >= DBG_STATS)
+    node->total_time += get_time () - start;
+
+  if (status == SANE_STATUS_GOOD)
+    node->rows_out++;
+  return status;
+}
+
+/* Adds a node whose output format is initially the same as the output of
+   the last node. in_row is allocated if in_row_bytes is not zero */
+static SANE_Status
+add_node (SANEI_Pipeline * p, const char *name, Node_Get_Row get_row,
+          size_t in_row_bytes, Node ** node)
+{
+  Node *n;
+
+  if (p->num_nodes == MAX_NODES)
+    {
+      DBG (1, "%s: too many nodes\n", __func__);
+      return SANE_STATUS_INVAL;
+    }
+  if (p->out_row)
+    {
+      DBG (1, "%s: can't add nodes after reading has started\n", __func__);
+      return SANE_STATUS_INVAL;
+    }
+
+  n = &p->nodes[p->num_nodes];
+  memset (n, 0, sizeof (*n));
+  n->name = name;
+  n->get_row = get_row;
+  n->params = p->nodes[p->num_nodes - 1].params;
+
+  if (in_row_bytes)
+    {
+      n->in_row = pool_alloc (p, in_row_bytes);
+      if (!n->in_row)
+        return SANE_STATUS_NO_MEM;
+    }
+
+  p->num_nodes++;
+  *node = n;
+  return SANE_STATUS_GOOD;
+}
+
+static const SANE_Parameters *
+last_params (SANEI_Pipeline * p)
+{
+  return &p->nodes[p->num_nodes - 1].params;
+}
+
+static SANE_Status
+source_get_row (SANEI_Pipeline * p, int index, SANE_Byte * out)
+{
+  return p->read_func (p->arg, out, p->nodes[index].params.bytes_per_line);
+}
+
+static SANE_Status
+color_shift_get_row (SANEI_Pipeline * p, int index, SANE_Byte * out)
+{
+  Node *node = &p->nodes[index];
+  SANE_Int row_bytes = p->nodes[index - 1].params.bytes_per_line;
+  SANE_Int pixels = node->params.pixels_per_line;
+  SANE_Status status;
+  int c;
+  SANE_Int x;
+
+  while (node->rows_in <= node->rows_out + node->max_shift)
+    {
+      SANE_Byte *row = node->ring
+        + (node->rows_in % node->ring_rows) * (size_t) row_bytes;
+      status = node_get_row (p, index - 1, row);
+      if (status != SANE_STATUS_GOOD)
+        return status;
+      node->rows_in++;
+    }
+
+  for (c = 0; c < 3; c++)
+    {
+      const SANE_Byte *src = node->ring
+        + ((node->rows_out + node->shifts[c]) % node->ring_rows)
+        * (size_t) row_bytes;
+
+      if (node->params.depth == 8)
+        {
+          for (x = 0; x < pixels; x++)
+            out[x * 3 + c] = src[x * 3 + c];
+        }
+      else
+        {
+          const uint16_t *src16 = (const uint16_t *) src;
+          uint16_t *out16 = (uint16_t *) out;
+          for (x = 0; x < pixels; x++)
+            out16[x * 3 + c] = src16[x * 3 + c];
+        }
+    }
+  return SANE_STATUS_GOOD;
+}
+
+static SANE_Status
+planar_to_pixel_get_row (SANEI_Pipeline * p, int index, SANE_Byte * out)
+{
+  Node *node = &p->nodes[index];
+  SANE_Int pixels = node->params.pixels_per_line;
+  SANE_Status status;
+  int c;
+  SANE_Int x;
+
+  status = node_get_row (p, index - 1, node->in_row);
+  if (status != SANE_STATUS_GOOD)
+    return status;
+
+  for (c = 0; c < 3; c++)
+    {
+      if (node->params.depth == 8)
+        {
+          const SANE_Byte *src = node->in_row + c * (size_t) pixels;
+          for (x = 0; x < pixels; x++)
+            out[x * 3 + c] = src[x];
+        }
+      else
+        {
+          const uint16_t *src16 = (const uint16_t *) node->in_row
+            + c * (size_t) pixels;
+          uint16_t *out16 = (uint16_t *) out;
+          for (x = 0; x < pixels; x++)
+            out16[x * 3 + c] = src16[x];
+        }
+    }
+  return SANE_STATUS_GOOD;
+}
+
+static SANE_Status
+expand_bits_get_row (SANEI_Pipeline * p, int index, SANE_Byte * out)
+{
+  Node *node = &p->nodes[index];
+  SANE_Int samples = node->params.bytes_per_line;
+  const SANE_Byte *src;
+  SANE_Status status;
+  SANE_Int x;
+  int bit;
+
+  status = node_get_row (p, index - 1, node->in_row);
+  if (status != SANE_STATUS_GOOD)
+    return status;
+
+  src = node->in_row;
+  for (x = 0; x + 8 <= samples; x += 8, src++)
+    {
+      for (bit = 0; bit < 8; bit++)
+        out[x + bit] = node->bit_values[(*src >> (7 - bit)) & 1];
+    }
+  for (bit = 0; x < samples; x++, bit++)
+    out[x] = node->bit_values[(*src >> (7 - bit)) & 1];
+
+  return SANE_STATUS_GOOD;
+}
+
+static SANE_Status
+rgb_to_gray_get_row (SANEI_Pipeline * p, int index, SANE_Byte * out)
+{
+  Node *node = &p->nodes[index];
+  SANE_Int pixels = node->params.pixels_per_line;
+  SANE_Status status;
+  SANE_Int x;
+
+  status = node_get_row (p, index - 1, node->in_row);
+  if (status != SANE_STATUS_GOOD)
+    return status;
+
+  if (node->params.depth == 8)
+    {
+      const SANE_Byte *src = node->in_row;
+      for (x = 0; x < pixels; x++, src += 3)
+        out[x] = (src[0] * node->weights[0] + src[1] * node->weights[1]
+                  + src[2] * node->weights[2]) / node->weight_sum;
+    }
+  else
+    {
+      const uint16_t *src16 = (const uint16_t *) node->in_row;
+      uint16_t *out16 = (uint16_t *) out;
+      for (x = 0; x < pixels; x++, src16 += 3)
+        out16[x] = ((uint64_t) src16[0] * node->weights[0]
+                    + (uint64_t) src16[1] * node->weights[1]
+                    + (uint64_t) src16[2] * node->weights[2])
+          / node->weight_sum;
+    }
+  return SANE_STATUS_GOOD;
+}
+
+static SANE_Status
+threshold_get_row (SANEI_Pipeline * p, int index, SANE_Byte * out)
+{
+  Node *node = &p->nodes[index];
+  SANE_Int pixels = node->params.pixels_per_line;
+  SANE_Status status;
+  SANE_Int x;
+
+  status = node_get_row (p, index - 1, node->in_row);
+  if (status != SANE_STATUS_GOOD)
+    return status;
+
+  memset (out, 0, node->params.bytes_per_line);
+  for (x = 0; x < pixels; x++)
+    if (node->in_row[x] < node->threshold)
+      out[x / 8] |= 0x80 >> (x % 8);
+
+  return SANE_STATUS_GOOD;
+}
+
+static SANE_Status
+deinterlace_get_row (SANEI_Pipeline * p, int index, SANE_Byte * out)
+{
+  Node *node = &p->nodes[index];
+  SANE_Status status;
+
+  /* the rows of the other images are read into out and overwritten */
+  for (;;)
+    {
+      int image = (node->rows_in / node->group_rows) % node->images;
+
+      status = node_get_row (p, index - 1, out);
+      if (status != SANE_STATUS_GOOD)
+        return status;
+      node->rows_in++;
+
+      if (image == node->image)
+        return SANE_STATUS_GOOD;
+    }
+}
+
+static SANE_Status
+mirror_get_row (SANEI_Pipeline * p, int index, SANE_Byte * out)
+{
+  Node *node = &p->nodes[index];
+  SANE_Int pixels = node->params.pixels_per_line;
+  int channels = get_channels (&node->params);
+  SANE_Status status;
+  SANE_Int x;
+  int c;
+
+  status = node_get_row (p, index - 1, node->in_row);
+  if (status != SANE_STATUS_GOOD)
+    return status;
+
+  if (node->params.depth == 1)
+    {
+      SANE_Int samples = pixels * channels;
+      memset (out, 0, node->params.bytes_per_line);
+      for (x = 0; x < pixels; x++)
+        for (c = 0; c < channels; c++)
+          {
+            SANE_Int src_bit = x * channels + c;
+            SANE_Int dst_bit = samples - (x + 1) * channels + c;
+            if ((node->in_row[src_bit / 8] >> (7 - src_bit % 8)) & 1)
+              out[dst_bit / 8] |= 0x80 >> (dst_bit % 8);
+          }
+    }
+  else
+    {
+      size_t pixel_bytes = channels * node->params.depth / 8;
+      const SANE_Byte *src = node->in_row;
+      SANE_Byte *dst = out + (pixels - 1) * pixel_bytes;
+      for (x = 0; x < pixels; x++, src += pixel_bytes, dst -= pixel_bytes)
+        memcpy (dst, src, pixel_bytes);
+    }
+  return SANE_STATUS_GOOD;
+}
+
+SANE_Status
+sanei_pipeline_new (const SANE_Parameters * params,
+                    SANEI_Pipeline_Read_Func read_func, void *arg,
+                    SANEI_Pipeline ** pipeline)
+{
+  SANEI_Pipeline *p;
+  Node *node;
+
+  DBG_INIT ();
+
+  *pipeline = NULL;
+
+  if ((params->format != SANE_FRAME_GRAY && params->format != SANE_FRAME_RGB)
+      || (params->depth != 1 && params->depth != 8 && params->depth != 16)
+      || params->pixels_per_line <= 0
+      || params->bytes_per_line < get_row_bytes (params))
+    {
+      DBG (1, "%s: unsupported format %d, depth %d, %d pixels, %d bytes\n",
+           __func__, params->format, params->depth, params->pixels_per_line,
+           params->bytes_per_line);
+      return SANE_STATUS_INVAL;
+    }
+
+  p = calloc (1, sizeof (*p));
+  if (!p)
+    return SANE_STATUS_NO_MEM;
+
+  p->read_func = read_func;
+  p->arg = arg;
+
+  node = &p->nodes[0];
+  node->name = "source";
+  node->get_row = source_get_row;
+  node->params = *params;
+  p->num_nodes = 1;
+
+  *pipeline = p;
+  return SANE_STATUS_GOOD;
+}
+
+void
+sanei_pipeline_free (SANEI_Pipeline * p)
+{
+  int i;
+
+  if (!p)
+    return;
+
+  if (DBG_LEVEL >= DBG_STATS)
+    {
+      for (i = 0; i < p->num_nodes; i++)
+        {
+          Node *node = &p->nodes[i];
+          double self_time = node->total_time;
+          if (i > 0)
+            self_time -= p->nodes[i - 1].total_time;
+          DBG (DBG_STATS, "%s: node %d (%s): %d rows, %.3f ms\n", __func__,
+               i, node->name, node->rows_out, self_time * 1000);
+        }
+    }
+
+  while (p->pool)
+    {
+      Pool_Block *next = p->pool->next;
+      free (p->pool);
+      p->pool = next;
+    }
+  free (p);
+}
+
+void
+sanei_pipeline_reset (SANEI_Pipeline * p)
+{
+  int i;
+
+  for (i = 0; i < p->num_nodes; i++)
+    {
+      p->nodes[i].rows_in = 0;
+      p->nodes[i].rows_out = 0;
+      p->nodes[i].total_time = 0;
+    }
+  p->out_pos = 0;
+  p->out_len = 0;
+}
+
+void
+sanei_pipeline_get_parameters (SANEI_Pipeline * p, SANE_Parameters * params)
+{
+  *params = *last_params (p);
+}
+
+SANE_Status
+sanei_pipeline_add_color_shift (SANEI_Pipeline * p, const int shifts[3])
+{
+  const SANE_Parameters *in = last_params (p);
+  SANE_Status status;
+  Node *node;
+  int c;
+
+  if (in->format != SANE_FRAME_RGB || in->depth == 1
+      || shifts[0] < 0 || shifts[1] < 0 || shifts[2] < 0)
+    {
+      DBG (1, "%s: unsupported format or shifts\n", __func__);
+      return SANE_STATUS_INVAL;
+    }
+
+  status = add_node (p, "color_shift", color_shift_get_row, 0, &node);
+  if (status != SANE_STATUS_GOOD)
+    return status;
+
+  for (c = 0; c < 3; c++)
+    {
+      node->shifts[c] = shifts[c];
+      if (shifts[c] > node->max_shift)
+        node->max_shift = shifts[c];
+    }
+  node->ring_rows = node->max_shift + 1;
+  node->ring = pool_alloc (p, node->ring_rows * (size_t) in->bytes_per_line);
+  if (!node->ring)
+    {
+      p->num_nodes--;
+      return SANE_STATUS_NO_MEM;
+    }
+
+  node->params.bytes_per_line = get_row_bytes (&node->params);
+  if (node->params.lines >= 0)
+    {
+      node->params.lines -= node->max_shift;
+      if (node->params.lines < 0)
+        node->params.lines = 0;
+    }
+  return SANE_STATUS_GOOD;
+}
+
+SANE_Status
+sanei_pipeline_add_planar_to_pixel (SANEI_Pipeline * p)
+{
+  const SANE_Parameters *in = last_params (p);
+  SANE_Status status;
+  Node *node;
+
+  if (in->format != SANE_FRAME_RGB || in->depth == 1)
+    {
+      DBG (1, "%s: unsupported format\n", __func__);
+      return SANE_STATUS_INVAL;
+    }
+
+  status = add_node (p, "planar_to_pixel", planar_to_pixel_get_row,
+                     in->bytes_per_line, &node);
+  if (status != SANE_STATUS_GOOD)
+    return status;
+
+  node->params.bytes_per_line = get_row_bytes (&node->params);
+  return SANE_STATUS_GOOD;
+}
+
+SANE_Status
+sanei_pipeline_add_expand_bits (SANEI_Pipeline * p, SANE_Bool invert)
+{
+  const SANE_Parameters *in = last_params (p);
+  SANE_Status status;
+  Node *node;
+
+  if (in->depth != 1)
+    {
+      DBG (1, "%s: unsupported depth %d\n", __func__, in->depth);
+      return SANE_STATUS_INVAL;
+    }
+
+  status = add_node (p, "expand_bits", expand_bits_get_row,
+                     in->bytes_per_line, &node);
+  if (status != SANE_STATUS_GOOD)
+    return status;
+
+  node->bit_values[0] = invert ? 0xff : 0x00;
+  node->bit_values[1] = invert ? 0x00 : 0xff;
+  node->params.depth = 8;
+  node->params.bytes_per_line = get_row_bytes (&node->params);
+  return SANE_STATUS_GOOD;
+}
+
+SANE_Status
+sanei_pipeline_add_rgb_to_gray (SANEI_Pipeline * p)
+{
+  static const int rec709_weights[3] = { 2126, 7152, 722 };
+
+  return sanei_pipeline_add_rgb_to_gray_weighted (p, rec709_weights);
+}
+
+SANE_Status
+sanei_pipeline_add_rgb_to_gray_weighted (SANEI_Pipeline * p,
+                                         const int weights[3])
+{
+  const SANE_Parameters *in = last_params (p);
+  SANE_Status status;
+  Node *node;
+  int c;
+
+  if (in->format != SANE_FRAME_RGB || in->depth == 1
+      || weights[0] < 0 || weights[1] < 0 || weights[2] < 0
+      || weights[0] + weights[1] + weights[2] <= 0)
+    {
+      DBG (1, "%s: unsupported format or weights\n", __func__);
+      return SANE_STATUS_INVAL;
+    }
+
+  status = add_node (p, "rgb_to_gray", rgb_to_gray_get_row,
+                     in->bytes_per_line, &node);
+  if (status != SANE_STATUS_GOOD)
+    return status;
+
+  for (c = 0; c < 3; c++)
+    {
+      node->weights[c] = weights[c];
+      node->weight_sum += weights[c];
+    }
+  node->params.format = SANE_FRAME_GRAY;
+  node->params.bytes_per_line = get_row_bytes (&node->params);
+  return SANE_STATUS_GOOD;
+}
+
+SANE_Status
+sanei_pipeline_add_threshold (SANEI_Pipeline * p, SANE_Int threshold)
+{
+  const SANE_Parameters *in = last_params (p);
+  SANE_Status status;
+  Node *node;
+
+  if (in->format != SANE_FRAME_GRAY || in->depth != 8)
+    {
+      DBG (1, "%s: unsupported format\n", __func__);
+      return SANE_STATUS_INVAL;
+    }
+
+  status = add_node (p, "threshold", threshold_get_row, in->bytes_per_line,
+                     &node);
+  if (status != SANE_STATUS_GOOD)
+    return status;
+
+  node->threshold = threshold;
+  node->params.depth = 1;
+  node->params.bytes_per_line = get_row_bytes (&node->params);
+  return SANE_STATUS_GOOD;
+}
+
+SANE_Status
+sanei_pipeline_add_deinterlace (SANEI_Pipeline * p, int images, int image,
+                                int group_rows)
+{
+  const SANE_Parameters *in = last_params (p);
+  SANE_Status status;
+  Node *node;
+
+  if (images < 1 || image < 0 || image >= images || group_rows < 1)
+    {
+      DBG (1, "%s: invalid image %d of %d, %d rows per group\n", __func__,
+           image, images, group_rows);
+      return SANE_STATUS_INVAL;
+    }
+
+  status = add_node (p, "deinterlace", deinterlace_get_row, 0, &node);
+  if (status != SANE_STATUS_GOOD)
+    return status;
+
+  node->images = images;
+  node->image = image;
+  node->group_rows = group_rows;
+
+  /* rows are passed through unchanged, thus the input padding is kept */
+  node->params.bytes_per_line = in->bytes_per_line;
+  if (in->lines >= 0)
+    {
+      SANE_Int cycle_rows = images * group_rows;
+      SANE_Int rest = in->lines % cycle_rows - image * group_rows;
+
+      node->params.lines = in->lines / cycle_rows * group_rows;
+      if (rest > group_rows)
+        rest = group_rows;
+      if (rest > 0)
+        node->params.lines += rest;
+    }
+  return SANE_STATUS_GOOD;
+}
+
+SANE_Status
+sanei_pipeline_add_mirror (SANEI_Pipeline * p)
+{
+  const SANE_Parameters *in = last_params (p);
+  SANE_Status status;
+  Node *node;
+
+  status = add_node (p, "mirror", mirror_get_row, in->bytes_per_line, &node);
+  if (status != SANE_STATUS_GOOD)
+    return status;
+
+  node->params.bytes_per_line = get_row_bytes (&node->params);
+  return SANE_STATUS_GOOD;
+}
+
+SANE_Status
+sanei_pipeline_read_row (SANEI_Pipeline * p, SANE_Byte * row)
+{
+  return node_get_row (p, p->num_nodes - 1, row);
+}
+
+SANE_Status
+sanei_pipeline_read (SANEI_Pipeline * p, SANE_Byte * buf, SANE_Int max_len,
+                     SANE_Int * len)
+{
+  SANE_Int row_bytes = last_params (p)->bytes_per_line;
+  SANE_Status status;
+
+  *len = 0;
+
+  if (!p->out_row)
+    {
+      p->out_row = pool_alloc (p, row_bytes);
+      if (!p->out_row)
+        return SANE_STATUS_NO_MEM;
+    }
+
+  while (*len < max_len)
+    {
+      SANE_Int count;
+
+      if (p->out_pos == p->out_len)
+        {
+          status = sanei_pipeline_read_row (p, p->out_row);
+          if (status == SANE_STATUS_EOF && *len > 0)
+            return SANE_STATUS_GOOD;
+          if (status != SANE_STATUS_GOOD)
+            return status;
+          p->out_pos = 0;
+          p->out_len = row_bytes;
+        }
+
+      count = p->out_len - p->out_pos;
+      if (count > max_len - *len)
+        count = max_len - *len;
+      memcpy (buf + *len, p->out_row + p->out_pos, count);
+      p->out_pos += count;
+      *len += count;
+    }
+  return SANE_STATUS_GOOD;
+}
@@ -50,6 +50,7 @@
 # include <stdint.h>
 #endif
 #include <stdlib.h>
+#include <limits.h>
 #include <ctype.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -63,9 +64,16 @@
 #include <stdio.h>
 #include <dirent.h>
 #include <time.h>
+#include <signal.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
 
 #if WITH_USB_RECORD_REPLAY
 #include <libxml/tree.h>
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <sys/mman.h>
+#endif
 #endif
 
 #ifdef HAVE_RESMGR
@@ -206,6 +214,44 @@ static xmlNode* testing_append_commands_node = NULL;
 static SANE_String testing_xml_path = NULL;
 static xmlDoc* testing_xml_doc = NULL;
 static xmlNode* testing_xml_next_tx_node = NULL;
+
+// Transaction payload stored out of line in a binary capture. Replayed nodes
+// point to it via xmlNode::_private instead of carrying a hex text child.
+typedef struct
+{
+  const char* data;
+  size_t size;
+} sanei_usb_capture_payload;
+
+// Binary capture file contents, either memory-mapped or read into memory
+typedef struct
+{
+  char* data;
+  size_t size;
+  int is_mmap;
+  sanei_usb_capture_payload* payloads;
+  size_t num_payloads;
+  size_t max_payloads;
+
+  // regions of the file
+  const char* strings;
+  size_t strings_size;
+  const char* nodes;
+  size_t nodes_size;
+  const char* index;
+  uint32_t num_index;
+  const char* payload;
+  size_t payload_size;
+
+  // transactions element whose children are loaded from the index when
+  // replay reaches them, NULL if the whole tree has been loaded
+  xmlNode* lazy_parent;
+  uint32_t lazy_next;
+} sanei_usb_capture_map;
+
+// set if testing_xml_path refers to a binary capture
+static int testing_capture_is_binary = 0;
+static sanei_usb_capture_map testing_capture_map;
 #endif // WITH_USB_RECORD_REPLAY
 
 #if defined(HAVE_LIBUSB_LEGACY) || defined(HAVE_LIBUSB)
@@ -498,6 +544,15 @@ sanei_libusb_strerror (int errcode)
 #endif /* HAVE_LIBUSB */
 
 #if WITH_USB_RECORD_REPLAY
+static int sanei_usb_capture_is_binary(const char* path);
+static int sanei_usb_capture_has_binary_extension(const char* path);
+static xmlDoc* sanei_usb_capture_load_binary(const char* path,
+                                             sanei_usb_capture_map* map,
+                                             int lazy);
+static xmlNode* sanei_usb_capture_load_next_tx(sanei_usb_capture_map* map);
+static SANE_Status sanei_usb_capture_save_binary(xmlDoc* doc, const char* path);
+static void sanei_usb_capture_unmap(sanei_usb_capture_map* map);
+
 SANE_Status sanei_usb_testing_enable_replay(SANE_String_Const path,
                                             int development_mode)
 {
@@ -506,7 +561,15 @@ SANE_Status sanei_usb_testing_enable_replay(SANE_String_Const path,
 
   // TODO: we'll leak if no one ever inits sane_usb properly
   testing_xml_path = strdup(path);
-  testing_xml_doc = xmlReadFile(testing_xml_path, NULL, 0);
+  testing_capture_is_binary = sanei_usb_capture_is_binary(testing_xml_path);
+  // development mode edits and saves the whole tree, so the transactions
+  // are loaded on demand only for plain replay
+  if (testing_capture_is_binary)
+    testing_xml_doc = sanei_usb_capture_load_binary(testing_xml_path,
+                                                    &testing_capture_map,
+                                                    !development_mode);
+  else
+    testing_xml_doc = xmlReadFile(testing_xml_path, NULL, 0);
   if (!testing_xml_doc)
     return SANE_STATUS_ACCESS_DENIED;
 
@@ -537,6 +600,8 @@ SANE_Status sanei_usb_testing_enable_record(SANE_String_Const path, SANE_String_
   testing_mode = sanei_usb_testing_mode_record;
   testing_record_backend = strdup(be_name);
   testing_xml_path = strdup(path);
+  testing_capture_is_binary =
+      sanei_usb_capture_has_binary_extension(testing_xml_path);
 
   return SANE_STATUS_GOOD;
 }
@@ -633,6 +698,17 @@ static int sanei_xml_is_transaction_ignored(xmlNode* node)
   return 0;
 }
 
+// Returns the element following a transaction node. The transactions of a
+// binary capture are loaded from its index as replay reaches them.
+static xmlNode* sanei_xml_next_tx_sibling(xmlNode* node)
+{
+  xmlNode* next = xmlNextElementSibling(node);
+  if (next == NULL && testing_capture_map.lazy_parent != NULL &&
+      node->parent == testing_capture_map.lazy_parent)
+    next = sanei_usb_capture_load_next_tx(&testing_capture_map);
+  return next;
+}
+
 static xmlNode* sanei_xml_skip_non_tx_nodes(xmlNode* node)
 {
   const char* known_node_names[] = {
@@ -658,7 +734,7 @@ static xmlNode* sanei_xml_skip_non_tx_nodes(xmlNode* node)
           break;
         }
 
-      node = xmlNextElementSibling(node);
+      node = sanei_xml_next_tx_sibling(node);
     }
   return node;
 }
@@ -685,8 +761,20 @@ static xmlNode* sanei_xml_get_next_tx_node()
       return next;
     }
 
+  // transactions loaded on demand are released once they have been
+  // replayed, only the one returned now is still in use
+  if (testing_capture_map.lazy_parent != NULL && next != NULL)
+    {
+      xmlNode* prev;
+      while ((prev = xmlPreviousElementSibling(next)) != NULL)
+        {
+          xmlUnlinkNode(prev);
+          xmlFreeNode(prev);
+        }
+    }
+
   testing_xml_next_tx_node =
-      xmlNextElementSibling(testing_xml_next_tx_node);
+      sanei_xml_next_tx_sibling(testing_xml_next_tx_node);
 
   testing_xml_next_tx_node =
       sanei_xml_skip_non_tx_nodes(testing_xml_next_tx_node);
@@ -763,6 +851,16 @@ static char* sanei_xml_get_hex_data_slow_path(xmlNode* node, xmlChar* content, x
 // freeing the returned value
 static char* sanei_xml_get_hex_data(xmlNode* node, size_t* size)
 {
+  // nodes loaded from a binary capture reference the payload directly
+  if (node->_private != NULL)
+    {
+      const sanei_usb_capture_payload* payload = node->_private;
+      char* ret_data = malloc(payload->size + 1);
+      memcpy(ret_data, payload->data, payload->size);
+      *size = payload->size;
+      return ret_data;
+    }
+
   xmlChar* content = xmlNodeGetContent(node);
 
   // let's overallocate to simplify the implementation. We expect the string
@@ -1061,6 +1159,14 @@ SANE_Bool sanei_usb_is_replay_mode_enabled()
   return SANE_FALSE;
 }
 
+SANE_Bool sanei_usb_is_record_mode_enabled()
+{
+  if (testing_mode == sanei_usb_testing_mode_record)
+    return SANE_TRUE;
+
+  return SANE_FALSE;
+}
+
 static void sanei_usb_record_debug_msg(xmlNode* node, SANE_String_Const message)
 {
   int node_was_null = node == NULL;
@@ -1180,202 +1286,1804 @@ static SANE_Status sanei_usb_testing_init()
       return SANE_STATUS_INVAL;
     }
 
-  int device_id = sanei_xml_get_prop_uint(el_description, "id_vendor");
-  if (device_id < 0)
+  int device_id = sanei_xml_get_prop_uint(el_description, "id_vendor");
+  if (device_id < 0)
+    {
+      DBG(1, "%s: no id_vendor attr in description node\n", __func__);
+      return SANE_STATUS_INVAL;
+    }
+
+  int product_id = sanei_xml_get_prop_uint(el_description, "id_product");
+  if (product_id < 0)
+    {
+      DBG(1, "%s: no id_product attr in description node\n", __func__);
+      return SANE_STATUS_INVAL;
+    }
+
+  xmlNode* el_configurations =
+      sanei_xml_find_first_child_with_name(el_description, "configurations");
+  if (el_configurations == NULL)
+    {
+      DBG(1, "%s: could not find configurations node\n", __func__);
+      return SANE_STATUS_INVAL;
+    }
+
+  xmlNode* el_configuration =
+      sanei_xml_find_first_child_with_name(el_configurations, "configuration");
+  if (el_configuration == NULL)
+    {
+      DBG(1, "%s: no configuration nodes\n", __func__);
+      return SANE_STATUS_INVAL;
+    }
+
+  while (el_configuration != NULL)
+    {
+      xmlNode* el_interface =
+          sanei_xml_find_first_child_with_name(el_configuration, "interface");
+
+      while (el_interface != NULL)
+        {
+          device_list_type device;
+          memset(&device, 0, sizeof(device));
+          device.devname = strdup(testing_xml_path);
+
+          // other code shouldn't depend on method because testing_mode is
+          // sanei_usb_testing_mode_replay
+          device.method = sanei_usb_method_libusb;
+          device.vendor = device_id;
+          device.product = product_id;
+
+          device.interface_nr = sanei_xml_get_prop_uint(el_interface, "number");
+          if (device.interface_nr < 0)
+            {
+              DBG(1, "%s: no number attr in interface node\n", __func__);
+              return SANE_STATUS_INVAL;
+            }
+
+          xmlNode* el_endpoint =
+              sanei_xml_find_first_child_with_name(el_interface, "endpoint");
+
+          while (el_endpoint != NULL)
+            {
+              char* transfer_attr = sanei_xml_get_prop(el_endpoint,
+                                                       "transfer_type");
+              int address = sanei_xml_get_prop_uint(el_endpoint, "address");
+              char* direction_attr = sanei_xml_get_prop(el_endpoint,
+                                                        "direction");
+
+              int direction_is_in = strcmp(direction_attr, "IN") == 0 ? 1 : 0;
+              int transfer_type = -1;
+              if (strcmp(transfer_attr, "INTERRUPT") == 0)
+                transfer_type = USB_ENDPOINT_TYPE_INTERRUPT;
+              else if (strcmp(transfer_attr, "BULK") == 0)
+                transfer_type = USB_ENDPOINT_TYPE_BULK;
+              else if (strcmp(transfer_attr, "ISOCHRONOUS") == 0)
+                transfer_type = USB_ENDPOINT_TYPE_ISOCHRONOUS;
+              else if (strcmp(transfer_attr, "CONTROL") == 0)
+                transfer_type = USB_ENDPOINT_TYPE_CONTROL;
+              else
+                {
+                  DBG(3, "%s: unknown endpoint type %s\n",
+                      __func__, transfer_attr);
+                }
+
+              if (transfer_type >= 0)
+                {
+                  sanei_usb_add_endpoint(&device, transfer_type, address,
+                                         direction_is_in);
+                }
+
+              xmlFree(transfer_attr);
+              xmlFree(direction_attr);
+
+              el_endpoint =
+                  sanei_xml_find_next_child_with_name(el_endpoint, "endpoint");
+            }
+          device.alt_setting = 0;
+          device.missing = 0;
+
+          memcpy(&(devices[device_number]), &device, sizeof(device));
+          device_number++;
+
+          el_interface = sanei_xml_find_next_child_with_name(el_interface,
+                                                             "interface");
+        }
+      el_configuration =
+            sanei_xml_find_next_child_with_name(el_configurations,
+                                                "configuration");
+    }
+
+  xmlNode* el_transactions =
+      sanei_xml_find_first_child_with_name(el_root, "transactions");
+
+  if (el_transactions == NULL)
+    {
+      DBG(1, "%s: could not find transactions node\n", __func__);
+      return SANE_STATUS_INVAL;
+    }
+
+  xmlNode* el_transaction = xmlFirstElementChild(el_transactions);
+  if (el_transaction == NULL &&
+      el_transactions == testing_capture_map.lazy_parent)
+    el_transaction = sanei_usb_capture_load_next_tx(&testing_capture_map);
+  el_transaction = sanei_xml_skip_non_tx_nodes(el_transaction);
+
+  if (el_transaction == NULL)
+    {
+      DBG(1, "%s: no transactions within capture\n", __func__);
+      return SANE_STATUS_INVAL;
+    }
+
+  testing_xml_next_tx_node = el_transaction;
+
+  return SANE_STATUS_GOOD;
+}
+
+static void sanei_usb_testing_exit()
+{
+  if (testing_development_mode || testing_mode == sanei_usb_testing_mode_record)
+    {
+      if (testing_mode == sanei_usb_testing_mode_record)
+        {
+          xmlAddNextSibling(testing_append_commands_node, xmlNewText((const xmlChar*)"\n  "));
+          free(testing_record_backend);
+        }
+      if (testing_capture_is_binary)
+        sanei_usb_capture_save_binary(testing_xml_doc, testing_xml_path);
+      else
+        xmlSaveFileEnc(testing_xml_path, testing_xml_doc, "UTF-8");
+    }
+  xmlFreeDoc(testing_xml_doc);
+  sanei_usb_capture_unmap(&testing_capture_map);
+  free(testing_xml_path);
+  xmlCleanupParser();
+
+  // reset testing-related all data to initial values
+  testing_development_mode = 0;
+  testing_already_opened = 0;
+  testing_known_commands_input_failed = 0;
+  testing_last_known_seq = 0;
+  testing_record_backend = NULL;
+  testing_append_commands_node = NULL;
+
+  testing_xml_path = NULL;
+  testing_xml_doc = NULL;
+  testing_xml_next_tx_node = NULL;
+  testing_capture_is_binary = 0;
+}
+
+/* Binary capture format.
+
+   The binary format stores the same document tree as an XML capture in a
+   compact form and keeps the transaction payloads out of line, so that they
+   are used directly from the memory-mapped file instead of being stored and
+   decoded as hex text. Whitespace-only text and comments are not preserved.
+
+   When replaying, only the description and the empty transactions element
+   are loaded into the DOM. Each transaction is loaded through the index
+   when replay reaches it and freed after it has been replayed, so loading
+   takes the same time for any capture size and the DOM stays small. The
+   replay code itself is shared between both formats. In development mode
+   the whole tree is loaded, as it is edited and saved again.
+
+   The hex text of control_tx, bulk_tx and interrupt_tx elements is stored
+   as a payload, so that captures recorded in the XML format benefit from
+   conversion. Text of these elements that is not hex data and the text of
+   any other element is stored as a string.
+
+   All integers are 32-bit little endian. The file consists of:
+
+   header   - "SANEUSBC" magic followed by the fields below
+   strings  - deduplicated NUL-terminated strings, referenced by offset
+   nodes    - element records in document order: name, attribute count,
+              child element count, content type, content offset, content
+              size, followed by (key, value) pairs of the attributes.
+              Children immediately follow their parent.
+   index    - (seq, node offset, payload offset, payload size) for each
+              child of the transactions element, offsets are relative to
+              the start of their region
+   payloads - transaction data, each chunk aligned to 8 bytes
+
+   Captures are written in this format if the file name ends with
+   ".usbcap". When replaying, the format is detected from the magic.
+*/
+#define CAPTURE_MAGIC "SANEUSBC"
+#define CAPTURE_MAGIC_SIZE 8
+#define CAPTURE_VERSION 1
+#define CAPTURE_EXTENSION ".usbcap"
+#define CAPTURE_HEADER_SIZE 64
+#define CAPTURE_NODE_SIZE 24
+#define CAPTURE_INDEX_ENTRY_SIZE 16
+#define CAPTURE_ALIGN 8
+#define CAPTURE_MAX_DEPTH 32
+
+// offsets of the header fields
+#define CAPTURE_HDR_VERSION 8
+#define CAPTURE_HDR_STRINGS_OFFSET 12
+#define CAPTURE_HDR_STRINGS_SIZE 16
+#define CAPTURE_HDR_NODES_OFFSET 20
+#define CAPTURE_HDR_NODES_SIZE 24
+#define CAPTURE_HDR_NUM_NODES 28
+#define CAPTURE_HDR_INDEX_OFFSET 32
+#define CAPTURE_HDR_NUM_INDEX 36
+#define CAPTURE_HDR_PAYLOAD_OFFSET 40
+#define CAPTURE_HDR_PAYLOAD_SIZE 44
+
+enum
+{
+  CAPTURE_CONTENT_NONE = 0,
+  CAPTURE_CONTENT_PAYLOAD = 1,
+  CAPTURE_CONTENT_TEXT = 2
+};
+
+static uint32_t sanei_usb_capture_get_u32(const char* p)
+{
+  const uint8_t* u = (const uint8_t*) p;
+  return u[0] | (u[1] << 8) | (u[2] << 16) | ((uint32_t) u[3] << 24);
+}
+
+static void sanei_usb_capture_set_u32(char* p, uint32_t value)
+{
+  p[0] = value & 0xff;
+  p[1] = (value >> 8) & 0xff;
+  p[2] = (value >> 16) & 0xff;
+  p[3] = (value >> 24) & 0xff;
+}
+
+static size_t sanei_usb_capture_align(size_t value)
+{
+  return (value + CAPTURE_ALIGN - 1) & ~(size_t) (CAPTURE_ALIGN - 1);
+}
+
+static int sanei_usb_capture_is_binary(const char* path)
+{
+  char magic[CAPTURE_MAGIC_SIZE];
+  FILE* f = fopen(path, "rb");
+  if (f == NULL)
+    return 0;
+
+  size_t read_size = fread(magic, 1, CAPTURE_MAGIC_SIZE, f);
+  fclose(f);
+  return read_size == CAPTURE_MAGIC_SIZE &&
+      memcmp(magic, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE) == 0;
+}
+
+static int sanei_usb_capture_has_binary_extension(const char* path)
+{
+  size_t len = strlen(path);
+  size_t ext_len = strlen(CAPTURE_EXTENSION);
+  return len > ext_len && strcmp(path + len - ext_len, CAPTURE_EXTENSION) == 0;
+}
+
+static void sanei_usb_capture_unmap(sanei_usb_capture_map* map)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+  if (map->is_mmap)
+    munmap(map->data, map->size);
+  else
+#endif
+    free(map->data);
+  free(map->payloads);
+  memset(map, 0, sizeof(*map));
+}
+
+// returns 1 on success
+static int sanei_usb_capture_map_file(const char* path,
+                                      sanei_usb_capture_map* map)
+{
+  memset(map, 0, sizeof(*map));
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    {
+      DBG(1, "%s: could not open %s: %s\n", __func__, path, strerror(errno));
+      return 0;
+    }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size < CAPTURE_HEADER_SIZE)
+    {
+      DBG(1, "%s: %s is too short\n", __func__, path);
+      close(fd);
+      return 0;
+    }
+  map->size = st.st_size;
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+  void* data = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data != MAP_FAILED)
+    {
+      map->data = data;
+      map->is_mmap = 1;
+      close(fd);
+      return 1;
+    }
+  DBG(3, "%s: mmap failed, reading the file instead\n", __func__);
+#endif
+
+  map->data = malloc(map->size);
+  if (map->data == NULL)
+    {
+      close(fd);
+      return 0;
+    }
+
+  size_t done = 0;
+  while (done < map->size)
+    {
+      ssize_t ret = read(fd, map->data + done, map->size - done);
+      if (ret < 0 && errno == EINTR)
+        continue;
+      if (ret <= 0)
+        {
+          DBG(1, "%s: could not read %s\n", __func__, path);
+          close(fd);
+          sanei_usb_capture_unmap(map);
+          return 0;
+        }
+      done += ret;
+    }
+  close(fd);
+  return 1;
+}
+
+typedef struct
+{
+  sanei_usb_capture_map* map;
+  size_t nodes_pos;
+} sanei_usb_capture_reader;
+
+static const char* sanei_usb_capture_get_string(sanei_usb_capture_reader* r,
+                                                uint32_t offset)
+{
+  sanei_usb_capture_map* map = r->map;
+  if (offset >= map->strings_size)
+    return NULL;
+  if (memchr(map->strings + offset, 0, map->strings_size - offset) == NULL)
+    return NULL;
+  return map->strings + offset;
+}
+
+// Skips the node record at the current position and its children. Returns 0
+// if the node data is corrupt.
+static int sanei_usb_capture_skip_node(sanei_usb_capture_reader* r, int depth)
+{
+  sanei_usb_capture_map* map = r->map;
+  if (depth > CAPTURE_MAX_DEPTH ||
+      map->nodes_size - r->nodes_pos < CAPTURE_NODE_SIZE)
+    return 0;
+
+  const char* rec = map->nodes + r->nodes_pos;
+  uint32_t num_attrs = sanei_usb_capture_get_u32(rec + 4);
+  uint32_t num_children = sanei_usb_capture_get_u32(rec + 8);
+
+  r->nodes_pos += CAPTURE_NODE_SIZE;
+  if (num_attrs > (map->nodes_size - r->nodes_pos) / 8)
+    return 0;
+  r->nodes_pos += num_attrs * 8;
+
+  for (uint32_t i = 0; i < num_children; ++i)
+    {
+      if (!sanei_usb_capture_skip_node(r, depth + 1))
+        return 0;
+    }
+  return 1;
+}
+
+// Reads the node record at the current position and its children. If lazy
+// is set, the children of the transactions element are skipped and loaded
+// later by sanei_usb_capture_load_next_tx(). Returns NULL if the node data
+// is corrupt.
+static xmlNode* sanei_usb_capture_read_node(sanei_usb_capture_reader* r,
+                                            int depth, int lazy)
+{
+  sanei_usb_capture_map* map = r->map;
+  if (depth > CAPTURE_MAX_DEPTH ||
+      map->nodes_size - r->nodes_pos < CAPTURE_NODE_SIZE)
+    return NULL;
+
+  const char* rec = map->nodes + r->nodes_pos;
+  const char* name = sanei_usb_capture_get_string(r,
+                                                  sanei_usb_capture_get_u32(rec));
+  uint32_t num_attrs = sanei_usb_capture_get_u32(rec + 4);
+  uint32_t num_children = sanei_usb_capture_get_u32(rec + 8);
+  uint32_t content_type = sanei_usb_capture_get_u32(rec + 12);
+  uint32_t content_offset = sanei_usb_capture_get_u32(rec + 16);
+  uint32_t content_size = sanei_usb_capture_get_u32(rec + 20);
+
+  r->nodes_pos += CAPTURE_NODE_SIZE;
+
+  if (name == NULL || num_attrs > (map->nodes_size - r->nodes_pos) / 8)
+    return NULL;
+
+  xmlNode* node = xmlNewNode(NULL, (const xmlChar*) name);
+
+  for (uint32_t i = 0; i < num_attrs; ++i)
+    {
+      const char* attr = map->nodes + r->nodes_pos;
+      const char* key =
+          sanei_usb_capture_get_string(r, sanei_usb_capture_get_u32(attr));
+      const char* value =
+          sanei_usb_capture_get_string(r, sanei_usb_capture_get_u32(attr + 4));
+      r->nodes_pos += 8;
+      if (key == NULL || value == NULL)
+        {
+          xmlFreeNode(node);
+          return NULL;
+        }
+      xmlNewProp(node, (const xmlChar*) key, (const xmlChar*) value);
+    }
+
+  switch (content_type)
+    {
+      case CAPTURE_CONTENT_NONE:
+        break;
+      case CAPTURE_CONTENT_PAYLOAD:
+        {
+          if (content_offset > map->payload_size ||
+              content_size > map->payload_size - content_offset ||
+              map->num_payloads == map->max_payloads)
+            {
+              xmlFreeNode(node);
+              return NULL;
+            }
+          sanei_usb_capture_payload* payload =
+              &map->payloads[map->num_payloads++];
+          payload->data = map->payload + content_offset;
+          payload->size = content_size;
+          node->_private = payload;
+          break;
+        }
+      case CAPTURE_CONTENT_TEXT:
+        {
+          const char* text = sanei_usb_capture_get_string(r, content_offset);
+          if (text == NULL)
+            {
+              xmlFreeNode(node);
+              return NULL;
+            }
+          xmlAddChild(node, xmlNewText((const xmlChar*) text));
+          break;
+        }
+      default:
+        xmlFreeNode(node);
+        return NULL;
+    }
+
+  if (lazy && depth == 1 && map->lazy_parent == NULL &&
+      num_children > 0 && num_children == map->num_index &&
+      xmlStrcmp(node->name, (const xmlChar*)"transactions") == 0)
+    {
+      // continue after the last transaction, the transactions themselves
+      // are loaded through the index
+      const char* last = map->index +
+          (map->num_index - 1) * CAPTURE_INDEX_ENTRY_SIZE;
+      r->nodes_pos = sanei_usb_capture_get_u32(last + 4);
+      if (r->nodes_pos > map->nodes_size ||
+          !sanei_usb_capture_skip_node(r, depth + 1))
+        {
+          xmlFreeNode(node);
+          return NULL;
+        }
+      map->lazy_parent = node;
+      map->lazy_next = 0;
+      return node;
+    }
+
+  for (uint32_t i = 0; i < num_children; ++i)
+    {
+      xmlNode* child = sanei_usb_capture_read_node(r, depth + 1, lazy);
+      if (child == NULL)
+        {
+          xmlFreeNode(node);
+          return NULL;
+        }
+      xmlAddChild(node, child);
+    }
+  return node;
+}
+
+// Loads the next transaction of a capture loaded with lazy set and appends
+// it to the transactions element. Returns NULL if there are no more
+// transactions or the capture is corrupt.
+static xmlNode* sanei_usb_capture_load_next_tx(sanei_usb_capture_map* map)
+{
+  if (map->lazy_parent == NULL || map->lazy_next >= map->num_index)
+    return NULL;
+
+  const char* entry = map->index + map->lazy_next * CAPTURE_INDEX_ENTRY_SIZE;
+  map->lazy_next++;
+
+  sanei_usb_capture_reader r;
+  r.map = map;
+  r.nodes_pos = sanei_usb_capture_get_u32(entry + 4);
+
+  xmlNode* node = NULL;
+  if (r.nodes_pos <= map->nodes_size)
+    node = sanei_usb_capture_read_node(&r, 2, 0);
+  if (node == NULL)
+    {
+      DBG(1, "%s: corrupt transaction %u\n", __func__,
+          (unsigned) map->lazy_next - 1);
+      map->lazy_next = map->num_index;
+      return NULL;
+    }
+  xmlAddChild(map->lazy_parent, node);
+  return node;
+}
+
+// returns 1 if the region is within the file
+static int sanei_usb_capture_check_region(sanei_usb_capture_map* map,
+                                          uint32_t offset, uint32_t size)
+{
+  return offset <= map->size && size <= map->size - offset;
+}
+
+// Loads a binary capture. If lazy is set, the transactions are not loaded
+// into the tree, see sanei_usb_capture_load_next_tx().
+static xmlDoc* sanei_usb_capture_load_binary(const char* path,
+                                             sanei_usb_capture_map* map,
+                                             int lazy)
+{
+  if (!sanei_usb_capture_map_file(path, map))
+    return NULL;
+
+  const char* hdr = map->data;
+  uint32_t version = sanei_usb_capture_get_u32(hdr + CAPTURE_HDR_VERSION);
+  if (memcmp(hdr, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE) != 0 ||
+      version != CAPTURE_VERSION)
+    {
+      DBG(1, "%s: %s is not a supported capture (version %u)\n", __func__,
+          path, version);
+      sanei_usb_capture_unmap(map);
+      return NULL;
+    }
+
+  uint32_t strings_offset =
+      sanei_usb_capture_get_u32(hdr + CAPTURE_HDR_STRINGS_OFFSET);
+  uint32_t strings_size =
+      sanei_usb_capture_get_u32(hdr + CAPTURE_HDR_STRINGS_SIZE);
+  uint32_t nodes_offset =
+      sanei_usb_capture_get_u32(hdr + CAPTURE_HDR_NODES_OFFSET);
+  uint32_t nodes_size = sanei_usb_capture_get_u32(hdr + CAPTURE_HDR_NODES_SIZE);
+  uint32_t num_nodes = sanei_usb_capture_get_u32(hdr + CAPTURE_HDR_NUM_NODES);
+  uint32_t index_offset =
+      sanei_usb_capture_get_u32(hdr + CAPTURE_HDR_INDEX_OFFSET);
+  uint32_t num_index = sanei_usb_capture_get_u32(hdr + CAPTURE_HDR_NUM_INDEX);
+  uint32_t payload_offset =
+      sanei_usb_capture_get_u32(hdr + CAPTURE_HDR_PAYLOAD_OFFSET);
+  uint32_t payload_size =
+      sanei_usb_capture_get_u32(hdr + CAPTURE_HDR_PAYLOAD_SIZE);
+
+  if (!sanei_usb_capture_check_region(map, strings_offset, strings_size) ||
+      !sanei_usb_capture_check_region(map, nodes_offset, nodes_size) ||
+      num_index > map->size / CAPTURE_INDEX_ENTRY_SIZE ||
+      !sanei_usb_capture_check_region(map, index_offset,
+                                      num_index * CAPTURE_INDEX_ENTRY_SIZE) ||
+      !sanei_usb_capture_check_region(map, payload_offset, payload_size) ||
+      num_nodes == 0 || num_nodes > nodes_size / CAPTURE_NODE_SIZE)
+    {
+      DBG(1, "%s: %s is corrupt\n", __func__, path);
+      sanei_usb_capture_unmap(map);
+      return NULL;
+    }
+
+  map->max_payloads = num_nodes;
+  map->payloads = malloc(num_nodes * sizeof(sanei_usb_capture_payload));
+  if (map->payloads == NULL)
+    {
+      sanei_usb_capture_unmap(map);
+      return NULL;
+    }
+
+  map->strings = map->data + strings_offset;
+  map->strings_size = strings_size;
+  map->nodes = map->data + nodes_offset;
+  map->nodes_size = nodes_size;
+  map->index = map->data + index_offset;
+  map->num_index = num_index;
+  map->payload = map->data + payload_offset;
+  map->payload_size = payload_size;
+
+  sanei_usb_capture_reader r;
+  r.map = map;
+  r.nodes_pos = 0;
+
+  xmlNode* root = sanei_usb_capture_read_node(&r, 0, lazy);
+  if (root == NULL)
+    {
+      DBG(1, "%s: %s has corrupt node data\n", __func__, path);
+      sanei_usb_capture_unmap(map);
+      return NULL;
+    }
+
+  xmlDoc* doc = xmlNewDoc((const xmlChar*)"1.0");
+  xmlDocSetRootElement(doc, root);
+  return doc;
+}
+
+typedef struct
+{
+  char* data;
+  size_t size;
+  size_t capacity;
+} sanei_usb_capture_buf;
+
+typedef struct
+{
+  sanei_usb_capture_buf strings;
+  sanei_usb_capture_buf nodes;
+  sanei_usb_capture_buf index;
+  sanei_usb_capture_buf payload;
+
+  // open addressing table of string offsets + 1, 0 denotes an empty slot
+  uint32_t* string_table;
+  size_t string_table_size;
+  size_t num_strings;
+
+  uint32_t num_nodes;
+  uint32_t num_index;
+  int failed;
+} sanei_usb_capture_writer;
+
+static char* sanei_usb_capture_buf_extend(sanei_usb_capture_writer* w,
+                                          sanei_usb_capture_buf* buf,
+                                          size_t size)
+{
+  if (buf->size + size > buf->capacity)
+    {
+      size_t capacity = buf->capacity ? buf->capacity : 4096;
+      while (capacity < buf->size + size)
+        capacity *= 2;
+      char* data = realloc(buf->data, capacity);
+      if (data == NULL)
+        {
+          w->failed = 1;
+          return NULL;
+        }
+      buf->data = data;
+      buf->capacity = capacity;
+    }
+  char* ret = buf->data + buf->size;
+  buf->size += size;
+  return ret;
+}
+
+static void sanei_usb_capture_buf_append(sanei_usb_capture_writer* w,
+                                         sanei_usb_capture_buf* buf,
+                                         const void* data, size_t size)
+{
+  char* dst = sanei_usb_capture_buf_extend(w, buf, size);
+  if (dst != NULL)
+    memcpy(dst, data, size);
+}
+
+static void sanei_usb_capture_buf_append_u32(sanei_usb_capture_writer* w,
+                                             sanei_usb_capture_buf* buf,
+                                             uint32_t value)
+{
+  char* dst = sanei_usb_capture_buf_extend(w, buf, 4);
+  if (dst != NULL)
+    sanei_usb_capture_set_u32(dst, value);
+}
+
+static uint32_t sanei_usb_capture_hash_string(const char* str)
+{
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  while (*str)
+    {
+      hash ^= (uint8_t) *str++;
+      hash *= 16777619u;
+    }
+  return hash;
+}
+
+static void sanei_usb_capture_grow_string_table(sanei_usb_capture_writer* w)
+{
+  size_t new_size = w->string_table_size ? w->string_table_size * 2 : 1024;
+  uint32_t* table = calloc(new_size, sizeof(uint32_t));
+  if (table == NULL)
+    {
+      w->failed = 1;
+      return;
+    }
+
+  for (size_t i = 0; i < w->string_table_size; ++i)
+    {
+      uint32_t entry = w->string_table[i];
+      if (entry == 0)
+        continue;
+      size_t slot = sanei_usb_capture_hash_string(w->strings.data + entry - 1) &
+          (new_size - 1);
+      while (table[slot] != 0)
+        slot = (slot + 1) & (new_size - 1);
+      table[slot] = entry;
+    }
+  free(w->string_table);
+  w->string_table = table;
+  w->string_table_size = new_size;
+}
+
+// returns the offset of the string within the string region
+static uint32_t sanei_usb_capture_add_string(sanei_usb_capture_writer* w,
+                                             const char* str)
+{
+  if ((w->num_strings + 1) * 2 > w->string_table_size)
+    sanei_usb_capture_grow_string_table(w);
+  if (w->failed)
+    return 0;
+
+  size_t mask = w->string_table_size - 1;
+  size_t slot = sanei_usb_capture_hash_string(str) & mask;
+  while (w->string_table[slot] != 0)
+    {
+      uint32_t offset = w->string_table[slot] - 1;
+      if (strcmp(w->strings.data + offset, str) == 0)
+        return offset;
+      slot = (slot + 1) & mask;
+    }
+
+  uint32_t offset = w->strings.size;
+  sanei_usb_capture_buf_append(w, &w->strings, str, strlen(str) + 1);
+  w->string_table[slot] = offset + 1;
+  w->num_strings++;
+  return offset;
+}
+
+// Parses the hex text written by sanei_xml_set_hex_data into the payload
+// region. Returns 0 and leaves the payload region unchanged if the text is
+// not valid hex data.
+static int sanei_usb_capture_parse_hex(sanei_usb_capture_writer* w,
+                                       const char* text)
+{
+  size_t start_size = w->payload.size;
+  int num_nibbles = 0;
+  unsigned cur_nibble = 0;
+
+  for (; *text != 0; text++)
+    {
+      int8_t ci = sanei_xml_char_types[(uint8_t) *text];
+      if (ci == CHAR_TYPE_SPACE)
+        continue;
+      if (ci == CHAR_TYPE_INVALID)
+        {
+          w->payload.size = start_size;
+          return 0;
+        }
+
+      cur_nibble = (cur_nibble << 4) | ci;
+      if (++num_nibbles == 2)
+        {
+          char c = cur_nibble;
+          sanei_usb_capture_buf_append(w, &w->payload, &c, 1);
+          cur_nibble = 0;
+          num_nibbles = 0;
+        }
+    }
+
+  if (num_nibbles != 0)
+    {
+      w->payload.size = start_size;
+      return 0;
+    }
+  return 1;
+}
+
+static int sanei_usb_capture_is_blank(const char* text)
+{
+  for (; *text != 0; text++)
+    {
+      if (sanei_xml_char_types[(uint8_t) *text] != CHAR_TYPE_SPACE)
+        return 0;
+    }
+  return 1;
+}
+
+// returns 1 if the text of the node is transaction data
+static int sanei_usb_capture_is_data_node(xmlNode* node)
+{
+  return xmlStrcmp(node->name, (const xmlChar*)"control_tx") == 0 ||
+      xmlStrcmp(node->name, (const xmlChar*)"bulk_tx") == 0 ||
+      xmlStrcmp(node->name, (const xmlChar*)"interrupt_tx") == 0;
+}
+
+static void sanei_usb_capture_add_node(sanei_usb_capture_writer* w,
+                                       xmlNode* node, int is_transaction)
+{
+  uint32_t num_attrs = 0;
+  for (xmlAttr* attr = node->properties; attr != NULL; attr = attr->next)
+    num_attrs++;
+
+  uint32_t num_children = 0;
+  for (xmlNode* child = xmlFirstElementChild(node); child != NULL;
+       child = xmlNextElementSibling(child))
+    num_children++;
+
+  uint32_t content_type = CAPTURE_CONTENT_NONE;
+  uint32_t content_offset = 0;
+  uint32_t content_size = 0;
+
+  if (num_children == 0)
+    {
+      size_t aligned = sanei_usb_capture_align(w->payload.size);
+      char* padding = sanei_usb_capture_buf_extend(w, &w->payload,
+                                                   aligned - w->payload.size);
+      if (padding != NULL)
+        memset(padding, 0, aligned - (padding - w->payload.data));
+      content_offset = w->payload.size;
+
+      if (node->_private != NULL)
+        {
+          const sanei_usb_capture_payload* payload = node->_private;
+          sanei_usb_capture_buf_append(w, &w->payload, payload->data,
+                                       payload->size);
+          content_type = CAPTURE_CONTENT_PAYLOAD;
+        }
+      else
+        {
+          // only transaction data is stored as a payload, other text such as
+          // "(unknown read of allowed size 16)" is kept as is
+          char* text = (char*) xmlNodeGetContent(node);
+          if (text != NULL && !sanei_usb_capture_is_blank(text))
+            {
+              if (sanei_usb_capture_is_data_node(node) &&
+                  sanei_usb_capture_parse_hex(w, text))
+                {
+                  content_type = CAPTURE_CONTENT_PAYLOAD;
+                }
+              else
+                {
+                  content_type = CAPTURE_CONTENT_TEXT;
+                  content_offset = sanei_usb_capture_add_string(w, text);
+                }
+            }
+          xmlFree(text);
+        }
+
+      if (content_type == CAPTURE_CONTENT_PAYLOAD)
+        content_size = w->payload.size - content_offset;
+      else if (content_type == CAPTURE_CONTENT_NONE)
+        content_offset = 0;
+    }
+
+  if (is_transaction)
+    {
+      int seq = sanei_xml_get_prop_uint(node, "seq");
+      sanei_usb_capture_buf_append_u32(w, &w->index, seq < 0 ? 0 : seq);
+      sanei_usb_capture_buf_append_u32(w, &w->index, w->nodes.size);
+      sanei_usb_capture_buf_append_u32(w, &w->index,
+          content_type == CAPTURE_CONTENT_PAYLOAD ? content_offset : 0);
+      sanei_usb_capture_buf_append_u32(w, &w->index, content_size);
+      w->num_index++;
+    }
+
+  uint32_t name = sanei_usb_capture_add_string(w, (const char*) node->name);
+  sanei_usb_capture_buf_append_u32(w, &w->nodes, name);
+  sanei_usb_capture_buf_append_u32(w, &w->nodes, num_attrs);
+  sanei_usb_capture_buf_append_u32(w, &w->nodes, num_children);
+  sanei_usb_capture_buf_append_u32(w, &w->nodes, content_type);
+  sanei_usb_capture_buf_append_u32(w, &w->nodes, content_offset);
+  sanei_usb_capture_buf_append_u32(w, &w->nodes, content_size);
+  w->num_nodes++;
+
+  for (xmlAttr* attr = node->properties; attr != NULL; attr = attr->next)
+    {
+      char* value = sanei_xml_get_prop(node, (const char*) attr->name);
+      sanei_usb_capture_buf_append_u32(w, &w->nodes,
+          sanei_usb_capture_add_string(w, (const char*) attr->name));
+      sanei_usb_capture_buf_append_u32(w, &w->nodes,
+          sanei_usb_capture_add_string(w, value ? value : ""));
+      xmlFree(value);
+    }
+
+  // the children of the transactions element below the root are indexed
+  int children_are_transactions =
+      xmlStrcmp(node->name, (const xmlChar*)"transactions") == 0 &&
+      node->parent != NULL && node->parent->parent != NULL &&
+      node->parent->parent->type == XML_DOCUMENT_NODE;
+  for (xmlNode* child = xmlFirstElementChild(node); child != NULL;
+       child = xmlNextElementSibling(child))
+    {
+      sanei_usb_capture_add_node(w, child, children_are_transactions);
+    }
+}
+
+static int sanei_usb_capture_write_region(FILE* f, size_t* pos,
+                                          size_t offset,
+                                          const sanei_usb_capture_buf* buf)
+{
+  static const char zeros[CAPTURE_ALIGN];
+
+  if (offset - *pos > 0 &&
+      fwrite(zeros, 1, offset - *pos, f) != offset - *pos)
+    return 0;
+  if (buf->size > 0 && fwrite(buf->data, 1, buf->size, f) != buf->size)
+    return 0;
+  *pos = offset + buf->size;
+  return 1;
+}
+
+static SANE_Status sanei_usb_capture_save_binary(xmlDoc* doc, const char* path)
+{
+  xmlNode* el_root = xmlDocGetRootElement(doc);
+  if (el_root == NULL)
+    return SANE_STATUS_INVAL;
+
+  sanei_usb_capture_writer w;
+  memset(&w, 0, sizeof(w));
+
+  sanei_usb_capture_add_node(&w, el_root, 0);
+
+  size_t strings_offset = CAPTURE_HEADER_SIZE;
+  size_t nodes_offset = sanei_usb_capture_align(strings_offset +
+                                                w.strings.size);
+  size_t index_offset = sanei_usb_capture_align(nodes_offset + w.nodes.size);
+  size_t payload_offset = sanei_usb_capture_align(index_offset +
+                                                  w.index.size);
+
+  SANE_Status status = SANE_STATUS_GOOD;
+  if (w.failed)
+    status = SANE_STATUS_NO_MEM;
+  else if (payload_offset + w.payload.size > 0xffffffff)
+    status = SANE_STATUS_INVAL;
+
+  char header_data[CAPTURE_HEADER_SIZE];
+  memset(header_data, 0, sizeof(header_data));
+  memcpy(header_data, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE);
+  sanei_usb_capture_set_u32(header_data + CAPTURE_HDR_VERSION, CAPTURE_VERSION);
+  sanei_usb_capture_set_u32(header_data + CAPTURE_HDR_STRINGS_OFFSET,
+                            strings_offset);
+  sanei_usb_capture_set_u32(header_data + CAPTURE_HDR_STRINGS_SIZE,
+                            w.strings.size);
+  sanei_usb_capture_set_u32(header_data + CAPTURE_HDR_NODES_OFFSET,
+                            nodes_offset);
+  sanei_usb_capture_set_u32(header_data + CAPTURE_HDR_NODES_SIZE,
+                            w.nodes.size);
+  sanei_usb_capture_set_u32(header_data + CAPTURE_HDR_NUM_NODES, w.num_nodes);
+  sanei_usb_capture_set_u32(header_data + CAPTURE_HDR_INDEX_OFFSET,
+                            index_offset);
+  sanei_usb_capture_set_u32(header_data + CAPTURE_HDR_NUM_INDEX, w.num_index);
+  sanei_usb_capture_set_u32(header_data + CAPTURE_HDR_PAYLOAD_OFFSET,
+                            payload_offset);
+  sanei_usb_capture_set_u32(header_data + CAPTURE_HDR_PAYLOAD_SIZE,
+                            w.payload.size);
+  // The capture may be memory-mapped from the same path when recording in
+  // development mode, so write a new file and rename it into place.
+  size_t tmp_path_size = strlen(path) + 5;
+  char* tmp_path = malloc(tmp_path_size);
+  FILE* f = NULL;
+  if (status == SANE_STATUS_GOOD && tmp_path != NULL)
+    {
+      snprintf(tmp_path, tmp_path_size, "%s.tmp", path);
+      f = fopen(tmp_path, "wb");
+    }
+
+  if (status == SANE_STATUS_GOOD)
+    {
+      size_t pos = CAPTURE_HEADER_SIZE;
+      if (f == NULL ||
+          fwrite(header_data, 1, CAPTURE_HEADER_SIZE, f) != CAPTURE_HEADER_SIZE ||
+          !sanei_usb_capture_write_region(f, &pos, strings_offset, &w.strings) ||
+          !sanei_usb_capture_write_region(f, &pos, nodes_offset, &w.nodes) ||
+          !sanei_usb_capture_write_region(f, &pos, index_offset, &w.index) ||
+          !sanei_usb_capture_write_region(f, &pos, payload_offset, &w.payload))
+        {
+          status = SANE_STATUS_IO_ERROR;
+        }
+      if (f != NULL && fclose(f) != 0)
+        status = SANE_STATUS_IO_ERROR;
+      if (status == SANE_STATUS_GOOD && rename(tmp_path, path) != 0)
+        status = SANE_STATUS_IO_ERROR;
+      if (status != SANE_STATUS_GOOD && f != NULL)
+        unlink(tmp_path);
+    }
+
+  if (status != SANE_STATUS_GOOD)
+    DBG(1, "%s: could not write %s\n", __func__, path);
+
+  free(tmp_path);
+  free(w.strings.data);
+  free(w.nodes.data);
+  free(w.index.data);
+  free(w.payload.data);
+  free(w.string_table);
+  return status;
+}
+
+// replaces payload references with hex text so that the tree can be saved as XML
+static void sanei_usb_capture_payloads_to_hex(xmlNode* node)
+{
+  for (; node != NULL; node = xmlNextElementSibling(node))
+    {
+      if (node->_private != NULL)
+        {
+          const sanei_usb_capture_payload* payload = node->_private;
+          if (payload->size > 0)
+            sanei_xml_set_hex_data(node, payload->data, payload->size);
+          node->_private = NULL;
+        }
+      sanei_usb_capture_payloads_to_hex(xmlFirstElementChild(node));
+    }
+}
+
+SANE_Status sanei_usb_testing_convert_capture(SANE_String_Const in_path,
+                                              SANE_String_Const out_path)
+{
+  sanei_usb_capture_map map;
+  memset(&map, 0, sizeof(map));
+
+  xmlDoc* doc;
+  if (sanei_usb_capture_is_binary(in_path))
+    doc = sanei_usb_capture_load_binary(in_path, &map, 0);
+  else
+    doc = xmlReadFile(in_path, NULL, 0);
+
+  if (doc == NULL)
+    {
+      DBG(1, "%s: could not load %s\n", __func__, in_path);
+      return SANE_STATUS_INVAL;
+    }
+
+  SANE_Status status = SANE_STATUS_GOOD;
+  if (sanei_usb_capture_has_binary_extension(out_path))
+    {
+      status = sanei_usb_capture_save_binary(doc, out_path);
+    }
+  else
+    {
+      sanei_usb_capture_payloads_to_hex(xmlDocGetRootElement(doc));
+      if (xmlSaveFormatFileEnc(out_path, doc, "UTF-8", 1) < 0)
+        status = SANE_STATUS_IO_ERROR;
+    }
+
+  xmlFreeDoc(doc);
+  sanei_usb_capture_unmap(&map);
+  return status;
+}
+#else // WITH_USB_RECORD_REPLAY
+SANE_Status sanei_usb_testing_enable_replay(SANE_String_Const path,
+                                            int development_mode)
+{
+  (void) path;
+  (void) development_mode;
+
+  DBG(1, "USB record-replay mode support is missing\n");
+  return SANE_STATUS_UNSUPPORTED;
+}
+
+SANE_Status sanei_usb_testing_enable_record(SANE_String_Const path, SANE_String_Const be_name)
+{
+  (void) path;
+  (void) be_name;
+
+  DBG(1, "USB record-replay mode support is missing\n");
+  return SANE_STATUS_UNSUPPORTED;
+}
+
+SANE_String sanei_usb_testing_get_backend()
+{
+  return NULL;
+}
+
+SANE_Bool sanei_usb_is_replay_mode_enabled()
+{
+  return SANE_FALSE;
+}
+
+SANE_Bool sanei_usb_is_record_mode_enabled()
+{
+  return SANE_FALSE;
+}
+
+void sanei_usb_testing_record_clear()
+{
+}
+
+void sanei_usb_testing_record_message(SANE_String_Const message)
+{
+  (void) message;
+}
+
+SANE_Status sanei_usb_testing_convert_capture(SANE_String_Const in_path,
+                                              SANE_String_Const out_path)
+{
+  (void) in_path;
+  (void) out_path;
+
+  DBG(1, "USB record-replay mode support is missing\n");
+  return SANE_STATUS_UNSUPPORTED;
+}
+#endif // WITH_USB_RECORD_REPLAY
+
+/* Transfer tracing.
+
+   When the SANE_USB_TRACE environment variable is set, sanei_usb keeps
+   per-device statistics of all transfers: counts, errors, timeouts, size and
+   latency histograms and the throughput achieved for each transfer size,
+   plus a ring buffer of the most recent transfers. The statistics are dumped
+   when the device is closed, when sanei_usb_trace_dump() is called and, if
+   SANE_USB_TRACE_SIGNAL is set to a signal number, after the next transfer
+   following the delivery of that signal.
+
+   Recording is a couple of additions to preallocated per-device data, so
+   unlike DBG output it does not disturb the timing of the transfers.
+   Backends may do transfers on a device from several threads at once, so
+   every counter is updated with an atomic addition and the ring slot of a
+   record is claimed with an atomic increment; no thread ever waits. A
+   record carries its number, which is cleared while it is written, so a
+   dump skips records that are incomplete or were overwritten under it. A
+   dump running during transfers sees every counter exactly, but possibly
+   not yet all the counters of the transfers in flight.
+ */
+#define TRACE_NUM_BUCKETS 24
+#define TRACE_RING_SIZE 256
+#define TRACE_DUMP_RECENT 32
+
+#if defined(__ATOMIC_RELAXED)
+#define TRACE_ADD(var, value) \
+  __atomic_fetch_add (&(var), (value), __ATOMIC_RELAXED)
+#define TRACE_LOAD(var) __atomic_load_n (&(var), __ATOMIC_RELAXED)
+#define TRACE_STORE(var, value) \
+  __atomic_store_n (&(var), (value), __ATOMIC_RELAXED)
+#define TRACE_LOAD_ACQUIRE(var) __atomic_load_n (&(var), __ATOMIC_ACQUIRE)
+#define TRACE_STORE_RELEASE(var, value) \
+  __atomic_store_n (&(var), (value), __ATOMIC_RELEASE)
+#define TRACE_FENCE_ACQUIRE() __atomic_thread_fence (__ATOMIC_ACQUIRE)
+#define TRACE_FENCE_RELEASE() __atomic_thread_fence (__ATOMIC_RELEASE)
+#define TRACE_CAS(var, expected, value) \
+  __atomic_compare_exchange_n (&(var), &(expected), (value), 1, \
+                               __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#else
+/* without the atomic builtins concurrent transfers on the same device may
+   lose counts */
+#define TRACE_ADD(var, value) (((var) += (value)) - (value))
+#define TRACE_LOAD(var) (var)
+#define TRACE_STORE(var, value) ((var) = (value))
+#define TRACE_LOAD_ACQUIRE(var) (var)
+#define TRACE_STORE_RELEASE(var, value) ((var) = (value))
+#define TRACE_FENCE_ACQUIRE()
+#define TRACE_FENCE_RELEASE()
+#define TRACE_CAS(var, expected, value) ((var) = (value), 1)
+#endif
+
+/* byte and time totals are 64 bit only where atomic operations on them are
+   lock-free, so that 32 bit targets don't need libatomic */
+#if defined(__GCC_ATOMIC_LLONG_LOCK_FREE) && __GCC_ATOMIC_LLONG_LOCK_FREE == 2
+typedef unsigned long long sanei_usb_trace_total;
+#else
+typedef unsigned long sanei_usb_trace_total;
+#endif
+
+typedef enum
+{
+  sanei_usb_trace_bulk_in = 0,
+  sanei_usb_trace_bulk_out,
+  sanei_usb_trace_control,
+  sanei_usb_trace_int,
+  SANEI_USB_TRACE_NUM_KINDS
+}
+sanei_usb_trace_kind;
+
+static const char *trace_kind_names[SANEI_USB_TRACE_NUM_KINDS] = {
+  "bulk in", "bulk out", "control", "interrupt"
+};
+
+typedef struct
+{
+  unsigned long count;
+  unsigned long errors;
+  unsigned long timeouts;
+  sanei_usb_trace_total bytes;
+  sanei_usb_trace_total usec;
+  unsigned long max_usec;
+  /* bucket i counts transfers of less than 2^i bytes (and at least 2^(i-1)) */
+  unsigned long size_count[TRACE_NUM_BUCKETS];
+  sanei_usb_trace_total size_bytes[TRACE_NUM_BUCKETS];
+  sanei_usb_trace_total size_usec[TRACE_NUM_BUCKETS];
+  /* bucket i counts transfers that took less than 2^i microseconds */
+  unsigned long latency_count[TRACE_NUM_BUCKETS];
+}
+sanei_usb_trace_stats;
+
+typedef struct
+{
+  unsigned long seq; /* record number + 1, 0 while the record is written */
+  unsigned char kind;
+  unsigned char status;
+  unsigned int size;
+  unsigned long usec;
+}
+sanei_usb_trace_record;
+
+typedef struct
+{
+  sanei_usb_trace_stats stats[SANEI_USB_TRACE_NUM_KINDS];
+  sanei_usb_trace_record ring[TRACE_RING_SIZE];
+  unsigned long ring_head; /* total number of records ever claimed */
+}
+sanei_usb_trace;
+
+static int trace_enabled = 0;
+static const char *trace_path = NULL; /* NULL means stderr */
+static volatile sig_atomic_t trace_dump_requested = 0;
+static sanei_usb_trace *device_traces[MAX_DEVICES];
+
+static void
+sanei_usb_trace_signal_handler (int signum)
+{
+  (void) signum;
+  trace_dump_requested = 1;
+}
+
+static void
+sanei_usb_trace_init (void)
+{
+  char *env;
+
+  if (initialized != 0)
+    return;
+
+  env = getenv ("SANE_USB_TRACE");
+  trace_enabled = env != NULL && *env != 0 && strcmp (env, "0") != 0;
+  if (!trace_enabled)
+    return;
+
+  trace_path = NULL;
+  if (strcmp (env, "1") != 0 && strcmp (env, "stderr") != 0)
+    trace_path = env;
+
+  env = getenv ("SANE_USB_TRACE_SIGNAL");
+  if (env != NULL && atoi (env) > 0)
+    {
+      DBG (4, "%s: dumping USB transfer traces on signal %d\n", __func__,
+           atoi (env));
+      signal (atoi (env), sanei_usb_trace_signal_handler);
+    }
+}
+
+static unsigned int
+sanei_usb_trace_bucket (unsigned long value)
+{
+  unsigned int bucket = 0;
+
+  while (value != 0 && bucket < TRACE_NUM_BUCKETS - 1)
+    {
+      value >>= 1;
+      bucket++;
+    }
+  return bucket;
+}
+
+static void
+sanei_usb_trace_copy_stats (sanei_usb_trace_stats * dst,
+                            sanei_usb_trace_stats * src)
+{
+  int b;
+
+  dst->count = TRACE_LOAD (src->count);
+  dst->errors = TRACE_LOAD (src->errors);
+  dst->timeouts = TRACE_LOAD (src->timeouts);
+  dst->bytes = TRACE_LOAD (src->bytes);
+  dst->usec = TRACE_LOAD (src->usec);
+  dst->max_usec = TRACE_LOAD (src->max_usec);
+  for (b = 0; b < TRACE_NUM_BUCKETS; b++)
+    {
+      dst->size_count[b] = TRACE_LOAD (src->size_count[b]);
+      dst->size_bytes[b] = TRACE_LOAD (src->size_bytes[b]);
+      dst->size_usec[b] = TRACE_LOAD (src->size_usec[b]);
+      dst->latency_count[b] = TRACE_LOAD (src->latency_count[b]);
+    }
+}
+
+/* copies record number i, returns 0 if it is not (or no longer) complete */
+static int
+sanei_usb_trace_copy_record (sanei_usb_trace_record * dst,
+                             sanei_usb_trace * trace, unsigned long i)
+{
+  sanei_usb_trace_record *rec = &trace->ring[i % TRACE_RING_SIZE];
+
+  if (TRACE_LOAD_ACQUIRE (rec->seq) != i + 1)
+    return 0;
+  dst->kind = TRACE_LOAD (rec->kind);
+  dst->status = TRACE_LOAD (rec->status);
+  dst->size = TRACE_LOAD (rec->size);
+  dst->usec = TRACE_LOAD (rec->usec);
+  TRACE_FENCE_ACQUIRE ();
+  return TRACE_LOAD (rec->seq) == i + 1;
+}
+
+static void
+sanei_usb_trace_dump_device (FILE * out, SANE_Int dn)
+{
+  sanei_usb_trace *trace = device_traces[dn];
+  sanei_usb_trace_stats stats;
+  sanei_usb_trace_record rec;
+  unsigned long i, first, head;
+  int kind, b;
+
+  fprintf (out, "sanei_usb trace: device %s (0x%04x/0x%04x)\n",
+           devices[dn].devname, devices[dn].vendor, devices[dn].product);
+
+  for (kind = 0; kind < SANEI_USB_TRACE_NUM_KINDS; kind++)
+    {
+      /* transfers may continue during the output */
+      sanei_usb_trace_copy_stats (&stats, &trace->stats[kind]);
+      if (stats.count == 0)
+        continue;
+
+      fprintf (out, "  %s: %lu transfers, %llu bytes, %lu errors, "
+               "%lu timeouts, %.3f s, %.2f MB/s, max latency %lu us\n",
+               trace_kind_names[kind], stats.count,
+               (unsigned long long) stats.bytes, stats.errors,
+               stats.timeouts, stats.usec / 1e6,
+               stats.usec ? (double) stats.bytes / stats.usec : 0.0,
+               stats.max_usec);
+
+      for (b = 0; b < TRACE_NUM_BUCKETS; b++)
+        {
+          if (stats.size_count[b] == 0)
+            continue;
+          fprintf (out, "    size < %8lu: %8lu transfers, %8.2f MB/s\n",
+                   1ul << b, stats.size_count[b],
+                   stats.size_usec[b] ?
+                   (double) stats.size_bytes[b] / stats.size_usec[b] : 0.0);
+        }
+      for (b = 0; b < TRACE_NUM_BUCKETS; b++)
+        {
+          if (stats.latency_count[b] == 0)
+            continue;
+          fprintf (out, "    latency < %8lu us: %8lu transfers\n",
+                   1ul << b, stats.latency_count[b]);
+        }
+    }
+
+  head = TRACE_LOAD (trace->ring_head);
+  first = 0;
+  if (head > TRACE_DUMP_RECENT)
+    first = head - TRACE_DUMP_RECENT;
+  if (first < head)
+    fprintf (out, "  last %lu transfers:\n", head - first);
+  for (i = first; i < head; i++)
+    {
+      if (!sanei_usb_trace_copy_record (&rec, trace, i))
+        {
+          fprintf (out, "    #%lu in progress\n", i);
+          continue;
+        }
+      fprintf (out, "    #%lu %s %u bytes %lu us: status %d\n", i,
+               trace_kind_names[rec.kind], rec.size, rec.usec, rec.status);
+    }
+}
+
+void
+sanei_usb_trace_dump (SANE_Int dn)
+{
+  FILE *out = stderr;
+  SANE_Int i;
+
+  if (!trace_enabled)
+    return;
+
+  if (trace_path != NULL)
+    {
+      out = fopen (trace_path, "a");
+      if (out == NULL)
+        {
+          DBG (1, "%s: could not open %s: %s\n", __func__, trace_path,
+               strerror (errno));
+          return;
+        }
+    }
+
+  for (i = 0; i < device_number; i++)
+    {
+      if ((dn < 0 || dn == i) && device_traces[i] != NULL)
+        sanei_usb_trace_dump_device (out, i);
+    }
+
+  if (out != stderr)
+    fclose (out);
+  else
+    fflush (out);
+}
+
+static void
+sanei_usb_trace_open (SANE_Int dn)
+{
+  if (!trace_enabled)
+    return;
+
+  free (device_traces[dn]);
+  device_traces[dn] = calloc (1, sizeof (sanei_usb_trace));
+}
+
+static void
+sanei_usb_trace_close (SANE_Int dn)
+{
+  if (device_traces[dn] == NULL)
+    return;
+
+  sanei_usb_trace_dump (dn);
+  free (device_traces[dn]);
+  device_traces[dn] = NULL;
+}
+
+static void
+sanei_usb_trace_start (struct timeval *start)
+{
+  if (trace_enabled)
+    gettimeofday (start, NULL);
+}
+
+static void
+sanei_usb_trace_transfer (SANE_Int dn, sanei_usb_trace_kind kind,
+                          const struct timeval *start, SANE_Status status,
+                          size_t size)
+{
+  sanei_usb_trace *trace;
+  sanei_usb_trace_stats *stats;
+  sanei_usb_trace_record *rec;
+  struct timeval now;
+  unsigned long usec, max_usec, slot;
+  unsigned int b;
+
+  if (!trace_enabled || dn < 0 || dn >= device_number ||
+      (trace = device_traces[dn]) == NULL)
+    return;
+
+  gettimeofday (&now, NULL);
+  usec = (now.tv_sec - start->tv_sec) * 1000000L +
+    (now.tv_usec - start->tv_usec);
+
+  stats = &trace->stats[kind];
+  TRACE_ADD (stats->count, 1);
+  TRACE_ADD (stats->usec, usec);
+  max_usec = TRACE_LOAD (stats->max_usec);
+  while (usec > max_usec && !TRACE_CAS (stats->max_usec, max_usec, usec))
+    ;
+  TRACE_ADD (stats->latency_count[sanei_usb_trace_bucket (usec)], 1);
+
+  if (status == SANE_STATUS_GOOD)
     {
-      DBG(1, "%s: no id_vendor attr in description node\n", __func__);
-      return SANE_STATUS_INVAL;
+      b = sanei_usb_trace_bucket (size);
+      TRACE_ADD (stats->bytes, size);
+      TRACE_ADD (stats->size_count[b], 1);
+      TRACE_ADD (stats->size_bytes[b], size);
+      TRACE_ADD (stats->size_usec[b], usec);
     }
-
-  int product_id = sanei_xml_get_prop_uint(el_description, "id_product");
-  if (product_id < 0)
+  else if (status != SANE_STATUS_EOF)
     {
-      DBG(1, "%s: no id_product attr in description node\n", __func__);
-      return SANE_STATUS_INVAL;
+      TRACE_ADD (stats->errors, 1);
+#if defined(HAVE_LIBUSB_LEGACY) || defined(HAVE_LIBUSB)
+      /* the access methods don't report timeouts separately, but a failed
+         transfer that took the whole timeout period almost surely was one */
+      if (usec >= (unsigned long) libusb_timeout * 1000)
+        TRACE_ADD (stats->timeouts, 1);
+#endif
     }
 
-  xmlNode* el_configurations =
-      sanei_xml_find_first_child_with_name(el_description, "configurations");
-  if (el_configurations == NULL)
-    {
-      DBG(1, "%s: could not find configurations node\n", __func__);
-      return SANE_STATUS_INVAL;
-    }
+  slot = TRACE_ADD (trace->ring_head, 1);
+  rec = &trace->ring[slot % TRACE_RING_SIZE];
+  TRACE_STORE (rec->seq, 0);
+  TRACE_FENCE_RELEASE ();
+  TRACE_STORE (rec->kind, kind);
+  TRACE_STORE (rec->status, status);
+  TRACE_STORE (rec->size, size);
+  TRACE_STORE (rec->usec, usec);
+  TRACE_STORE_RELEASE (rec->seq, slot + 1);
 
-  xmlNode* el_configuration =
-      sanei_xml_find_first_child_with_name(el_configurations, "configuration");
-  if (el_configuration == NULL)
+  if (trace_dump_requested)
     {
-      DBG(1, "%s: no configuration nodes\n", __func__);
-      return SANE_STATUS_INVAL;
+      trace_dump_requested = 0;
+      sanei_usb_trace_dump (-1);
     }
+}
 
-  while (el_configuration != NULL)
-    {
-      xmlNode* el_interface =
-          sanei_xml_find_first_child_with_name(el_configuration, "interface");
+/* Adaptive bulk transfer sizing.
+
+   Backends that call sanei_usb_get_bulk_size() get a bulk transfer size
+   for the device that is picked by measuring the transfers themselves.
+   Candidate sizes are powers of two between the limits given by the
+   backend. Starting at the largest, each candidate is used for
+   TUNE_SAMPLES complete transfers, then the next smaller one is tried
+   for as long as it still achieves TUNE_KEEP_PERCENT of the best
+   throughput seen. The smallest size that does is kept: it has the same
+   throughput as the larger ones but lower latency. Which size that is
+   depends on the device and very much on the host controller, so the
+   result is stored per device, direction and bus in a small text file
+   and reused when the device is opened again.
+ */
+#define TUNE_MAX_BUCKETS 32
+#define TUNE_SAMPLES 8
+#define TUNE_KEEP_PERCENT 95
 
-      while (el_interface != NULL)
-        {
-          device_list_type device;
-          memset(&device, 0, sizeof(device));
-          device.devname = strdup(testing_xml_path);
+#ifndef PATH_MAX
+# define PATH_MAX 1024
+#endif
 
-          // other code shouldn't depend on method because testing_mode is
-          // sanei_usb_testing_mode_replay
-          device.method = sanei_usb_method_libusb;
-          device.vendor = device_id;
-          device.product = product_id;
+typedef struct
+{
+  unsigned int lo, hi;          /* range of candidate log2 sizes */
+  unsigned int cur;             /* log2 of the size handed out */
+  int settled;
+  int loaded;                   /* settled size was read from the file */
+  unsigned long samples[TUNE_MAX_BUCKETS];
+  unsigned long long bytes[TUNE_MAX_BUCKETS];
+  unsigned long long usec[TUNE_MAX_BUCKETS];
+}
+sanei_usb_tuning_dir;
 
-          device.interface_nr = sanei_xml_get_prop_uint(el_interface, "number");
-          if (device.interface_nr < 0)
-            {
-              DBG(1, "%s: no number attr in interface node\n", __func__);
-              return SANE_STATUS_INVAL;
-            }
+typedef struct
+{
+  sanei_usb_tuning_dir dir[2];  /* 0: bulk in, 1: bulk out */
+}
+sanei_usb_tuning;
 
-          xmlNode* el_endpoint =
-              sanei_xml_find_first_child_with_name(el_interface, "endpoint");
+static int tuning_disabled = 0;
+static sanei_usb_tuning *device_tunings[MAX_DEVICES];
 
-          while (el_endpoint != NULL)
-            {
-              char* transfer_attr = sanei_xml_get_prop(el_endpoint,
-                                                       "transfer_type");
-              int address = sanei_xml_get_prop_uint(el_endpoint, "address");
-              char* direction_attr = sanei_xml_get_prop(el_endpoint,
-                                                        "direction");
+static void
+sanei_usb_tuning_init (void)
+{
+  char *env = getenv ("SANE_USB_TUNING");
 
-              int direction_is_in = strcmp(direction_attr, "IN") == 0 ? 1 : 0;
-              int transfer_type = -1;
-              if (strcmp(transfer_attr, "INTERRUPT") == 0)
-                transfer_type = USB_ENDPOINT_TYPE_INTERRUPT;
-              else if (strcmp(transfer_attr, "BULK") == 0)
-                transfer_type = USB_ENDPOINT_TYPE_BULK;
-              else if (strcmp(transfer_attr, "ISOCHRONOUS") == 0)
-                transfer_type = USB_ENDPOINT_TYPE_ISOCHRONOUS;
-              else if (strcmp(transfer_attr, "CONTROL") == 0)
-                transfer_type = USB_ENDPOINT_TYPE_CONTROL;
-              else
-                {
-                  DBG(3, "%s: unknown endpoint type %s\n",
-                      __func__, transfer_attr);
-                }
+  tuning_disabled = env != NULL && strcmp (env, "0") == 0;
+}
 
-              if (transfer_type >= 0)
-                {
-                  sanei_usb_add_endpoint(&device, transfer_type, address,
-                                         direction_is_in);
-                }
+/* the file is $SANE_USB_TUNING_FILE, $XDG_CACHE_HOME/sane/usb-tuning or
+   ~/.cache/sane/usb-tuning. An empty SANE_USB_TUNING_FILE disables it. */
+static int
+sanei_usb_tuning_path (char *path, size_t size, int create_dir)
+{
+  const char *env = getenv ("SANE_USB_TUNING_FILE");
+  const char *base;
+  char dir[PATH_MAX];
 
-              xmlFree(transfer_attr);
-              xmlFree(direction_attr);
+  if (env != NULL)
+    {
+      if (*env == 0 || strlen (env) >= size)
+        return 0;
+      strcpy (path, env);
+      return 1;
+    }
 
-              el_endpoint =
-                  sanei_xml_find_next_child_with_name(el_endpoint, "endpoint");
-            }
-          device.alt_setting = 0;
-          device.missing = 0;
+  base = getenv ("XDG_CACHE_HOME");
+  if (base != NULL && *base != 0)
+    snprintf (dir, sizeof (dir), "%s", base);
+  else if ((base = getenv ("HOME")) != NULL && *base != 0)
+    snprintf (dir, sizeof (dir), "%s/.cache", base);
+  else
+    return 0;
 
-          memcpy(&(devices[device_number]), &device, sizeof(device));
-          device_number++;
+  if (create_dir)
+    mkdir (dir, 0700);
+  strncat (dir, "/sane", sizeof (dir) - strlen (dir) - 1);
+  if (create_dir)
+    mkdir (dir, 0700);
 
-          el_interface = sanei_xml_find_next_child_with_name(el_interface,
-                                                             "interface");
-        }
-      el_configuration =
-            sanei_xml_find_next_child_with_name(el_configurations,
-                                                "configuration");
-    }
+  if (snprintf (path, size, "%s/usb-tuning", dir) >= (int) size)
+    return 0;
+  return 1;
+}
 
-  xmlNode* el_transactions =
-      sanei_xml_find_first_child_with_name(el_root, "transactions");
+/* the key identifies the device model, the direction and the bus, which
+   is the devname without the device address, e.g. "libusb:001" */
+static void
+sanei_usb_tuning_key (SANE_Int dn, int dir, char *key, size_t size)
+{
+  const char *devname = devices[dn].devname ? devices[dn].devname : "";
+  const char *colon = strrchr (devname, ':');
+  int buslen = colon ? (int) (colon - devname) : (int) strlen (devname);
 
-  if (el_transactions == NULL)
-    {
-      DBG(1, "%s: could not find transactions node\n", __func__);
-      return SANE_STATUS_INVAL;
-    }
+  snprintf (key, size, "%04x:%04x %s %.*s", devices[dn].vendor,
+            devices[dn].product, dir ? "out" : "in", buslen, devname);
+}
 
-  xmlNode* el_transaction = xmlFirstElementChild(el_transactions);
-  el_transaction = sanei_xml_skip_non_tx_nodes(el_transaction);
+static void
+sanei_usb_tuning_load (SANE_Int dn, int dir)
+{
+  sanei_usb_tuning_dir *t = &device_tunings[dn]->dir[dir];
+  char path[PATH_MAX], key[PATH_MAX], line[PATH_MAX + 64];
+  size_t keylen;
+  FILE *fp;
 
-  if (el_transaction == NULL)
-    {
-      DBG(1, "%s: no transactions within capture\n", __func__);
-      return SANE_STATUS_INVAL;
-    }
+  if (!sanei_usb_tuning_path (path, sizeof (path), 0)
+      || (fp = fopen (path, "r")) == NULL)
+    return;
 
-  testing_xml_next_tx_node = el_transaction;
+  sanei_usb_tuning_key (dn, dir, key, sizeof (key));
+  keylen = strlen (key);
+  while (fgets (line, sizeof (line), fp) != NULL)
+    {
+      unsigned long size;
+      unsigned int b;
 
-  return SANE_STATUS_GOOD;
+      if (strncmp (line, key, keylen) != 0 || line[keylen] != ' ')
+        continue;
+      size = strtoul (line + keylen + 1, NULL, 10);
+      for (b = t->lo; b <= t->hi; b++)
+        {
+          if ((1ul << b) == size)
+            {
+              DBG (4, "%s: using %lu byte transfers for %s\n", __func__,
+                   size, key);
+              t->cur = b;
+              t->settled = t->loaded = 1;
+            }
+        }
+    }
+  fclose (fp);
 }
 
-static void sanei_usb_testing_exit()
+static void
+sanei_usb_tuning_save (SANE_Int dn, int dir)
 {
-  if (testing_development_mode || testing_mode == sanei_usb_testing_mode_record)
+  sanei_usb_tuning_dir *t = &device_tunings[dn]->dir[dir];
+  /* room for the path, the dot and any long value with its sign */
+  char path[PATH_MAX], tmp[PATH_MAX + 1 + 20], key[PATH_MAX];
+  char line[PATH_MAX + 64];
+  size_t keylen;
+  int n;
+  FILE *in, *out;
+
+  if (!t->settled || t->loaded
+      || !sanei_usb_tuning_path (path, sizeof (path), 1))
+    return;
+
+  n = snprintf (tmp, sizeof (tmp), "%s.%ld", path, (long) getpid ());
+  if (n < 0 || (size_t) n >= sizeof (tmp))
+    return;
+  if ((out = fopen (tmp, "w")) == NULL)
     {
-      if (testing_mode == sanei_usb_testing_mode_record)
+      DBG (1, "%s: could not create %s: %s\n", __func__, tmp,
+           strerror (errno));
+      return;
+    }
+
+  sanei_usb_tuning_key (dn, dir, key, sizeof (key));
+  keylen = strlen (key);
+  if ((in = fopen (path, "r")) != NULL)
+    {
+      while (fgets (line, sizeof (line), in) != NULL)
         {
-          xmlAddNextSibling(testing_append_commands_node, xmlNewText((const xmlChar*)"\n  "));
-          free(testing_record_backend);
+          if (strncmp (line, key, keylen) != 0 || line[keylen] != ' ')
+            fputs (line, out);
         }
-      xmlSaveFileEnc(testing_xml_path, testing_xml_doc, "UTF-8");
+      fclose (in);
     }
-  xmlFreeDoc(testing_xml_doc);
-  free(testing_xml_path);
-  xmlCleanupParser();
-
-  // reset testing-related all data to initial values
-  testing_development_mode = 0;
-  testing_already_opened = 0;
-  testing_known_commands_input_failed = 0;
-  testing_last_known_seq = 0;
-  testing_record_backend = NULL;
-  testing_append_commands_node = NULL;
-
-  testing_xml_path = NULL;
-  testing_xml_doc = NULL;
-  testing_xml_next_tx_node = NULL;
-}
-#else // WITH_USB_RECORD_REPLAY
-SANE_Status sanei_usb_testing_enable_replay(SANE_String_Const path,
-                                            int development_mode)
-{
-  (void) path;
-  (void) development_mode;
+  fprintf (out, "%s %lu\n", key, 1ul << t->cur);
 
-  DBG(1, "USB record-replay mode support is missing\n");
-  return SANE_STATUS_UNSUPPORTED;
+  if (fclose (out) != 0 || rename (tmp, path) != 0)
+    {
+      DBG (1, "%s: could not write %s: %s\n", __func__, path,
+           strerror (errno));
+      unlink (tmp);
+      return;
+    }
+  DBG (4, "%s: stored %lu byte transfers for %s\n", __func__,
+       1ul << t->cur, key);
+  t->loaded = 1;
 }
 
-SANE_Status sanei_usb_testing_enable_record(SANE_String_Const path, SANE_String_Const be_name)
+static void
+sanei_usb_tuning_close (SANE_Int dn)
 {
-  (void) path;
-  (void) be_name;
+  if (device_tunings[dn] == NULL)
+    return;
 
-  DBG(1, "USB record-replay mode support is missing\n");
-  return SANE_STATUS_UNSUPPORTED;
+  sanei_usb_tuning_save (dn, 0);
+  sanei_usb_tuning_save (dn, 1);
+  free (device_tunings[dn]);
+  device_tunings[dn] = NULL;
 }
 
-SANE_String sanei_usb_testing_get_backend()
+static unsigned long long
+sanei_usb_tuning_rate (sanei_usb_tuning_dir * t, unsigned int b)
 {
-  return NULL;
+  /* bytes per millisecond, to stay in integer arithmetic */
+  return t->usec[b] ? t->bytes[b] * 1000 / t->usec[b] : 0;
 }
 
-SANE_Bool sanei_usb_is_replay_mode_enabled()
+/* called after TUNE_SAMPLES transfers of the current size */
+static void
+sanei_usb_tuning_step (sanei_usb_tuning_dir * t)
 {
-  return SANE_FALSE;
+  unsigned long long best = 0, rate;
+  unsigned int b;
+
+  for (b = t->lo; b <= t->hi; b++)
+    {
+      rate = sanei_usb_tuning_rate (t, b);
+      if (rate > best)
+        best = rate;
+    }
+
+  rate = sanei_usb_tuning_rate (t, t->cur);
+  if (rate * 100 < best * TUNE_KEEP_PERCENT)
+    {
+      /* too slow, go back to the previous (larger) size */
+      t->cur++;
+      t->settled = 1;
+    }
+  else if (t->cur == t->lo)
+    t->settled = 1;
+  else
+    t->cur--;
+
+  if (t->settled)
+    DBG (4, "%s: settled on %lu byte transfers\n", __func__, 1ul << t->cur);
 }
 
-void sanei_usb_testing_record_clear()
+static void
+sanei_usb_tuning_transfer (SANE_Int dn, int dir, const struct timeval *start,
+                           SANE_Status status, size_t wanted, size_t size)
 {
+  sanei_usb_tuning_dir *t;
+  struct timeval now;
+  unsigned long usec;
+
+  if (dn < 0 || dn >= device_number || device_tunings[dn] == NULL)
+    return;
+
+  t = &device_tunings[dn]->dir[dir];
+  /* only complete transfers of the size handed out tell something about
+     the bus, short ones are limited by the data the device had ready */
+  if (t->settled || t->hi == 0 || status != SANE_STATUS_GOOD
+      || wanted != size || size != (1ul << t->cur))
+    return;
+
+  gettimeofday (&now, NULL);
+  usec = (now.tv_sec - start->tv_sec) * 1000000L +
+    (now.tv_usec - start->tv_usec);
+
+  t->samples[t->cur]++;
+  t->bytes[t->cur] += size;
+  t->usec[t->cur] += usec ? usec : 1;
+  if (t->samples[t->cur] >= TUNE_SAMPLES)
+    sanei_usb_tuning_step (t);
 }
 
-void sanei_usb_testing_record_message(SANE_String_Const message)
+size_t
+sanei_usb_get_bulk_size (SANE_Int dn, SANE_Int ep_dir, size_t min_size,
+                         size_t max_size)
 {
-  (void) message;
+  sanei_usb_tuning_dir *t;
+  int dir = (ep_dir & USB_DIR_IN) ? 0 : 1;
+  unsigned int lo, hi;
+
+  if (dn < 0 || dn >= device_number || min_size == 0
+      || max_size <= min_size || tuning_disabled
+      || testing_mode != sanei_usb_testing_mode_disabled)
+    return max_size;
+
+  if (device_tunings[dn] == NULL)
+    {
+      device_tunings[dn] = calloc (1, sizeof (sanei_usb_tuning));
+      if (device_tunings[dn] == NULL)
+        return max_size;
+    }
+
+  t = &device_tunings[dn]->dir[dir];
+  if (t->hi == 0)
+    {
+      for (lo = 0; lo < TUNE_MAX_BUCKETS - 1 && (1ul << lo) < min_size; lo++)
+        ;
+      for (hi = lo; hi < TUNE_MAX_BUCKETS - 1 && (2ul << hi) <= max_size;
+           hi++)
+        ;
+      if ((1ul << hi) > max_size || hi == 0)
+        return max_size;
+
+      t->lo = lo;
+      t->hi = t->cur = hi;
+      sanei_usb_tuning_load (dn, dir);
+    }
+
+  if ((1ul << t->cur) > max_size)
+    return max_size;
+  return 1ul << t->cur;
 }
-#endif // WITH_USB_RECORD_REPLAY
 
 void
 sanei_usb_init (void)
@@ -1391,6 +3099,9 @@ sanei_usb_init (void)
   debug_level = 0;
 #endif
 
+  sanei_usb_trace_init ();
+  sanei_usb_tuning_init ();
+
   /* if no device yet, clean up memory */
   if(device_number==0)
     memset (devices, 0, sizeof (devices));
@@ -1491,6 +3202,8 @@ int i;
       DBG (4, "%s: freeing resources\n", __func__);
       for (i = 0; i < device_number; i++)
         {
+          sanei_usb_trace_close (i);
+          sanei_usb_tuning_close (i);
           if (devices[i].devname != NULL)
             {
               DBG (5, "%s: freeing device %02d\n", __func__, i);
@@ -2982,6 +4695,7 @@ sanei_usb_open (SANE_String_Const devname, SANE_Int * dn)
     }
 
   devices[devcount].open = SANE_TRUE;
+  sanei_usb_trace_open (devcount);
   *dn = devcount;
   DBG (3, "sanei_usb_open: opened usb device `%s' (*dn=%d)\n",
        devname, devcount);
@@ -3064,6 +4778,8 @@ sanei_usb_close (SANE_Int dn)
 #else /* not HAVE_LIBUSB_LEGACY && not HAVE_LIBUSB */
     DBG (1, "sanei_usb_close: libusb support missing\n");
 #endif
+  sanei_usb_trace_close (dn);
+  sanei_usb_tuning_close (dn);
   devices[dn].open = SANE_FALSE;
   return;
 }
@@ -3343,8 +5059,8 @@ static int sanei_usb_replay_read_bulk(SANE_Int dn, SANE_Byte* buffer,
 }
 #endif // WITH_USB_RECORD_REPLAY
 
-SANE_Status
-sanei_usb_read_bulk (SANE_Int dn, SANE_Byte * buffer, size_t * size)
+static SANE_Status
+sanei_usb_do_read_bulk (SANE_Int dn, SANE_Byte * buffer, size_t * size)
 {
   ssize_t read_size = 0;
 
@@ -3518,6 +5234,25 @@ sanei_usb_read_bulk (SANE_Int dn, SANE_Byte * buffer, size_t * size)
   return SANE_STATUS_GOOD;
 }
 
+SANE_Status
+sanei_usb_read_bulk (SANE_Int dn, SANE_Byte * buffer, size_t * size)
+{
+  struct timeval start;
+  SANE_Status status;
+
+  size_t wanted = size ? *size : 0;
+
+  sanei_usb_trace_start (&start);
+  if (!trace_enabled && dn >= 0 && dn < device_number && device_tunings[dn])
+    gettimeofday (&start, NULL);
+  status = sanei_usb_do_read_bulk (dn, buffer, size);
+  sanei_usb_trace_transfer (dn, sanei_usb_trace_bulk_in, &start, status,
+                            size ? *size : 0);
+  sanei_usb_tuning_transfer (dn, 0, &start, status, wanted,
+                             size ? *size : 0);
+  return status;
+}
+
 #if WITH_USB_RECORD_REPLAY
 static int sanei_usb_record_write_bulk(xmlNode* node, SANE_Int dn,
                                        const SANE_Byte* buffer,
@@ -3677,8 +5412,8 @@ static int sanei_usb_replay_write_bulk(SANE_Int dn, const SANE_Byte* buffer,
 }
 #endif
 
-SANE_Status
-sanei_usb_write_bulk (SANE_Int dn, const SANE_Byte * buffer, size_t * size)
+static SANE_Status
+sanei_usb_do_write_bulk (SANE_Int dn, const SANE_Byte * buffer, size_t * size)
 {
   ssize_t write_size = 0;
 
@@ -3845,6 +5580,25 @@ sanei_usb_write_bulk (SANE_Int dn, const SANE_Byte * buffer, size_t * size)
   return SANE_STATUS_GOOD;
 }
 
+SANE_Status
+sanei_usb_write_bulk (SANE_Int dn, const SANE_Byte * buffer, size_t * size)
+{
+  struct timeval start;
+  SANE_Status status;
+
+  size_t wanted = size ? *size : 0;
+
+  sanei_usb_trace_start (&start);
+  if (!trace_enabled && dn >= 0 && dn < device_number && device_tunings[dn])
+    gettimeofday (&start, NULL);
+  status = sanei_usb_do_write_bulk (dn, buffer, size);
+  sanei_usb_trace_transfer (dn, sanei_usb_trace_bulk_out, &start, status,
+                            size ? *size : 0);
+  sanei_usb_tuning_transfer (dn, 1, &start, status, wanted,
+                             size ? *size : 0);
+  return status;
+}
+
 #if WITH_USB_RECORD_REPLAY
 static void
 sanei_usb_record_control_msg(xmlNode* node,
@@ -4000,10 +5754,10 @@ sanei_usb_replay_control_msg(SANE_Int dn, SANE_Int rtype, SANE_Int req,
 }
 #endif
 
-SANE_Status
-sanei_usb_control_msg (SANE_Int dn, SANE_Int rtype, SANE_Int req,
-		       SANE_Int value, SANE_Int index, SANE_Int len,
-		       SANE_Byte * data)
+static SANE_Status
+sanei_usb_do_control_msg (SANE_Int dn, SANE_Int rtype, SANE_Int req,
+			  SANE_Int value, SANE_Int index, SANE_Int len,
+			  SANE_Byte * data)
 {
   if (dn >= device_number || dn < 0)
     {
@@ -4153,6 +5907,20 @@ sanei_usb_control_msg (SANE_Int dn, SANE_Int rtype, SANE_Int req,
   return SANE_STATUS_GOOD;
 }
 
+SANE_Status
+sanei_usb_control_msg (SANE_Int dn, SANE_Int rtype, SANE_Int req,
+		       SANE_Int value, SANE_Int index, SANE_Int len,
+		       SANE_Byte * data)
+{
+  struct timeval start;
+  SANE_Status status;
+
+  sanei_usb_trace_start (&start);
+  status = sanei_usb_do_control_msg (dn, rtype, req, value, index, len, data);
+  sanei_usb_trace_transfer (dn, sanei_usb_trace_control, &start, status, len);
+  return status;
+}
+
 #if WITH_USB_RECORD_REPLAY
 static void sanei_usb_record_read_int(xmlNode* node,
                                       SANE_Int dn, SANE_Byte* buffer,
@@ -4278,8 +6046,8 @@ static int sanei_usb_replay_read_int(SANE_Int dn, SANE_Byte* buffer,
 }
 #endif // WITH_USB_RECORD_REPLAY
 
-SANE_Status
-sanei_usb_read_int (SANE_Int dn, SANE_Byte * buffer, size_t * size)
+static SANE_Status
+sanei_usb_do_read_int (SANE_Int dn, SANE_Byte * buffer, size_t * size)
 {
   ssize_t read_size = 0;
 #if defined(HAVE_LIBUSB_LEGACY) || defined(HAVE_LIBUSB)
@@ -4447,6 +6215,19 @@ sanei_usb_read_int (SANE_Int dn, SANE_Byte * buffer, size_t * size)
   return SANE_STATUS_GOOD;
 }
 
+SANE_Status
+sanei_usb_read_int (SANE_Int dn, SANE_Byte * buffer, size_t * size)
+{
+  struct timeval start;
+  SANE_Status status;
+
+  sanei_usb_trace_start (&start);
+  status = sanei_usb_do_read_int (dn, buffer, size);
+  sanei_usb_trace_transfer (dn, sanei_usb_trace_int, &start, status,
+                            size ? *size : 0);
+  return status;
+}
+
 #if WITH_USB_RECORD_REPLAY
 static SANE_Status sanei_usb_replay_set_configuration(SANE_Int dn,
                                                       SANE_Int configuration)
@@ -25,11 +25,14 @@
 
 int main()
 {
+    genesys::test_background();
+    genesys::test_buffer_pool();
     genesys::test_calibration_parsing();
     genesys::test_image();
     genesys::test_image_pipeline();
     genesys::test_motor();
     genesys::test_row_buffer();
+    genesys::test_scan_simulator();
     genesys::test_utilities();
     return finish_tests();
 }
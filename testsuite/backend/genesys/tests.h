@@ -23,11 +23,14 @@
 
 namespace genesys {
 
+void test_background();
+void test_buffer_pool();
 void test_calibration_parsing();
 void test_image();
 void test_image_pipeline();
 void test_motor();
 void test_row_buffer();
+void test_scan_simulator();
 void test_utilities();
 
 } // namespace genesys
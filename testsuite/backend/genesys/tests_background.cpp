@@ -0,0 +1,119 @@
+/* sane - Scanner Access Now Easy.
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#define DEBUG_DECLARE_ONLY
+
+#include "tests.h"
+#include "minigtest.h"
+
+#include "../../../backend/genesys/background.h"
+#include "../../../backend/genesys/error.h"
+
+#include <atomic>
+#include <thread>
+
+namespace genesys {
+
+// runs throw_if_cancelled() until it throws, returns whether the task has been cancelled then
+static bool run_until_thrown(BackgroundWorker& worker, std::atomic<bool>& running)
+{
+    running = true;
+    try {
+        while (true) {
+            BackgroundWorker::throw_if_cancelled();
+            worker.sleep_ms(1);
+        }
+    } catch (const SaneException& e) {
+        if (e.status() != SANE_STATUS_CANCELLED) {
+            throw;
+        }
+    }
+    return worker.is_cancelled();
+}
+
+static void wait_until_running(const std::atomic<bool>& running)
+{
+    while (!running) {
+        std::this_thread::yield();
+    }
+}
+
+void test_background_worker_change_abandons_step()
+{
+    BackgroundWorker worker;
+    std::atomic<bool> running{false};
+    bool cancelled = true;
+
+    worker.start([&](BackgroundWorker& w)
+    {
+        w.mark_changes_seen();
+        cancelled = run_until_thrown(w, running);
+    });
+    wait_until_running(running);
+    worker.notify_changed();
+    worker.finish();
+
+    ASSERT_FALSE(cancelled);
+}
+
+void test_background_worker_change_ignored_until_tracked()
+{
+    BackgroundWorker worker;
+    std::atomic<bool> notified{false};
+    bool thrown = false;
+
+    worker.start([&](BackgroundWorker&)
+    {
+        wait_until_running(notified);
+        try {
+            BackgroundWorker::throw_if_cancelled();
+        } catch (const SaneException&) {
+            thrown = true;
+        }
+    });
+    worker.notify_changed();
+    notified = true;
+    worker.finish();
+
+    ASSERT_FALSE(thrown);
+}
+
+void test_background_worker_cancel()
+{
+    BackgroundWorker worker;
+    std::atomic<bool> running{false};
+    bool cancelled = false;
+
+    worker.start([&](BackgroundWorker& w)
+    {
+        cancelled = run_until_thrown(w, running);
+    });
+    wait_until_running(running);
+    worker.cancel();
+
+    ASSERT_TRUE(cancelled);
+}
+
+void test_background()
+{
+    test_background_worker_change_abandons_step();
+    test_background_worker_change_ignored_until_tracked();
+    test_background_worker_cancel();
+}
+
+} // namespace genesys
@@ -0,0 +1,180 @@
+/* sane - Scanner Access Now Easy.
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#define DEBUG_DECLARE_ONLY
+
+#include "tests.h"
+#include "minigtest.h"
+#include "tests_printers.h"
+
+#include "../../../backend/genesys/buffer_pool.h"
+#include "../../../backend/genesys/image.h"
+#include "../../../backend/genesys/row_buffer.h"
+
+namespace genesys {
+
+void test_buffer_pool_reuse()
+{
+    auto pool = std::make_shared<BufferPool>();
+    BufferPool::Scope scope{pool};
+
+    const std::uint8_t* first_data = nullptr;
+    {
+        PooledBuffer buffer;
+        buffer.resize(100000);
+        first_data = buffer.data();
+        ASSERT_EQ(pool->in_use_bytes(), 100000u);
+    }
+    ASSERT_EQ(pool->in_use_bytes(), 0u);
+    ASSERT_EQ(pool->pooled_bytes(), 100000u);
+
+    pool->begin_session();
+    ASSERT_EQ(pool->pooled_bytes(), 100000u);
+
+    PooledBuffer buffer;
+    buffer.resize(80000);
+    ASSERT_EQ(buffer.data(), first_data);
+    ASSERT_EQ(buffer.size(), 80000u);
+    ASSERT_EQ(buffer[0], 0);
+    ASSERT_EQ(buffer[79999], 0);
+    ASSERT_EQ(pool->reused_count(), 1u);
+    ASSERT_EQ(pool->allocated_count(), 1u);
+    ASSERT_EQ(pool->pooled_bytes(), 0u);
+}
+
+void test_buffer_pool_size_ratio()
+{
+    auto pool = std::make_shared<BufferPool>();
+    BufferPool::Scope scope{pool};
+
+    {
+        PooledBuffer buffer;
+        buffer.resize(1000000);
+    }
+
+    // a much larger buffer is not wasted on a small request
+    PooledBuffer small;
+    small.resize(100000);
+    ASSERT_EQ(pool->reused_count(), 0u);
+    ASSERT_EQ(pool->pooled_bytes(), 1000000u);
+
+    // buffers below the minimum size are not pooled at all
+    PooledBuffer tiny;
+    tiny.resize(100);
+    ASSERT_EQ(pool->in_use_bytes(), 100000u);
+}
+
+void test_buffer_pool_trim()
+{
+    auto pool = std::make_shared<BufferPool>();
+    BufferPool::Scope scope{pool};
+
+    {
+        PooledBuffer a;
+        PooledBuffer b;
+        a.resize(100000);
+        b.resize(200000);
+    }
+    ASSERT_EQ(pool->pooled_bytes(), 300000u);
+
+    // the following sessions need only the smaller buffer. The memory of the larger one is kept
+    // while a recent session needed it.
+    for (std::size_t i = 0; i < BufferPool::RECENT_SESSION_COUNT; ++i) {
+        pool->begin_session();
+        PooledBuffer a;
+        a.resize(100000);
+        ASSERT_EQ(pool->pooled_bytes(), 200000u);
+    }
+    pool->begin_session();
+    ASSERT_EQ(pool->pooled_bytes(), 100000u);
+
+    pool->clear();
+    ASSERT_EQ(pool->pooled_bytes(), 0u);
+}
+
+void test_buffer_pool_copy_and_resize()
+{
+    auto pool = std::make_shared<BufferPool>();
+    BufferPool::Scope scope{pool};
+
+    PooledBuffer buffer;
+    buffer.resize(40000);
+    for (std::size_t i = 0; i < buffer.size(); ++i) {
+        buffer[i] = static_cast<std::uint8_t>(i);
+    }
+
+    PooledBuffer copy = buffer;
+    ASSERT_TRUE(std::equal(buffer.begin(), buffer.end(), copy.begin()));
+    ASSERT_EQ(pool->in_use_bytes(), 80000u);
+
+    buffer.resize(200000);
+    ASSERT_EQ(buffer[39999], static_cast<std::uint8_t>(39999));
+    ASSERT_EQ(buffer[40000], 0);
+    ASSERT_EQ(pool->in_use_bytes(), 240000u);
+    ASSERT_EQ(pool->pooled_bytes(), 40000u);
+
+    PooledBuffer moved = std::move(copy);
+    ASSERT_EQ(moved.size(), 40000u);
+    ASSERT_EQ(pool->in_use_bytes(), 240000u);
+}
+
+void test_buffer_pool_no_pool()
+{
+    PooledBuffer buffer;
+    buffer.resize(100000);
+    buffer[99999] = 1;
+    buffer.resize(200000);
+    ASSERT_EQ(buffer[99999], 1);
+    ASSERT_FALSE(BufferPool::current());
+}
+
+void test_buffer_pool_image_and_row_buffer()
+{
+    auto pool = std::make_shared<BufferPool>();
+
+    {
+        BufferPool::Scope scope{pool};
+        Image image{1000, 100, PixelFormat::RGB888};
+        RowBuffer rows{30000};
+        for (unsigned i = 0; i < 4; ++i) {
+            rows.push_back();
+            *rows.get_back_row_ptr() = static_cast<std::uint8_t>(i + 1);
+        }
+        rows.pop_front();
+        ASSERT_EQ(*rows.get_front_row_ptr(), 2);
+        ASSERT_EQ(*rows.get_back_row_ptr(), 4);
+        ASSERT_TRUE(pool->in_use_bytes() > 300000u);
+    }
+
+    // the buffers are returned to the pool even though they outlive the scope of the pool
+    ASSERT_EQ(pool->in_use_bytes(), 0u);
+    ASSERT_TRUE(pool->pooled_bytes() > 300000u);
+    ASSERT_FALSE(BufferPool::current());
+}
+
+void test_buffer_pool()
+{
+    test_buffer_pool_reuse();
+    test_buffer_pool_size_ratio();
+    test_buffer_pool_trim();
+    test_buffer_pool_copy_and_resize();
+    test_buffer_pool_no_pool();
+    test_buffer_pool_image_and_row_buffer();
+}
+
+} // namespace genesys
@@ -25,6 +25,9 @@
 
 #include "../../../backend/genesys/low.h"
 
+#include "../../../backend/genesys/genesys.h"
+
+#include <cmath>
 #include <sstream>
 
 namespace genesys {
@@ -121,9 +124,138 @@ void test_calibration_roundtrip()
     ASSERT_TRUE(str.eof());
 }
 
+void test_calibration_file_roundtrip()
+{
+    Genesys_Device::Calibration calibration = { create_fake_calibration_entry() };
+    LampWarmupModel warmup_model;
+    warmup_model.time_constants_ms = { 5000, 4000, 6000 };
+
+    std::stringstream str;
+    write_calibration(str, calibration, warmup_model);
+
+    Genesys_Device::Calibration deserialized;
+    LampWarmupModel deserialized_warmup_model;
+    ASSERT_TRUE(read_calibration(str, deserialized, deserialized_warmup_model, "test"));
+    ASSERT_TRUE(calibration == deserialized);
+    ASSERT_TRUE(warmup_model == deserialized_warmup_model);
+}
+
+// brightness of a lamp that reaches 200 with time constant of 5 seconds
+float simulated_lamp_brightness(unsigned time_ms)
+{
+    return 200.0f - 100.0f * std::exp(-(time_ms / 5000.0f));
+}
+
+unsigned simulate_lamp_warmup(const LampWarmupModel& model, LampWarmupModel& updated_model,
+                              unsigned& sample_count)
+{
+    LampWarmupTracker tracker{model, 0.005f};
+    unsigned time_ms = 0;
+    while (time_ms < 65000) {
+        float brightness = simulated_lamp_brightness(time_ms);
+        tracker.add_sample(time_ms, { brightness, brightness, brightness });
+        if (tracker.is_stable()) {
+            break;
+        }
+        // each test scan takes 50 ms
+        time_ms += tracker.next_sample_delay_ms(100, 1000) + 50;
+    }
+    updated_model = tracker.updated_model();
+    sample_count = tracker.sample_count();
+    return time_ms;
+}
+
+void test_lamp_warmup_tracker()
+{
+    // the time at which the brightness changes by 0.5% per second
+    unsigned expected_ms = 0;
+    while (100.0f / 5 * std::exp(-(expected_ms / 5000.0f)) / simulated_lamp_brightness(expected_ms)
+            >= 0.005f)
+    {
+        expected_ms++;
+    }
+
+    LampWarmupModel updated_model;
+    unsigned sample_count = 0;
+    unsigned time_ms = simulate_lamp_warmup(LampWarmupModel{}, updated_model, sample_count);
+
+    ASSERT_TRUE(time_ms >= expected_ms);
+    ASSERT_TRUE(time_ms < expected_ms + 200);
+    ASSERT_EQ(updated_model.time_constants_ms.size(), 3u);
+    for (auto time_constant : updated_model.time_constants_ms) {
+        ASSERT_TRUE(time_constant > 4950 && time_constant < 5050);
+    }
+
+    // warming up again with the learned model keeps the time constants stable
+    LampWarmupModel relearned_model;
+    time_ms = simulate_lamp_warmup(updated_model, relearned_model, sample_count);
+
+    ASSERT_TRUE(time_ms >= expected_ms);
+    ASSERT_TRUE(time_ms < expected_ms + 200);
+    ASSERT_EQ(relearned_model.time_constants_ms.size(), 3u);
+    for (auto time_constant : relearned_model.time_constants_ms) {
+        ASSERT_TRUE(time_constant > 4950 && time_constant < 5050);
+    }
+}
+
+void test_lamp_warmup_tracker_stable_lamp()
+{
+    LampWarmupTracker tracker{LampWarmupModel{}, 0.005f};
+    tracker.add_sample(0, { 150.0f });
+    ASSERT_FALSE(tracker.is_stable());
+
+    // a flat pair of samples is not enough
+    tracker.add_sample(100, { 150.05f });
+    ASSERT_FALSE(tracker.is_stable());
+
+    // neither are samples over too short a time
+    tracker.add_sample(200, { 150.0f });
+    tracker.add_sample(300, { 150.05f });
+    tracker.add_sample(400, { 150.0f });
+    ASSERT_FALSE(tracker.is_stable());
+
+    tracker.add_sample(700, { 150.05f });
+    tracker.add_sample(1000, { 150.0f });
+    ASSERT_TRUE(tracker.is_stable());
+
+    // noise does not produce a time constant
+    ASSERT_TRUE(tracker.updated_model().empty());
+
+    // the lamp is still brightening even though the last two samples are equal
+    LampWarmupTracker rising{LampWarmupModel{}, 0.005f};
+    rising.add_sample(0, { 100.0f });
+    rising.add_sample(300, { 110.0f });
+    rising.add_sample(600, { 105.0f });
+    rising.add_sample(900, { 125.0f });
+    rising.add_sample(1200, { 125.0f });
+    ASSERT_FALSE(rising.is_stable());
+}
+
+void test_compute_channel_averages()
+{
+    std::vector<std::uint8_t> data = { 10, 20, 30, 20, 40, 60 };
+    auto averages = compute_channel_averages(data.data(), data.size(), 8, 3, 1, false);
+    ASSERT_TRUE(averages == std::vector<float>({ 15.0f, 30.0f, 45.0f }));
+
+    std::vector<std::uint8_t> data16 = { 0x00, 0x01, 0x00, 0x03, 0x10, 0x00, 0x30, 0x00 };
+    averages = compute_channel_averages(data16.data(), data16.size(), 16, 1, 2, false);
+    ASSERT_TRUE(averages == std::vector<float>({ (0x100 + 0x300 + 0x10 + 0x30) / 4.0f }));
+
+    std::vector<std::uint8_t> lines = {
+        10, 20, 30, 40, 50, 60,
+        30, 40, 50, 60, 70, 80,
+    };
+    averages = compute_channel_averages(lines.data(), lines.size(), 8, 3, 2, true);
+    ASSERT_TRUE(averages == std::vector<float>({ 25.0f, 45.0f, 65.0f }));
+}
+
 void test_calibration_parsing()
 {
     test_calibration_roundtrip();
+    test_calibration_file_roundtrip();
+    test_lamp_warmup_tracker();
+    test_lamp_warmup_tracker_stable_lamp();
+    test_compute_channel_averages();
 }
 
 } // namespace genesys
@@ -560,6 +560,75 @@ void test_convert_pixel_row_format()
     ASSERT_EQ(out_data, expected_data);
 }
 
+void test_convert_pixel_row_format_matches_generic()
+{
+    using Data = std::vector<std::uint8_t>;
+
+    const PixelFormat formats[] = {
+        PixelFormat::I1, PixelFormat::RGB111, PixelFormat::I8, PixelFormat::RGB888,
+        PixelFormat::BGR888, PixelFormat::I16, PixelFormat::RGB161616, PixelFormat::BGR161616,
+    };
+
+    const std::size_t width = 37;
+
+    Data in_data;
+    in_data.resize(get_pixel_row_bytes(PixelFormat::RGB161616, width));
+    for (std::size_t i = 0; i < in_data.size(); ++i) {
+        in_data[i] = static_cast<std::uint8_t>(i * 73 + 11);
+    }
+
+    for (auto in_format : formats) {
+        for (auto out_format : formats) {
+            auto out_bytes = get_pixel_row_bytes(out_format, width);
+
+            Data expected_data(out_bytes);
+            for (std::size_t x = 0; x < width; ++x) {
+                set_pixel_to_row(expected_data.data(), x,
+                                 get_pixel_from_row(in_data.data(), x, in_format), out_format);
+            }
+
+            Data out_data(out_bytes);
+            convert_pixel_row_format(in_data.data(), in_format, out_data.data(), out_format,
+                                     width);
+
+            if (in_format == out_format) {
+                // the padding bits of 1-bit formats are copied as well
+                auto in_bytes = get_pixel_row_bytes(in_format, width);
+                expected_data.assign(in_data.begin(), in_data.begin() + in_bytes);
+            }
+            ASSERT_EQ(out_data, expected_data);
+        }
+    }
+}
+
+void test_swap_16bit_endian()
+{
+    using Data = std::vector<std::uint8_t>;
+
+    Data data = { 0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde };
+    swap_16bit_endian(data.data(), 3);
+
+    Data expected_data = { 0x34, 0x12, 0x78, 0x56, 0xbc, 0x9a, 0xde };
+    ASSERT_EQ(data, expected_data);
+}
+
+void test_invert_pixel_data()
+{
+    using Data = std::vector<std::uint8_t>;
+
+    Data data = { 0x00, 0xff, 0x12, 0xf0 };
+    invert_pixel_data(data.data(), 3);
+
+    Data expected_data = { 0xff, 0x00, 0xed, 0xf0 };
+    ASSERT_EQ(data, expected_data);
+
+    // inverting the bytes inverts 16-bit values too
+    Data data16 = { 0x34, 0x12 };
+    invert_pixel_data(data16.data(), data16.size());
+    std::uint16_t value = data16[0] | (data16[1] << 8);
+    ASSERT_EQ(value, 0xffff - 0x1234);
+}
+
 void test_image()
 {
     test_get_pixel_from_row();
@@ -569,6 +638,9 @@ void test_image()
     test_get_raw_channel_from_row();
     test_set_raw_channel_to_row();
     test_convert_pixel_row_format();
+    test_convert_pixel_row_format_matches_generic();
+    test_swap_16bit_endian();
+    test_invert_pixel_data();
 }
 
 } // namespace genesys
@@ -167,6 +167,42 @@ void test_image_buffer_capped_remaining_bytes()
     ASSERT_EQ(requests, expected);
 }
 
+void test_image_buffer_batch_reads()
+{
+    std::vector<std::size_t> requests;
+    std::uint8_t next_value = 0;
+
+    auto on_read = [&](std::size_t x, std::uint8_t* data)
+    {
+        requests.push_back(x);
+        for (std::size_t i = 0; i < x; ++i) {
+            data[i] = next_value++;
+        }
+        return true;
+    };
+
+    ImageBuffer buffer{1000, on_read};
+    buffer.set_remaining_size(10000);
+    buffer.set_max_batch_size(3500);
+
+    std::vector<std::uint8_t> data;
+    data.resize(8000);
+
+    ASSERT_TRUE(buffer.get_data(7500, data.data()));
+    ASSERT_TRUE(buffer.get_data(500, data.data() + 7500));
+
+    // large reads are done in whole chunks and never read ahead of the request
+    std::vector<std::size_t> expected = {
+        3000, 3000, 1000, 1000
+    };
+    ASSERT_EQ(requests, expected);
+
+    std::vector<std::uint8_t> expected_data;
+    expected_data.resize(data.size());
+    std::iota(expected_data.begin(), expected_data.end(), 0);
+    ASSERT_EQ(data, expected_data);
+}
+
 void test_node_buffered_callable_source()
 {
     using Data = std::vector<std::uint8_t>;
@@ -611,8 +647,7 @@ void test_node_pixel_shift_lines_4lines()
     };
 
     ImagePipelineStack stack;
-    stack.push_first_node<ImagePipelineNodeArraySource>(12, 9, PixelFormat::I8,
-                                                        std::move(in_data));
+    stack.push_first_node<ImagePipelineNodeArraySource>(12, 9, PixelFormat::I8, in_data);
     stack.push_node<ImagePipelineNodePixelShiftLines>(std::vector<std::size_t>{0, 2, 1, 3});
 
     ASSERT_EQ(stack.get_output_width(), 12u);
@@ -632,6 +667,21 @@ void test_node_pixel_shift_lines_4lines()
     };
 
     ASSERT_EQ(out_data, expected_data);
+
+    // the history must be kept across reads of any number of rows
+    ImagePipelineStack batch_stack;
+    batch_stack.push_first_node<ImagePipelineNodeArraySource>(12, 9, PixelFormat::I8,
+                                                              std::move(in_data));
+    batch_stack.push_node<ImagePipelineNodePixelShiftLines>(std::vector<std::size_t>{0, 2, 1, 3});
+
+    Data batch_data(expected_data.size());
+    std::size_t row = 0;
+    for (std::size_t count : { 1, 1, 3, 1 }) {
+        batch_stack.get_next_rows(count, batch_data.data() + row * 12);
+        row += count;
+    }
+
+    ASSERT_EQ(batch_data, expected_data);
 }
 
 void test_node_pixel_shift_columns_compute_max_width()
@@ -921,6 +971,225 @@ void test_node_calibrate_16bit()
     ASSERT_EQ(out_data, expected_data);
 }
 
+void test_resample_coefficients_box_downscale()
+{
+    auto coeffs = compute_resample_coefficients(4, 2, ResampleFilter::BOX);
+
+    ASSERT_EQ(coeffs.taps, 3u);
+    ASSERT_EQ(coeffs.first, std::vector<std::size_t>({0, 1}));
+    ASSERT_EQ(coeffs.weights, std::vector<float>({0.5f, 0.5f, 0.0f, 0.0f, 0.5f, 0.5f}));
+}
+
+void test_node_resample_box_downscale()
+{
+    using Data = std::vector<std::uint8_t>;
+
+    Data in_data = {
+        10, 20, 30, 40,
+        50, 60, 70, 80,
+    };
+
+    ImagePipelineStack stack;
+    stack.push_first_node<ImagePipelineNodeArraySource>(4, 2, PixelFormat::I8,
+                                                        std::move(in_data));
+    stack.push_node<ImagePipelineNodeResample>(2, 1, ResampleFilter::BOX);
+
+    ASSERT_EQ(stack.get_output_width(), 2u);
+    ASSERT_EQ(stack.get_output_height(), 1u);
+    ASSERT_EQ(stack.get_output_row_bytes(), 2u);
+    ASSERT_EQ(stack.get_output_format(), PixelFormat::I8);
+
+    auto out_data = stack.get_all_data();
+
+    Data expected_data = {
+        35, 55
+    };
+
+    ASSERT_EQ(out_data, expected_data);
+}
+
+void test_node_resample_bilinear_upscale()
+{
+    using Data = std::vector<std::uint8_t>;
+
+    Data in_data = {
+        0, 100,
+    };
+
+    ImagePipelineStack stack;
+    stack.push_first_node<ImagePipelineNodeArraySource>(2, 1, PixelFormat::I8,
+                                                        std::move(in_data));
+    stack.push_node<ImagePipelineNodeResample>(4, 2, ResampleFilter::BILINEAR);
+
+    ASSERT_EQ(stack.get_output_width(), 4u);
+    ASSERT_EQ(stack.get_output_height(), 2u);
+    ASSERT_EQ(stack.get_output_format(), PixelFormat::I8);
+
+    auto out_data = stack.get_all_data();
+
+    Data expected_data = {
+        0, 25, 75, 100,
+        0, 25, 75, 100,
+    };
+
+    ASSERT_EQ(out_data, expected_data);
+}
+
+void test_node_resample_upscale_eof()
+{
+    Image image{2, 1, PixelFormat::I8};
+    image.get_row_ptr(0)[0] = 0;
+    image.get_row_ptr(0)[1] = 100;
+
+    ImagePipelineStack stack;
+    stack.push_first_node<ImagePipelineNodeImageSource>(image);
+    stack.push_node<ImagePipelineNodeResample>(4, 3, ResampleFilter::BILINEAR);
+
+    std::vector<std::uint8_t> row(stack.get_output_row_bytes());
+    for (unsigned y = 0; y < 3; y++) {
+        ASSERT_FALSE(stack.eof());
+        ASSERT_TRUE(stack.get_next_row_data(row.data()));
+        // the single source row has been read with the first output row already
+        ASSERT_TRUE(stack.front().eof());
+    }
+    ASSERT_TRUE(stack.eof());
+}
+
+void test_node_resample_same_size()
+{
+    using Data = std::vector<std::uint8_t>;
+
+    Data in_data = {
+        0x00, 0x00, 0xff, 0xff, 0x34, 0x12,
+        0x78, 0x56, 0x00, 0x10, 0xff, 0x00,
+        0x01, 0x00, 0xcd, 0xab, 0x00, 0x80,
+        0xff, 0xff, 0x00, 0x00, 0x21, 0x43,
+    };
+    Data expected_data = in_data;
+
+    ImagePipelineStack stack;
+    stack.push_first_node<ImagePipelineNodeArraySource>(2, 2, PixelFormat::RGB161616,
+                                                        std::move(in_data));
+    stack.push_node<ImagePipelineNodeResample>(2, 2, ResampleFilter::BILINEAR);
+
+    ASSERT_EQ(stack.get_output_width(), 2u);
+    ASSERT_EQ(stack.get_output_height(), 2u);
+    ASSERT_EQ(stack.get_output_row_bytes(), 12u);
+    ASSERT_EQ(stack.get_output_format(), PixelFormat::RGB161616);
+
+    auto out_data = stack.get_all_data();
+
+    ASSERT_EQ(out_data, expected_data);
+}
+
+void test_node_resample_unsupported_format()
+{
+    ImagePipelineStack stack;
+    stack.push_first_node<ImagePipelineNodeArraySource>(16, 1, PixelFormat::I1,
+                                                        std::vector<std::uint8_t>(2));
+    ASSERT_RAISES(stack.push_node<ImagePipelineNodeResample>(8, 1, ResampleFilter::BOX),
+                  SaneException);
+}
+
+namespace {
+
+std::vector<std::uint8_t> read_rows_in_batches(ImagePipelineStack& stack,
+                                               const std::vector<std::size_t>& batch_sizes)
+{
+    auto row_bytes = stack.get_output_row_bytes();
+    auto height = stack.get_output_height();
+
+    std::vector<std::uint8_t> data;
+    data.resize(row_bytes * height);
+
+    std::size_t row = 0;
+    for (std::size_t i = 0; row < height; ++i) {
+        auto count = std::min(batch_sizes[i % batch_sizes.size()], height - row);
+        ASSERT_TRUE(stack.get_next_rows(count, data.data() + row_bytes * row));
+        row += count;
+    }
+    return data;
+}
+
+std::vector<std::uint8_t> make_test_data(std::size_t size)
+{
+    std::vector<std::uint8_t> data;
+    data.resize(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<std::uint8_t>(i * 37 + i / 7);
+    }
+    return data;
+}
+
+void build_shift_pipeline(ImagePipelineStack& stack)
+{
+    std::vector<std::uint16_t> bottom(6 * 3, 0x1000);
+    std::vector<std::uint16_t> top(6 * 3, 0xe000);
+
+    stack.push_first_node<ImagePipelineNodeArraySource>(6, 40, PixelFormat::RGB888,
+                                                        make_test_data(6 * 3 * 40));
+    stack.push_node<ImagePipelineNodeComponentShiftLines>(0, 1, 3);
+    stack.push_node<ImagePipelineNodePixelShiftLines>(std::vector<std::size_t>{0, 2});
+    stack.push_node<ImagePipelineNodeInvert>();
+    stack.push_node<ImagePipelineNodeFormatConvert>(PixelFormat::RGB161616);
+    stack.push_node<ImagePipelineNodeSwap16BitEndian>();
+    stack.push_node<ImagePipelineNodeCalibrate>(bottom, top, 0);
+}
+
+void build_desegment_pipeline(ImagePipelineStack& stack)
+{
+    stack.push_first_node<ImagePipelineNodeArraySource>(8, 72, PixelFormat::I8,
+                                                        make_test_data(8 * 72));
+    stack.push_node<ImagePipelineNodeDeinterleaveLines>(2, 1);
+    stack.push_node<ImagePipelineNodeMergeMonoLines>(ColorOrder::RGB);
+    stack.push_node<ImagePipelineNodePixelShiftColumns>(std::vector<std::size_t>{0, 1});
+}
+
+} // namespace
+
+void test_node_batch_reads_match_row_reads()
+{
+    using Data = std::vector<std::uint8_t>;
+
+    for (auto build : { build_shift_pipeline, build_desegment_pipeline }) {
+        ImagePipelineStack row_stack;
+        build(row_stack);
+        Data row_data;
+        row_data.resize(row_stack.get_output_row_bytes() * row_stack.get_output_height());
+        for (std::size_t i = 0; i < row_stack.get_output_height(); ++i) {
+            ASSERT_TRUE(row_stack.get_next_row_data(row_data.data() +
+                                                    row_stack.get_output_row_bytes() * i));
+        }
+
+        ImagePipelineStack batch_stack;
+        build(batch_stack);
+        ASSERT_EQ(read_rows_in_batches(batch_stack, { 3, 1, 7, 2 }), row_data);
+
+        ImagePipelineStack all_stack;
+        build(all_stack);
+        ASSERT_EQ(all_stack.get_all_data(), row_data);
+    }
+}
+
+void test_node_batch_reads_past_end()
+{
+    using Data = std::vector<std::uint8_t>;
+
+    ImagePipelineStack stack;
+    stack.push_first_node<ImagePipelineNodeArraySource>(2, 3, PixelFormat::I8,
+                                                        Data{1, 2, 3, 4, 5, 6});
+
+    Data out_data;
+    out_data.resize(8);
+
+    ASSERT_TRUE(stack.get_next_rows(2, out_data.data()));
+    ASSERT_FALSE(stack.eof());
+    ASSERT_FALSE(stack.get_next_rows(2, out_data.data()));
+    ASSERT_TRUE(stack.eof());
+    ASSERT_EQ(out_data[0], 5u);
+    ASSERT_EQ(out_data[1], 6u);
+}
+
 void test_image_pipeline()
 {
     test_image_buffer_exact_reads();
@@ -928,6 +1197,7 @@ void test_image_pipeline()
     test_image_buffer_larger_reads();
     test_image_buffer_uncapped_remaining_bytes();
     test_image_buffer_capped_remaining_bytes();
+    test_image_buffer_batch_reads();
     test_node_buffered_callable_source();
     test_node_format_convert();
     test_node_desegment_1_line();
@@ -950,6 +1220,14 @@ void test_image_pipeline()
     test_node_pixel_shift_columns_compute_max_width();
     test_node_calibrate_8bit();
     test_node_calibrate_16bit();
+    test_resample_coefficients_box_downscale();
+    test_node_resample_box_downscale();
+    test_node_resample_bilinear_upscale();
+    test_node_resample_upscale_eof();
+    test_node_resample_same_size();
+    test_node_resample_unsupported_format();
+    test_node_batch_reads_match_row_reads();
+    test_node_batch_reads_past_end();
 }
 
 } // namespace genesys
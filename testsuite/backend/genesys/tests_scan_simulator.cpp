@@ -0,0 +1,298 @@
+/* sane - Scanner Access Now Easy.
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#define DEBUG_DECLARE_ONLY
+
+#include "tests.h"
+#include "minigtest.h"
+#include "tests_printers.h"
+
+#include "../../../backend/genesys/device.h"
+#include "../../../backend/genesys/test_scan_simulator.h"
+#include "../../../backend/genesys/test_scanner_interface.h"
+#include "../../../backend/genesys/test_settings.h"
+
+#include <vector>
+
+namespace genesys {
+
+namespace {
+
+TestScanSimulatorSettings deterministic_settings()
+{
+    TestScanSimulatorSettings settings;
+    settings.time_scale = 0;
+    return settings;
+}
+
+TestScanSimulatorFormat gray8_format(unsigned pixels, unsigned yres)
+{
+    TestScanSimulatorFormat format;
+    format.channels = 1;
+    format.depth = 8;
+    format.line_bytes = pixels;
+    format.yres = yres;
+    return format;
+}
+
+} // namespace
+
+void test_scan_simulator_read_pacing()
+{
+    auto settings = deterministic_settings();
+    settings.motor_speed_ips = 1.0;
+    settings.motor_acceleration_us = 0;
+    TestScanSimulator sim{settings};
+
+    // 600 lines per second at 600 dpi
+    sim.start_scan(gray8_format(1000, 600), true);
+    auto start_us = sim.now_us();
+
+    std::vector<std::uint8_t> data(1000 * 600);
+    sim.read_data(data.data(), data.size());
+
+    auto elapsed_us = sim.now_us() - start_us;
+    ASSERT_TRUE(elapsed_us >= 1000000u);
+    ASSERT_TRUE(elapsed_us < 1005000u);
+    ASSERT_EQ(sim.bytes_read(), 600000u);
+    ASSERT_EQ(sim.head_stops(), 0u);
+}
+
+void test_scan_simulator_read_pacing_acceleration()
+{
+    auto settings = deterministic_settings();
+    settings.motor_speed_ips = 1.0;
+    settings.motor_acceleration_us = 50000;
+    TestScanSimulator sim{settings};
+
+    // the head loses half of the acceleration time
+    sim.start_scan(gray8_format(1000, 600), true);
+    auto start_us = sim.now_us();
+
+    std::vector<std::uint8_t> data(1000 * 600);
+    sim.read_data(data.data(), data.size());
+
+    auto elapsed_us = sim.now_us() - start_us;
+    ASSERT_TRUE(elapsed_us >= 1025000u);
+    ASSERT_TRUE(elapsed_us < 1030000u);
+}
+
+void test_scan_simulator_line_rate_limit()
+{
+    auto settings = deterministic_settings();
+    settings.motor_acceleration_us = 0;
+    settings.max_line_rate = 500;
+    TestScanSimulator sim{settings};
+
+    // at 2400 dpi the sensor, not the motor, limits the speed
+    sim.start_scan(gray8_format(1000, 2400), true);
+    std::vector<std::uint8_t> data(1000 * 500);
+    sim.read_data(data.data(), data.size());
+
+    ASSERT_TRUE(sim.now_us() >= 1000000u);
+    ASSERT_TRUE(sim.now_us() < 1005000u);
+}
+
+void test_scan_simulator_fifo_full()
+{
+    auto settings = deterministic_settings();
+    settings.motor_acceleration_us = 0;
+    settings.fifo_size = 100000;
+    TestScanSimulator sim{settings};
+
+    sim.start_scan(gray8_format(1000, 600), true);
+
+    // the host does not read for a second, the head stops once 100 lines have been scanned
+    sim.sleep_us(1000000);
+    std::uint8_t byte = 0;
+    sim.read_data(&byte, 1);
+    ASSERT_EQ(sim.head_stops(), 1u);
+    ASSERT_EQ(sim.bytes_produced(), 100000u);
+
+    // the data in the FIFO is available immediately
+    auto now_us = sim.now_us();
+    std::vector<std::uint8_t> data(99999);
+    sim.read_data(data.data(), data.size());
+    ASSERT_EQ(sim.now_us(), now_us);
+
+    // once there's room the head moves again
+    sim.sleep_us(100000);
+    sim.read_data(data.data(), 1000);
+    ASSERT_EQ(sim.head_stops(), 1u);
+    ASSERT_TRUE(sim.bytes_produced() >= 159000u);
+}
+
+void test_scan_simulator_lamp_warmup()
+{
+    auto settings = deterministic_settings();
+    settings.lamp_initial_brightness = 0.7;
+    settings.lamp_time_constant_us = 10000000;
+    TestScanSimulator sim{settings};
+
+    sim.set_lamp(false);
+    ASSERT_EQ(sim.lamp_brightness(), 0.0);
+
+    sim.set_lamp(true);
+    auto initial = sim.lamp_brightness();
+    ASSERT_TRUE(initial > 0.69 && initial < 0.71);
+
+    sim.sleep_us(10000000);
+    auto after_tau = sim.lamp_brightness();
+    ASSERT_TRUE(after_tau > 0.88 && after_tau < 0.90);
+
+    sim.sleep_us(100000000);
+    auto warm = sim.lamp_brightness();
+    ASSERT_TRUE(warm > after_tau && warm <= 1.0);
+
+    // a white target gets brighter as the lamp warms up
+    sim.set_lamp(false);
+    sim.set_lamp(true);
+    sim.start_scan(gray8_format(1000, 600), false);
+    auto cold_value = sim.sample_value(0, 500, 0);
+    sim.sleep_us(30000000);
+    ASSERT_TRUE(sim.sample_value(0, 500, 0) > cold_value);
+}
+
+void test_scan_simulator_shading()
+{
+    auto settings = deterministic_settings();
+    settings.lamp_initial_brightness = 1.0;
+    TestScanSimulator sim{settings};
+
+    // the head does not move, the sensor sees the white strip
+    unsigned pixels = 1000;
+    sim.start_scan(gray8_format(pixels, 600), false);
+    std::vector<std::uint8_t> line(pixels);
+    sim.read_data(line.data(), line.size());
+
+    unsigned edge_sum = 0;
+    unsigned center_sum = 0;
+    for (unsigned i = 0; i < 20; ++i) {
+        edge_sum += line[i];
+        center_sum += line[pixels / 2 - 10 + i];
+    }
+    ASSERT_TRUE(edge_sum < center_sum);
+    ASSERT_TRUE(center_sum / 20 <= static_cast<unsigned>(255 * 0.85 * 1.03 + 1));
+
+    // the per-pixel gain deviates, but is the same in each line
+    std::vector<std::uint8_t> line2(pixels);
+    sim.read_data(line2.data(), line2.size());
+    ASSERT_EQ(line, line2);
+
+    bool all_equal = true;
+    for (unsigned i = pixels / 2 - 10; i < pixels / 2 + 10; ++i) {
+        if (line[i] != line[pixels / 2]) {
+            all_equal = false;
+        }
+    }
+    ASSERT_FALSE(all_equal);
+}
+
+void test_scan_simulator_formats()
+{
+    auto settings = deterministic_settings();
+    settings.lamp_initial_brightness = 1.0;
+    TestScanSimulator sim{settings};
+
+    TestScanSimulatorFormat format;
+    format.channels = 3;
+    format.depth = 16;
+    format.line_bytes = 100 * 3 * 2;
+    format.yres = 600;
+    sim.start_scan(format, false);
+
+    std::vector<std::uint8_t> line(format.line_bytes);
+    sim.read_data(line.data(), line.size());
+
+    for (unsigned ch = 0; ch < 3; ++ch) {
+        unsigned offset = (50 * 3 + ch) * 2;
+        unsigned value = line[offset] | (line[offset + 1] << 8);
+        auto expected = static_cast<unsigned>(sim.sample_value(0, 50, ch) * 65535);
+        ASSERT_EQ(value, expected);
+    }
+
+    // white is not lineart black
+    format.channels = 1;
+    format.depth = 1;
+    format.line_bytes = 100 / 8;
+    sim.start_scan(format, false);
+    std::uint8_t byte = 0xff;
+    sim.read_data(&byte, 1);
+    ASSERT_EQ(byte, 0x00);
+}
+
+namespace {
+
+// returns whether writing the scan start register through the interface started a scan
+bool interface_scan_started(AsicType asic_type, bool single_write)
+{
+    Genesys_Model model;
+    model.asic_type = asic_type;
+
+    Genesys_Device dev;
+    dev.model = &model;
+    dev.session.params.channels = 1;
+    dev.session.params.depth = 8;
+    dev.session.params.yres = 600;
+    dev.session.output_line_bytes_raw = 1000;
+
+    enable_testing_simulation(deterministic_settings());
+    bool started = false;
+    {
+        TestScannerInterface iface{&dev, 0, 0, 0};
+        if (single_write) {
+            iface.write_register(0x0f, 0x00);
+        } else {
+            Genesys_Register_Set regs;
+            regs.init_reg(0x01, 0x01);
+            regs.init_reg(0x0f, 0x01);
+            iface.write_registers(regs);
+        }
+        std::uint8_t byte = 0;
+        iface.simulator()->read_data(&byte, 1);
+        started = iface.simulator()->bytes_read() > 0;
+    }
+    disable_testing_simulation();
+    dev.model = nullptr;
+    return started;
+}
+
+} // namespace
+
+void test_scan_simulator_interface_scan_start()
+{
+    ASSERT_TRUE(interface_scan_started(AsicType::GL646, false));
+    // gl646_stop_motor() writes 0x0f on its own
+    ASSERT_FALSE(interface_scan_started(AsicType::GL646, true));
+    // scanner_start_action() writes 0x0f on its own on the other ASICs
+    ASSERT_TRUE(interface_scan_started(AsicType::GL843, true));
+}
+
+void test_scan_simulator()
+{
+    test_scan_simulator_read_pacing();
+    test_scan_simulator_read_pacing_acceleration();
+    test_scan_simulator_line_rate_limit();
+    test_scan_simulator_fifo_full();
+    test_scan_simulator_lamp_warmup();
+    test_scan_simulator_shading();
+    test_scan_simulator_formats();
+    test_scan_simulator_interface_scan_start();
+}
+
+} // namespace genesys
@@ -0,0 +1,385 @@
+#include "../../include/sane/config.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/* sane includes for the sanei functions called */
+#include "../include/sane/sane.h"
+#include "../include/sane/sanei.h"
+#include "../include/sane/sanei_ir.h"
+
+#define ROWS 1031
+#define COLS 211
+
+/* fills a 16 bit image with reproducible noise and a few dark spots */
+static SANE_Uint *
+create_image (SANE_Parameters * params, uint32_t seed)
+{
+  SANE_Uint *img;
+  int i;
+
+  memset (params, 0, sizeof (*params));
+  params->format = SANE_FRAME_GRAY;
+  params->last_frame = SANE_TRUE;
+  params->depth = 16;
+  params->pixels_per_line = COLS;
+  params->lines = ROWS;
+  params->bytes_per_line = COLS * 2;
+
+  img = malloc (ROWS * COLS * sizeof (SANE_Uint));
+  assert (img != NULL);
+  for (i = 0; i < ROWS * COLS; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      img[i] = 20000 + (seed >> 16) % 40000;
+      if ((seed >> 8) % 97 == 0)
+        img[i] = (seed >> 4) % 2000;
+    }
+  return img;
+}
+
+/* mean over the window clipped to the image, as documented */
+static void
+reference_mean (const SANE_Uint * in, SANE_Uint * out, int win_rows,
+                int win_cols)
+{
+  int64_t *sums = calloc ((ROWS + 1) * (COLS + 1), sizeof (int64_t));
+  int i, j;
+
+  assert (sums != NULL);
+  for (i = 0; i < ROWS; i++)
+    for (j = 0; j < COLS; j++)
+      sums[(i + 1) * (COLS + 1) + j + 1] = in[i * COLS + j]
+        + sums[i * (COLS + 1) + j + 1] + sums[(i + 1) * (COLS + 1) + j]
+        - sums[i * (COLS + 1) + j];
+
+  for (i = 0; i < ROWS; i++)
+    for (j = 0; j < COLS; j++)
+      {
+        int top = i - win_rows / 2 < 0 ? 0 : i - win_rows / 2;
+        int bot = i + win_rows / 2 + 1 > ROWS ? ROWS : i + win_rows / 2 + 1;
+        int left = j - win_cols / 2 < 0 ? 0 : j - win_cols / 2;
+        int right = j + win_cols / 2 + 1 > COLS ? COLS : j + win_cols / 2 + 1;
+        int64_t sum = sums[bot * (COLS + 1) + right]
+          - sums[top * (COLS + 1) + right] - sums[bot * (COLS + 1) + left]
+          + sums[top * (COLS + 1) + left];
+        out[i * COLS + j] = sum / ((bot - top) * (right - left));
+      }
+  free (sums);
+}
+
+/* runs the mean filter on the calling thread and on several threads */
+static void
+filter_mean_threads (int win_rows, int win_cols)
+{
+  SANE_Parameters params;
+  SANE_Uint *in, *serial, *threaded, *expected;
+  size_t size = ROWS * COLS * sizeof (SANE_Uint);
+  SANE_Status status;
+
+  in = create_image (&params, win_rows * 1000 + win_cols);
+  serial = malloc (size);
+  threaded = malloc (size);
+  expected = malloc (size);
+  assert (serial != NULL && threaded != NULL && expected != NULL);
+
+  setenv ("SANE_IR_THREADS", "1", 1);
+  status = sanei_ir_filter_mean (&params, in, serial, win_rows, win_cols);
+  assert (status == SANE_STATUS_GOOD);
+
+  setenv ("SANE_IR_THREADS", "8", 1);
+  status = sanei_ir_filter_mean (&params, in, threaded, win_rows, win_cols);
+  assert (status == SANE_STATUS_GOOD);
+
+  reference_mean (in, expected, win_rows, win_cols);
+
+  /* check results */
+  assert (memcmp (serial, expected, size) == 0);
+  assert (memcmp (threaded, serial, size) == 0);
+
+  free (expected);
+  free (threaded);
+  free (serial);
+  free (in);
+}
+
+static void
+filter_mean_small_window (void)
+{
+  filter_mean_threads (3, 3);
+}
+
+static void
+filter_mean_window_taller_than_band (void)
+{
+  /* 8 bands of 129 rows */
+  filter_mean_threads (301, 9);
+}
+
+static void
+filter_mean_wide_window (void)
+{
+  filter_mean_threads (15, 151);
+}
+
+static void
+filter_mean_even_window (void)
+{
+  SANE_Parameters params;
+  SANE_Uint *in, *out;
+  SANE_Status status;
+
+  in = create_image (&params, 1);
+  out = malloc (ROWS * COLS * sizeof (SANE_Uint));
+  assert (out != NULL);
+
+  status = sanei_ir_filter_mean (&params, in, out, 4, 3);
+  assert (status == SANE_STATUS_INVAL);
+
+  free (out);
+  free (in);
+}
+
+static void
+filter_madmean_threads (void)
+{
+  SANE_Parameters params;
+  SANE_Uint *in, *serial, *threaded;
+  SANE_Status status;
+
+  in = create_image (&params, 42);
+
+  setenv ("SANE_IR_THREADS", "1", 1);
+  status = sanei_ir_filter_madmean (&params, in, &serial, 9, 20, 100);
+  assert (status == SANE_STATUS_GOOD);
+
+  setenv ("SANE_IR_THREADS", "8", 1);
+  status = sanei_ir_filter_madmean (&params, in, &threaded, 9, 20, 100);
+  assert (status == SANE_STATUS_GOOD);
+
+  /* check results */
+  assert (memcmp (threaded, serial, ROWS * COLS * sizeof (SANE_Uint)) == 0);
+
+  free (threaded);
+  free (serial);
+  free (in);
+}
+
+static void
+dilate_mean_threads (void)
+{
+  SANE_Parameters params;
+  SANE_Uint *serial[3], *threaded[3], *mask;
+  size_t size = ROWS * COLS * sizeof (SANE_Uint);
+  SANE_Status status;
+  int k;
+
+  for (k = 0; k < 3; k++)
+    {
+      serial[k] = create_image (&params, k + 7);
+      threaded[k] = malloc (size);
+      assert (threaded[k] != NULL);
+      memcpy (threaded[k], serial[k], size);
+    }
+
+  status = sanei_ir_filter_madmean (&params, serial[0], &mask, 9, 20, 100);
+  assert (status == SANE_STATUS_GOOD);
+
+  setenv ("SANE_IR_THREADS", "1", 1);
+  status = sanei_ir_dilate_mean (&params, serial, mask, 500, 0, 5,
+                                 SANE_FALSE, 0, NULL);
+  assert (status == SANE_STATUS_GOOD);
+
+  setenv ("SANE_IR_THREADS", "8", 1);
+  status = sanei_ir_dilate_mean (&params, threaded, mask, 500, 0, 5,
+                                 SANE_FALSE, 0, NULL);
+  assert (status == SANE_STATUS_GOOD);
+
+  /* check results */
+  for (k = 0; k < 3; k++)
+    {
+      assert (memcmp (threaded[k], serial[k], size) == 0);
+      free (threaded[k]);
+      free (serial[k]);
+    }
+  free (mask);
+}
+
+/* spectral clean as done before the correction was tabulated, with a
+ * double multiply per pixel */
+static void
+reference_spectral_clean (const SANE_Parameters * params, double *llut,
+                          const SANE_Uint * red_data, SANE_Uint * ir_data)
+{
+  double *norm_histo;
+  double rval, rsum, rrsum, risum, rfac;
+  int64_t isum;
+  int *calc_buf;
+  int ival, imin, imax, thresh, thresh_low;
+  int itop, len, ssize, irand, i;
+  SANE_Status status;
+
+  itop = params->pixels_per_line * params->lines;
+  len = 1 << params->depth;
+
+  status = sanei_ir_create_norm_histogram (params, ir_data, &norm_histo);
+  assert (status == SANE_STATUS_GOOD);
+  thresh_low = INT_MAX;
+  if (sanei_ir_threshold_maxentropy (params, norm_histo, &thresh)
+      == SANE_STATUS_GOOD)
+    thresh_low = thresh;
+  if (sanei_ir_threshold_otsu (params, norm_histo, &thresh)
+      == SANE_STATUS_GOOD && thresh < thresh_low)
+    thresh_low = thresh;
+  if (sanei_ir_threshold_yen (params, norm_histo, &thresh)
+      == SANE_STATUS_GOOD && thresh < thresh_low)
+    thresh_low = thresh;
+  thresh_low = thresh_low == INT_MAX ? 0 : thresh_low / 2;
+  free (norm_histo);
+
+  ssize = itop / 2;
+  if (SAMPLE_SIZE < ssize)
+    ssize = SAMPLE_SIZE;
+  isum = 0;
+  rsum = rrsum = risum = 0.0;
+  i = ssize;
+  while (i > 0)
+    {
+      irand = rand () % itop;
+      rval = llut[red_data[irand]];
+      ival = ir_data[irand];
+      if (ival > thresh_low)
+        {
+          isum += ival;
+          rsum += rval;
+          rrsum += rval * rval;
+          risum += rval * (double) ival;
+          i--;
+        }
+    }
+  rfac = ((double) ssize * risum - rsum * (double) isum)
+    / ((double) ssize * rrsum - rsum * rsum);
+
+  calc_buf = malloc (itop * sizeof (int));
+  assert (calc_buf != NULL);
+  imin = INT_MAX;
+  imax = INT_MIN;
+  for (i = 0; i < itop; i++)
+    {
+      ival = ir_data[i] - (int) (rfac * llut[red_data[i]] + 0.5);
+      imax = ival > imax ? ival : imax;
+      imin = ival < imin ? ival : imin;
+      calc_buf[i] = ival;
+    }
+
+  rfac = (double) (len - 1) / (double) (imax - imin);
+  for (i = 0; i < itop; i++)
+    ir_data[i] = (double) (calc_buf[i] - imin) * rfac;
+  free (calc_buf);
+}
+
+/* the tabulated spectral clean must give the same image as the reference */
+static void
+spectral_clean_reference (void)
+{
+  SANE_Parameters params;
+  SANE_Uint *red, *ir, *expected;
+  size_t size = ROWS * COLS * sizeof (SANE_Uint);
+  double *llut;
+  SANE_Status status;
+  int k;
+
+  status = sanei_ir_ln_table (1 << 16, &llut);
+  assert (status == SANE_STATUS_GOOD);
+
+  for (k = 0; k < 8; k++)
+    {
+      red = create_image (&params, 100 + k);
+      ir = create_image (&params, 200 + k);
+      expected = malloc (size);
+      assert (expected != NULL);
+      memcpy (expected, ir, size);
+
+      srand (k);
+      reference_spectral_clean (&params, llut, red, expected);
+      srand (k);
+      status = sanei_ir_spectral_clean (&params, llut, red, ir);
+      assert (status == SANE_STATUS_GOOD);
+
+      /* check results */
+      assert (memcmp (ir, expected, size) == 0);
+
+      free (expected);
+      free (ir);
+      free (red);
+    }
+  free (llut);
+}
+
+/* kept scratch maps must not change the results */
+static void
+scratch_reuse (void)
+{
+  SANE_Parameters params;
+  SANE_Uint *in, *first, *second, *small;
+  SANE_Status status;
+
+  in = create_image (&params, 3);
+
+  sanei_ir_exit ();
+  status = sanei_ir_filter_madmean (&params, in, &first, 9, 20, 100);
+  assert (status == SANE_STATUS_GOOD);
+
+  /* a smaller image leaves the larger maps in place */
+  params.lines = ROWS / 4;
+  status = sanei_ir_filter_madmean (&params, in, &small, 9, 20, 100);
+  assert (status == SANE_STATUS_GOOD);
+  params.lines = ROWS;
+
+  status = sanei_ir_filter_madmean (&params, in, &second, 9, 20, 100);
+  assert (status == SANE_STATUS_GOOD);
+
+  /* check results */
+  assert (memcmp (first, second, ROWS * COLS * sizeof (SANE_Uint)) == 0);
+  sanei_ir_exit ();
+
+  free (small);
+  free (second);
+  free (first);
+  free (in);
+}
+
+/**
+ * run the test suite for sanei ir related tests
+ */
+static void
+sanei_ir_suite (void)
+{
+  filter_mean_small_window ();
+  filter_mean_window_taller_than_band ();
+  filter_mean_wide_window ();
+  filter_mean_even_window ();
+  filter_madmean_threads ();
+  dilate_mean_threads ();
+  spectral_clean_reference ();
+  scratch_reuse ();
+}
+
+/**
+ * main function to run the test suite
+ */
+int
+main (void)
+{
+  sanei_ir_init ();
+
+  /* run suites */
+  sanei_ir_suite ();
+
+  return 0;
+}
+
+/* vim: set sw=2 cino=>2se-1sn-1s{s^-1st0(0u0 smarttab expandtab: */
@@ -0,0 +1,462 @@
+#include "../../include/sane/config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/* sane includes for the sanei functions called */
+#include "../include/sane/sane.h"
+#include "../include/sane/sanei.h"
+#include "../include/sane/sanei_pipeline.h"
+
+/* supplies rows from a memory buffer */
+typedef struct
+{
+  const SANE_Byte *data;
+  size_t size;
+  size_t pos;
+} Memory_Source;
+
+static SANE_Status
+read_memory_row (void *arg, SANE_Byte * row, size_t row_bytes)
+{
+  Memory_Source *source = arg;
+  if (source->pos + row_bytes > source->size)
+    return SANE_STATUS_EOF;
+  memcpy (row, source->data + source->pos, row_bytes);
+  source->pos += row_bytes;
+  return SANE_STATUS_GOOD;
+}
+
+static SANEI_Pipeline *
+create_pipeline (Memory_Source * source, const SANE_Byte * data, size_t size,
+                 SANE_Frame format, SANE_Int depth, SANE_Int pixels,
+                 SANE_Int lines)
+{
+  SANE_Parameters params;
+  SANEI_Pipeline *pipeline;
+  SANE_Status status;
+
+  source->data = data;
+  source->size = size;
+  source->pos = 0;
+
+  memset (&params, 0, sizeof (params));
+  params.format = format;
+  params.last_frame = SANE_TRUE;
+  params.depth = depth;
+  params.pixels_per_line = pixels;
+  params.lines = lines;
+  params.bytes_per_line = (pixels * (format == SANE_FRAME_RGB ? 3 : 1)
+                           * depth + 7) / 8;
+
+  status = sanei_pipeline_new (&params, read_memory_row, source, &pipeline);
+  assert (status == SANE_STATUS_GOOD);
+  return pipeline;
+}
+
+/* reads the whole output in small chunks */
+static size_t
+read_all (SANEI_Pipeline * pipeline, SANE_Byte * out, size_t max_size)
+{
+  SANE_Int len;
+  size_t total = 0;
+  SANE_Status status;
+
+  do
+    {
+      SANE_Int chunk = 5;
+      if (chunk > (SANE_Int) (max_size - total))
+        chunk = max_size - total;
+      status = sanei_pipeline_read (pipeline, out + total, chunk, &len);
+      if (status == SANE_STATUS_GOOD)
+        total += len;
+    }
+  while (status == SANE_STATUS_GOOD && total < max_size);
+
+  assert (status == SANE_STATUS_GOOD || status == SANE_STATUS_EOF);
+  return total;
+}
+
+/******************************/
+/* start of tests definitions */
+/******************************/
+
+static void
+invalid_format (void)
+{
+  SANE_Parameters params;
+  SANEI_Pipeline *pipeline;
+  SANE_Status status;
+
+  memset (&params, 0, sizeof (params));
+  params.format = SANE_FRAME_RGB;
+  params.depth = 4;
+  params.pixels_per_line = 10;
+  params.bytes_per_line = 15;
+  params.lines = -1;
+
+  status = sanei_pipeline_new (&params, read_memory_row, NULL, &pipeline);
+
+  /* check results */
+  assert (status == SANE_STATUS_INVAL);
+  assert (pipeline == NULL);
+}
+
+static void
+passthrough (void)
+{
+  SANE_Byte in[] = { 1, 2, 3, 4, 5, 6 };
+  SANE_Byte out[16];
+  Memory_Source source;
+  SANEI_Pipeline *pipeline;
+  size_t size;
+
+  pipeline = create_pipeline (&source, in, sizeof (in), SANE_FRAME_GRAY, 8,
+                              3, -1);
+  size = read_all (pipeline, out, sizeof (out));
+
+  /* check results */
+  assert (size == sizeof (in));
+  assert (memcmp (out, in, size) == 0);
+  sanei_pipeline_free (pipeline);
+}
+
+static void
+color_shift (void)
+{
+  /* 1 pixel per line, green is one line late, blue two lines */
+  SANE_Byte in[] = {
+    10, 0, 0,
+    11, 20, 0,
+    12, 21, 30,
+    13, 22, 31,
+  };
+  SANE_Byte expected[] = {
+    10, 20, 30,
+    11, 21, 31,
+  };
+  int shifts[3] = { 0, 1, 2 };
+  SANE_Byte out[16];
+  Memory_Source source;
+  SANEI_Pipeline *pipeline;
+  SANE_Parameters params;
+  SANE_Status status;
+  size_t size;
+
+  pipeline = create_pipeline (&source, in, sizeof (in), SANE_FRAME_RGB, 8,
+                              1, 4);
+  status = sanei_pipeline_add_color_shift (pipeline, shifts);
+  assert (status == SANE_STATUS_GOOD);
+
+  sanei_pipeline_get_parameters (pipeline, &params);
+  assert (params.lines == 2);
+  assert (params.bytes_per_line == 3);
+
+  size = read_all (pipeline, out, sizeof (out));
+
+  /* check results */
+  assert (size == sizeof (expected));
+  assert (memcmp (out, expected, size) == 0);
+  sanei_pipeline_free (pipeline);
+}
+
+static void
+planar_to_pixel (void)
+{
+  SANE_Byte in[] = { 1, 2, 3, 4, 5, 6 };
+  SANE_Byte expected[] = { 1, 3, 5, 2, 4, 6 };
+  SANE_Byte out[16];
+  Memory_Source source;
+  SANEI_Pipeline *pipeline;
+  SANE_Status status;
+  size_t size;
+
+  pipeline = create_pipeline (&source, in, sizeof (in), SANE_FRAME_RGB, 8,
+                              2, 1);
+  status = sanei_pipeline_add_planar_to_pixel (pipeline);
+  assert (status == SANE_STATUS_GOOD);
+
+  size = read_all (pipeline, out, sizeof (out));
+
+  /* check results */
+  assert (size == sizeof (expected));
+  assert (memcmp (out, expected, size) == 0);
+  sanei_pipeline_free (pipeline);
+}
+
+static void
+expand_bits_invert (void)
+{
+  SANE_Byte in[] = { 0xa5, 0x80 };
+  SANE_Byte expected[] = {
+    0x00, 0xff, 0x00, 0xff, 0xff, 0x00, 0xff, 0x00, 0x00, 0xff
+  };
+  SANE_Byte out[16];
+  Memory_Source source;
+  SANEI_Pipeline *pipeline;
+  SANE_Parameters params;
+  SANE_Status status;
+  size_t size;
+
+  pipeline = create_pipeline (&source, in, sizeof (in), SANE_FRAME_GRAY, 1,
+                              10, 1);
+  status = sanei_pipeline_add_expand_bits (pipeline, SANE_TRUE);
+  assert (status == SANE_STATUS_GOOD);
+
+  sanei_pipeline_get_parameters (pipeline, &params);
+  assert (params.depth == 8);
+  assert (params.bytes_per_line == 10);
+
+  size = read_all (pipeline, out, sizeof (out));
+
+  /* check results */
+  assert (size == sizeof (expected));
+  assert (memcmp (out, expected, size) == 0);
+  sanei_pipeline_free (pipeline);
+}
+
+static void
+rgb_to_gray_16 (void)
+{
+  uint16_t in[] = { 65535, 65535, 65535, 10000, 0, 0 };
+  uint16_t expected[] = { 65535, 2126 };
+  uint16_t out[8];
+  Memory_Source source;
+  SANEI_Pipeline *pipeline;
+  SANE_Status status;
+  size_t size;
+
+  pipeline = create_pipeline (&source, (SANE_Byte *) in, sizeof (in),
+                              SANE_FRAME_RGB, 16, 2, 1);
+  status = sanei_pipeline_add_rgb_to_gray (pipeline);
+  assert (status == SANE_STATUS_GOOD);
+
+  size = read_all (pipeline, (SANE_Byte *) out, sizeof (out));
+
+  /* check results */
+  assert (size == sizeof (expected));
+  assert (memcmp (out, expected, size) == 0);
+  sanei_pipeline_free (pipeline);
+}
+
+static void
+rgb_to_gray_weighted (void)
+{
+  SANE_Byte in[] = { 100, 0, 0, 0, 200, 0, 60, 60, 60 };
+  SANE_Byte expected[] = { 25, 100, 60 };
+  int weights[3] = { 1, 2, 1 };
+  int bad_weights[3] = { 0, 0, 0 };
+  SANE_Byte out[8];
+  Memory_Source source;
+  SANEI_Pipeline *pipeline;
+  SANE_Status status;
+  size_t size;
+
+  pipeline = create_pipeline (&source, in, sizeof (in), SANE_FRAME_RGB, 8,
+                              3, 1);
+  status = sanei_pipeline_add_rgb_to_gray_weighted (pipeline, bad_weights);
+  assert (status == SANE_STATUS_INVAL);
+  status = sanei_pipeline_add_rgb_to_gray_weighted (pipeline, weights);
+  assert (status == SANE_STATUS_GOOD);
+
+  size = read_all (pipeline, out, sizeof (out));
+
+  /* check results */
+  assert (size == sizeof (expected));
+  assert (memcmp (out, expected, size) == 0);
+  sanei_pipeline_free (pipeline);
+}
+
+static void
+threshold (void)
+{
+  SANE_Byte in[] = { 0, 127, 128, 255, 10, 200, 0, 1, 255, 0 };
+  SANE_Byte expected[] = { 0xcb, 0x40 };
+  SANE_Byte out[4];
+  SANE_Parameters params;
+  Memory_Source source;
+  SANEI_Pipeline *pipeline;
+  SANE_Status status;
+  size_t size;
+
+  pipeline = create_pipeline (&source, in, sizeof (in), SANE_FRAME_GRAY, 8,
+                              10, 1);
+  status = sanei_pipeline_add_threshold (pipeline, 128);
+  assert (status == SANE_STATUS_GOOD);
+
+  /* only 8-bit gray can be thresholded */
+  status = sanei_pipeline_add_threshold (pipeline, 128);
+  assert (status == SANE_STATUS_INVAL);
+
+  sanei_pipeline_get_parameters (pipeline, &params);
+  assert (params.depth == 1);
+  assert (params.bytes_per_line == 2);
+
+  size = read_all (pipeline, out, sizeof (out));
+
+  /* check results */
+  assert (size == sizeof (expected));
+  assert (memcmp (out, expected, size) == 0);
+  sanei_pipeline_free (pipeline);
+}
+
+static void
+deinterlace (void)
+{
+  /* two images interlaced in groups of two rows, the last group is cut */
+  SANE_Byte in[] = { 1, 2, 11, 12, 3, 4, 13, 14, 5 };
+  SANE_Byte expected_front[] = { 1, 2, 3, 4, 5 };
+  SANE_Byte expected_back[] = { 11, 12, 13, 14 };
+  SANE_Byte out[16];
+  SANE_Parameters params;
+  Memory_Source source;
+  SANEI_Pipeline *pipeline;
+  SANE_Status status;
+  size_t size;
+
+  pipeline = create_pipeline (&source, in, sizeof (in), SANE_FRAME_GRAY, 8,
+                              1, sizeof (in));
+  status = sanei_pipeline_add_deinterlace (pipeline, 2, 2, 2);
+  assert (status == SANE_STATUS_INVAL);
+  status = sanei_pipeline_add_deinterlace (pipeline, 2, 0, 2);
+  assert (status == SANE_STATUS_GOOD);
+
+  sanei_pipeline_get_parameters (pipeline, &params);
+  assert (params.lines == sizeof (expected_front));
+
+  size = read_all (pipeline, out, sizeof (out));
+  assert (size == sizeof (expected_front));
+  assert (memcmp (out, expected_front, size) == 0);
+  sanei_pipeline_free (pipeline);
+
+  pipeline = create_pipeline (&source, in, sizeof (in), SANE_FRAME_GRAY, 8,
+                              1, sizeof (in));
+  status = sanei_pipeline_add_deinterlace (pipeline, 2, 1, 2);
+  assert (status == SANE_STATUS_GOOD);
+
+  sanei_pipeline_get_parameters (pipeline, &params);
+  assert (params.lines == sizeof (expected_back));
+
+  size = read_all (pipeline, out, sizeof (out));
+
+  /* check results */
+  assert (size == sizeof (expected_back));
+  assert (memcmp (out, expected_back, size) == 0);
+  sanei_pipeline_free (pipeline);
+}
+
+static void
+mirror_rgb (void)
+{
+  SANE_Byte in[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+  SANE_Byte expected[] = { 7, 8, 9, 4, 5, 6, 1, 2, 3 };
+  SANE_Byte out[16];
+  Memory_Source source;
+  SANEI_Pipeline *pipeline;
+  SANE_Status status;
+  size_t size;
+
+  pipeline = create_pipeline (&source, in, sizeof (in), SANE_FRAME_RGB, 8,
+                              3, 1);
+  status = sanei_pipeline_add_mirror (pipeline);
+  assert (status == SANE_STATUS_GOOD);
+
+  size = read_all (pipeline, out, sizeof (out));
+
+  /* check results */
+  assert (size == sizeof (expected));
+  assert (memcmp (out, expected, size) == 0);
+  sanei_pipeline_free (pipeline);
+}
+
+static void
+mirror_lineart (void)
+{
+  SANE_Byte in[] = { 0xc1, 0x00 };
+  SANE_Byte expected[] = { 0x20, 0xc0 };
+  SANE_Byte out[4];
+  Memory_Source source;
+  SANEI_Pipeline *pipeline;
+  SANE_Status status;
+  size_t size;
+
+  pipeline = create_pipeline (&source, in, sizeof (in), SANE_FRAME_GRAY, 1,
+                              10, 1);
+  status = sanei_pipeline_add_mirror (pipeline);
+  assert (status == SANE_STATUS_GOOD);
+
+  size = read_all (pipeline, out, sizeof (out));
+
+  /* check results */
+  assert (size == sizeof (expected));
+  assert (memcmp (out, expected, size) == 0);
+  sanei_pipeline_free (pipeline);
+}
+
+static void
+reset_and_reread (void)
+{
+  SANE_Byte in[] = { 1, 2, 3, 4 };
+  SANE_Byte out[8];
+  Memory_Source source;
+  SANEI_Pipeline *pipeline;
+  SANE_Status status;
+  size_t size;
+
+  pipeline = create_pipeline (&source, in, sizeof (in), SANE_FRAME_GRAY, 8,
+                              2, 2);
+  status = sanei_pipeline_add_mirror (pipeline);
+  assert (status == SANE_STATUS_GOOD);
+
+  size = read_all (pipeline, out, sizeof (out));
+  assert (size == 4);
+
+  /* nodes can't be added once reading has started */
+  status = sanei_pipeline_add_mirror (pipeline);
+  assert (status == SANE_STATUS_INVAL);
+
+  sanei_pipeline_reset (pipeline);
+  source.pos = 0;
+  size = read_all (pipeline, out, sizeof (out));
+
+  /* check results */
+  assert (size == 4);
+  assert (out[0] == 2 && out[1] == 1 && out[2] == 4 && out[3] == 3);
+  sanei_pipeline_free (pipeline);
+}
+
+/**
+ * run the test suite for sanei pipeline related tests
+ */
+static void
+sanei_pipeline_suite (void)
+{
+  invalid_format ();
+  passthrough ();
+  color_shift ();
+  planar_to_pixel ();
+  expand_bits_invert ();
+  rgb_to_gray_16 ();
+  rgb_to_gray_weighted ();
+  threshold ();
+  deinterlace ();
+  mirror_rgb ();
+  mirror_lineart ();
+  reset_and_reread ();
+}
+
+/**
+ * main function to run the test suite
+ */
+int
+main (void)
+{
+  /* run suites */
+  sanei_pipeline_suite ();
+
+  return 0;
+}
+
+/* vim: set sw=2 cino=>2se-1sn-1s{s^-1st0(0u0 smarttab expandtab: */
@@ -17,6 +17,9 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 #include <assert.h>
 
@@ -826,6 +829,613 @@ test_attach (void)
   return 1;
 }
 
+/** feed one round of measurements to a tuning direction
+ * records TUNE_SAMPLES transfers of the current size at the given rate
+ * in bytes per millisecond and lets the tuning pick the next size
+ */
+static void
+tuning_sample (sanei_usb_tuning_dir * t, unsigned long long rate)
+{
+  t->samples[t->cur] = TUNE_SAMPLES;
+  t->bytes[t->cur] = rate * 8;
+  t->usec[t->cur] = 8000;
+  sanei_usb_tuning_step (t);
+}
+
+/** test the choice of the bulk transfer size
+ * the smallest size within TUNE_KEEP_PERCENT of the best rate is kept
+ * @return 1 on success, else 0
+ */
+static int
+test_tuning_step (void)
+{
+  sanei_usb_tuning_dir t;
+
+  printf ("%s starting ...\n", __func__);
+
+  memset (&t, 0, sizeof (t));
+  t.lo = 9;
+  t.hi = t.cur = 14;
+  tuning_sample (&t, 1000);
+  tuning_sample (&t, 1000);
+  /* exactly 95% of the best rate is still good enough */
+  tuning_sample (&t, 950);
+  if (t.settled || t.cur != 11)
+    {
+      printf ("ERROR: tuning stopped at %u, expected 11!\n", t.cur);
+      return 0;
+    }
+  /* just below it the previous size is kept */
+  tuning_sample (&t, 949);
+  if (!t.settled || t.cur != 12)
+    {
+      printf ("ERROR: tuning settled at %u, expected 12!\n", t.cur);
+      return 0;
+    }
+
+  /* a rate that doesn't depend on the size ends at the smallest size */
+  memset (&t, 0, sizeof (t));
+  t.lo = 9;
+  t.hi = t.cur = 11;
+  tuning_sample (&t, 1000);
+  tuning_sample (&t, 1000);
+  tuning_sample (&t, 1000);
+  if (!t.settled || t.cur != 9)
+    {
+      printf ("ERROR: tuning settled at %u, expected 9!\n", t.cur);
+      return 0;
+    }
+
+  printf ("%s success\n\n", __func__);
+  return 1;
+}
+
+/** check that the tuning file contains exactly the expected lines
+ * @return 1 on success, else 0
+ */
+static int
+check_tuning_file (const char *path, const char *expected)
+{
+  char data[256];
+  size_t size;
+  FILE *f = fopen (path, "r");
+
+  if (f == NULL)
+    {
+      printf ("ERROR: %s not written!\n", path);
+      return 0;
+    }
+  size = fread (data, 1, sizeof (data) - 1, f);
+  fclose (f);
+  data[size] = 0;
+  if (strcmp (data, expected) != 0)
+    {
+      printf ("ERROR: unexpected tuning file contents:\n%s", data);
+      return 0;
+    }
+  return 1;
+}
+
+/** test sanei_usb_get_bulk_size
+ * tunes a mock device, stores the result in SANE_USB_TUNING_FILE and
+ * reuses it, and checks that tuning is off when disabled or replaying
+ * @return 1 on success, else 0
+ */
+static int
+test_tuning (void)
+{
+  const char *path = "sanei_usb_test_tuning";
+  device_list_type mock;
+  SANE_Int dn;
+  size_t size;
+  FILE *f;
+  int ret = 0;
+
+  printf ("%s starting ...\n", __func__);
+
+  create_mock_device ("libusb:001:042", &mock);
+  store_device (mock);
+  for (dn = 0; dn < device_number; dn++)
+    {
+      if (devices[dn].devname && !strcmp (devices[dn].devname, mock.devname))
+	break;
+    }
+
+  unsetenv ("SANE_USB_TUNING");
+  setenv ("SANE_USB_TUNING_FILE", path, 1);
+  sanei_usb_tuning_init ();
+
+  /* entries of other devices are kept, stale ones replaced, sizes
+   * outside of the candidates ignored */
+  f = fopen (path, "w");
+  if (f == NULL)
+    {
+      printf ("ERROR: could not create %s\n", path);
+      goto out;
+    }
+  fputs ("1234:5678 in libusb:002 8192\n"
+	 "dead:beef in libusb:001 1048576\n", f);
+  fclose (f);
+
+  /* tuning starts with the largest power of two */
+  size = sanei_usb_get_bulk_size (dn, USB_DIR_IN, 512, 100000);
+  if (size != 65536 || device_tunings[dn]->dir[0].settled)
+    {
+      printf ("ERROR: expected untuned 65536, got %lu!\n",
+	      (unsigned long) size);
+      goto out;
+    }
+  tuning_sample (&device_tunings[dn]->dir[0], 1000);
+  tuning_sample (&device_tunings[dn]->dir[0], 1000);
+  tuning_sample (&device_tunings[dn]->dir[0], 990);
+  tuning_sample (&device_tunings[dn]->dir[0], 500);
+  size = sanei_usb_get_bulk_size (dn, USB_DIR_IN, 512, 100000);
+  if (size != 16384)
+    {
+      printf ("ERROR: expected tuned 16384, got %lu!\n",
+	      (unsigned long) size);
+      goto out;
+    }
+  /* the other direction is tuned separately */
+  size = sanei_usb_get_bulk_size (dn, USB_DIR_OUT, 512, 100000);
+  if (size != 65536)
+    {
+      printf ("ERROR: expected untuned 65536 out, got %lu!\n",
+	      (unsigned long) size);
+      goto out;
+    }
+
+  /* only settled directions are stored */
+  sanei_usb_tuning_close (dn);
+  if (!check_tuning_file (path, "1234:5678 in libusb:002 8192\n"
+			  "dead:beef in libusb:001 16384\n"))
+    goto out;
+
+  /* the next session starts with the stored size */
+  size = sanei_usb_get_bulk_size (dn, USB_DIR_IN, 512, 100000);
+  if (size != 16384 || !device_tunings[dn]->dir[0].settled)
+    {
+      printf ("ERROR: expected stored 16384, got %lu!\n",
+	      (unsigned long) size);
+      goto out;
+    }
+  sanei_usb_tuning_close (dn);
+
+  /* an empty file name disables storing the sizes */
+  setenv ("SANE_USB_TUNING_FILE", "", 1);
+  unlink (path);
+  size = sanei_usb_get_bulk_size (dn, USB_DIR_IN, 512, 100000);
+  if (size != 65536)
+    {
+      printf ("ERROR: expected untuned 65536, got %lu!\n",
+	      (unsigned long) size);
+      goto out;
+    }
+  device_tunings[dn]->dir[0].settled = 1;
+  sanei_usb_tuning_close (dn);
+  if (access (path, F_OK) == 0)
+    {
+      printf ("ERROR: %s written although disabled!\n", path);
+      goto out;
+    }
+
+  /* disabled tuning and replay use the size given by the backend */
+  setenv ("SANE_USB_TUNING", "0", 1);
+  sanei_usb_tuning_init ();
+  size = sanei_usb_get_bulk_size (dn, USB_DIR_IN, 512, 100000);
+  if (size != 100000 || device_tunings[dn] != NULL)
+    {
+      printf ("ERROR: tuning not disabled!\n");
+      goto out;
+    }
+  unsetenv ("SANE_USB_TUNING");
+  sanei_usb_tuning_init ();
+  testing_mode = sanei_usb_testing_mode_replay;
+  size = sanei_usb_get_bulk_size (dn, USB_DIR_IN, 512, 100000);
+  testing_mode = sanei_usb_testing_mode_disabled;
+  if (size != 100000 || device_tunings[dn] != NULL)
+    {
+      printf ("ERROR: tuning active during replay!\n");
+      goto out;
+    }
+
+  ret = 1;
+  printf ("%s success\n\n", __func__);
+
+out:
+  sanei_usb_tuning_close (dn);
+  unsetenv ("SANE_USB_TUNING_FILE");
+  unlink (path);
+
+  /* remove mock device */
+  device_number--;
+  free (devices[device_number].devname);
+  devices[device_number].devname = NULL;
+
+  return ret;
+}
+
+#ifdef HAVE_PTHREAD_H
+#define TRACE_TEST_THREADS 4
+#define TRACE_TEST_TRANSFERS 20000
+
+static void *
+trace_transfers (void *arg)
+{
+  SANE_Int dn = *(SANE_Int *) arg;
+  struct timeval start;
+  int i;
+
+  for (i = 0; i < TRACE_TEST_TRANSFERS; i++)
+    {
+      sanei_usb_trace_start (&start);
+      sanei_usb_trace_transfer (dn, sanei_usb_trace_bulk_out, &start,
+				SANE_STATUS_GOOD, 64);
+    }
+  return NULL;
+}
+#endif
+
+/* returns 1 if a line of path starts with prefix */
+static int
+trace_file_contains (const char *path, const char *prefix)
+{
+  char buf[256];
+  FILE *f = fopen (path, "r");
+  int found = 0;
+
+  if (f == NULL)
+    return 0;
+  while (!found && fgets (buf, sizeof (buf), f) != NULL)
+    found = strncmp (buf, prefix, strlen (prefix)) == 0;
+  fclose (f);
+  return found;
+}
+
+/** test transfer tracing
+ * records transfers of a mock device, checks the histograms, the ring of
+ * recent transfers, the counts under concurrent transfers and the dump
+ * @return 1 on success, else 0
+ */
+static int
+test_trace (void)
+{
+  const char *path = "sanei_usb_test_trace";
+  device_list_type mock;
+  sanei_usb_trace_stats *stats;
+  sanei_usb_trace_record rec;
+  struct timeval start;
+  unsigned long latency;
+  SANE_Int dn;
+  int i, ret = 0;
+
+  printf ("%s starting ...\n", __func__);
+
+  create_mock_device ("libusb:001:043", &mock);
+  store_device (mock);
+  for (dn = 0; dn < device_number; dn++)
+    {
+      if (devices[dn].devname && !strcmp (devices[dn].devname, mock.devname))
+	break;
+    }
+
+  unlink (path);
+  setenv ("SANE_USB_TRACE", path, 1);
+  sanei_usb_trace_init ();
+  sanei_usb_trace_open (dn);
+  if (device_traces[dn] == NULL)
+    {
+      printf ("ERROR: tracing not enabled!\n");
+      goto out;
+    }
+
+  /* three 512 byte reads, a 100 byte read, an error and an EOF, all taking
+   * at least 600 us */
+  for (i = 0; i < 6; i++)
+    {
+      SANE_Status status = SANE_STATUS_GOOD;
+      size_t size = i < 3 ? 512 : 100;
+
+      if (i == 4)
+	status = SANE_STATUS_IO_ERROR;
+      if (i == 5)
+	status = SANE_STATUS_EOF;
+      gettimeofday (&start, NULL);
+      start.tv_sec -= 1;
+      start.tv_usec += 1000000 - 600;
+      sanei_usb_trace_transfer (dn, sanei_usb_trace_bulk_in, &start, status,
+				size);
+    }
+  stats = &device_traces[dn]->stats[sanei_usb_trace_bulk_in];
+  if (stats->count != 6 || stats->bytes != 3 * 512 + 100
+      || stats->errors != 1 || stats->size_count[10] != 3
+      || stats->size_count[7] != 1 || stats->size_bytes[10] != 3 * 512
+      || stats->max_usec < 600)
+    {
+      printf ("ERROR: wrong bulk in statistics!\n");
+      goto out;
+    }
+  latency = 0;
+  for (i = 10; i < TRACE_NUM_BUCKETS; i++)
+    latency += stats->latency_count[i];
+  if (latency != 6)
+    {
+      printf ("ERROR: wrong latency histogram!\n");
+      goto out;
+    }
+
+  /* the ring keeps the most recent transfers */
+  for (i = 0; i < TRACE_RING_SIZE + 10; i++)
+    {
+      sanei_usb_trace_start (&start);
+      sanei_usb_trace_transfer (dn, sanei_usb_trace_control, &start,
+				SANE_STATUS_GOOD, i);
+    }
+  if (device_traces[dn]->ring_head != 6 + TRACE_RING_SIZE + 10)
+    {
+      printf ("ERROR: wrong ring head!\n");
+      goto out;
+    }
+  if (!sanei_usb_trace_copy_record (&rec, device_traces[dn],
+				    5 + TRACE_RING_SIZE + 10)
+      || rec.kind != sanei_usb_trace_control
+      || rec.size != TRACE_RING_SIZE + 9)
+    {
+      printf ("ERROR: wrong last record!\n");
+      goto out;
+    }
+  if (sanei_usb_trace_copy_record (&rec, device_traces[dn], 5))
+    {
+      printf ("ERROR: overwritten record still in the ring!\n");
+      goto out;
+    }
+
+#ifdef HAVE_PTHREAD_H
+  /* no counts are lost with transfers from several threads */
+  {
+    pthread_t threads[TRACE_TEST_THREADS];
+
+    for (i = 0; i < TRACE_TEST_THREADS; i++)
+      pthread_create (&threads[i], NULL, trace_transfers, &dn);
+    for (i = 0; i < TRACE_TEST_THREADS; i++)
+      pthread_join (threads[i], NULL);
+    stats = &device_traces[dn]->stats[sanei_usb_trace_bulk_out];
+    if (stats->count != TRACE_TEST_THREADS * TRACE_TEST_TRANSFERS
+	|| stats->bytes != 64ull * TRACE_TEST_THREADS * TRACE_TEST_TRANSFERS
+	|| stats->size_count[7] != stats->count
+	|| device_traces[dn]->ring_head != 6 + TRACE_RING_SIZE + 10
+	+ TRACE_TEST_THREADS * TRACE_TEST_TRANSFERS)
+      {
+	printf ("ERROR: counts lost with concurrent transfers!\n");
+	goto out;
+      }
+  }
+#endif
+
+  /* closing the device dumps the statistics */
+  sanei_usb_trace_close (dn);
+  if (device_traces[dn] != NULL
+      || !trace_file_contains (path, "sanei_usb trace: device "
+			       "libusb:001:043 (0xdead/0xbeef)\n")
+      || !trace_file_contains (path, "  bulk in: 6 transfers, 1636 bytes, "
+			       "1 errors")
+      || !trace_file_contains (path, "    size <     1024:        3 "
+			       "transfers")
+      || !trace_file_contains (path, "  last 32 transfers:\n"))
+    {
+      printf ("ERROR: wrong trace dump!\n");
+      goto out;
+    }
+
+  /* nothing is recorded or dumped when tracing is disabled */
+  unlink (path);
+  unsetenv ("SANE_USB_TRACE");
+  sanei_usb_trace_init ();
+  sanei_usb_trace_open (dn);
+  sanei_usb_trace_dump (dn);
+  if (device_traces[dn] != NULL || access (path, F_OK) == 0)
+    {
+      printf ("ERROR: tracing not disabled!\n");
+      goto out;
+    }
+
+  ret = 1;
+  printf ("%s success\n\n", __func__);
+
+out:
+  sanei_usb_trace_close (dn);
+  unsetenv ("SANE_USB_TRACE");
+  sanei_usb_trace_init ();
+  unlink (path);
+
+  /* remove mock device */
+  device_number--;
+  free (devices[device_number].devname);
+  devices[device_number].devname = NULL;
+
+  return ret;
+}
+
+#if WITH_USB_RECORD_REPLAY
+static const char *capture_xml =
+  "<?xml version=\"1.0\"?>\n"
+  "<device_capture backend=\"test\">\n"
+  "  <description id_vendor=\"0x04a9\" id_product=\"0x2206\">\n"
+  "    <configurations>\n"
+  "      <configuration number=\"1\">\n"
+  "        <interface number=\"0\">\n"
+  "          <endpoint transfer_type=\"BULK\" number=\"1\" direction=\"IN\" address=\"0x81\"/>\n"
+  "          <endpoint transfer_type=\"BULK\" number=\"2\" direction=\"OUT\" address=\"0x02\"/>\n"
+  "        </interface>\n"
+  "      </configuration>\n"
+  "    </configurations>\n"
+  "  </description>\n"
+  "  <transactions>\n"
+  "    <control_tx time_usec=\"0\" seq=\"1\" endpoint_number=\"0x0\" direction=\"OUT\" bmRequestType=\"0x40\" bRequest=\"0x0c\" wValue=\"0x0083\" wIndex=\"0x0000\" wLength=\"1\">6a</control_tx>\n"
+  "    <bulk_tx time_usec=\"0\" seq=\"2\" endpoint_number=\"0x2\" direction=\"OUT\">01 02 03 04</bulk_tx>\n"
+  "    <debug seq=\"3\" message=\"scan start\"/>\n"
+  "    <bulk_tx time_usec=\"0\" seq=\"4\" endpoint_number=\"0x1\" direction=\"IN\">de ad be ef 00 11 22 33 44</bulk_tx>\n"
+  "    <bulk_tx time_usec=\"0\" seq=\"5\" endpoint_number=\"0x1\" direction=\"IN\">(unknown read of allowed size 16)</bulk_tx>\n"
+  "    <bulk_tx time_usec=\"0\" seq=\"6\" endpoint_number=\"0x1\" direction=\"IN\">ab cd</bulk_tx>\n"
+  "    <debug seq=\"7\" message=\"note\">12 34</debug>\n"
+  "  </transactions>\n"
+  "</device_capture>\n";
+
+static int
+read_whole_file (const char *path, char **data, size_t * size)
+{
+  FILE *f = fopen (path, "rb");
+  long len;
+
+  if (f == NULL)
+    return 0;
+  fseek (f, 0, SEEK_END);
+  len = ftell (f);
+  fseek (f, 0, SEEK_SET);
+  *data = malloc (len + 1);
+  *size = fread (*data, 1, len, f);
+  fclose (f);
+  return *size == (size_t) len;
+}
+
+/* returns 1 if the NUL-terminated str is stored in data */
+static int
+contains_string (const char *data, size_t size, const char *str)
+{
+  size_t len = strlen (str) + 1;
+  size_t i;
+
+  for (i = 0; i + len <= size; i++)
+    if (memcmp (data + i, str, len) == 0)
+      return 1;
+  return 0;
+}
+
+/** test conversion between XML and binary USB captures
+ * converts a capture XML -> binary -> XML -> binary, checks that both binary
+ * captures are identical, that transaction data is stored as payload and
+ * indexed, and replays the binary one
+ * @return 1 on success, else 0
+ */
+static int
+test_capture_convert (void)
+{
+  const char *xml_path = "sanei_usb_test_capture.xml";
+  const char *bin_path = "sanei_usb_test_capture.usbcap";
+  const char *xml2_path = "sanei_usb_test_capture2.xml";
+  const char *bin2_path = "sanei_usb_test_capture2.usbcap";
+  char *bin_data, *bin2_data;
+  size_t bin_size, bin2_size;
+  SANE_Byte buffer[16];
+  SANE_Byte data[1] = { 0x6a };
+  size_t size;
+  SANE_Int dn;
+  FILE *f;
+  int ret = 1;
+
+  printf ("%s starting ...\n", __func__);
+
+  f = fopen (xml_path, "w");
+  if (f == NULL)
+    {
+      printf ("ERROR: could not create %s\n", xml_path);
+      return 0;
+    }
+  fputs (capture_xml, f);
+  fclose (f);
+
+  if (sanei_usb_testing_convert_capture (xml_path, bin_path) != SANE_STATUS_GOOD
+      || sanei_usb_testing_convert_capture (bin_path, xml2_path) != SANE_STATUS_GOOD
+      || sanei_usb_testing_convert_capture (xml2_path, bin2_path) != SANE_STATUS_GOOD)
+    {
+      printf ("ERROR: capture conversion failed\n");
+      return 0;
+    }
+
+  if (!read_whole_file (bin_path, &bin_data, &bin_size)
+      || !read_whole_file (bin2_path, &bin2_data, &bin2_size))
+    {
+      printf ("ERROR: could not read converted captures\n");
+      return 0;
+    }
+  if (bin_size != bin2_size || memcmp (bin_data, bin2_data, bin_size) != 0)
+    {
+      printf ("ERROR: binary captures differ after round trip\n");
+      ret = 0;
+    }
+  /* hex data of transactions is a payload, other text is a string */
+  if (contains_string (bin_data, bin_size, "ab cd")
+      || !contains_string (bin_data, bin_size, "12 34")
+      || !contains_string (bin_data, bin_size,
+                           "(unknown read of allowed size 16)"))
+    {
+      printf ("ERROR: wrong text stored as payload\n");
+      ret = 0;
+    }
+  /* all 7 transactions are indexed */
+  if (bin_size < 40 || bin_data[36] != 7 || bin_data[37] != 0
+      || bin_data[38] != 0 || bin_data[39] != 0)
+    {
+      printf ("ERROR: transactions are not indexed\n");
+      ret = 0;
+    }
+  free (bin_data);
+  free (bin2_data);
+
+  /* replay the binary capture */
+  if (sanei_usb_testing_enable_replay (bin_path, 0) != SANE_STATUS_GOOD)
+    {
+      printf ("ERROR: could not enable replay of %s\n", bin_path);
+      return 0;
+    }
+  sanei_usb_init ();
+  if (sanei_usb_open (bin_path, &dn) != SANE_STATUS_GOOD)
+    {
+      printf ("ERROR: could not open replayed device\n");
+      ret = 0;
+    }
+  else
+    {
+      if (sanei_usb_control_msg (dn, 0x40, 0x0c, 0x83, 0, 1, data)
+	  != SANE_STATUS_GOOD)
+	{
+	  printf ("ERROR: control_msg replay failed\n");
+	  ret = 0;
+	}
+      buffer[0] = 1;
+      buffer[1] = 2;
+      buffer[2] = 3;
+      buffer[3] = 4;
+      size = 4;
+      if (sanei_usb_write_bulk (dn, buffer, &size) != SANE_STATUS_GOOD)
+	{
+	  printf ("ERROR: write_bulk replay failed\n");
+	  ret = 0;
+	}
+      sanei_usb_testing_record_message ("scan start");
+      size = 9;
+      if (sanei_usb_read_bulk (dn, buffer, &size) != SANE_STATUS_GOOD
+	  || size != 9 || buffer[0] != 0xde || buffer[8] != 0x44)
+	{
+	  printf ("ERROR: read_bulk replay returned wrong data\n");
+	  ret = 0;
+	}
+      sanei_usb_close (dn);
+    }
+  sanei_usb_exit ();
+  testing_mode = sanei_usb_testing_mode_disabled;
+
+  unlink (xml_path);
+  unlink (bin_path);
+  unlink (xml2_path);
+  unlink (bin2_path);
+
+  if (ret)
+    printf ("%s success\n\n", __func__);
+  return ret;
+}
+#endif /* WITH_USB_RECORD_REPLAY */
+
 int
 main (int __sane_unused__ argc, char **argv)
 {
@@ -924,6 +1534,13 @@ main (int __sane_unused__ argc, char **argv)
   /* test attach matching device with a mock */
   assert (test_attach ());
 
+  /* pick bulk transfer sizes for a mock device */
+  assert (test_tuning_step ());
+  assert (test_tuning ());
+
+  /* record transfer statistics of a mock device */
+  assert (test_trace ());
+
   /* try to call sanei_usb_exit() when it not initialized */
   assert (test_exit (0));
 
@@ -942,6 +1559,11 @@ main (int __sane_unused__ argc, char **argv)
   /* finally free resources */
   assert (test_exit (0));
 
+#if WITH_USB_RECORD_REPLAY
+  /* convert and replay captures */
+  assert (test_capture_convert ());
+#endif
+
   /* all the tests are OK ! */
   return 0;
 }
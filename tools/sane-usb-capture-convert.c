@@ -0,0 +1,58 @@
+/* sane - Scanner Access Now Easy.
+
+   sane-usb-capture-convert
+
+   Converts USB captures used by the sanei_usb record-replay testing mode
+   between the XML and binary formats.
+
+   This file is part of the SANE package.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "../include/sane/config.h"
+
+#include <stdio.h>
+
+#include "../include/sane/sane.h"
+#include "../include/sane/sanei.h"
+#include "../include/sane/sanei_usb.h"
+
+int
+main (int argc, char **argv)
+{
+  SANE_Status status;
+  int i;
+
+  if (argc < 3 || argc % 2 == 0)
+    {
+      fprintf (stderr, "Usage: %s INPUT OUTPUT [INPUT OUTPUT ...]\n"
+	       "Converts USB captures between the XML and binary formats.\n"
+	       "OUTPUT is written in the binary format if its name ends "
+	       "with .usbcap\n", argv[0]);
+      return 1;
+    }
+
+  for (i = 1; i + 1 < argc; i += 2)
+    {
+      status = sanei_usb_testing_convert_capture (argv[i], argv[i + 1]);
+      if (status != SANE_STATUS_GOOD)
+	{
+	  fprintf (stderr, "%s: could not convert %s to %s: %s\n", argv[0],
+		   argv[i], argv[i + 1], sane_strstatus (status));
+	  return 1;
+	}
+    }
+  return 0;
+}